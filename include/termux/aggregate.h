@@ -0,0 +1,115 @@
+/*!
+ @file aggregate.h
+ @brief statistics of sensor samples over windows
+ @details samples are arrays of axes values one after another, as termux_sensor() and streams give them.
+ a window covers window samples and the next one starts step samples later: step equal to window gives
+ tumbling windows, a shorter step sliding windows and a longer one skips the samples between them.
+ each window is reduced on its own with vector kernels chosen for the processor at run time.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_AGGREGATE_H__
+#define __TERMUX_AGGREGATE_H__
+
+#include "sensor.h"
+
+/*!
+ @brief kernels of the reduction
+*/
+enum
+{
+    TERMUX_SIMD_NONE, //!< scalar code
+    TERMUX_SIMD_128, //!< vectors of 128 bits, SSE2 or NEON
+    TERMUX_SIMD_256, //!< vectors of 256 bits, AVX
+    TERMUX_SIMD_MAX //!< the widest the processor has
+};
+
+/*!
+ @brief statistics of an axis over a window
+*/
+typedef struct termux_window_s
+{
+    double mean;
+    double min;
+    double max;
+    double var; //!< variance of the population, divided by the samples
+    double rms; //!< root mean square
+} termux_window_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief instance structure for windows over batches of samples
+*/
+typedef struct termux_aggregate_s
+{
+    int axes; //!< values of a sample
+    size_t window; //!< samples of a window
+    size_t step; //!< samples from the start of a window to the next
+    size_t windows; //!< windows reduced
+    /* private */
+    double *buf; //!< samples of a window split between batches
+    size_t fill; //!< samples in buf
+    size_t skip; //!< samples to drop before the next window
+} termux_aggregate_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief choose the kernels of the reduction
+ @param[in] simd TERMUX_SIMD_NONE, TERMUX_SIMD_128, TERMUX_SIMD_256 or TERMUX_SIMD_MAX
+ @return the kernels in use, no wider than the processor has
+*/
+int termux_aggregate_simd(int simd);
+
+/*!
+ @brief reduce the windows of an array of samples
+ @param[in] values n samples of axes values
+ @param[in] axes values of a sample, 1~TERMUX_SAMPLE_MAX
+ @param[in] window samples of a window
+ @param[in] step samples from the start of a window to the next
+ @param[out] stats axes statistics for each window, room for (n - window) / step + 1 windows
+ @return number of windows
+*/
+size_t termux_aggregate(const double *values, size_t n, int axes, size_t window, size_t step, termux_window_s *stats);
+
+/*!
+ @brief start windows over batches of samples
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_aggregate_init(termux_aggregate_s *ctx, int axes, size_t window, size_t step);
+
+/*!
+ @brief feed a batch of samples, the windows it completes are reported at once
+ @param[in] values n samples of axes values
+ @param[in] done called with axes statistics for each window
+ @return number of windows completed
+*/
+size_t termux_aggregate_feed(termux_aggregate_s *ctx, const double *values, size_t n,
+                             void (*done)(const termux_window_s *stats, int axes, void *arg), void *arg);
+
+/*!
+ @brief drop the samples of a window not yet complete
+*/
+void termux_aggregate_reset(termux_aggregate_s *ctx);
+
+/*!
+ @brief free the memory of windows over batches
+*/
+void termux_aggregate_exit(termux_aggregate_s *ctx);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_AGGREGATE_H__ */
@@ -0,0 +1,119 @@
+/*!
+ @file align.h
+ @brief samples of several sensors aligned into frames at a fixed rate
+ @details each sensor keeps its newest samples in a ring, and frames are taken at multiples of the period
+ by holding the sample before or by a line between the samples around. a frame is ready once every sensor
+ has a sample at or after its time, or once the latency passed: a sensor that fell behind is then held
+ and marked stale. frames older than the samples kept are skipped. memory is fixed when the stage is made.
+ the stage is not shared between threads.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_ALIGN_H__
+#define __TERMUX_ALIGN_H__
+
+#include "sensor.h"
+
+#define TERMUX_ALIGN_MAX 8 //!< most sensors in a frame
+
+/*!
+ @brief ways to take a value between two samples
+*/
+enum
+{
+    TERMUX_ALIGN_HOLD, //!< the sample before
+    TERMUX_ALIGN_LINEAR //!< the line between the sample before and the one after
+};
+
+typedef struct termux_align_s termux_align_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief values of all sensors at one time
+*/
+typedef struct termux_frame_s
+{
+    uint64_t ns; //!< time of the frame
+    int sensors; //!< sensors in the frame, in the order they were asked for
+    unsigned int stale; //!< bit i is set if sensor i had no sample since the time of the frame
+    int n[TERMUX_ALIGN_MAX]; //!< number of values of each sensor
+    double values[TERMUX_ALIGN_MAX][TERMUX_SAMPLE_MAX];
+} termux_frame_s;
+
+/*!
+ @brief counters of an alignment stage
+*/
+typedef struct termux_align_stat_s
+{
+    uint64_t pushed; //!< samples taken
+    uint64_t dropped; //!< samples older than the newest of their sensor, or pushed out of a full ring
+    uint64_t frames; //!< frames given
+    uint64_t skipped; //!< frames older than the samples kept
+    uint64_t stale; //!< sensors held past their newest sample in the frames given
+} termux_align_stat_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief make an alignment stage
+ @param[in] sensors names of the sensors separated by commas, as for termux_stream_open().
+ a sensor takes the samples of its own name, ignoring case, or when no sensor of a report has it,
+ of the first name that contains it.
+ @param[in] period time between two frames, nanosecond
+ @param[in] mode TERMUX_ALIGN_HOLD or TERMUX_ALIGN_LINEAR
+ @param[in] depth samples kept for each sensor, at least 2
+ @param[in] latency longest wait for a late sensor before a frame is given without it, nanosecond
+ @return stage, 0 on failure
+*/
+termux_align_s *termux_align_new(const char *sensors, uint64_t period, int mode, size_t depth, uint64_t latency);
+
+/*!
+ @brief free an alignment stage
+*/
+void termux_align_free(termux_align_s *ctx);
+
+/*!
+ @brief take a sample of a sensor
+ @param[in] ns time of the sample, nanosecond of CLOCK_MONOTONIC, 0 is now
+ @return index of the sensor in the frames, ~0 if the stage does not take the sample
+*/
+int termux_align_push(termux_align_s *ctx, const char *sensor, const double *values, int n, uint64_t ns);
+
+/*!
+ @brief take a sample of a stream, to be passed to termux_stream_read() with the stage as arg
+*/
+void termux_align_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg);
+
+/*!
+ @brief take the next frame
+ @param[in] now time to weigh the latency against, nanosecond of CLOCK_MONOTONIC, 0 is now
+ @retval 0 success
+ @retval ~0 no frame is ready, errno is EAGAIN
+*/
+int termux_align_next(termux_align_s *ctx, uint64_t now, termux_frame_s *frame);
+
+/*!
+ @brief name of a sensor of the frames, the full name once a sample matched it
+*/
+const char *termux_align_name(const termux_align_s *ctx, int sensor);
+
+/*!
+ @brief read the counters of an alignment stage
+*/
+void termux_align_stat(const termux_align_s *ctx, termux_align_stat_s *stat);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_ALIGN_H__ */
@@ -26,6 +26,117 @@ enum
     TERMUX_TOAST_SHORT = 1 << 4, //!< short
 };
 
+/*!
+ @brief status codes of the termux api
+*/
+enum
+{
+    TERMUX_FAILURE = ~0, //!< failure
+    TERMUX_REJECT = ~2, //!< rejected without running, the service is unreachable or too many calls wait
+    TERMUX_TIMEOUT = ~3, //!< the deadline passed before the call ended, its child was killed
+    TERMUX_CANCEL = ~4, //!< the call was cancelled, its child was killed
+};
+
+/*!
+ @brief states of the circuit breaker
+*/
+enum
+{
+    TERMUX_BREAKER_CLOSED, //!< calls run
+    TERMUX_BREAKER_OPEN, //!< calls are rejected until the back-off elapses
+    TERMUX_BREAKER_PROBE, //!< one call probes the service, others are rejected
+};
+
+/*!
+ @brief priority classes of calls waiting to run
+*/
+enum
+{
+    TERMUX_PRIORITY_HIGH, //!< the user waits for it, dialogs and fingerprint
+    TERMUX_PRIORITY_NORMAL,
+    TERMUX_PRIORITY_LOW, //!< background polls of sensors and volume
+    TERMUX_PRIORITY_MAX
+};
+
+/*!
+ @brief endpoints of the termux api
+*/
+enum
+{
+    TERMUX_API_BRIGHTNESS,
+    TERMUX_API_CLIPBOARD_GET,
+    TERMUX_API_CLIPBOARD_SET,
+    TERMUX_API_DIALOG,
+    TERMUX_API_FINGERPRINT,
+    TERMUX_API_SENSOR_CLEANUP,
+    TERMUX_API_SENSOR_LIST,
+    TERMUX_API_SENSOR,
+    TERMUX_API_TOAST,
+    TERMUX_API_TORCH,
+    TERMUX_API_VIBRATE,
+    TERMUX_API_VOLUME_GET,
+    TERMUX_API_VOLUME_SET,
+    TERMUX_API_MAX
+};
+
+/*!
+ @brief latency statistics of an endpoint
+*/
+typedef struct termux_latency_s
+{
+    unsigned long count; //!< completed calls
+    unsigned long kills; //!< children killed at the deadline before they exited
+    unsigned long p50; //!< median latency, microsecond
+    unsigned long p99; //!< 99th percentile latency, microsecond
+    unsigned long deadline; //!< current deadline, millisecond
+    unsigned long shared; //!< reads that joined an identical one in flight instead of running
+} termux_latency_s;
+
+/*!
+ @brief statistics of a priority class
+*/
+typedef struct termux_sched_s
+{
+    unsigned long admitted; //!< calls that ran
+    unsigned long waited; //!< calls that waited for a slot before they ran
+    unsigned long rejected; //!< calls rejected because the queue was too deep
+    unsigned long wait; //!< mean time in the queue of the calls that waited, microsecond
+    unsigned long wait_max; //!< longest time in the queue, microsecond
+    unsigned int queued; //!< calls waiting now
+    unsigned int queued_max; //!< most calls waiting at once
+    unsigned int running; //!< calls of all classes in flight
+} termux_sched_s;
+
+/*!
+ @brief cancellation token that any thread can trigger
+*/
+typedef struct termux_cancel_s termux_cancel_s;
+
+/*!
+ @brief state of a token bucket shared by all processes
+*/
+typedef struct termux_bucket_s
+{
+    double rate; //!< calls per second, 0 is no limit
+    double burst; //!< calls that may run at once after the bucket filled up
+    unsigned long taken; //!< calls that took a token at once
+    unsigned long waited; //!< calls that waited for a token
+    unsigned long rejected; //!< calls rejected without a token
+} termux_bucket_s;
+
+/*!
+ @brief state of the circuit breaker
+*/
+typedef struct termux_breaker_s
+{
+    int state; //!< TERMUX_BREAKER_*
+    unsigned int failures; //!< consecutive failures
+    unsigned long backoff; //!< current back-off, millisecond
+    unsigned long retry; //!< time until the next probe, millisecond
+    unsigned long opens; //!< times the breaker opened
+    unsigned long rejects; //!< calls rejected
+} termux_breaker_s;
+
 typedef struct termux_volume_s
 {
     struct
@@ -60,18 +171,231 @@ typedef struct termux_volume_s
     } notice[1];
 } termux_volume_s;
 
+/*!
+ @brief handle of an asynchronous termux_init
+*/
+typedef struct termux_init_s termux_init_s;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif /* __cplusplus */
 
 /*!
+ @brief start the KeepAliveService unless it started recently
  @retval 0 success
  @retval ~0 failure
 */
 int termux_init(void);
 
+/*!
+ @brief start termux_init without waiting for it
+ @details nothing is spawned if the state file in $TMPDIR shows a start within the cache period
+ @return handle to pass to termux_init_wait, 0 on failure
+*/
+termux_init_s *termux_init_async(void);
+
+/*!
+ @brief check if an asynchronous termux_init has finished
+ @retval 0 pending
+ @retval 1 finished, termux_init_wait returns at once
+*/
+int termux_init_done(termux_init_s *ctx);
+
+/*!
+ @brief wait for an asynchronous termux_init and release its handle
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_init_wait(termux_init_s *ctx);
+
+/*!
+ @brief set how long a successful termux_init is trusted by later ones
+ @param[in] ms cache period, millisecond, 0 always spawns am, default 60000
+*/
+void termux_init_cache(unsigned long ms);
+
+/*!
+ @brief set the path of the am command used by termux_init and termux_exit
+ @param[in] path path of am, 0 restores the Termux one
+*/
+void termux_am(const char *path);
+
+/*!
+ @brief stop the KeepAliveService and forget the cached start
+*/
 void termux_exit(void);
 
+/*!
+ @brief bound the adaptive deadline of an endpoint
+ @details the deadline is scale times the p99 latency of recent calls, clamped to [floor, ceil]
+ @param[in] api endpoint TERMUX_API_*
+ @param[in] floor lower bound, millisecond
+ @param[in] ceil upper bound, millisecond
+ @param[in] scale multiple of the p99 latency
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_timeout(int api, unsigned long floor, unsigned long ceil, unsigned int scale);
+
+/*!
+ @brief override the deadline of the next call on the calling thread
+ @details the deadline also covers the time the call waits for a slot
+ @param[in] ms deadline, millisecond, 0 restores the adaptive deadline
+*/
+void termux_timeout_once(unsigned long ms);
+
+/*!
+ @brief create a cancellation token
+ @return token, 0 on failure
+*/
+termux_cancel_s *termux_cancel_new(void);
+
+/*!
+ @brief release a cancellation token that no call uses
+*/
+void termux_cancel_free(termux_cancel_s *ctx);
+
+/*!
+ @brief cancel the calls that use a token, they end at once with TERMUX_CANCEL
+ @details safe to call from any thread and from a signal handler, the token stays cancelled until reset
+*/
+void termux_cancel(termux_cancel_s *ctx);
+
+/*!
+ @brief let a cancelled token be used again
+*/
+void termux_cancel_reset(termux_cancel_s *ctx);
+
+/*!
+ @brief check if a token is cancelled
+*/
+int termux_cancelled(const termux_cancel_s *ctx);
+
+/*!
+ @brief file descriptor that becomes readable once a token is cancelled
+*/
+int termux_cancel_fd(const termux_cancel_s *ctx);
+
+/*!
+ @brief let a token cancel the next call on the calling thread
+ @details with termux_timeout_once(), this bounds a dialog or fingerprint prompt nobody answers
+ @param[in] ctx token, 0 for none
+*/
+void termux_cancel_once(termux_cancel_s *ctx);
+
+/*!
+ @brief get the latency statistics of an endpoint
+ @param[in] api endpoint TERMUX_API_*
+ @param[out] ctx latency statistics
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_latency(int api, termux_latency_s *ctx);
+
+/*!
+ @brief limit the calls in flight across all threads
+ @details a blocking call waits for a slot in the queue of its priority class, classes are served from
+ the highest and calls in one class in the order they came. a waiting call leaves the queue with TERMUX_TIMEOUT
+ at its deadline or TERMUX_CANCEL once its token is cancelled. a call started by termux_call_start() does not
+ wait, it is rejected with errno EAGAIN when no slot is free.
+ @param[in] max most calls in flight, 0 is no limit
+ @param[in] depth most calls waiting in one class, more are rejected with errno EAGAIN, 0 is no limit
+*/
+void termux_sched_config(unsigned int max, unsigned int depth);
+
+/*!
+ @brief set the priority class of an endpoint
+ @param[in] api endpoint TERMUX_API_*
+ @param[in] priority TERMUX_PRIORITY_*
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_priority(int api, int priority);
+
+/*!
+ @brief get the statistics of a priority class
+ @param[in] priority TERMUX_PRIORITY_*
+ @param[out] ctx statistics of the class
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_sched(int priority, termux_sched_s *ctx);
+
+/*!
+ @brief draw the calls of this process from token buckets shared with other processes
+ @details the buckets live in $TMPDIR/termux-api.<uid>.bucket, one for each priority class.
+ a blocking call without a token waits for one, termux_call_start() is rejected with errno EAGAIN.
+ the wait ends with TERMUX_TIMEOUT at the deadline of the call or TERMUX_CANCEL once its token is cancelled,
+ and the token goes back to the bucket. a call the scheduler or the breaker turns away takes no token.
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_bucket_open(void);
+
+/*!
+ @brief stop drawing from the shared token buckets
+*/
+void termux_bucket_close(void);
+
+/*!
+ @brief set the budget of a priority class for all processes
+ @param[in] priority TERMUX_PRIORITY_*
+ @param[in] rate calls per second, 0 is no limit
+ @param[in] burst calls that may run at once after the bucket filled up, at least 1
+ @retval 0 success
+ @retval ~0 failure, the buckets are not open
+*/
+int termux_bucket_config(int priority, double rate, double burst);
+
+/*!
+ @brief get the state of the token bucket of a priority class, counted over all processes
+ @retval 0 success
+ @retval ~0 failure, the buckets are not open
+*/
+int termux_bucket(int priority, termux_bucket_s *ctx);
+
+/*!
+ @brief share identical reads that run at the same time, enabled by default
+ @details a clipboard_get, sensor_list, sensor or volume_get called while the same read is in flight
+ waits for that one and gets a copy of its result instead of running on its own.
+ it gives up with TERMUX_TIMEOUT at its own deadline or TERMUX_CANCEL once its own token is cancelled.
+ @param[in] enabled 0 runs every read on its own
+*/
+void termux_share(int enabled);
+
+/*!
+ @brief get the state of the circuit breaker
+ @details calls that time out or fail count as failures, after threshold consecutive failures
+ the breaker opens and calls return TERMUX_REJECT without running. once the back-off elapses,
+ one call probes the service: success closes the breaker, failure doubles the back-off.
+ @param[out] ctx state of the circuit breaker
+ @return TERMUX_BREAKER_*
+*/
+int termux_breaker(termux_breaker_s *ctx);
+
+/*!
+ @brief configure the circuit breaker
+ @param[in] threshold consecutive failures that open the breaker, default 5
+ @param[in] backoff_min first back-off, millisecond, default 500
+ @param[in] backoff_max longest back-off, millisecond, default 30000
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_breaker_config(unsigned int threshold, unsigned long backoff_min, unsigned long backoff_max);
+
+/*!
+ @brief close the circuit breaker and forget failures
+*/
+void termux_breaker_reset(void);
+
+/*!
+ @brief replace the command run by the child process of each call
+ @details the command writes its reply to stdout, reads input from stdin and returns the exit status.
+ it stands in for the Termux:API service in tests.
+ @param[in] command stand-in backend, 0 restores the Termux:API service
+*/
+void termux_backend(int (*command)(int argc, char *argv[]));
+
 /*!
  @param[in] brightness 0~255
  @retval ~0 failure
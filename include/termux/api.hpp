@@ -0,0 +1,507 @@
+/*!
+ @file api.hpp
+ @brief termux api for C++
+ @details results own the buffers allocated by the C calls and are viewed without copying,
+ failures are returned as values instead of thrown.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_API_HPP__
+#define __TERMUX_API_HPP__
+
+#include "api.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <string_view>
+
+namespace termux
+{
+
+/*!
+ @brief status of a call without a result
+*/
+class status
+{
+    int code_;
+
+public:
+    constexpr status(int code = 0) noexcept
+        : code_(code)
+    {
+    }
+    constexpr explicit operator bool() const noexcept { return code_ == 0; }
+    constexpr bool ok() const noexcept { return code_ == 0; }
+    /*! the service is unreachable and the call did not run */
+    constexpr bool rejected() const noexcept { return code_ == TERMUX_REJECT; }
+    constexpr int code() const noexcept { return code_; }
+};
+
+/*!
+ @brief result of a call, or the status it failed with
+*/
+template <typename T>
+class expected
+{
+    T value_;
+    int error_;
+
+public:
+    expected(T &&value) noexcept
+        : value_(std::move(value))
+        , error_(0)
+    {
+    }
+    expected(status error) noexcept
+        : value_()
+        , error_(error.ok() ? TERMUX_FAILURE : error.code())
+    {
+    }
+    constexpr explicit operator bool() const noexcept { return error_ == 0; }
+    constexpr bool has_value() const noexcept { return error_ == 0; }
+    constexpr status error() const noexcept { return error_; }
+    /*! only meaningful if has_value() */
+    T &value() & noexcept { return value_; }
+    const T &value() const & noexcept { return value_; }
+    T &&value() && noexcept { return std::move(value_); }
+    T &operator*() & noexcept { return value_; }
+    const T &operator*() const & noexcept { return value_; }
+    T *operator->() noexcept { return &value_; }
+    const T *operator->() const noexcept { return &value_; }
+    template <typename U>
+    T value_or(U &&other) const & { return error_ == 0 ? value_ : static_cast<T>(std::forward<U>(other)); }
+};
+
+/*!
+ @brief array allocated by a C call
+*/
+template <typename T>
+class array
+{
+    T *data_ = nullptr;
+    std::size_t size_ = 0;
+
+public:
+    array() noexcept = default;
+    array(T *data, std::size_t size) noexcept
+        : data_(data)
+        , size_(size)
+    {
+    }
+    array(array &&other) noexcept
+        : data_(std::exchange(other.data_, nullptr))
+        , size_(std::exchange(other.size_, 0))
+    {
+    }
+    array &operator=(array &&other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+    array(const array &) = delete;
+    array &operator=(const array &) = delete;
+    ~array() { std::free(data_); }
+
+    T *data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    T *begin() const noexcept { return data_; }
+    T *end() const noexcept { return data_ + size_; }
+    T &operator[](std::size_t i) const noexcept { return data_[i]; }
+};
+
+/*!
+ @brief string allocated by a C call
+*/
+class text
+{
+    char *data_ = nullptr;
+    std::size_t size_ = 0;
+
+public:
+    text() noexcept = default;
+    text(char *data, std::size_t size) noexcept
+        : data_(data)
+        , size_(size)
+    {
+    }
+    explicit text(char *data) noexcept
+        : data_(data)
+        , size_(data ? std::strlen(data) : 0)
+    {
+    }
+    text(text &&other) noexcept
+        : data_(std::exchange(other.data_, nullptr))
+        , size_(std::exchange(other.size_, 0))
+    {
+    }
+    text &operator=(text &&other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+    text(const text &) = delete;
+    text &operator=(const text &) = delete;
+    ~text() { std::free(data_); }
+
+    const char *c_str() const noexcept { return data_ ? data_ : ""; }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    std::string_view view() const noexcept { return {c_str(), size_}; }
+    operator std::string_view() const noexcept { return view(); }
+};
+
+/*!
+ @brief array of strings allocated by a C call
+*/
+class strings
+{
+    char **data_ = nullptr;
+    std::size_t size_ = 0;
+
+public:
+    class iterator
+    {
+        char *const *p_;
+
+    public:
+        explicit iterator(char *const *p) noexcept
+            : p_(p)
+        {
+        }
+        std::string_view operator*() const noexcept { return *p_; }
+        iterator &operator++() noexcept { return ++p_, *this; }
+        bool operator!=(const iterator &other) const noexcept { return p_ != other.p_; }
+        bool operator==(const iterator &other) const noexcept { return p_ == other.p_; }
+    };
+
+    strings() noexcept = default;
+    strings(char **data, std::size_t size) noexcept
+        : data_(data)
+        , size_(size)
+    {
+    }
+    strings(strings &&other) noexcept
+        : data_(std::exchange(other.data_, nullptr))
+        , size_(std::exchange(other.size_, 0))
+    {
+    }
+    strings &operator=(strings &&other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        return *this;
+    }
+    strings(const strings &) = delete;
+    strings &operator=(const strings &) = delete;
+    ~strings()
+    {
+        for (std::size_t i = 0; i != size_; ++i)
+        {
+            std::free(data_[i]);
+        }
+        std::free(data_);
+    }
+
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+    const char *c_str(std::size_t i) const noexcept { return data_[i]; }
+    std::string_view operator[](std::size_t i) const noexcept { return data_[i]; }
+    iterator begin() const noexcept { return iterator(data_); }
+    iterator end() const noexcept { return iterator(data_ + size_); }
+};
+
+/*!
+ @brief running KeepAliveService, stopped when destroyed
+*/
+class service
+{
+    bool owner_ = false;
+
+    explicit service(bool owner) noexcept
+        : owner_(owner)
+    {
+    }
+    friend class starting;
+
+public:
+    service() noexcept = default;
+    service(service &&other) noexcept
+        : owner_(std::exchange(other.owner_, false))
+    {
+    }
+    service &operator=(service &&other) noexcept
+    {
+        std::swap(owner_, other.owner_);
+        return *this;
+    }
+    service(const service &) = delete;
+    service &operator=(const service &) = delete;
+    ~service()
+    {
+        if (owner_)
+        {
+            termux_exit();
+        }
+    }
+    /*! keep the service running after this object is destroyed */
+    void release() noexcept { owner_ = false; }
+};
+
+/*!
+ @brief KeepAliveService being started
+*/
+class starting
+{
+    termux_init_s *ctx_ = nullptr;
+
+public:
+    explicit starting(termux_init_s *ctx) noexcept
+        : ctx_(ctx)
+    {
+    }
+    starting(starting &&other) noexcept
+        : ctx_(std::exchange(other.ctx_, nullptr))
+    {
+    }
+    starting &operator=(starting &&other) noexcept
+    {
+        std::swap(ctx_, other.ctx_);
+        return *this;
+    }
+    starting(const starting &) = delete;
+    starting &operator=(const starting &) = delete;
+    ~starting()
+    {
+        if (ctx_)
+        {
+            termux_init_wait(ctx_);
+        }
+    }
+
+    bool done() const noexcept { return ctx_ == nullptr || termux_init_done(ctx_); }
+    expected<service> wait() noexcept
+    {
+        if (ctx_ == nullptr)
+        {
+            return status(TERMUX_FAILURE);
+        }
+        int ok = termux_init_wait(std::exchange(ctx_, nullptr));
+        if (ok)
+        {
+            return status(ok);
+        }
+        return service(true);
+    }
+};
+
+inline starting start_async() noexcept { return starting(termux_init_async()); }
+inline expected<service> start() noexcept { return start_async().wait(); }
+
+namespace detail
+{
+
+inline char *str(const char *s) noexcept { return const_cast<char *>(s); }
+inline char *const *strv(const char *const *s) noexcept { return const_cast<char *const *>(s); }
+
+inline expected<int> number(int ok) noexcept
+{
+    if (ok < 0)
+    {
+        return status(ok);
+    }
+    return ok;
+}
+
+} /* namespace detail */
+
+inline status brightness(int value) noexcept { return termux_brightness(value); }
+
+inline expected<text> clipboard_get() noexcept
+{
+    char *data = nullptr;
+    std::size_t byte = 0;
+    int ok = termux_clipboard_get(&data, &byte);
+    text out(data, byte);
+    if (ok)
+    {
+        return status(ok);
+    }
+    return out;
+}
+
+inline status clipboard_set(std::string_view data) noexcept
+{
+    return termux_clipboard_set(const_cast<char *>(data.data()), data.size());
+}
+
+/*!
+ @retval 0 yes
+ @retval 1 no
+ @retval 2 cancel
+*/
+inline expected<int> dialog_confirm(const char *hint, const char *title) noexcept
+{
+    return detail::number(termux_dialog_confirm(detail::str(hint), detail::str(title)));
+}
+
+inline expected<array<int>> dialog_checkbox(const char *const values[], const char *title) noexcept
+{
+    int *index = nullptr;
+    int n = termux_dialog_checkbox(detail::strv(values), detail::str(title), &index);
+    array<int> out(index, n > 0 ? std::size_t(n) : 0);
+    if (n < 0)
+    {
+        return status(n);
+    }
+    return out;
+}
+
+inline expected<int> dialog_counter(const char *title, int min, int max, int init = 0) noexcept
+{
+    int ok = termux_dialog_counter(detail::str(title), min, max, &init);
+    if (ok)
+    {
+        return status(ok);
+    }
+    return init;
+}
+
+inline expected<text> dialog_date(const char *format, const char *title) noexcept
+{
+    char *out = nullptr;
+    int ok = termux_dialog_date(detail::str(format), detail::str(title), &out);
+    if (ok)
+    {
+        return status(ok);
+    }
+    return text(out);
+}
+
+inline expected<int> dialog_radio(const char *const values[], const char *title) noexcept
+{
+    return detail::number(termux_dialog_radio(detail::strv(values), detail::str(title)));
+}
+
+inline expected<int> dialog_sheet(const char *const values[], const char *title) noexcept
+{
+    return detail::number(termux_dialog_sheet(detail::strv(values), detail::str(title)));
+}
+
+inline expected<int> dialog_spinner(const char *const values[], const char *title) noexcept
+{
+    return detail::number(termux_dialog_spinner(detail::strv(values), detail::str(title)));
+}
+
+inline expected<text> dialog_speech(const char *hint, const char *title) noexcept
+{
+    char *out = nullptr;
+    int ok = termux_dialog_speech(detail::str(hint), detail::str(title), &out);
+    if (ok)
+    {
+        return status(ok);
+    }
+    return text(out);
+}
+
+inline expected<text> dialog_text(const char *hint, const char *title, int option = 0) noexcept
+{
+    char *out = nullptr;
+    int ok = termux_dialog_text(detail::str(hint), detail::str(title), &out, option);
+    if (ok)
+    {
+        return status(ok);
+    }
+    return text(out);
+}
+
+/*!
+ @return hour * 100 + minute
+*/
+inline expected<int> dialog_time(const char *title) noexcept
+{
+    return detail::number(termux_dialog_time(detail::str(title)));
+}
+
+/*!
+ @retval 0 success
+ @retval 1 failure
+ @retval 2 unknown
+*/
+inline expected<int> fingerprint(const char *title, const char *description = nullptr,
+                                 const char *subtitle = nullptr, const char *cancel = nullptr) noexcept
+{
+    return detail::number(termux_fingerprint(detail::str(title), detail::str(description),
+                                             detail::str(subtitle), detail::str(cancel)));
+}
+
+inline status sensor_cleanup() noexcept { return termux_sensor_cleanup(); }
+
+inline expected<strings> sensor_list() noexcept
+{
+    char **sensor = nullptr;
+    int n = termux_sensor_list(&sensor);
+    strings out(sensor, n > 0 ? std::size_t(n) : 0);
+    if (n < 0)
+    {
+        return status(n);
+    }
+    return out;
+}
+
+inline expected<array<double>> sensor(const char *name) noexcept
+{
+    double *values = nullptr;
+    int n = termux_sensor(detail::str(name), &values);
+    array<double> out(values, n > 0 ? std::size_t(n) : 0);
+    if (n < 0)
+    {
+        return status(n);
+    }
+    return out;
+}
+
+inline status toast(const char *text, const char *text_color = nullptr,
+                    const char *background = nullptr, int gravity = 0) noexcept
+{
+    return termux_toast(detail::str(text), detail::str(text_color), detail::str(background), gravity);
+}
+
+inline status torch(bool enabled) noexcept { return termux_torch(enabled); }
+
+inline status vibrate(int ms, bool force = false) noexcept { return termux_vibrate(ms, force); }
+
+inline expected<termux_volume_s> volume_get() noexcept
+{
+    termux_volume_s ctx{};
+    int ok = termux_volume_get(&ctx);
+    if (ok)
+    {
+        return status(ok);
+    }
+    return ctx;
+}
+
+inline status volume_set(termux_volume_s &ctx) noexcept { return termux_volume_set(&ctx); }
+
+inline termux_breaker_s breaker() noexcept
+{
+    termux_breaker_s ctx{};
+    termux_breaker(&ctx);
+    return ctx;
+}
+
+inline termux_latency_s latency(int api) noexcept
+{
+    termux_latency_s ctx{};
+    termux_latency(api, &ctx);
+    return ctx;
+}
+
+} /* namespace termux */
+
+#endif /* __TERMUX_API_HPP__ */
@@ -0,0 +1,61 @@
+/*!
+ @file batch.h
+ @brief batch of termux api calls run together
+ @details calls are started as soon as a slot is free and the call they depend on finished,
+ so the spawn and the wait of one call overlap with the others.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_BATCH_H__
+#define __TERMUX_BATCH_H__
+
+#include "call.h"
+
+/*!
+ @brief instance structure for a batch of calls
+*/
+typedef struct termux_batch_s termux_batch_s;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief create a batch of calls
+ @param[in] limit most calls in flight at once, 0 is no limit
+ @return batch, 0 on failure
+*/
+termux_batch_s *termux_batch_new(unsigned int limit);
+
+/*!
+ @brief release a batch and the calls in it, but not the results of the calls
+*/
+void termux_batch_free(termux_batch_s *ctx);
+
+/*!
+ @brief queue a call
+ @param[in] call kind and parameters of the call, copied
+ @param[in] after index of an earlier call that must finish first, ~0 for none
+ @return index of the call, ~0 on failure
+*/
+int termux_batch_add(termux_batch_s *ctx, const termux_call_s *call, int after);
+
+/*!
+ @brief run the calls queued since the last run
+ @return number of calls that failed to start or were killed at their deadline
+*/
+int termux_batch_run(termux_batch_s *ctx);
+
+/*!
+ @brief results of the calls, in the order they were queued
+ @details status and out of each call are the same as those of termux_call(),
+ buffers in out belong to the caller.
+ @param[out] n number of calls
+*/
+termux_call_s *termux_batch_calls(termux_batch_s *ctx, unsigned int *n);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_BATCH_H__ */
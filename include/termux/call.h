@@ -0,0 +1,233 @@
+/*!
+ @file call.h
+ @brief termux api calls that do not block
+ @details a call is started, its output is read whenever termux_call_fd() is readable,
+ and it is finished once termux_call_read() reports the end of the output or its deadline passed.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_CALL_H__
+#define __TERMUX_CALL_H__
+
+#include "api.h"
+
+/*!
+ @brief kinds of call, one for each termux_* function
+*/
+enum
+{
+    TERMUX_CALL_BRIGHTNESS,
+    TERMUX_CALL_CLIPBOARD_GET,
+    TERMUX_CALL_CLIPBOARD_SET,
+    TERMUX_CALL_DIALOG_CONFIRM,
+    TERMUX_CALL_DIALOG_CHECKBOX,
+    TERMUX_CALL_DIALOG_COUNTER,
+    TERMUX_CALL_DIALOG_DATE,
+    TERMUX_CALL_DIALOG_RADIO,
+    TERMUX_CALL_DIALOG_SHEET,
+    TERMUX_CALL_DIALOG_SPINNER,
+    TERMUX_CALL_DIALOG_SPEECH,
+    TERMUX_CALL_DIALOG_TEXT,
+    TERMUX_CALL_DIALOG_TIME,
+    TERMUX_CALL_FINGERPRINT,
+    TERMUX_CALL_SENSOR_CLEANUP,
+    TERMUX_CALL_SENSOR_LIST,
+    TERMUX_CALL_SENSOR,
+    TERMUX_CALL_TOAST,
+    TERMUX_CALL_TORCH,
+    TERMUX_CALL_VIBRATE,
+    TERMUX_CALL_VOLUME_GET,
+    TERMUX_CALL_VOLUME_SET, //!< one stream
+    TERMUX_CALL_MAX
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief instance structure for a call
+ @details set call and its parameters in in, the rest is written by the call.
+ status and out hold what the blocking termux_* function returns and writes to its out-parameters,
+ buffers in out are allocated with malloc and belong to the caller.
+*/
+typedef struct termux_call_s
+{
+    int call; //!< TERMUX_CALL_*
+    int status; //!< status of the finished call
+    union
+    {
+        int brightness; //!< 0~255, negative is automatic
+        struct
+        {
+            void *data;
+            size_t byte;
+        } clipboard; //!< CLIPBOARD_SET
+        struct
+        {
+            char *hint;
+            char *title;
+            char *format; //!< DIALOG_DATE
+            char *const *values; //!< DIALOG_CHECKBOX, DIALOG_RADIO, DIALOG_SHEET, DIALOG_SPINNER
+            int min; //!< DIALOG_COUNTER
+            int max; //!< DIALOG_COUNTER
+            int value; //!< DIALOG_COUNTER
+            int option; //!< DIALOG_TEXT, TERMUX_DIALOG_*
+        } dialog;
+        struct
+        {
+            char *title;
+            char *description;
+            char *subtitle;
+            char *cancel;
+        } fingerprint;
+        char *sensor; //!< SENSOR
+        struct
+        {
+            char *text;
+            char *text_color;
+            char *background;
+            int gravity;
+        } toast;
+        int torch;
+        struct
+        {
+            int ms;
+            int force;
+        } vibrate;
+        struct
+        {
+            char *stream; //!< call, system, ring, music, alarm or notification
+            int volume;
+        } volume; //!< VOLUME_SET
+    } in;
+    union
+    {
+        int value; //!< DIALOG_COUNTER
+        struct
+        {
+            char *data;
+            size_t byte;
+        } text; //!< CLIPBOARD_GET, DIALOG_DATE, DIALOG_SPEECH, DIALOG_TEXT
+        int *index; //!< DIALOG_CHECKBOX, status entries
+        char **sensors; //!< SENSOR_LIST, status entries
+        double *values; //!< SENSOR, status entries
+        termux_volume_s volume; //!< VOLUME_GET
+    } out;
+    unsigned long deadline; //!< deadline set by the caller, millisecond, 0 is the default of the endpoint
+    termux_cancel_s *cancel; //!< token that cancels the call, 0 for none
+    unsigned long ms; //!< deadline after the start, millisecond, 0 is none
+    /* private */
+    uint64_t t0;
+    char *buf;
+    size_t len;
+    size_t cap;
+    int fd;
+    int pid;
+    int probe;
+    int eof;
+    int cause; //!< TERMUX_TIMEOUT or TERMUX_CANCEL once the call is cut short
+} termux_call_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief call whose arguments are built once and run many times
+ @details change the parameters in the in of termux_prepared_call() between runs,
+ numbers and strings are patched in place, only a parameter that adds or drops an argument builds them again.
+ the strings of the parameters must live as long as the prepared call.
+*/
+typedef struct termux_prepared_s termux_prepared_s;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief start a call without waiting for it
+ @param[in,out] ctx points to an instance of call structure
+ @retval 0 success
+ @retval ~0 failure
+ @retval TERMUX_REJECT the circuit breaker is open, or errno is EAGAIN when no slot of termux_sched_config() is free
+*/
+int termux_call_start(termux_call_s *ctx);
+
+/*!
+ @brief file descriptor that becomes readable when the call has output or has ended
+ @return file descriptor, ~0 if the call is not running
+*/
+int termux_call_fd(const termux_call_s *ctx);
+
+/*!
+ @brief read the output available without blocking
+ @details watch termux_cancel_fd() as well to notice a cancellation at once
+ @retval 0 pending
+ @retval 1 the output ended, finish the call
+ @retval ~0 failure or cancelled, finish the call
+*/
+int termux_call_read(termux_call_s *ctx);
+
+/*!
+ @brief time left until the deadline of the call
+ @return millisecond, ~0 if the call has no deadline
+*/
+long termux_call_left(const termux_call_s *ctx);
+
+/*!
+ @brief wait for the output of a call to end, its deadline to pass or its token to be cancelled
+ @retval 0 the output ended
+ @retval ~0 errno is ETIMEDOUT or ECANCELED
+*/
+int termux_call_wait(termux_call_s *ctx);
+
+/*!
+ @brief reap the child process, killing it if it still runs, and decode the output
+ @return status of the call, TERMUX_TIMEOUT or TERMUX_CANCEL if it was cut short
+*/
+int termux_call_finish(termux_call_s *ctx);
+
+/*!
+ @brief run a call to the end, the same as the blocking termux_* function
+ @return status of the call
+*/
+int termux_call(termux_call_s *ctx);
+
+/*!
+ @brief build the arguments of a call to run it many times
+ @param[in] call kind and parameters of the call, copied
+ @return prepared call, 0 on failure
+*/
+termux_prepared_s *termux_prepare(const termux_call_s *call);
+
+/*!
+ @brief call of a prepared call, to change its parameters and read its results
+*/
+termux_call_s *termux_prepared_call(termux_prepared_s *ctx);
+
+/*!
+ @brief start a prepared call without waiting for it, finish it with termux_call_*
+ @retval 0 success
+ @retval ~0 failure
+ @retval TERMUX_REJECT the circuit breaker is open, or errno is EAGAIN when no slot is free
+*/
+int termux_prepared_start(termux_prepared_s *ctx);
+
+/*!
+ @brief run a prepared call to the end
+ @return status of the call
+*/
+int termux_prepared_run(termux_prepared_s *ctx);
+
+/*!
+ @brief release a prepared call that is not running
+*/
+void termux_prepared_free(termux_prepared_s *ctx);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_CALL_H__ */
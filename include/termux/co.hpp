@@ -0,0 +1,602 @@
+/*!
+ @file co.hpp
+ @brief termux api as C++20 coroutines
+ @details every call is an awaitable that starts the child process and suspends until a reactor
+ sees its output end or its deadline pass, so one thread keeps many calls in flight.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_CO_HPP__
+#define __TERMUX_CO_HPP__
+
+#include "api.hpp"
+#include "call.h"
+
+#include <coroutine>
+#include <ctime>
+#include <exception>
+#include <unordered_map>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+namespace termux
+{
+namespace co
+{
+
+/*!
+ @brief watches file descriptors for the calls in flight
+ @details implement it to drive calls from an external event loop
+*/
+class reactor
+{
+public:
+    using callback = void (*)(void *arg, bool timeout);
+    virtual ~reactor() = default;
+    /*!
+     @brief call back once when fd is readable or hung up, or when ms elapsed
+     @param[in] ms millisecond, negative waits forever
+    */
+    virtual void watch(int fd, long ms, callback cb, void *arg) = 0;
+};
+
+/*!
+ @brief single-threaded reactor built on epoll
+*/
+class loop final: public reactor
+{
+    struct entry
+    {
+        long ms;
+        long long deadline;
+        callback cb;
+        void *arg;
+    };
+    std::unordered_map<int, entry> watch_;
+    int epfd_;
+
+    static long long now() noexcept
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<long long>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    void fire(int fd, bool timeout)
+    {
+        auto it = watch_.find(fd);
+        if (it == watch_.end())
+        {
+            return;
+        }
+        entry e = it->second;
+        watch_.erase(it);
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        e.cb(e.arg, timeout);
+    }
+
+public:
+    loop() noexcept
+        : epfd_(epoll_create1(EPOLL_CLOEXEC))
+    {
+    }
+    loop(const loop &) = delete;
+    loop &operator=(const loop &) = delete;
+    ~loop() override { close(epfd_); }
+
+    void watch(int fd, long ms, callback cb, void *arg) override
+    {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            /* the call cannot be watched, let it finish at once */
+            cb(arg, true);
+            return;
+        }
+        watch_[fd] = entry{ms, ms < 0 ? -1 : now() + ms, cb, arg};
+    }
+
+    /*! number of calls in flight */
+    std::size_t size() const noexcept { return watch_.size(); }
+
+    /*!
+     @brief dispatch events for at most ms millisecond
+     @param[in] ms millisecond, negative waits until an event or deadline
+     @return number of calls still in flight, it returns at once when none is
+    */
+    std::size_t poll(long ms = -1)
+    {
+        if (watch_.empty())
+        {
+            return 0;
+        }
+        long long t = now();
+        for (auto const &it : watch_)
+        {
+            if (it.second.deadline >= 0)
+            {
+                long left = it.second.deadline > t ? long(it.second.deadline - t) : 0;
+                ms = ms < 0 || left < ms ? left : ms;
+            }
+        }
+        epoll_event ev[64];
+        int n = epoll_wait(epfd_, ev, 64, int(ms));
+        for (int i = 0; i < n; ++i)
+        {
+            fire(ev[i].data.fd, false);
+        }
+        t = now();
+        for (auto it = watch_.begin(); it != watch_.end();)
+        {
+            int fd = it->first;
+            bool expired = it->second.deadline >= 0 && it->second.deadline <= t;
+            ++it;
+            if (expired)
+            {
+                fire(fd, true);
+                it = watch_.begin();
+            }
+        }
+        return watch_.size();
+    }
+
+    /*! dispatch events until no call is in flight */
+    void run()
+    {
+        while (size())
+        {
+            poll();
+        }
+    }
+};
+
+/*!
+ @brief lazily started coroutine that resumes its awaiter when it finishes
+*/
+template <typename T = void>
+class task;
+
+namespace detail
+{
+
+template <typename T>
+struct promise_base
+{
+    std::coroutine_handle<> next_ = std::noop_coroutine();
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept
+    {
+        struct awaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<T> h) noexcept { return h.promise().next_; }
+            void await_resume() noexcept {}
+        };
+        return awaiter{};
+    }
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+} /* namespace detail */
+
+template <typename T>
+class task
+{
+public:
+    struct promise_type: detail::promise_base<promise_type>
+    {
+        T value_;
+        task get_return_object() noexcept { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_value(T value) noexcept { value_ = std::move(value); }
+    };
+
+private:
+    std::coroutine_handle<promise_type> h_;
+
+public:
+    explicit task(std::coroutine_handle<promise_type> h) noexcept
+        : h_(h)
+    {
+    }
+    task(task &&other) noexcept
+        : h_(std::exchange(other.h_, nullptr))
+    {
+    }
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task()
+    {
+        if (h_)
+        {
+            h_.destroy();
+        }
+    }
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> next) noexcept
+    {
+        h_.promise().next_ = next;
+        return h_;
+    }
+    T await_resume() noexcept { return std::move(h_.promise().value_); }
+};
+
+template <>
+class task<void>
+{
+public:
+    struct promise_type: detail::promise_base<promise_type>
+    {
+        task get_return_object() noexcept { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() noexcept {}
+    };
+
+private:
+    std::coroutine_handle<promise_type> h_;
+
+public:
+    explicit task(std::coroutine_handle<promise_type> h) noexcept
+        : h_(h)
+    {
+    }
+    task(task &&other) noexcept
+        : h_(std::exchange(other.h_, nullptr))
+    {
+    }
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task()
+    {
+        if (h_)
+        {
+            h_.destroy();
+        }
+    }
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> next) noexcept
+    {
+        h_.promise().next_ = next;
+        return h_;
+    }
+    void await_resume() noexcept {}
+};
+
+namespace detail
+{
+
+struct detached
+{
+    struct promise_type
+    {
+        detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+inline detached spawn(task<void> t) { co_await std::move(t); }
+
+} /* namespace detail */
+
+/*!
+ @brief start a task that owns itself, run the reactor to drive it
+*/
+inline void spawn(task<void> t) { detail::spawn(std::move(t)); }
+
+/*!
+ @brief awaitable call decoded by D when it finishes
+*/
+template <typename R, R (*D)(termux_call_s &)>
+class call
+{
+    termux_call_s ctx_;
+    reactor &reactor_;
+    std::coroutine_handle<> h_;
+    int epfd_ = -1; //!< epoll of the output and the token of a call that has one
+
+    int fd() const noexcept { return epfd_ >= 0 ? epfd_ : ctx_.fd; }
+
+    static void on_event(void *arg, bool timeout)
+    {
+        call *self = static_cast<call *>(arg);
+        if (!timeout && termux_call_read(&self->ctx_) == 0)
+        {
+            /* more output is coming */
+            self->reactor_.watch(self->fd(), termux_call_left(&self->ctx_), on_event, self);
+            return;
+        }
+        self->h_.resume();
+    }
+
+public:
+    call(reactor &r, const termux_call_s &ctx) noexcept
+        : ctx_(ctx)
+        , reactor_(r)
+    {
+    }
+    call(const call &) = delete;
+    call &operator=(const call &) = delete;
+
+    bool await_ready() noexcept { return termux_call_start(&ctx_) != 0; }
+    void await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        h_ = h;
+        if (ctx_.cancel)
+        {
+            /* a token is shared by calls, so each watches it through an epoll of its own */
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            epfd_ = epoll_create1(EPOLL_CLOEXEC);
+            if (epfd_ >= 0 && (epoll_ctl(epfd_, EPOLL_CTL_ADD, ctx_.fd, &ev) < 0 ||
+                               epoll_ctl(epfd_, EPOLL_CTL_ADD, termux_cancel_fd(ctx_.cancel), &ev) < 0))
+            {
+                close(epfd_);
+                epfd_ = -1;
+            }
+        }
+        reactor_.watch(fd(), termux_call_left(&ctx_), on_event, this);
+    }
+    R await_resume() noexcept
+    {
+        if (epfd_ >= 0)
+        {
+            close(epfd_);
+            epfd_ = -1;
+        }
+        termux_call_finish(&ctx_);
+        return D(ctx_);
+    }
+};
+
+namespace detail
+{
+
+inline status decode_status(termux_call_s &ctx) noexcept { return ctx.status; }
+
+inline expected<int> decode_number(termux_call_s &ctx) noexcept
+{
+    return termux::detail::number(ctx.status);
+}
+
+inline expected<int> decode_value(termux_call_s &ctx) noexcept
+{
+    if (ctx.status)
+    {
+        return status(ctx.status);
+    }
+    return int(ctx.out.value);
+}
+
+inline expected<text> decode_text(termux_call_s &ctx) noexcept
+{
+    text out(ctx.out.text.data, ctx.out.text.byte);
+    if (ctx.status)
+    {
+        return status(ctx.status);
+    }
+    return out;
+}
+
+inline expected<array<int>> decode_index(termux_call_s &ctx) noexcept
+{
+    array<int> out(ctx.out.index, ctx.status > 0 ? std::size_t(ctx.status) : 0);
+    if (ctx.status < 0)
+    {
+        return status(ctx.status);
+    }
+    return out;
+}
+
+inline expected<strings> decode_sensors(termux_call_s &ctx) noexcept
+{
+    strings out(ctx.out.sensors, ctx.status > 0 ? std::size_t(ctx.status) : 0);
+    if (ctx.status < 0)
+    {
+        return status(ctx.status);
+    }
+    return out;
+}
+
+inline expected<array<double>> decode_values(termux_call_s &ctx) noexcept
+{
+    array<double> out(ctx.out.values, ctx.status > 0 ? std::size_t(ctx.status) : 0);
+    if (ctx.status < 0)
+    {
+        return status(ctx.status);
+    }
+    return out;
+}
+
+inline expected<termux_volume_s> decode_volume(termux_call_s &ctx) noexcept
+{
+    if (ctx.status)
+    {
+        return status(ctx.status);
+    }
+    return termux_volume_s(ctx.out.volume);
+}
+
+inline termux_call_s make(int kind) noexcept
+{
+    termux_call_s ctx{};
+    ctx.call = kind;
+    return ctx;
+}
+
+inline termux_call_s make_dialog(int kind, const char *hint, const char *title, const char *const *values = nullptr) noexcept
+{
+    termux_call_s ctx = make(kind);
+    ctx.in.dialog.hint = termux::detail::str(hint);
+    ctx.in.dialog.title = termux::detail::str(title);
+    ctx.in.dialog.values = termux::detail::strv(values);
+    return ctx;
+}
+
+} /* namespace detail */
+
+using status_call = call<status, detail::decode_status>;
+using number_call = call<expected<int>, detail::decode_number>;
+using value_call = call<expected<int>, detail::decode_value>;
+using text_call = call<expected<text>, detail::decode_text>;
+using index_call = call<expected<array<int>>, detail::decode_index>;
+using sensors_call = call<expected<strings>, detail::decode_sensors>;
+using values_call = call<expected<array<double>>, detail::decode_values>;
+using volume_call = call<expected<termux_volume_s>, detail::decode_volume>;
+
+inline status_call brightness(reactor &r, int value) noexcept
+{
+    termux_call_s ctx = detail::make(TERMUX_CALL_BRIGHTNESS);
+    ctx.in.brightness = value;
+    return status_call(r, ctx);
+}
+
+inline text_call clipboard_get(reactor &r) noexcept
+{
+    return text_call(r, detail::make(TERMUX_CALL_CLIPBOARD_GET));
+}
+
+/*! the data is written when the call starts */
+inline status_call clipboard_set(reactor &r, std::string_view data) noexcept
+{
+    termux_call_s ctx = detail::make(TERMUX_CALL_CLIPBOARD_SET);
+    ctx.in.clipboard.data = const_cast<char *>(data.data());
+    ctx.in.clipboard.byte = data.size();
+    return status_call(r, ctx);
+}
+
+inline number_call dialog_confirm(reactor &r, const char *hint, const char *title) noexcept
+{
+    return number_call(r, detail::make_dialog(TERMUX_CALL_DIALOG_CONFIRM, hint, title));
+}
+
+inline index_call dialog_checkbox(reactor &r, const char *const values[], const char *title) noexcept
+{
+    return index_call(r, detail::make_dialog(TERMUX_CALL_DIALOG_CHECKBOX, nullptr, title, values));
+}
+
+inline value_call dialog_counter(reactor &r, const char *title, int min, int max, int init = 0) noexcept
+{
+    termux_call_s ctx = detail::make_dialog(TERMUX_CALL_DIALOG_COUNTER, nullptr, title);
+    ctx.in.dialog.min = min;
+    ctx.in.dialog.max = max;
+    ctx.in.dialog.value = init;
+    return value_call(r, ctx);
+}
+
+inline text_call dialog_date(reactor &r, const char *format, const char *title) noexcept
+{
+    termux_call_s ctx = detail::make_dialog(TERMUX_CALL_DIALOG_DATE, nullptr, title);
+    ctx.in.dialog.format = termux::detail::str(format);
+    return text_call(r, ctx);
+}
+
+inline number_call dialog_radio(reactor &r, const char *const values[], const char *title) noexcept
+{
+    return number_call(r, detail::make_dialog(TERMUX_CALL_DIALOG_RADIO, nullptr, title, values));
+}
+
+inline number_call dialog_sheet(reactor &r, const char *const values[], const char *title) noexcept
+{
+    return number_call(r, detail::make_dialog(TERMUX_CALL_DIALOG_SHEET, nullptr, title, values));
+}
+
+inline number_call dialog_spinner(reactor &r, const char *const values[], const char *title) noexcept
+{
+    return number_call(r, detail::make_dialog(TERMUX_CALL_DIALOG_SPINNER, nullptr, title, values));
+}
+
+inline text_call dialog_speech(reactor &r, const char *hint, const char *title) noexcept
+{
+    return text_call(r, detail::make_dialog(TERMUX_CALL_DIALOG_SPEECH, hint, title));
+}
+
+inline text_call dialog_text(reactor &r, const char *hint, const char *title, int option = 0) noexcept
+{
+    termux_call_s ctx = detail::make_dialog(TERMUX_CALL_DIALOG_TEXT, hint, title);
+    ctx.in.dialog.option = option;
+    return text_call(r, ctx);
+}
+
+inline number_call dialog_time(reactor &r, const char *title) noexcept
+{
+    return number_call(r, detail::make_dialog(TERMUX_CALL_DIALOG_TIME, nullptr, title));
+}
+
+inline number_call fingerprint(reactor &r, const char *title, const char *description = nullptr,
+                               const char *subtitle = nullptr, const char *cancel = nullptr) noexcept
+{
+    termux_call_s ctx = detail::make(TERMUX_CALL_FINGERPRINT);
+    ctx.in.fingerprint.title = termux::detail::str(title);
+    ctx.in.fingerprint.description = termux::detail::str(description);
+    ctx.in.fingerprint.subtitle = termux::detail::str(subtitle);
+    ctx.in.fingerprint.cancel = termux::detail::str(cancel);
+    return number_call(r, ctx);
+}
+
+inline status_call sensor_cleanup(reactor &r) noexcept
+{
+    return status_call(r, detail::make(TERMUX_CALL_SENSOR_CLEANUP));
+}
+
+inline sensors_call sensor_list(reactor &r) noexcept
+{
+    return sensors_call(r, detail::make(TERMUX_CALL_SENSOR_LIST));
+}
+
+/*! the name must live until the call is awaited */
+inline values_call sensor(reactor &r, const char *name) noexcept
+{
+    termux_call_s ctx = detail::make(TERMUX_CALL_SENSOR);
+    ctx.in.sensor = termux::detail::str(name);
+    return values_call(r, ctx);
+}
+
+inline status_call toast(reactor &r, const char *text, const char *text_color = nullptr,
+                         const char *background = nullptr, int gravity = 0) noexcept
+{
+    termux_call_s ctx = detail::make(TERMUX_CALL_TOAST);
+    ctx.in.toast.text = termux::detail::str(text);
+    ctx.in.toast.text_color = termux::detail::str(text_color);
+    ctx.in.toast.background = termux::detail::str(background);
+    ctx.in.toast.gravity = gravity;
+    return status_call(r, ctx);
+}
+
+inline status_call torch(reactor &r, bool enabled) noexcept
+{
+    termux_call_s ctx = detail::make(TERMUX_CALL_TORCH);
+    ctx.in.torch = enabled;
+    return status_call(r, ctx);
+}
+
+inline status_call vibrate(reactor &r, int ms, bool force = false) noexcept
+{
+    termux_call_s ctx = detail::make(TERMUX_CALL_VIBRATE);
+    ctx.in.vibrate.ms = ms;
+    ctx.in.vibrate.force = force;
+    return status_call(r, ctx);
+}
+
+inline volume_call volume_get(reactor &r) noexcept
+{
+    return volume_call(r, detail::make(TERMUX_CALL_VOLUME_GET));
+}
+
+/*!
+ @param[in] stream call, system, ring, music, alarm or notification
+*/
+inline status_call volume_set(reactor &r, const char *stream, int volume) noexcept
+{
+    termux_call_s ctx = detail::make(TERMUX_CALL_VOLUME_SET);
+    ctx.in.volume.stream = termux::detail::str(stream);
+    ctx.in.volume.volume = volume;
+    return status_call(r, ctx);
+}
+
+} /* namespace co */
+} /* namespace termux */
+
+#endif /* __TERMUX_CO_HPP__ */
@@ -0,0 +1,81 @@
+/*!
+ @file fusion.h
+ @brief orientation of the device from its accelerometer, gyroscope and magnetometer
+ @details the filter of Madgwick: the gyroscope turns the orientation on, and a step of gradient descent
+ of size beta pulls it towards the directions of gravity and of the magnetic field. each update costs the
+ same and nothing is allocated. the earth frame has x to the magnetic north, y to the west and z up.
+ units are those of android: m/s^2 for the accelerometer, rad/s for the gyroscope and uT for the magnetometer,
+ only the directions of the accelerometer and the magnetometer count.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_FUSION_H__
+#define __TERMUX_FUSION_H__
+
+#include "sensor.h"
+
+#define TERMUX_FUSION_BETA 0.1 //!< gain of the correction for gyroscopes of phones
+#define TERMUX_FUSION_GAP 500000000 //!< updates further apart start again from gravity and the field, nanosecond
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief instance structure for the orientation filter
+*/
+typedef struct termux_fusion_s
+{
+    double q[4]; //!< quaternion w x y z turning the device frame into the earth frame
+    double beta; //!< gain of the correction
+    uint64_t ns; //!< time of the last update
+    uint64_t updates; //!< updates since the start
+    /* private */
+    double accel[3]; //!< newest accelerometer sample of a stream
+    double mag[3]; //!< newest magnetometer sample of a stream
+    unsigned int have; //!< which of them a stream gave
+} termux_fusion_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief start the orientation filter
+ @param[in] beta gain of the correction, 0 is TERMUX_FUSION_BETA
+*/
+void termux_fusion_init(termux_fusion_s *ctx, double beta);
+
+/*!
+ @brief update the orientation with samples taken together
+ @details the first update, and one after a gap, sets the orientation from gravity and the field alone.
+ @param[in] ns time of the samples, nanosecond
+ @param[in] gyro angular rate, 3 values
+ @param[in] accel acceleration, 3 values, 0 to turn with the gyroscope alone
+ @param[in] mag magnetic field, 3 values, 0 to leave the heading to the gyroscope
+*/
+void termux_fusion_update(termux_fusion_s *ctx, uint64_t ns, const double *gyro, const double *accel, const double *mag);
+
+/*!
+ @brief update the orientation from a stream, to be passed to termux_stream_read() with the filter as arg
+ @details samples of sensors named accelerometer and magnetic field are kept,
+ each sample of the gyroscope then updates the orientation with the newest of them.
+*/
+void termux_fusion_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg);
+
+/*!
+ @brief angles of the orientation
+ @param[out] euler roll about x, pitch about y and yaw about z, radian
+*/
+void termux_fusion_euler(const termux_fusion_s *ctx, double *euler);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_FUSION_H__ */
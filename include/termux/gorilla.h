@@ -0,0 +1,100 @@
+/*!
+ @file gorilla.h
+ @brief compression of sensor samples in blocks
+ @details the scheme of Gorilla: times are stored as the change of their step, values as the bits
+ that changed from the value before. a block starts from nothing, so each block decodes on its own.
+ the steps of times take 0, 12, 20, 32 or 64 bits, wider than in Gorilla, for times in nanoseconds.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_GORILLA_H__
+#define __TERMUX_GORILLA_H__
+
+#include "sensor.h"
+
+#define TERMUX_GORILLA_HEAD 8 //!< bytes of the header of a block: samples and axes
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief instance structure for a block being encoded or decoded
+*/
+typedef struct termux_gorilla_s
+{
+    uint32_t count; //!< samples in the block
+    int axes; //!< values of a sample
+    /* private */
+    uint32_t index; //!< samples taken
+    unsigned char *buf;
+    size_t cap;
+    size_t byte; //!< bytes written or read
+    uint64_t bits; //!< bits not yet written, or read and not yet used
+    unsigned int fill; //!< number of those bits
+    uint64_t ns;
+    uint64_t delta;
+    uint64_t value[TERMUX_SAMPLE_MAX];
+    unsigned char lead[TERMUX_SAMPLE_MAX];
+    unsigned char trail[TERMUX_SAMPLE_MAX];
+} termux_gorilla_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief most bytes of a block of samples
+*/
+size_t termux_gorilla_bound(size_t n, int axes);
+
+/*!
+ @brief start encoding a block
+ @param[in] buf memory of the block
+ @param[in] cap bytes of the memory
+ @param[in] axes values of a sample, 1~TERMUX_SAMPLE_MAX
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_gorilla_init(termux_gorilla_s *ctx, void *buf, size_t cap, int axes);
+
+/*!
+ @brief append a sample to a block
+ @retval 0 success
+ @retval ~0 the block may not have room for it, end the block and start another
+*/
+int termux_gorilla_put(termux_gorilla_s *ctx, uint64_t ns, const double *values);
+
+/*!
+ @brief end a block
+ @return bytes of the block
+*/
+size_t termux_gorilla_end(termux_gorilla_s *ctx);
+
+/*!
+ @brief start decoding a block
+ @param[in] buf memory of the block
+ @param[in] byte bytes of the block
+ @retval 0 success, count and axes describe the block
+ @retval ~0 not a block
+*/
+int termux_gorilla_open(termux_gorilla_s *ctx, const void *buf, size_t byte);
+
+/*!
+ @brief take the next sample of a block
+ @param[out] values axes values
+ @retval 0 success
+ @retval ~0 the block ended
+*/
+int termux_gorilla_get(termux_gorilla_s *ctx, uint64_t *ns, double *values);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_GORILLA_H__ */
@@ -0,0 +1,122 @@
+/*!
+ @file metrics.h
+ @brief metrics of the sensors of streams
+ @details a stream with metrics attached counts for each sensor the time from its events to their receipt
+ when the reports stamp them, the time between samples with a histogram of its jitter, the gaps and the samples
+ they miss, and the time to decode a sample. it also counts how much output each read of the stream took and
+ how many samples waited for consumers. the metrics of a sensor handle and of a shared stream of subscribers
+ add up over the streams they start. a snapshot can be taken from any thread while the stream runs.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_METRICS_H__
+#define __TERMUX_METRICS_H__
+
+#include "sensor.h"
+
+#define TERMUX_METRIC_BUCKETS 20 //!< buckets of a jitter histogram
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief metrics of a sensor
+ @details jitter is how far the time between two samples is from the mean of the times before it.
+ bucket 0 of the histogram counts jitter under 1 microsecond, bucket i under 2^i microseconds,
+ and the last bucket all the rest. a time between two samples over 1.5 times the mean is a gap.
+*/
+typedef struct termux_metric_s
+{
+    char name[TERMUX_SENSOR_NAME]; //!< full name of the sensor
+    uint64_t samples; //!< samples decoded
+    uint64_t stamped; //!< samples that carried the time of their event
+    uint64_t latency; //!< mean time from an event to the receipt of its sample, nanosecond
+    uint64_t latency_max; //!< longest time from an event to the receipt of its sample, nanosecond
+    uint64_t interval; //!< mean time between two samples outside gaps, nanosecond
+    uint64_t jitter; //!< mean jitter, nanosecond
+    uint64_t jitter_max; //!< largest jitter, nanosecond
+    uint64_t jitter_hist[TERMUX_METRIC_BUCKETS]; //!< histogram of the jitter
+    uint64_t gaps; //!< gaps between two samples
+    uint64_t dropped; //!< samples the mean expected in the gaps
+    uint64_t parse; //!< mean time to decode a sample, nanosecond
+    uint64_t parse_max; //!< longest time to decode a sample, nanosecond
+} termux_metric_s;
+
+/*!
+ @brief metrics of the queues of a stream, the pipe from the service and the samples waiting for consumers
+*/
+typedef struct termux_queue_metric_s
+{
+    uint64_t reads; //!< reads that took output
+    uint64_t bytes; //!< bytes of output
+    uint64_t backlog; //!< mean bytes a read took
+    uint64_t backlog_max; //!< most bytes a read took
+    uint64_t queued; //!< samples waiting for a consumer after the last sample
+    uint64_t queued_max; //!< most samples waiting for a consumer
+} termux_queue_metric_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief make metrics without sensors
+ @return metrics, 0 on failure
+*/
+termux_metrics_s *termux_metrics_new(void);
+
+/*!
+ @brief free metrics, no stream may have them attached
+*/
+void termux_metrics_free(termux_metrics_s *ctx);
+
+/*!
+ @brief forget the sensors and counts of metrics
+*/
+void termux_metrics_reset(termux_metrics_s *ctx);
+
+/*!
+ @brief learn the times between samples again, the counts are kept
+ @details a stream calls it when the metrics are attached, since a new stream may report at another delay.
+*/
+void termux_metrics_restart(termux_metrics_s *ctx);
+
+/*!
+ @brief count a read of output of a stream
+ @param[in] byte bytes the read took
+*/
+void termux_metrics_read(termux_metrics_s *ctx, size_t byte);
+
+/*!
+ @brief count a sample decoded by a stream
+ @param[in] ns time of the event of the sample, nanosecond of CLOCK_MONOTONIC
+ @param[in] now time the sample was received, the same as ns if the report did not stamp it
+ @param[in] parse time to decode the sample, nanosecond
+*/
+void termux_metrics_sample(termux_metrics_s *ctx, const char *sensor, uint64_t ns, uint64_t now, uint64_t parse);
+
+/*!
+ @brief count the samples waiting for consumers
+*/
+void termux_metrics_queue(termux_metrics_s *ctx, size_t queued);
+
+/*!
+ @brief copy the metrics
+ @param[out] queue metrics of the queues, may be 0
+ @param[out] metric metrics of the sensors, in the order they first reported
+ @param[in] max most sensors to copy
+ @return number of sensors, may be more than max
+*/
+int termux_metrics_snapshot(termux_metrics_s *ctx, termux_queue_metric_s *queue, termux_metric_s *metric, int max);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_METRICS_H__ */
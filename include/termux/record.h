@@ -0,0 +1,142 @@
+/*!
+ @file record.h
+ @brief recordings of sensor samples in mapped files
+ @details a recording is a header naming the sensors and their axes, followed by blocks appended one after another.
+ a block holds the samples of one sensor as columns: the times, then each axis, so a reader maps the file
+ and uses each column as an array without parsing anything.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_RECORD_H__
+#define __TERMUX_RECORD_H__
+
+#include "sensor.h"
+
+#define TERMUX_RECORD_SENSORS 16 //!< most sensors in a recording
+
+/*!
+ @brief types of the values in a recording
+*/
+enum
+{
+    TERMUX_RECORD_FLOAT = 4, //!< float32
+    TERMUX_RECORD_DOUBLE = 8, //!< float64
+};
+
+/*!
+ @brief recording being written
+*/
+typedef struct termux_record_s termux_record_s;
+
+/*!
+ @brief recording mapped to read
+*/
+typedef struct termux_recording_s termux_recording_s;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief create a recording
+ @param[in] path file of the recording, replaced if it exists
+ @param[in] type TERMUX_RECORD_FLOAT or TERMUX_RECORD_DOUBLE
+ @param[in] block samples in a block, rounded up to a multiple of 16
+ @param[in] sync time between two flushes to the storage, millisecond, 0 is only on close
+ @return recording, 0 on failure
+*/
+termux_record_s *termux_record_open(const char *path, int type, size_t block, unsigned long sync);
+
+/*!
+ @brief append a sample of a sensor
+ @details the first sample of a sensor adds it to the header with as many axes as it has values,
+ missing values of later samples are written as 0.
+ @param[in] ns time of the sample, nanosecond of CLOCK_MONOTONIC, 0 is now
+ @retval 0 success
+ @retval ~0 failure, errno is ENOSPC when the recording has TERMUX_RECORD_SENSORS sensors
+*/
+int termux_record(termux_record_s *ctx, const char *sensor, const double *values, int n, uint64_t ns);
+
+/*!
+ @brief append a sample of a stream, to be passed to termux_stream_read() with the recording as arg
+*/
+void termux_record_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg);
+
+/*!
+ @brief flush the samples to the storage
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_record_sync(termux_record_s *ctx);
+
+/*!
+ @brief flush and close a recording
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_record_close(termux_record_s *ctx);
+
+/*!
+ @brief map a recording to read it
+ @details a recording still being written can be read up to the blocks appended when it was mapped
+ @return recording, 0 on failure, errno is EPROTO if the file is not a recording
+*/
+termux_recording_s *termux_recording_open(const char *path);
+
+/*!
+ @brief unmap a recording
+*/
+void termux_recording_close(termux_recording_s *ctx);
+
+/*!
+ @brief type of the values of a recording
+ @return TERMUX_RECORD_FLOAT or TERMUX_RECORD_DOUBLE
+*/
+int termux_recording_type(const termux_recording_s *ctx);
+
+/*!
+ @brief number of sensors in a recording
+*/
+int termux_recording_sensors(const termux_recording_s *ctx);
+
+/*!
+ @brief name of a sensor of a recording
+ @return name, 0 if there is no such sensor
+*/
+const char *termux_recording_name(const termux_recording_s *ctx, int sensor);
+
+/*!
+ @brief number of axes of a sensor of a recording
+*/
+int termux_recording_axes(const termux_recording_s *ctx, int sensor);
+
+/*!
+ @brief number of blocks in a recording
+*/
+size_t termux_recording_blocks(const termux_recording_s *ctx);
+
+/*!
+ @brief get the samples of a block
+ @param[in] block index of the block
+ @param[out] sensor index of the sensor of the block, may be 0
+ @return number of samples in the block
+*/
+size_t termux_recording_block(const termux_recording_s *ctx, size_t block, int *sensor);
+
+/*!
+ @brief times of the samples of a block
+ @return array of nanoseconds of CLOCK_MONOTONIC, 0 if there is no such block
+*/
+const uint64_t *termux_recording_ns(const termux_recording_s *ctx, size_t block);
+
+/*!
+ @brief values of an axis for the samples of a block
+ @return array of float or double as termux_recording_type(), 0 if there is no such block or axis
+*/
+const void *termux_recording_axis(const termux_recording_s *ctx, size_t block, int axis);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_RECORD_H__ */
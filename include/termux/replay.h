@@ -0,0 +1,42 @@
+/*!
+ @file replay.h
+ @brief replay of recorded sensors through the termux api
+ @details the replay stands in for the service with termux_backend(), so termux_sensor_list(), termux_sensor()
+ and sensor streams answer from a recording of termux_record_open() or from a transcript of termux-sensor,
+ the json objects it printed one after another. other calls of the service fail.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_REPLAY_H__
+#define __TERMUX_REPLAY_H__
+
+#include "record.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief answer the sensor calls from a capture
+ @details at a speed above 0 the capture plays against the clock from this call on, speed times faster
+ than it was captured, and a call reads the samples of its time. at speed 0 it plays as fast as possible,
+ each report moving the capture one step on, so runs are the same on any machine.
+ a step is a sample of the first sensor asked for, or the delay of a stream when it is longer.
+ @param[in] path recording or transcript
+ @param[in] speed rate of the replay, 1 is the original timing, 0 is as fast as possible
+ @param[in] period time between two reports of a transcript, millisecond, above 0
+ @retval 0 success
+ @retval ~0 failure, errno is EPROTO if the file holds no sample
+*/
+int termux_replay(const char *path, double speed, unsigned long period);
+
+/*!
+ @brief stop the replay and call the service again
+*/
+void termux_replay_stop(void);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_REPLAY_H__ */
@@ -0,0 +1,108 @@
+/*!
+ @file rule.h
+ @brief rules over the values of sensors evaluated for each sample
+ @details a rule is written as sensor[axis] op value [hyst h] [for ms], for example
+ "accel[2] > 12 hyst 0.5 for 50" or "light[norm] <= 5". the sensor is the one with that name, ignoring case,
+ or when no sensor of a report has it, the first name that contains it. the axis is an index or norm for
+ the length of all values, op is one of < <= > >=.
+ a rule becomes active when its comparison holds and inactive when the value comes back past the
+ threshold by more than hyst, each change only once it held for ms. rules are compiled into arrays
+ for each sensor, so a sample only runs the rules of its sensor and nothing is allocated then.
+ an engine is not shared between threads.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_RULE_H__
+#define __TERMUX_RULE_H__
+
+#include "call.h"
+#include "sensor.h"
+
+typedef struct termux_rules_s termux_rules_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief counters of a rule
+*/
+typedef struct termux_rule_stat_s
+{
+    uint64_t rises; //!< changes to active
+    uint64_t falls; //!< changes to inactive
+    uint64_t actions; //!< actions started
+    uint64_t busy; //!< actions not started because the one before still ran
+    uint64_t failed; //!< actions that did not start or ended with an error
+    int active; //!< the rule is active
+} termux_rule_stat_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief make an engine without rules
+ @return engine, 0 on failure
+*/
+termux_rules_s *termux_rules_new(void);
+
+/*!
+ @brief free an engine, killing the actions still running
+*/
+void termux_rules_free(termux_rules_s *ctx);
+
+/*!
+ @brief compile a rule into an engine
+ @param[in] rule text of the rule
+ @param[in] fire called when the rule changes, active is 1 or 0, value is the one that changed it, may be 0
+ @return index of the rule, ~0 on failure, errno is EINVAL if the text is not a rule
+*/
+int termux_rule_add(termux_rules_s *ctx, const char *rule,
+                    void (*fire)(int rule, int active, double value, uint64_t ns, void *arg), void *arg);
+
+/*!
+ @brief start a call each time a rule becomes active
+ @details the call is copied, its strings must live as long as the engine.
+ the call starts without waiting and is finished by termux_rules_poll(), while it runs the rule starts no other.
+ @param[in] call kind and parameters of the call, 0 for none
+ @retval 0 success
+ @retval ~0 no such rule
+*/
+int termux_rule_action(termux_rules_s *ctx, int rule, const termux_call_s *call);
+
+/*!
+ @brief evaluate the rules of a sensor on a sample
+ @param[in] ns time of the sample, nanosecond of CLOCK_MONOTONIC, 0 is now
+ @return number of rules that changed
+*/
+int termux_rules_eval(termux_rules_s *ctx, const char *sensor, const double *values, int n, uint64_t ns);
+
+/*!
+ @brief evaluate the rules on a sample of a stream, to be passed to termux_stream_read() with the engine as arg
+*/
+void termux_rules_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg);
+
+/*!
+ @brief finish the actions whose calls ended or passed their deadline, without blocking
+ @return number of actions still running
+*/
+int termux_rules_poll(termux_rules_s *ctx);
+
+/*!
+ @brief read the counters of a rule
+ @retval 0 success
+ @retval ~0 no such rule
+*/
+int termux_rule_stat(const termux_rules_s *ctx, int rule, termux_rule_stat_s *stat);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_RULE_H__ */
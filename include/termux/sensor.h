@@ -0,0 +1,411 @@
+/*!
+ @file sensor.h
+ @brief termux api sensor streams
+ @details a stream keeps one child process reporting sensors until it is closed,
+ instead of one child process and one sensor registration for each reading.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_SENSOR_H__
+#define __TERMUX_SENSOR_H__
+
+#include "api.h"
+
+#define TERMUX_SAMPLE_MAX 16 //!< most values of a sensor
+#define TERMUX_SENSOR_NAME 64 //!< longest name of a sensor, with the terminating null
+#define TERMUX_BUS_MAX 16 //!< most sensors on a bus
+#define TERMUX_ADAPT_LOG 16 //!< decisions of an adaptive delay kept
+
+/*!
+ @brief what a subscriber with a full queue loses
+*/
+enum
+{
+    TERMUX_OVERFLOW_OLDEST, //!< the oldest sample queued makes room for the new one
+    TERMUX_OVERFLOW_NEWEST, //!< the new sample is dropped
+};
+
+/*!
+ @brief scheduling of a reader thread
+*/
+enum
+{
+    TERMUX_READER_OTHER, //!< time sharing, the priority is a nice value
+    TERMUX_READER_FIFO //!< SCHED_FIFO, the priority is a real-time priority
+};
+
+/*!
+ @brief options a reader thread got
+*/
+enum
+{
+    TERMUX_READER_AFFINITY = 1, //!< it runs on the cpus asked for
+    TERMUX_READER_PRIORITY = 2, //!< it runs with the scheduling asked for
+    TERMUX_READER_BUFFER = 4, //!< its stream buffer was allocated and touched
+    TERMUX_READER_LOCKED = 8 //!< its buffers are locked in memory
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief options of the threads that read streams for a bus, a sensor handle or subscribers
+*/
+typedef struct termux_reader_s
+{
+    unsigned long cpus; //!< bit i lets the thread run on cpu i, 0 for any
+    int policy; //!< TERMUX_READER_OTHER or TERMUX_READER_FIFO
+    int priority; //!< nice value or real-time priority, 0 keeps the nice value inherited
+    int lock; //!< lock the stream buffer and the rings of subscribers in memory
+    size_t buffer; //!< bytes of the stream buffer allocated before the first report, 0 lets it grow
+} termux_reader_s;
+
+/*!
+ @brief statistics of a reader thread
+ @details jitter is how far the time between two samples read is from the delay,
+ missed counts the samples the delay expected in the gaps between the times of the samples.
+*/
+typedef struct termux_reader_stat_s
+{
+    uint64_t reports; //!< samples read
+    uint64_t late; //!< samples read more than half a delay late
+    uint64_t missed; //!< samples the delay expected that never came
+    uint64_t jitter; //!< mean jitter, nanosecond
+    uint64_t jitter_max; //!< largest jitter, nanosecond
+    unsigned int applied; //!< TERMUX_READER_ flags of the options the thread got
+} termux_reader_stat_s;
+
+/*!
+ @brief bounds and thresholds of an adaptive delay
+ @details at the end of each window the delay is doubled if too many samples were lost to the consumers,
+ or halved if too many reads found no new sample, once the same was called for in hold windows in a row.
+ the stream is then started again with the new delay, and the old one is read until the new one reports.
+ with both thresholds at one half the delay settles where samples come between half and twice as often as reads.
+*/
+typedef struct termux_adapt_s
+{
+    int delay_min; //!< shortest delay, millisecond
+    int delay_max; //!< longest delay, millisecond
+    unsigned long window; //!< time over which samples and reads are counted, millisecond
+    double coarse; //!< fraction of the samples lost above which the delay gets longer
+    double fine; //!< fraction of the reads without a new sample above which the delay gets shorter
+    unsigned int hold; //!< windows in a row that call for a change before it is made, 0 is 1
+} termux_adapt_s;
+
+/*!
+ @brief decision of an adaptive delay
+*/
+typedef struct termux_adapt_event_s
+{
+    uint64_t ns; //!< time of the decision, nanosecond of CLOCK_MONOTONIC
+    int from; //!< delay before, millisecond
+    int to; //!< delay asked for, millisecond
+    int failed; //!< the stream with the new delay did not start, the old one runs on
+    double lost; //!< fraction of the samples lost in the window
+    double starved; //!< fraction of the reads without a new sample in the window
+} termux_adapt_event_s;
+
+/*!
+ @brief statistics of an adaptive delay
+*/
+typedef struct termux_adapt_stat_s
+{
+    uint64_t windows; //!< windows weighed
+    uint64_t coarser; //!< times the delay got longer
+    uint64_t finer; //!< times the delay got shorter
+    uint64_t failed; //!< changes whose stream did not start
+    uint64_t events; //!< decisions so far, the last TERMUX_ADAPT_LOG are kept
+    int delay; //!< delay of the running stream, millisecond
+    int on; //!< the delay adapts
+} termux_adapt_stat_s;
+
+/*!
+ @brief newest values of a sensor
+*/
+typedef struct termux_sample_s
+{
+    uint64_t ns; //!< time the values were read, nanosecond of CLOCK_MONOTONIC
+    uint64_t seq; //!< samples of the sensor so far
+    int n; //!< number of values
+    double values[TERMUX_SAMPLE_MAX];
+} termux_sample_s;
+
+/*!
+ @brief statistics of a subscriber
+*/
+typedef struct termux_sub_stat_s
+{
+    uint64_t delivered; //!< samples queued
+    uint64_t taken; //!< samples taken from the queue
+    uint64_t dropped; //!< samples lost to a full queue
+    uint64_t age; //!< time the last sample taken waited since it was read, nanosecond
+    size_t lag; //!< samples queued and not taken yet
+    size_t lag_max; //!< most samples queued at once
+    unsigned int subscribers; //!< subscribers sharing the stream
+} termux_sub_stat_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief child process that reports sensors until it is closed
+*/
+typedef struct termux_stream_s termux_stream_s;
+
+/*!
+ @brief latest value bus in a file that any process maps
+*/
+typedef struct termux_bus_s termux_bus_s;
+
+/*!
+ @brief handle that keeps the newest sample of a sensor at hand
+*/
+typedef struct termux_sensor_s termux_sensor_s;
+
+/*!
+ @brief subscriber to a stream shared by the subscribers of the same sensor and delay
+*/
+typedef struct termux_sub_s termux_sub_s;
+
+/*!
+ @brief metrics of the sensors of streams, see metrics.h
+*/
+typedef struct termux_metrics_s termux_metrics_s;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief start reporting sensors
+ @param[in] sensors names of the sensors separated by commas
+ @param[in] delay time between two reports, millisecond
+ @return stream, 0 on failure
+*/
+termux_stream_s *termux_stream_open(const char *sensors, int delay);
+
+/*!
+ @brief file descriptor that becomes readable when the stream has output or has ended
+*/
+int termux_stream_fd(const termux_stream_s *ctx);
+
+/*!
+ @brief decode the reports available without blocking
+ @param[in] sample called for each sensor of each report, ns is the time it was read,
+ or the time of the event on CLOCK_MONOTONIC when the report stamps it
+ @return number of values reported to sample, ~0 once the stream ended
+*/
+int termux_stream_read(termux_stream_s *ctx, void (*sample)(const char *sensor, const double *values, int n, uint64_t ns, void *arg), void *arg);
+
+/*!
+ @brief allocate the buffer of a stream at once and fault its pages in
+ @details a stream grows its buffer as reports need it, a buffer that holds the reports of a burst never moves again.
+ @param[in] byte size of the buffer, at least 8 KiB
+ @param[in] lock lock the buffer in memory as well
+ @retval 0 success
+ @retval ~0 failure, errno is from malloc() or mlock()
+*/
+int termux_stream_buffer(termux_stream_s *ctx, size_t byte, int lock);
+
+/*!
+ @brief feed metrics from the reads of a stream
+ @details the times between samples of the metrics are learned again from this stream.
+ @param[in] metrics metrics to feed, 0 for none, they must outlive the stream or be detached first
+*/
+void termux_stream_metrics(termux_stream_s *ctx, termux_metrics_s *metrics);
+
+/*!
+ @brief wait for the stream to have output
+ @param[in] ms longest time to wait, millisecond, negative is forever
+ @retval 0 readable
+ @retval ~0 errno is ETIMEDOUT or the wait failed
+*/
+int termux_stream_wait(const termux_stream_s *ctx, long ms);
+
+/*!
+ @brief stop the child process and release the stream
+*/
+void termux_stream_close(termux_stream_s *ctx);
+
+/*!
+ @brief set the options of the reader threads started from now on
+ @details each option is tried on its own, one that fails leaves the thread as it would be without it,
+ real-time scheduling and locking memory often need privileges a process does not have.
+ @param[in] options options of the threads, 0 for none
+*/
+void termux_reader_config(const termux_reader_s *options);
+
+/*!
+ @brief publish the newest sample of each sensor on a bus
+ @details a thread streams the sensors once into $TMPDIR/termux-api.<uid>.bus.<name>,
+ each sensor has a slot guarded by a seqlock, so readers never block the thread nor each other.
+ @param[in] name name of the bus
+ @param[in] sensors names of the sensors separated by commas, at most TERMUX_BUS_MAX
+ @param[in] delay time between two reports, millisecond
+ @return bus, 0 on failure
+*/
+termux_bus_s *termux_bus_publish(const char *name, const char *sensors, int delay);
+
+/*!
+ @brief map a bus to read it
+ @param[in] name name of the bus
+ @return bus, 0 on failure, errno is EPROTO if the file is not a bus
+*/
+termux_bus_s *termux_bus_open(const char *name);
+
+/*!
+ @brief stop publishing or unmap a bus
+*/
+void termux_bus_close(termux_bus_s *ctx);
+
+/*!
+ @brief find the slot of a sensor on a bus
+ @return slot, ~0 if the sensor has not reported yet
+*/
+int termux_bus_find(const termux_bus_s *ctx, const char *sensor);
+
+/*!
+ @brief name of the sensor of a slot
+ @return name, 0 if the slot is unused
+*/
+const char *termux_bus_name(const termux_bus_s *ctx, int slot);
+
+/*!
+ @brief copy the newest sample of a slot without a system call
+ @retval 0 success
+ @retval ~0 the slot is unused or has no sample yet
+*/
+int termux_bus_read(const termux_bus_s *ctx, int slot, termux_sample_s *sample);
+
+/*!
+ @brief open a handle on a sensor
+ @details a thread streams the sensor and swaps each sample in, the thread and its child process stop
+ once the handle was not read for idle milliseconds, and the next read starts them again.
+ the handle takes the samples of the sensor with the name asked for, ignoring case, or when no sensor
+ of a report has it, of the first sensor whose full name contains it.
+ @param[in] sensor name of the sensor
+ @param[in] delay time between two reports, millisecond
+ @param[in] idle time without a read before the stream stops, millisecond, 0 is never
+ @return handle, 0 on failure
+*/
+termux_sensor_s *termux_sensor_open(const char *sensor, int delay, unsigned long idle);
+
+/*!
+ @brief copy the newest sample of a sensor without waiting
+ @param[out] sample newest sample
+ @param[out] age time since the sample was read, nanosecond, may be 0
+ @return number of values
+ @retval ~0 no sample yet, errno is EAGAIN
+*/
+int termux_sensor_latest(termux_sensor_s *ctx, termux_sample_s *sample, uint64_t *age);
+
+/*!
+ @brief check if the stream of a handle runs
+*/
+int termux_sensor_running(termux_sensor_s *ctx);
+
+/*!
+ @brief read the statistics of the thread of a handle, over all the streams it started
+*/
+void termux_sensor_reader(termux_sensor_s *ctx, termux_reader_stat_s *stat);
+
+/*!
+ @brief metrics of the streams of a handle, valid until the handle is closed
+*/
+termux_metrics_s *termux_sensor_metrics(termux_sensor_s *ctx);
+
+/*!
+ @brief adapt the delay of a handle to how often it is read
+ @details a sample replaced before it was read is lost, and a read that finds the sample it found before starves.
+ samples the reports skipped are lost as well. a stream started again after it idled keeps the delay reached.
+ @param[in] adapt bounds and thresholds, 0 to keep the current delay from now on
+ @retval 0 success
+ @retval ~0 errno is EINVAL if the bounds are not 0 <= delay_min <= delay_max, the window is 0
+ or a threshold is not between 0 and 1
+*/
+int termux_sensor_adapt(termux_sensor_s *ctx, const termux_adapt_s *adapt);
+
+/*!
+ @brief read the statistics and decisions of the adaptive delay of a handle
+ @param[out] event last decisions, oldest first, may be 0
+ @param[in] max most decisions to copy
+ @return number of decisions copied
+*/
+int termux_sensor_adapt_stat(termux_sensor_s *ctx, termux_adapt_stat_s *stat, termux_adapt_event_s *event, int max);
+
+/*!
+ @brief stop the stream and release the handle
+*/
+void termux_sensor_close(termux_sensor_s *ctx);
+
+/*!
+ @brief subscribe to a sensor
+ @details the subscribers of the same sensor and delay in a process share one stream,
+ which stops when the last of them leaves. each subscriber has a queue of its own.
+ the stream takes the samples of the sensor with the name asked for, ignoring case, or when no sensor
+ of a report has it, of the first sensor whose full name contains it.
+ @param[in] sensor name of the sensor
+ @param[in] delay time between two reports, millisecond
+ @param[in] depth most samples queued
+ @param[in] overflow TERMUX_OVERFLOW_*
+ @return subscriber, 0 on failure
+*/
+termux_sub_s *termux_subscribe(const char *sensor, int delay, size_t depth, int overflow);
+
+/*!
+ @brief take the oldest sample queued for a subscriber
+ @param[out] sample oldest sample
+ @param[in] ms longest time to wait, millisecond, negative is forever
+ @return number of values
+ @retval ~0 errno is ETIMEDOUT, or EPIPE once the stream ended and the queue is empty
+*/
+int termux_sub_next(termux_sub_s *ctx, termux_sample_s *sample, long ms);
+
+/*!
+ @brief get the statistics of a subscriber
+*/
+void termux_sub_stat(termux_sub_s *ctx, termux_sub_stat_s *stat);
+
+/*!
+ @brief read the statistics of the thread of the stream a subscriber shares
+*/
+void termux_sub_reader(termux_sub_s *ctx, termux_reader_stat_s *stat);
+
+/*!
+ @brief metrics of the stream a subscriber shares, valid until it unsubscribes
+ @details the queue metrics count the samples waiting in the ring of the subscriber that lags the most.
+*/
+termux_metrics_s *termux_sub_metrics(termux_sub_s *ctx);
+
+/*!
+ @brief adapt the delay of the stream a subscriber shares to how its subscribers keep up
+ @details a sample dropped from a full ring or skipped by the reports is lost, and a ring more than half full
+ at the end of a window calls for a longer delay as well. a call of termux_sub_next() that has to wait starves.
+ the stream then has the delay reached, and only subscribers that come later with that delay share it.
+ @param[in] adapt bounds and thresholds, 0 to keep the current delay from now on
+ @retval 0 success
+ @retval ~0 errno is EINVAL as for termux_sensor_adapt()
+*/
+int termux_sub_adapt(termux_sub_s *ctx, const termux_adapt_s *adapt);
+
+/*!
+ @brief read the statistics and decisions of the adaptive delay of the stream a subscriber shares
+ @param[out] event last decisions, oldest first, may be 0
+ @param[in] max most decisions to copy
+ @return number of decisions copied
+*/
+int termux_sub_adapt_stat(termux_sub_s *ctx, termux_adapt_stat_s *stat, termux_adapt_event_s *event, int max);
+
+/*!
+ @brief leave a stream, the stream stops when its last subscriber leaves
+*/
+void termux_unsubscribe(termux_sub_s *ctx);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_SENSOR_H__ */
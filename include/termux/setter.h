@@ -0,0 +1,91 @@
+/*!
+ @file setter.h
+ @brief setters that keep only the newest value
+ @details values set faster than they can be applied replace each other, a background thread applies
+ the newest value of each target in order, no more often than the interval, and skips a value already applied.
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_SETTER_H__
+#define __TERMUX_SETTER_H__
+
+#include "api.h"
+
+/*!
+ @brief targets of the setters
+*/
+enum
+{
+    TERMUX_SETTER_BRIGHTNESS, //!< 0~255, negative is automatic
+    TERMUX_SETTER_TORCH, //!< 0 or 1
+    TERMUX_SETTER_VOLUME_CALL,
+    TERMUX_SETTER_VOLUME_SYSTEM,
+    TERMUX_SETTER_VOLUME_RING,
+    TERMUX_SETTER_VOLUME_MUSIC,
+    TERMUX_SETTER_VOLUME_ALARM,
+    TERMUX_SETTER_VOLUME_NOTICE,
+    TERMUX_SETTER_MAX
+};
+
+/*!
+ @brief statistics of a target
+*/
+typedef struct termux_setter_s
+{
+    unsigned long sets; //!< values set
+    unsigned long replaced; //!< values replaced by a newer one before they were applied
+    unsigned long skipped; //!< values equal to the one applied
+    unsigned long applied; //!< values applied
+    unsigned long failed; //!< values whose call failed
+    int value; //!< value last applied
+    int pending; //!< a value waits to be applied
+} termux_setter_s;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif /* __cplusplus */
+
+/*!
+ @brief start the thread that applies the values
+ @param[in] interval least time between two calls for one target, millisecond
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_setter_start(unsigned long interval);
+
+/*!
+ @brief apply the values still waiting, then stop the thread
+*/
+void termux_setter_stop(void);
+
+/*!
+ @brief set the newest value of a target without waiting
+ @param[in] target TERMUX_SETTER_*
+ @retval 0 success
+ @retval ~0 failure, the thread is not started or the target is unknown
+*/
+int termux_setter(int target, int value);
+
+/*!
+ @brief wait until no value waits to be applied
+*/
+void termux_setter_flush(void);
+
+/*!
+ @brief report each value that was applied
+ @param[in] applied called on the thread of the setters with the status of the call, 0 for none
+*/
+void termux_setter_report(void (*applied)(int target, int value, int status, void *arg), void *arg);
+
+/*!
+ @brief get the statistics of a target
+ @retval 0 success
+ @retval ~0 failure
+*/
+int termux_setter_stats(int target, termux_setter_s *ctx);
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* __TERMUX_SETTER_H__ */
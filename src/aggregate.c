@@ -0,0 +1,310 @@
+/*!
+ @file aggregate.c
+ @brief statistics of sensor samples over windows
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/aggregate.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AGG_X86 1
+#endif /* __x86_64__ || __i386__ */
+
+typedef void agg_f(const double *x, size_t n, int axes, termux_window_s *out);
+
+/*
+ sums are taken around the first sample of the window, so the variance of values
+ far from zero and close to each other does not vanish in rounding.
+*/
+static void agg_done(termux_window_s *out, int axes, size_t n, const double *k,
+                     const double *s, const double *q, const double *lo, const double *hi)
+{
+    double r = 1.0 / (double)n;
+    for (int a = 0; a != axes; ++a)
+    {
+        double m = s[a] * r;
+        double var = q[a] * r - m * m;
+        double ms = q[a] * r + 2 * k[a] * m + k[a] * k[a];
+        out[a].mean = k[a] + m;
+        out[a].min = lo[a];
+        out[a].max = hi[a];
+        out[a].var = var > 0 ? var : 0;
+        out[a].rms = ms > 0 ? sqrt(ms) : 0;
+    }
+}
+
+static void agg_scalar(const double *x, size_t n, int axes, termux_window_s *out)
+{
+    double k[TERMUX_SAMPLE_MAX], s[TERMUX_SAMPLE_MAX], q[TERMUX_SAMPLE_MAX];
+    double lo[TERMUX_SAMPLE_MAX], hi[TERMUX_SAMPLE_MAX];
+    for (int a = 0; a != axes; ++a)
+    {
+        k[a] = lo[a] = hi[a] = x[a];
+        s[a] = q[a] = 0;
+    }
+    for (size_t i = 0; i != n; ++i, x += axes)
+    {
+        for (int a = 0; a != axes; ++a)
+        {
+            double d = x[a] - k[a];
+            s[a] += d;
+            q[a] += d * d;
+            lo[a] = x[a] < lo[a] ? x[a] : lo[a];
+            hi[a] = x[a] > hi[a] ? x[a] : hi[a];
+        }
+    }
+    agg_done(out, axes, n, k, s, q, lo, hi);
+}
+
+/*
+ the samples are taken lanes at a time, as axes vectors in a row. lane l of vector v
+ then always holds axis (v * lanes + l) % axes, whatever the number of axes.
+ the kernel is made for vectors of each width, V of lanes doubles and M of as many masks.
+*/
+#define AGG_VECTOR(name, V, M, lanes)                                                            \
+    static inline __attribute__((always_inline)) void name(const double *x, size_t n, int axes, \
+                                                           termux_window_s *out)                \
+    {                                                                                            \
+        V kv[TERMUX_SAMPLE_MAX], sv[TERMUX_SAMPLE_MAX], qv[TERMUX_SAMPLE_MAX];                   \
+        V lv[TERMUX_SAMPLE_MAX], hv[TERMUX_SAMPLE_MAX];                                          \
+        for (int v = 0; v != axes; ++v)                                                          \
+        {                                                                                        \
+            for (int l = 0; l != lanes; ++l)                                                     \
+            {                                                                                    \
+                kv[v][l] = x[(v * lanes + l) % axes];                                            \
+            }                                                                                    \
+            sv[v] = qv[v] = kv[v] - kv[v];                                                       \
+            lv[v] = hv[v] = kv[v];                                                               \
+        }                                                                                        \
+        size_t i = 0;                                                                            \
+        for (const double *p = x; i + lanes <= n; i += lanes)                                    \
+        {                                                                                        \
+            for (int v = 0; v != axes; ++v, p += lanes)                                          \
+            {                                                                                    \
+                V a;                                                                             \
+                memcpy(&a, p, sizeof(a));                                                        \
+                V d = a - kv[v];                                                                 \
+                sv[v] += d;                                                                      \
+                qv[v] += d * d;                                                                  \
+                M m = a < lv[v];                                                                 \
+                lv[v] = (V)(((M)a & m) | ((M)lv[v] & ~m));                                       \
+                m = a > hv[v];                                                                   \
+                hv[v] = (V)(((M)a & m) | ((M)hv[v] & ~m));                                       \
+            }                                                                                    \
+        }                                                                                        \
+        double k[TERMUX_SAMPLE_MAX], s[TERMUX_SAMPLE_MAX], q[TERMUX_SAMPLE_MAX];                 \
+        double lo[TERMUX_SAMPLE_MAX], hi[TERMUX_SAMPLE_MAX];                                     \
+        for (int a = 0; a != axes; ++a)                                                          \
+        {                                                                                        \
+            k[a] = lo[a] = hi[a] = x[a];                                                         \
+            s[a] = q[a] = 0;                                                                     \
+        }                                                                                        \
+        for (int v = 0; v != axes; ++v)                                                          \
+        {                                                                                        \
+            for (int l = 0; l != lanes; ++l)                                                     \
+            {                                                                                    \
+                int a = (v * lanes + l) % axes;                                                  \
+                s[a] += sv[v][l];                                                                \
+                q[a] += qv[v][l];                                                                \
+                lo[a] = lv[v][l] < lo[a] ? lv[v][l] : lo[a];                                     \
+                hi[a] = hv[v][l] > hi[a] ? hv[v][l] : hi[a];                                     \
+            }                                                                                    \
+        }                                                                                        \
+        for (x += i * (size_t)axes; i != n; ++i, x += axes)                                      \
+        {                                                                                        \
+            for (int a = 0; a != axes; ++a)                                                      \
+            {                                                                                    \
+                double d = x[a] - k[a];                                                          \
+                s[a] += d;                                                                       \
+                q[a] += d * d;                                                                   \
+                lo[a] = x[a] < lo[a] ? x[a] : lo[a];                                             \
+                hi[a] = x[a] > hi[a] ? x[a] : hi[a];                                             \
+            }                                                                                    \
+        }                                                                                        \
+        agg_done(out, axes, n, k, s, q, lo, hi);                                                 \
+    }
+
+typedef double agg_v2 __attribute__((vector_size(16)));
+typedef long long agg_m2 __attribute__((vector_size(16)));
+AGG_VECTOR(agg_vector2, agg_v2, agg_m2, 2)
+
+typedef double agg_v4 __attribute__((vector_size(32)));
+typedef long long agg_m4 __attribute__((vector_size(32)));
+AGG_VECTOR(agg_vector4, agg_v4, agg_m4, 4)
+
+/* the common numbers of axes get kernels of their own, with the vectors in registers */
+#define AGG_AXES(kernel, x, n, axes, out)       \
+    switch (axes)                               \
+    {                                           \
+    case 1: kernel(x, n, 1, out); break;        \
+    case 2: kernel(x, n, 2, out); break;        \
+    case 3: kernel(x, n, 3, out); break;        \
+    case 4: kernel(x, n, 4, out); break;        \
+    default: kernel(x, n, axes, out);           \
+    }
+
+static void agg_128(const double *x, size_t n, int axes, termux_window_s *out)
+{
+    AGG_AXES(agg_vector2, x, n, axes, out)
+}
+
+#if defined(AGG_X86)
+__attribute__((target("avx"))) static void agg_256(const double *x, size_t n, int axes, termux_window_s *out)
+{
+    AGG_AXES(agg_vector4, x, n, axes, out)
+}
+#else /* !AGG_X86 */
+#define agg_256 agg_128
+#endif /* AGG_X86 */
+
+static agg_f *const agg_kernel[TERMUX_SIMD_MAX] = {agg_scalar, agg_128, agg_256};
+static _Atomic int agg_simd = -1;
+
+static int agg_best(void)
+{
+#if defined(AGG_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") ? TERMUX_SIMD_256 : TERMUX_SIMD_128;
+#elif defined(__ARM_NEON) || defined(__SSE2__) || defined(__ALTIVEC__) || defined(__riscv_vector)
+    return TERMUX_SIMD_128;
+#else
+    return TERMUX_SIMD_NONE;
+#endif
+}
+
+int termux_aggregate_simd(int simd)
+{
+    int best = agg_best();
+    simd = simd < TERMUX_SIMD_NONE ? TERMUX_SIMD_NONE : simd;
+    simd = simd < best ? simd : best;
+    atomic_store_explicit(&agg_simd, simd, memory_order_relaxed);
+    return simd;
+}
+
+static agg_f *agg_choose(void)
+{
+    int simd = atomic_load_explicit(&agg_simd, memory_order_relaxed);
+    if (simd < 0)
+    {
+        simd = agg_best();
+        atomic_store_explicit(&agg_simd, simd, memory_order_relaxed);
+    }
+    return agg_kernel[simd];
+}
+
+size_t termux_aggregate(const double *values, size_t n, int axes, size_t window, size_t step, termux_window_s *stats)
+{
+    if (axes < 1 || axes > TERMUX_SAMPLE_MAX || window == 0 || step == 0 || n < window)
+    {
+        return 0;
+    }
+    agg_f *kernel = agg_choose();
+    size_t windows = (n - window) / step + 1;
+    for (size_t w = 0; w != windows; ++w)
+    {
+        kernel(values + w * step * (size_t)axes, window, axes, stats + w * (size_t)axes);
+    }
+    return windows;
+}
+
+int termux_aggregate_init(termux_aggregate_s *ctx, int axes, size_t window, size_t step)
+{
+    ctx->buf = 0;
+    if (axes < 1 || axes > TERMUX_SAMPLE_MAX || window == 0 || step == 0 ||
+        window > SIZE_MAX / sizeof(double) / (size_t)axes)
+    {
+        return ~0;
+    }
+    ctx->buf = (double *)malloc(sizeof(double) * window * (size_t)axes);
+    if (ctx->buf == 0)
+    {
+        return ~0;
+    }
+    ctx->axes = axes;
+    ctx->window = window;
+    ctx->step = step;
+    ctx->windows = 0;
+    ctx->fill = 0;
+    ctx->skip = 0;
+    return 0;
+}
+
+size_t termux_aggregate_feed(termux_aggregate_s *ctx, const double *values, size_t n,
+                             void (*done)(const termux_window_s *stats, int axes, void *arg), void *arg)
+{
+    termux_window_s stats[TERMUX_SAMPLE_MAX];
+    size_t const axes = (size_t)ctx->axes;
+    agg_f *kernel = agg_choose();
+    size_t count = 0, taken = 0;
+    while (n)
+    {
+        size_t k;
+        if (ctx->skip)
+        {
+            k = ctx->skip < n ? ctx->skip : n;
+            ctx->skip -= k;
+        }
+        else if (ctx->fill == 0 && n >= ctx->window)
+        {
+            /* the window lies in the batch, reduce it where it is */
+            kernel(values, ctx->window, ctx->axes, stats);
+            done(stats, ctx->axes, arg);
+            ++count;
+            k = ctx->step < n ? ctx->step : n;
+            ctx->skip = ctx->step - k;
+        }
+        else
+        {
+            k = ctx->window - ctx->fill;
+            k = k < n ? k : n;
+            memcpy(ctx->buf + ctx->fill * axes, values, sizeof(double) * k * axes);
+            ctx->fill += k;
+            if (ctx->fill == ctx->window)
+            {
+                kernel(ctx->buf, ctx->window, ctx->axes, stats);
+                done(stats, ctx->axes, arg);
+                ++count;
+                if (ctx->step < ctx->window)
+                {
+                    ctx->fill = ctx->window - ctx->step;
+                    memmove(ctx->buf, ctx->buf + ctx->step * axes, sizeof(double) * ctx->fill * axes);
+                }
+                else
+                {
+                    ctx->skip = ctx->step - ctx->window;
+                    ctx->fill = 0;
+                }
+                /* the samples kept are all of this batch, take them from it again */
+                if (ctx->fill && ctx->fill <= taken + k)
+                {
+                    values -= ctx->fill * axes;
+                    n += ctx->fill;
+                    taken -= ctx->fill;
+                    ctx->fill = 0;
+                }
+            }
+        }
+        values += k * axes;
+        taken += k;
+        n -= k;
+    }
+    ctx->windows += count;
+    return count;
+}
+
+void termux_aggregate_reset(termux_aggregate_s *ctx)
+{
+    ctx->fill = 0;
+    ctx->skip = 0;
+}
+
+void termux_aggregate_exit(termux_aggregate_s *ctx)
+{
+    free(ctx->buf);
+    ctx->buf = 0;
+}
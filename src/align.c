@@ -0,0 +1,282 @@
+/*!
+ @file align.c
+ @brief samples of several sensors aligned into frames at a fixed rate
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/align.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+typedef struct align_sensor_s
+{
+    char want[TERMUX_SENSOR_NAME]; //!< name asked for
+    char name[TERMUX_SENSOR_NAME]; //!< full name of the samples taken, empty before the first
+    int bound; //!< name is no longer a candidate
+    int n; //!< values of the newest sample
+    size_t head; //!< oldest sample in the ring
+    size_t count; //!< samples in the ring
+    uint64_t *ns;
+    double (*values)[TERMUX_SAMPLE_MAX];
+} align_sensor_s;
+
+struct termux_align_s
+{
+    int sensors;
+    int mode;
+    size_t depth;
+    uint64_t period;
+    uint64_t latency;
+    uint64_t t; //!< time of the next frame, 0 before the first
+    termux_align_stat_s stat;
+    align_sensor_s sensor[TERMUX_ALIGN_MAX];
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static uint64_t align_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+termux_align_s *termux_align_new(const char *sensors, uint64_t period, int mode, size_t depth, uint64_t latency)
+{
+    if (sensors == 0 || period == 0 || depth < 2 || (mode != TERMUX_ALIGN_HOLD && mode != TERMUX_ALIGN_LINEAR))
+    {
+        errno = EINVAL;
+        return 0;
+    }
+    termux_align_s *ctx = (termux_align_s *)calloc(1, sizeof(termux_align_s));
+    if (ctx == 0)
+    {
+        return 0;
+    }
+    ctx->mode = mode;
+    ctx->depth = depth;
+    ctx->period = period;
+    ctx->latency = latency;
+    for (const char *p = sensors; *p;)
+    {
+        size_t len = strcspn(p, ",");
+        if (len && len < TERMUX_SENSOR_NAME && ctx->sensors != TERMUX_ALIGN_MAX)
+        {
+            align_sensor_s *sensor = ctx->sensor + ctx->sensors++;
+            memcpy(sensor->want, p, len);
+            sensor->ns = (uint64_t *)malloc(sizeof(uint64_t) * depth);
+            sensor->values = (double(*)[TERMUX_SAMPLE_MAX])malloc(sizeof(*sensor->values) * depth);
+            if (sensor->ns == 0 || sensor->values == 0)
+            {
+                termux_align_free(ctx);
+                return 0;
+            }
+        }
+        p += len + (p[len] == ',');
+    }
+    if (ctx->sensors == 0)
+    {
+        termux_align_free(ctx);
+        errno = EINVAL;
+        return 0;
+    }
+    return ctx;
+}
+
+void termux_align_free(termux_align_s *ctx)
+{
+    if (ctx == 0)
+    {
+        return;
+    }
+    for (int i = 0; i != ctx->sensors; ++i)
+    {
+        free(ctx->sensor[i].ns);
+        free(ctx->sensor[i].values);
+    }
+    free(ctx);
+}
+
+/* the name asked for is taken at once, else the first name that contains it once it comes again and a whole report had no exact name */
+static int align_find(termux_align_s *ctx, const char *name)
+{
+    for (int i = 0; i != ctx->sensors; ++i)
+    {
+        if (ctx->sensor[i].bound && strncmp(ctx->sensor[i].name, name, TERMUX_SENSOR_NAME - 1) == 0)
+        {
+            return i;
+        }
+    }
+    int found = ~0;
+    for (int i = 0; i != ctx->sensors && found < 0; ++i)
+    {
+        align_sensor_s *sensor = ctx->sensor + i;
+        if (!sensor->bound && strcasecmp(name, sensor->want) == 0)
+        {
+            strncpy(sensor->name, name, TERMUX_SENSOR_NAME - 1);
+            found = i;
+        }
+    }
+    for (int i = 0; i != ctx->sensors && found < 0; ++i)
+    {
+        align_sensor_s *sensor = ctx->sensor + i;
+        if (!sensor->bound && sensor->name[0] && strncmp(sensor->name, name, TERMUX_SENSOR_NAME - 1) == 0)
+        {
+            found = i;
+        }
+    }
+    if (found >= 0)
+    {
+        ctx->sensor[found].bound = 1;
+        /* the name is no longer a candidate of another sensor */
+        for (int i = 0; i != ctx->sensors; ++i)
+        {
+            align_sensor_s *sensor = ctx->sensor + i;
+            if (!sensor->bound && strncmp(sensor->name, name, TERMUX_SENSOR_NAME - 1) == 0)
+            {
+                memset(sensor->name, 0, sizeof(sensor->name));
+            }
+        }
+        return found;
+    }
+    for (int i = 0; i != ctx->sensors; ++i)
+    {
+        align_sensor_s *sensor = ctx->sensor + i;
+        if (sensor->name[0] == 0 && strcasestr(name, sensor->want))
+        {
+            strncpy(sensor->name, name, TERMUX_SENSOR_NAME - 1);
+            break;
+        }
+    }
+    return ~0;
+}
+
+int termux_align_push(termux_align_s *ctx, const char *sensor, const double *values, int n, uint64_t ns)
+{
+    int i = align_find(ctx, sensor);
+    if (i < 0)
+    {
+        return ~0;
+    }
+    align_sensor_s *s = ctx->sensor + i;
+    if (ns == 0)
+    {
+        ns = align_clock();
+    }
+    if (s->count && ns < s->ns[(s->head + s->count - 1) % ctx->depth])
+    {
+        ++ctx->stat.dropped;
+        return ~0;
+    }
+    if (s->count == ctx->depth)
+    {
+        s->head = (s->head + 1) % ctx->depth;
+        --s->count;
+        ++ctx->stat.dropped;
+    }
+    size_t slot = (s->head + s->count++) % ctx->depth;
+    s->n = n < 0 ? 0 : n < TERMUX_SAMPLE_MAX ? n : TERMUX_SAMPLE_MAX;
+    s->ns[slot] = ns;
+    memcpy(s->values[slot], values, sizeof(double) * (size_t)s->n);
+    ++ctx->stat.pushed;
+    return i;
+}
+
+void termux_align_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    termux_align_push((termux_align_s *)arg, sensor, values, n, ns);
+}
+
+int termux_align_next(termux_align_s *ctx, uint64_t now, termux_frame_s *frame)
+{
+    uint64_t oldest = 0;
+    int ready = 1;
+    for (int i = 0; i != ctx->sensors; ++i)
+    {
+        align_sensor_s *s = ctx->sensor + i;
+        if (s->count == 0)
+        {
+            errno = EAGAIN;
+            return ~0;
+        }
+        oldest = s->ns[s->head] > oldest ? s->ns[s->head] : oldest;
+    }
+    /* start on the first multiple of the period all sensors reach, skip frames whose samples are gone */
+    if (ctx->t < oldest)
+    {
+        uint64_t k = (oldest - ctx->t + ctx->period - 1) / ctx->period;
+        ctx->stat.skipped += ctx->t ? k : 0;
+        ctx->t = ctx->t ? ctx->t + k * ctx->period : (oldest + ctx->period - 1) / ctx->period * ctx->period;
+    }
+    uint64_t t = ctx->t;
+    for (int i = 0; i != ctx->sensors; ++i)
+    {
+        align_sensor_s *s = ctx->sensor + i;
+        ready &= s->ns[(s->head + s->count - 1) % ctx->depth] >= t;
+    }
+    if (!ready && (now ? now : align_clock()) < t + ctx->latency)
+    {
+        errno = EAGAIN;
+        return ~0;
+    }
+    frame->ns = t;
+    frame->sensors = ctx->sensors;
+    frame->stale = 0;
+    for (int i = 0; i != ctx->sensors; ++i)
+    {
+        align_sensor_s *s = ctx->sensor + i;
+        /* keep one sample at or before the frame, the next frames are later */
+        while (s->count > 1 && s->ns[(s->head + 1) % ctx->depth] <= t)
+        {
+            s->head = (s->head + 1) % ctx->depth;
+            --s->count;
+        }
+        size_t l = s->head, r = (s->head + 1) % ctx->depth;
+        frame->n[i] = s->n;
+        if (ctx->mode == TERMUX_ALIGN_LINEAR && s->count > 1 && s->ns[l] < t)
+        {
+            double w = (double)(t - s->ns[l]) / (double)(s->ns[r] - s->ns[l]);
+            for (int a = 0; a != s->n; ++a)
+            {
+                frame->values[i][a] = s->values[l][a] + (s->values[r][a] - s->values[l][a]) * w;
+            }
+        }
+        else
+        {
+            memcpy(frame->values[i], s->values[l], sizeof(double) * (size_t)s->n);
+        }
+        if (s->ns[(s->head + s->count - 1) % ctx->depth] < t)
+        {
+            frame->stale |= 1U << i;
+            ++ctx->stat.stale;
+        }
+    }
+    ctx->t = t + ctx->period;
+    ++ctx->stat.frames;
+    return 0;
+}
+
+const char *termux_align_name(const termux_align_s *ctx, int sensor)
+{
+    if (sensor < 0 || sensor >= ctx->sensors)
+    {
+        return 0;
+    }
+    return ctx->sensor[sensor].bound ? ctx->sensor[sensor].name : ctx->sensor[sensor].want;
+}
+
+void termux_align_stat(const termux_align_s *ctx, termux_align_stat_s *stat)
+{
+    *stat = ctx->stat;
+}
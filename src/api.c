@@ -5,14 +5,28 @@
 */
 
 #include "termux/api.h"
+#include "termux/call.h"
+#include "termux/sensor.h"
+#include "termux/metrics.h"
 
 #include "pipe.h"
+#include <time.h>
+#include <poll.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 #include <jansson.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 
 #if defined(__GNUC__) || defined(__clang__)
 #pragma GCC diagnostic push
@@ -24,8 +38,8 @@
 */
 typedef struct
 {
-    FILE *wr;
-    FILE *rd;
+    int wr;
+    int rd;
     pid_t pid;
 } api_s;
 
@@ -33,1130 +47,2984 @@ typedef struct
 #pragma GCC diagnostic pop
 #endif /* __GNUC__ || __clang__ */
 
-static int api_command(int argc, char *argv[])
+#define API_RING 64
+
+/*!
+ @brief latency estimate of an endpoint
+*/
+typedef struct
 {
-    extern int run_api_command(int, char **);
-    int fd = run_api_command(argc, argv);
-    if (fd != -1)
-    {
-        _Noreturn void exec_callback(int);
-        exec_callback(fd);
-    }
-    return 0;
+    uint64_t ring[API_RING]; //!< recent latencies, microsecond
+    unsigned long count;
+    unsigned long kills;
+    unsigned long shared;
+    unsigned long init; //!< deadline before enough samples, millisecond
+    unsigned long floor;
+    unsigned long ceil;
+    unsigned int scale;
+} api_stat_s;
+
+#define API_STAT(ms) {.init = ms, .floor = 100, .ceil = 10000, .scale = 4}
+
+static api_stat_s api_stat[TERMUX_API_MAX] = {
+    [TERMUX_API_BRIGHTNESS] = API_STAT(1000),
+    [TERMUX_API_CLIPBOARD_GET] = API_STAT(1000),
+    [TERMUX_API_CLIPBOARD_SET] = API_STAT(1000),
+    [TERMUX_API_DIALOG] = API_STAT(1000),
+    [TERMUX_API_FINGERPRINT] = API_STAT(1000),
+    [TERMUX_API_SENSOR_CLEANUP] = API_STAT(1000),
+    [TERMUX_API_SENSOR_LIST] = API_STAT(1000),
+    [TERMUX_API_SENSOR] = API_STAT(1000),
+    [TERMUX_API_TOAST] = API_STAT(300),
+    [TERMUX_API_TORCH] = API_STAT(1000),
+    [TERMUX_API_VIBRATE] = API_STAT(1000),
+    [TERMUX_API_VOLUME_GET] = API_STAT(1000),
+    [TERMUX_API_VOLUME_SET] = API_STAT(1000),
+};
+
+#undef API_STAT
+
+static pthread_mutex_t api_stat_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* deadline of the next call on this thread, 0 is adaptive */
+static _Thread_local unsigned long api_once;
+static _Thread_local termux_cancel_s *api_cancel;
+
+static uint64_t api_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
 }
 
-#define R 0
-#define W 1
+#define API_POLL 10 /* millisecond between looks at the token of a call waiting on a condition */
 
-__attribute__((unused)) static int api_open(api_s *ctx, int argc, char *argv[])
+/* the cause a waiting call gives up with at end, microsecond, or once its token is cancelled, 0 while it may wait */
+static int api_expired(uint64_t end, const termux_cancel_s *cancel)
 {
-    ctx->wr = 0;
-    ctx->rd = 0;
-    ctx->pid = ~0;
-
-    /* create two pipes */
-    int pipe_wr[2];
-    if (pipe(pipe_wr) < 0)
-    {
-        goto pipe_wr;
-    }
-    int pipe_rd[2];
-    if (pipe(pipe_rd) < 0)
+    if (cancel && termux_cancelled(cancel))
     {
-        goto pipe_rd;
+        errno = ECANCELED;
+        return TERMUX_CANCEL;
     }
-
-    /* create a child process */
-    ctx->pid = fork();
-    if (ctx->pid < 0)
+    if (end && api_clock() >= end)
     {
-        goto pipe_rw;
+        errno = ETIMEDOUT;
+        return TERMUX_TIMEOUT;
     }
+    return 0;
+}
 
-    if (ctx->pid == 0)
+/* wait on a condition no later than end, microsecond, 0 is none */
+static void api_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, uint64_t end, const termux_cancel_s *cancel)
+{
+    if (end == 0 && cancel == 0)
     {
-        close(pipe_wr[W]);
-        close(pipe_rd[R]);
-
-        if (pipe_wr[R] != STDIN_FILENO)
-        {
-            int ok = dup2(pipe_wr[R], STDIN_FILENO);
-            close(pipe_wr[R]);
-            if (ok < 0)
-            {
-                _exit(EXIT_FAILURE);
-            }
-        }
-        if (pipe_rd[W] != STDOUT_FILENO)
-        {
-            int ok = dup2(pipe_rd[W], STDOUT_FILENO);
-            close(pipe_rd[W]);
-            if (ok < 0)
-            {
-                _exit(EXIT_FAILURE);
-            }
-        }
-
-        _exit(api_command(argc, argv));
+        pthread_cond_wait(cond, mutex);
+        return;
     }
-
-    close(pipe_wr[R]);
-    close(pipe_rd[W]);
-
-    ctx->wr = fdopen(pipe_wr[W], "w");
-    if (ctx->wr == 0)
+    /* a token cannot signal the condition, so it is looked at every API_POLL */
+    uint64_t now = api_clock();
+    uint64_t us = end ? (end > now ? end - now : 0) : API_POLL * 1000;
+    if (cancel && us > API_POLL * 1000)
     {
-        goto open_wr;
+        us = API_POLL * 1000;
     }
-    ctx->rd = fdopen(pipe_rd[R], "r");
-    if (ctx->rd == 0)
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)(us / 1000000);
+    ts.tv_nsec += (long)(us % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000)
     {
-        goto open_rd;
+        ts.tv_nsec -= 1000000000;
+        ++ts.tv_sec;
     }
-
-    return 0;
-
-open_rd:
-    close(pipe_rd[R]);
-open_wr:
-    close(pipe_wr[W]);
-
-    return ~0;
-
-pipe_rw:
-    close(pipe_rd[R]);
-    close(pipe_rd[W]);
-pipe_rd:
-    close(pipe_wr[R]);
-    close(pipe_wr[W]);
-pipe_wr:
-    return ~0;
+    pthread_cond_timedwait(cond, mutex, &ts);
 }
 
-#undef R
-#undef W
-
-__attribute__((unused)) static int api_close(api_s *ctx)
+static int api_cmp(const void *lhs, const void *rhs)
 {
-    int status = 0;
+    uint64_t l = *(const uint64_t *)lhs;
+    uint64_t r = *(const uint64_t *)rhs;
+    return (l > r) - (l < r);
+}
 
-    if (ctx->pid < 0)
+/* must be called with api_stat_mutex held */
+static uint64_t api_quantile(const api_stat_s *stat, unsigned int percent)
+{
+    uint64_t ring[API_RING];
+    size_t n = stat->count < API_RING ? stat->count : API_RING;
+    if (n == 0)
     {
-        errno = ECHILD;
-        return ~0;
+        return 0;
     }
+    memcpy(ring, stat->ring, sizeof(uint64_t) * n);
+    qsort(ring, n, sizeof(uint64_t), api_cmp);
+    return ring[(n * percent + 99) / 100 - 1];
+}
 
-    if (ctx->wr && fclose(ctx->wr) == EOF)
+/* must be called with api_stat_mutex held */
+static unsigned long api_deadline(const api_stat_s *stat)
+{
+    if (stat->count < 8)
     {
-        clearerr(ctx->wr);
+        return stat->init;
     }
-    ctx->wr = 0;
-    if (ctx->rd && fclose(ctx->rd) == EOF)
+    unsigned long ms = (unsigned long)(api_quantile(stat, 99) * stat->scale / 1000) + 1;
+    if (ms < stat->floor)
     {
-        clearerr(ctx->rd);
+        ms = stat->floor;
     }
-    ctx->rd = 0;
-
-    /* check if the child process to terminate */
-    while (waitpid(ctx->pid, &status, WNOHANG) == 0)
+    if (ms > stat->ceil)
     {
-        kill(ctx->pid, SIGTERM);
+        ms = stat->ceil;
     }
-    ctx->pid = ~0;
+    return ms;
+}
 
-    /* check if the child process terminated normally */
-    if (WIFEXITED(status))
+/*!
+ @brief health of the Termux:API service shared by the process
+*/
+typedef struct
+{
+    int state;
+    unsigned int failures;
+    unsigned int threshold;
+    unsigned long backoff; //!< millisecond
+    unsigned long backoff_min;
+    unsigned long backoff_max;
+    unsigned long opens;
+    unsigned long rejects;
+    uint64_t until; //!< microsecond
+} api_breaker_s;
+
+static api_breaker_s api_breaker = {
+    .state = TERMUX_BREAKER_CLOSED,
+    .threshold = 5,
+    .backoff = 500,
+    .backoff_min = 500,
+    .backoff_max = 30000,
+};
+
+/* must be called with api_stat_mutex held */
+static void api_breaker_open(api_breaker_s *ctx, uint64_t now)
+{
+    ctx->state = TERMUX_BREAKER_OPEN;
+    ctx->until = now + (uint64_t)ctx->backoff * 1000;
+    ++ctx->opens;
+}
+
+/* must be called with api_stat_mutex held */
+static int api_breaker_admit(api_breaker_s *ctx, uint64_t now)
+{
+    if (ctx->state == TERMUX_BREAKER_OPEN && now >= ctx->until)
     {
-        return WEXITSTATUS(status);
+        /* let one request through to probe the service */
+        ctx->state = TERMUX_BREAKER_PROBE;
+        return 1;
     }
-    /* check if the child process was terminated by a signal */
-    if (WIFSIGNALED(status))
+    if (ctx->state != TERMUX_BREAKER_CLOSED)
     {
-        return WTERMSIG(status);
+        ++ctx->rejects;
+        return ~0;
     }
-    /* reached only if the process did not terminate normally */
-    errno = ECHILD;
-    return status;
+    return 0;
 }
 
-__attribute__((unused)) static int api_wait(const api_s *ctx, unsigned long ms)
+/* must be called with api_stat_mutex held */
+static void api_breaker_done(api_breaker_s *ctx, int probe, int failed, uint64_t now)
 {
-    errno = 0;
-    int status = 0;
-    pid_t wait = waitpid(ctx->pid, &status, WNOHANG);
-    if (wait != 0 || ms == 0)
+    if (!failed)
     {
-        /* wait for the child process to terminate */
-        while (wait == ~0 && errno == EINTR)
+        ctx->failures = 0;
+        if (probe)
         {
-            wait = waitpid(ctx->pid, &status, 0);
+            ctx->state = TERMUX_BREAKER_CLOSED;
+            ctx->backoff = ctx->backoff_min;
         }
-        goto exit;
-    }
-
-    sigset_t mask;
-    sigemptyset(&mask);
-    sigaddset(&mask, SIGCHLD);
-
-    sigset_t orig_mask;
-    if (sigprocmask(SIG_BLOCK, &mask, &orig_mask) < 0)
-    {
-        return ~0;
+        return;
     }
-
-    struct timespec timeout = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000};
-    while (sigtimedwait(&mask, NULL, &timeout) < 0)
+    ++ctx->failures;
+    if (probe)
     {
-        if (errno == EAGAIN)
+        ctx->backoff <<= 1;
+        if (ctx->backoff > ctx->backoff_max)
         {
-            errno = ETIMEDOUT;
-            return ~0;
+            ctx->backoff = ctx->backoff_max;
         }
+        api_breaker_open(ctx, now);
     }
-
-    if (sigprocmask(SIG_SETMASK, &orig_mask, 0) < 0)
+    else if (ctx->state == TERMUX_BREAKER_CLOSED && ctx->failures >= ctx->threshold)
     {
-        return ~0;
+        api_breaker_open(ctx, now);
     }
-
-exit:
-    return status;
 }
 
-__attribute__((unused)) static int api_flush(const api_s *ctx)
+/* must be called with api_stat_mutex held, a cancelled call tells nothing of the service */
+static void api_breaker_skip(api_breaker_s *ctx, int probe, uint64_t now)
 {
-    int ok = 0;
-    if (ctx->wr)
+    if (probe)
     {
-        ok += fflush(ctx->wr);
+        /* the next request probes in its place */
+        ctx->state = TERMUX_BREAKER_OPEN;
+        ctx->until = now;
     }
-    if (ctx->rd)
-    {
-        ok += fflush(ctx->rd);
-    }
-    return ok;
-}
-
-__attribute__((unused)) static int api_getc(const api_s *ctx)
-{
-    return fgetc(ctx->rd);
 }
 
-__attribute__((unused)) static int api_putc(const api_s *ctx, int c)
+/* let the breaker admit a call, which may be the one to probe the service */
+static int api_probe(termux_call_s *ctx)
 {
-    return fputc(c, ctx->wr);
+    pthread_mutex_lock(&api_stat_mutex);
+    ctx->probe = api_breaker_admit(&api_breaker, api_clock());
+    pthread_mutex_unlock(&api_stat_mutex);
+    if (ctx->probe < 0)
+    {
+        errno = ECONNREFUSED;
+        return TERMUX_REJECT;
+    }
+    return 0;
 }
 
-__attribute__((unused)) static int api_puts(const api_s *ctx, const char *str)
+/* a call the breaker admitted did not run */
+static void api_unprobe(const termux_call_s *ctx)
 {
-    return fputs(str, ctx->wr);
+    pthread_mutex_lock(&api_stat_mutex);
+    api_breaker_skip(&api_breaker, ctx->probe, api_clock());
+    pthread_mutex_unlock(&api_stat_mutex);
 }
 
-__attribute__((unused)) static size_t api_read(const api_s *ctx, void *data, size_t byte)
+/* start the clock of a call, a deadline at end, microsecond, is what its waits left of it */
+static void api_begin(termux_call_s *ctx, int api, int wait, uint64_t end)
 {
-    return fread(data, 1, byte, ctx->rd);
+    ctx->t0 = api_clock();
+    ctx->ms = 0;
+    if (end)
+    {
+        ctx->ms = end > ctx->t0 ? (unsigned long)((end - ctx->t0 + 999) / 1000) : 1;
+    }
+    if (ctx->ms == 0 && wait)
+    {
+        pthread_mutex_lock(&api_stat_mutex);
+        ctx->ms = api_deadline(api_stat + api);
+        pthread_mutex_unlock(&api_stat_mutex);
+    }
 }
 
-__attribute__((unused)) static size_t api_write(const api_s *ctx, const void *data, size_t byte)
+static void api_end(const termux_call_s *ctx, int api, int killed, int failed)
 {
-    return fwrite(data, 1, byte, ctx->wr);
+    uint64_t now = api_clock();
+    api_stat_s *stat = api_stat + api;
+    pthread_mutex_lock(&api_stat_mutex);
+    /* a killed call took at least this long, which lets the deadline grow */
+    stat->ring[stat->count % API_RING] = now - ctx->t0;
+    stat->kills += (unsigned long)killed;
+    ++stat->count;
+    if (ctx->cause == TERMUX_CANCEL)
+    {
+        api_breaker_skip(&api_breaker, ctx->probe, now);
+    }
+    else
+    {
+        api_breaker_done(&api_breaker, ctx->probe, killed || failed, now);
+    }
+    pthread_mutex_unlock(&api_stat_mutex);
 }
 
-__attribute__((unused)) static int __attribute__((format(printf, 2, 3))) api_printf(const api_s *ctx, const char *fmt, ...)
+int termux_breaker(termux_breaker_s *ctx)
 {
-    int stats;
-    va_list va;
-    va_start(va, fmt);
-    stats = vfprintf(ctx->wr, fmt, va);
-    va_end(va);
-    return stats;
+    uint64_t now = api_clock();
+    pthread_mutex_lock(&api_stat_mutex);
+    ctx->state = api_breaker.state;
+    ctx->failures = api_breaker.failures;
+    ctx->backoff = api_breaker.backoff;
+    ctx->retry = 0;
+    if (api_breaker.state == TERMUX_BREAKER_OPEN && api_breaker.until > now)
+    {
+        ctx->retry = (unsigned long)((api_breaker.until - now + 999) / 1000);
+    }
+    ctx->opens = api_breaker.opens;
+    ctx->rejects = api_breaker.rejects;
+    pthread_mutex_unlock(&api_stat_mutex);
+    return ctx->state;
 }
 
-__attribute__((unused)) static void argv_display(char *const argv[])
+int termux_breaker_config(unsigned int threshold, unsigned long backoff_min, unsigned long backoff_max)
 {
-    while (*argv)
+    if (threshold == 0 || backoff_min == 0 || backoff_min > backoff_max)
     {
-        printf("%s ", *argv++);
+        errno = EINVAL;
+        return ~0;
     }
-    putchar('\n');
+    pthread_mutex_lock(&api_stat_mutex);
+    api_breaker.threshold = threshold;
+    api_breaker.backoff_min = backoff_min;
+    api_breaker.backoff_max = backoff_max;
+    api_breaker.backoff = backoff_min;
+    pthread_mutex_unlock(&api_stat_mutex);
+    return 0;
 }
 
-static int pipe_exec(int argc, char *argv[], unsigned long timeout)
+void termux_breaker_reset(void)
 {
-    api_s ctx[1];
-    api_open(ctx, argc, argv);
-    api_wait(ctx, timeout);
-    return api_close(ctx);
+    pthread_mutex_lock(&api_stat_mutex);
+    api_breaker.state = TERMUX_BREAKER_CLOSED;
+    api_breaker.failures = 0;
+    api_breaker.backoff = api_breaker.backoff_min;
+    pthread_mutex_unlock(&api_stat_mutex);
 }
 
-static int write_text(int argc, char *argv[], void *data, size_t byte)
+/*!
+ @brief call waiting for a slot, on the stack of its thread
+*/
+typedef struct api_waiter_s
 {
-    api_s ctx[1];
-    api_open(ctx, argc, argv);
-    api_write(ctx, data, byte);
-    return api_close(ctx);
-}
+    struct api_waiter_s *next;
+} api_waiter_s;
 
-static int read_text(int argc, char *argv[], char **data, size_t *byte)
+/*!
+ @brief queue of a priority class
+ @details waiters are linked in order and run when they come first, so each class is served FIFO,
+ a waiter that gives up unlinks itself.
+*/
+typedef struct
 {
-    api_s ctx[1];
-    api_open(ctx, argc, argv);
-    if (data && byte)
+    api_waiter_s *head; //!< waiter to run next
+    api_waiter_s *tail; //!< waiter that came last
+    unsigned long admitted;
+    unsigned long waited;
+    unsigned long rejected;
+    uint64_t wait; //!< total time in the queue, microsecond
+    uint64_t wait_max;
+    unsigned int queued;
+    unsigned int queued_max;
+} api_class_s;
+
+static api_class_s api_class[TERMUX_PRIORITY_MAX];
+/* read by api_admit() and api_bucket_take() without a lock, written under api_sched_mutex */
+static _Atomic int api_priority[TERMUX_API_MAX] = {
+    [TERMUX_API_BRIGHTNESS] = TERMUX_PRIORITY_NORMAL,
+    [TERMUX_API_CLIPBOARD_GET] = TERMUX_PRIORITY_NORMAL,
+    [TERMUX_API_CLIPBOARD_SET] = TERMUX_PRIORITY_NORMAL,
+    [TERMUX_API_DIALOG] = TERMUX_PRIORITY_HIGH,
+    [TERMUX_API_FINGERPRINT] = TERMUX_PRIORITY_HIGH,
+    [TERMUX_API_SENSOR_CLEANUP] = TERMUX_PRIORITY_LOW,
+    [TERMUX_API_SENSOR_LIST] = TERMUX_PRIORITY_LOW,
+    [TERMUX_API_SENSOR] = TERMUX_PRIORITY_LOW,
+    [TERMUX_API_TOAST] = TERMUX_PRIORITY_NORMAL,
+    [TERMUX_API_TORCH] = TERMUX_PRIORITY_NORMAL,
+    [TERMUX_API_VIBRATE] = TERMUX_PRIORITY_NORMAL,
+    [TERMUX_API_VOLUME_GET] = TERMUX_PRIORITY_LOW,
+    [TERMUX_API_VOLUME_SET] = TERMUX_PRIORITY_NORMAL,
+};
+static pthread_mutex_t api_sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t api_sched_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int api_running;
+static unsigned int api_max;
+static unsigned int api_depth;
+
+/* must be called with api_sched_mutex held, a slot is free and no higher class waits for one */
+static int api_sched_free(int priority)
+{
+    for (int i = 0; i < priority; ++i)
     {
-        *data = 0;
-        *byte = 0;
-        for (size_t size = BUFSIZ; size == BUFSIZ; *byte += size)
+        if (api_class[i].head)
         {
-            char buff[BUFSIZ];
-            size = api_read(ctx, buff, BUFSIZ);
-            if (size)
-            {
-                char *output = (char *)realloc(*data, size + 1);
-                if (output == 0)
-                {
-                    break;
-                }
-                *data = output;
-                memcpy(*data + *byte, buff, size);
-            }
-        }
-        if (*byte)
-        {
-            (*data)[*byte] = 0;
+            return 0;
         }
     }
-    return api_close(ctx);
+    return api_max == 0 || api_running < api_max;
 }
 
-static json_t *read_json(int argc, char *argv[])
+/* must be called with api_sched_mutex held */
+static void api_unqueue(api_class_s *ctx, api_waiter_s *waiter)
 {
-    api_s ctx[1];
-    if (api_open(ctx, argc, argv))
+    api_waiter_s *prev = 0, **node = &ctx->head;
+    while (*node != waiter)
     {
-        return 0;
+        prev = *node;
+        node = &prev->next;
     }
-    json_error_t error;
-    json_t *root = json_loadf(ctx->rd, 0, &error);
-    api_close(ctx);
-    return root;
+    *node = waiter->next;
+    if (ctx->tail == waiter)
+    {
+        ctx->tail = prev;
+    }
+    --ctx->queued;
 }
 
-int termux_init(void)
+/* take a slot for a child process, waiting for one in the queue of the endpoint if wait, until end or the token */
+static int api_admit(int api, int wait, uint64_t end, const termux_cancel_s *cancel)
 {
-    char buf[64];
-    pipe_s ctx[1];
-    pipe_open3(ctx,
-               "/data/data/com.termux/files/usr/bin/am",
-               (char *[]){"am", "startservice", "-n", "com.termux.api/.KeepAliveService"},
-               0);
-    fread(buf, 1, 100, ctx->er);
-    pipe_close(ctx);
-    if (*buf != 'E')
-    {
+    int priority = atomic_load_explicit(api_priority + api, memory_order_relaxed);
+    api_class_s *ctx = api_class + priority;
+    pthread_mutex_lock(&api_sched_mutex);
+    if (ctx->head == 0 && api_sched_free(priority))
+    {
+        ++api_running;
+        ++ctx->admitted;
+        pthread_mutex_unlock(&api_sched_mutex);
         return 0;
     }
-    fputs(buf, stderr);
-    return ~0;
+    if (!wait || (api_depth && ctx->queued >= api_depth))
+    {
+        ++ctx->rejected;
+        pthread_mutex_unlock(&api_sched_mutex);
+        errno = EAGAIN;
+        return TERMUX_REJECT;
+    }
+    api_waiter_s waiter = {0};
+    if (ctx->tail)
+    {
+        ctx->tail->next = &waiter;
+    }
+    else
+    {
+        ctx->head = &waiter;
+    }
+    ctx->tail = &waiter;
+    if (++ctx->queued > ctx->queued_max)
+    {
+        ctx->queued_max = ctx->queued;
+    }
+    uint64_t t0 = api_clock();
+    int cause = 0;
+    while (ctx->head != &waiter || !api_sched_free(priority))
+    {
+        cause = api_expired(end, cancel);
+        if (cause)
+        {
+            break;
+        }
+        api_wait(&api_sched_cond, &api_sched_mutex, end, cancel);
+    }
+    api_unqueue(ctx, &waiter);
+    if (cause)
+    {
+        /* the one behind may come first now */
+        pthread_cond_broadcast(&api_sched_cond);
+        pthread_mutex_unlock(&api_sched_mutex);
+        return cause;
+    }
+    uint64_t dt = api_clock() - t0;
+    ++api_running;
+    ++ctx->admitted;
+    ++ctx->waited;
+    ctx->wait += dt;
+    if (dt > ctx->wait_max)
+    {
+        ctx->wait_max = dt;
+    }
+    /* the next in line may run as well */
+    pthread_cond_broadcast(&api_sched_cond);
+    pthread_mutex_unlock(&api_sched_mutex);
+    return 0;
 }
 
-void termux_exit(void)
+static void api_release(void)
 {
-    pipe_s ctx[1];
-    pipe_open3(ctx,
-               "/data/data/com.termux/files/usr/bin/am",
-               (char *[]){"am", "stopservice", "-n", "com.termux.api/.KeepAliveService"},
-               0);
-    pipe_wait(ctx, 0);
-    pipe_close(ctx);
+    pthread_mutex_lock(&api_sched_mutex);
+    --api_running;
+    pthread_cond_broadcast(&api_sched_cond);
+    pthread_mutex_unlock(&api_sched_mutex);
 }
 
-int termux_brightness(int brightness)
+void termux_sched_config(unsigned int max, unsigned int depth)
+{
+    pthread_mutex_lock(&api_sched_mutex);
+    api_max = max;
+    api_depth = depth;
+    pthread_cond_broadcast(&api_sched_cond);
+    pthread_mutex_unlock(&api_sched_mutex);
+}
+
+int termux_priority(int api, int priority)
 {
-    int argc = 8;
-    char buff[10] = {'0', 0};
-    char *argv[9] = {0, "Brightness", "--ei", "brightness", buff, "--ez", "auto", 0, 0};
-    if (brightness > ~0)
+    if (api < 0 || api >= TERMUX_API_MAX || priority < 0 || priority >= TERMUX_PRIORITY_MAX)
     {
-        snprintf(buff, 10, "%i", brightness);
-        argv[7] = "0";
+        errno = EINVAL;
+        return ~0;
     }
-    else
+    pthread_mutex_lock(&api_sched_mutex);
+    atomic_store_explicit(api_priority + api, priority, memory_order_relaxed);
+    pthread_mutex_unlock(&api_sched_mutex);
+    return 0;
+}
+
+int termux_sched(int priority, termux_sched_s *ctx)
+{
+    if (priority < 0 || priority >= TERMUX_PRIORITY_MAX)
     {
-        argv[7] = "1";
+        errno = EINVAL;
+        return ~0;
     }
-    return pipe_exec(argc, argv, 1000);
+    const api_class_s *stat = api_class + priority;
+    pthread_mutex_lock(&api_sched_mutex);
+    ctx->admitted = stat->admitted;
+    ctx->waited = stat->waited;
+    ctx->rejected = stat->rejected;
+    ctx->wait = stat->waited ? (unsigned long)(stat->wait / stat->waited) : 0;
+    ctx->wait_max = (unsigned long)stat->wait_max;
+    ctx->queued = stat->queued;
+    ctx->queued_max = stat->queued_max;
+    ctx->running = api_running;
+    pthread_mutex_unlock(&api_sched_mutex);
+    return 0;
 }
 
-int termux_clipboard_get(char **data, size_t *byte)
+/* file shared by the processes of the user */
+static void api_path(char *path, size_t size, const char *name)
 {
-    int argc = 2;
-    char *argv[3] = {0, "Clipboard", 0};
-    return read_text(argc, argv, data, byte);
+    char const *dir = getenv("TMPDIR");
+    snprintf(path, size, "%s/termux-api.%u.%s", dir ? dir : "/tmp", (unsigned int)getuid(), name);
 }
 
-int termux_clipboard_set(void *data, size_t byte)
+#define API_BUCKET 0x7462 /* "bt" */
+
+/*!
+ @brief token buckets mapped from a file by every process that opened them
+ @details each bucket follows the generic cell rate algorithm: tat is the time the bucket is empty again,
+ a call may run once tat - tolerance is not after now and moves tat by one interval, with a single CAS.
+*/
+typedef struct
 {
-    int argc = 8;
-    char *argv[9] = {0, "Clipboard", "-e", "api_version", "2", "--ez", "set", "true", 0};
-    return write_text(argc, argv, data, byte);
+    uint32_t magic;
+    uint32_t size;
+    struct
+    {
+        _Atomic uint64_t tat; //!< theoretical arrival time, nanosecond of CLOCK_MONOTONIC
+        _Atomic uint64_t interval; //!< nanosecond per call, 0 is no limit
+        _Atomic uint64_t tolerance; //!< nanosecond a call may come early
+        _Atomic uint64_t taken;
+        _Atomic uint64_t waited;
+        _Atomic uint64_t rejected;
+    } bucket[TERMUX_PRIORITY_MAX];
+} api_bucket_s;
+
+static api_bucket_s *_Atomic api_bucket;
+
+static uint64_t api_clock_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
 }
 
-static char *dialog_line(char *const values[])
+int termux_bucket_open(void)
 {
-    size_t size = 1;
-    size_t cur = 0;
-    char *line = 0;
-    if (values == 0 || *values == 0)
+    if (atomic_load(&api_bucket))
     {
-        goto exit;
+        return 0;
     }
-
-    for (char *const *strv = values; *strv; ++strv)
+    char path[PATH_MAX];
+    api_path(path, sizeof(path), "bucket");
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0)
     {
-        size += strlen(*strv) + 1;
+        return ~0;
     }
-
-    line = (char *)malloc(size);
-    if (line == 0)
+    struct stat st;
+    /* a new file is filled with zeros, which is a bucket without limits */
+    if (fstat(fd, &st) < 0 || ((size_t)st.st_size < sizeof(api_bucket_s) && ftruncate(fd, sizeof(api_bucket_s)) < 0))
     {
-        goto exit;
+        close(fd);
+        return ~0;
+    }
+    api_bucket_s *ctx = (api_bucket_s *)mmap(0, sizeof(api_bucket_s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ctx == MAP_FAILED)
+    {
+        return ~0;
+    }
+    if (ctx->magic == 0)
+    {
+        ctx->size = sizeof(api_bucket_s);
+        ctx->magic = API_BUCKET;
+    }
+    if (ctx->magic != API_BUCKET || ctx->size != sizeof(api_bucket_s))
+    {
+        munmap(ctx, sizeof(api_bucket_s));
+        errno = EPROTO;
+        return ~0;
+    }
+    api_bucket_s *none = 0;
+    if (!atomic_compare_exchange_strong(&api_bucket, &none, ctx))
+    {
+        munmap(ctx, sizeof(api_bucket_s));
     }
+    return 0;
+}
 
-    for (char *const *strv = values; *strv; ++strv)
+void termux_bucket_close(void)
+{
+    /* calls in flight may still use the mapping, keep it for the life of the process */
+    atomic_store(&api_bucket, 0);
+}
+
+int termux_bucket_config(int priority, double rate, double burst)
+{
+    api_bucket_s *ctx = atomic_load(&api_bucket);
+    if (ctx == 0 || priority < 0 || priority >= TERMUX_PRIORITY_MAX || !(rate >= 0) || !(burst >= 1))
     {
-        strcpy(line + cur, *strv);
-        cur += strlen(*strv) + 1;
-        line[cur - 1] = ',';
+        errno = EINVAL;
+        return ~0;
     }
-    line[cur - 1] = 0;
+    uint64_t interval = rate > 0 ? (uint64_t)(1e9 / rate) : 0;
+    atomic_store(&ctx->bucket[priority].tolerance, (uint64_t)((burst - 1) * (double)interval));
+    atomic_store(&ctx->bucket[priority].interval, interval);
+    return 0;
+}
 
-exit:
-    return line;
+int termux_bucket(int priority, termux_bucket_s *ctx)
+{
+    api_bucket_s *bucket = atomic_load(&api_bucket);
+    if (bucket == 0 || priority < 0 || priority >= TERMUX_PRIORITY_MAX)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    uint64_t interval = atomic_load(&bucket->bucket[priority].interval);
+    uint64_t tolerance = atomic_load(&bucket->bucket[priority].tolerance);
+    ctx->rate = interval ? 1e9 / (double)interval : 0;
+    ctx->burst = interval ? (double)tolerance / (double)interval + 1 : 0;
+    ctx->taken = (unsigned long)atomic_load(&bucket->bucket[priority].taken);
+    ctx->waited = (unsigned long)atomic_load(&bucket->bucket[priority].waited);
+    ctx->rejected = (unsigned long)atomic_load(&bucket->bucket[priority].rejected);
+    return 0;
 }
 
-int termux_dialog_confirm(char *hint, char *title)
+/* take a token of the class of the endpoint, waiting for one if wait, until end, microsecond, or the token */
+static int api_bucket_take(int api, int wait, uint64_t end, const termux_cancel_s *cancel)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[12] = {0, "Dialog", "--es", "input_method", "confirm"};
-    char *input_hint = hint;
-    if (input_hint)
+    api_bucket_s *ctx = atomic_load(&api_bucket);
+    if (ctx == 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_hint";
-        argv[argc++] = input_hint;
+        return 0;
     }
-    char *input_title = title;
-    if (input_title)
+    int priority = atomic_load_explicit(api_priority + api, memory_order_relaxed);
+    uint64_t interval = atomic_load(&ctx->bucket[priority].interval);
+    if (interval == 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
+        return 0;
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    if (root)
+    uint64_t tolerance = atomic_load(&ctx->bucket[priority].tolerance);
+    uint64_t now = api_clock_ns();
+    uint64_t tat = atomic_load(&ctx->bucket[priority].tat);
+    uint64_t base, delay;
+    do
     {
-        json_t *object = json_object_get(root, "text");
-        const char *string = json_string_value(object);
-        if (strcmp(string, "yes") == 0)
+        base = tat > now ? tat : now;
+        delay = base - tolerance > now && base > tolerance ? base - tolerance - now : 0;
+        if (delay && !wait)
         {
-            ok = 0;
+            atomic_fetch_add(&ctx->bucket[priority].rejected, 1);
+            errno = EAGAIN;
+            return TERMUX_REJECT;
         }
-        else if (strcmp(string, "no") == 0)
+        /* the token would come after the deadline, do not reserve it */
+        if (delay && end && now + delay > end * 1000)
         {
-            ok = 1;
+            atomic_fetch_add(&ctx->bucket[priority].rejected, 1);
+            errno = ETIMEDOUT;
+            return TERMUX_TIMEOUT;
         }
-        else
+    } while (!atomic_compare_exchange_weak(&ctx->bucket[priority].tat, &tat, base + interval));
+    if (delay == 0)
+    {
+        atomic_fetch_add(&ctx->bucket[priority].taken, 1);
+        return 0;
+    }
+    atomic_fetch_add(&ctx->bucket[priority].waited, 1);
+    /* the token is reserved, sleep until it is due or the call is cancelled */
+    struct pollfd fds[1] = {{.fd = cancel ? termux_cancel_fd(cancel) : ~0, .events = POLLIN}};
+    for (uint64_t due = now + delay;;)
+    {
+        int cause = api_expired(end, cancel);
+        if (cause)
         {
-            ok = 2;
+            /* give the token back to the other calls of the class */
+            atomic_fetch_sub(&ctx->bucket[priority].tat, interval);
+            return cause;
         }
-        json_decref(root);
+        now = api_clock_ns();
+        if (now >= due)
+        {
+            return 0;
+        }
+        struct timespec ts = {.tv_sec = (time_t)((due - now) / 1000000000), .tv_nsec = (long)((due - now) % 1000000000)};
+        ppoll(fds, 1, &ts, 0);
     }
-    return ok;
 }
 
-int termux_dialog_checkbox(char *const values[], char *title, int **index)
+int termux_timeout(int api, unsigned long floor, unsigned long ceil, unsigned int scale)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[12] = {0, "Dialog", "--es", "input_method", "checkbox"};
-    char *input_title = title;
-    if (input_title)
+    if (api < 0 || api >= TERMUX_API_MAX || floor > ceil || scale == 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
-    }
-    char *input_values = dialog_line(values);
-    if (input_values)
-    {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_values";
-        argv[argc++] = input_values;
+        errno = EINVAL;
+        return ~0;
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    free(input_values);
-    if (root)
+    pthread_mutex_lock(&api_stat_mutex);
+    api_stat[api].floor = floor;
+    api_stat[api].ceil = ceil;
+    api_stat[api].scale = scale;
+    pthread_mutex_unlock(&api_stat_mutex);
+    return 0;
+}
+
+void termux_timeout_once(unsigned long ms)
+{
+    api_once = ms;
+}
+
+struct termux_cancel_s
+{
+    atomic_int cancelled;
+    int fd; //!< eventfd, readable once cancelled
+};
+
+termux_cancel_s *termux_cancel_new(void)
+{
+    termux_cancel_s *ctx = (termux_cancel_s *)malloc(sizeof(termux_cancel_s));
+    if (ctx)
+    {
+        atomic_init(&ctx->cancelled, 0);
+        ctx->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (ctx->fd < 0)
+        {
+            free(ctx);
+            ctx = 0;
+        }
+    }
+    return ctx;
+}
+
+void termux_cancel_free(termux_cancel_s *ctx)
+{
+    if (ctx)
+    {
+        close(ctx->fd);
+        free(ctx);
+    }
+}
+
+void termux_cancel(termux_cancel_s *ctx)
+{
+    if (atomic_exchange(&ctx->cancelled, 1) == 0)
+    {
+        uint64_t one = 1;
+        (void)!write(ctx->fd, &one, sizeof(one));
+    }
+}
+
+void termux_cancel_reset(termux_cancel_s *ctx)
+{
+    uint64_t value;
+    if (atomic_exchange(&ctx->cancelled, 0))
+    {
+        (void)!read(ctx->fd, &value, sizeof(value));
+    }
+}
+
+int termux_cancelled(const termux_cancel_s *ctx)
+{
+    return atomic_load(&((termux_cancel_s *)ctx)->cancelled);
+}
+
+int termux_cancel_fd(const termux_cancel_s *ctx)
+{
+    return ctx->fd;
+}
+
+void termux_cancel_once(termux_cancel_s *ctx)
+{
+    api_cancel = ctx;
+}
+
+int termux_latency(int api, termux_latency_s *ctx)
+{
+    if (api < 0 || api >= TERMUX_API_MAX)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    const api_stat_s *stat = api_stat + api;
+    pthread_mutex_lock(&api_stat_mutex);
+    ctx->count = stat->count;
+    ctx->kills = stat->kills;
+    ctx->p50 = api_quantile(stat, 50);
+    ctx->p99 = api_quantile(stat, 99);
+    ctx->deadline = api_deadline(stat);
+    ctx->shared = stat->shared;
+    pthread_mutex_unlock(&api_stat_mutex);
+    return 0;
+}
+
+static int (*api_backend)(int, char *[]);
+
+void termux_backend(int (*command)(int argc, char *argv[]))
+{
+    api_backend = command;
+}
+
+static int api_command(int argc, char *argv[])
+{
+    if (api_backend)
+    {
+        return api_backend(argc, argv);
+    }
+    extern int run_api_command(int, char **);
+    int fd = run_api_command(argc, argv);
+    if (fd != -1)
+    {
+        _Noreturn void exec_callback(int);
+        exec_callback(fd);
+    }
+    return 0;
+}
+
+
+#define R 0
+#define W 1
+
+static int api_open(api_s *ctx, int argc, char *argv[])
+{
+    ctx->wr = ~0;
+    ctx->rd = ~0;
+    ctx->pid = ~0;
+
+    /* create two pipes, kept from programs other threads execute */
+    int pipe_wr[2];
+    if (pipe2(pipe_wr, O_CLOEXEC) < 0)
+    {
+        goto pipe_wr;
+    }
+    int pipe_rd[2];
+    if (pipe2(pipe_rd, O_CLOEXEC) < 0)
+    {
+        goto pipe_rd;
+    }
+
+    /* create a child process */
+    ctx->pid = fork();
+    if (ctx->pid < 0)
+    {
+        goto pipe_rw;
+    }
+
+    if (ctx->pid == 0)
+    {
+        if (dup2(pipe_wr[R], STDIN_FILENO) < 0 || dup2(pipe_rd[W], STDOUT_FILENO) < 0)
+        {
+            _exit(EXIT_FAILURE);
+        }
+#if defined(SYS_close_range)
+        /* drop the pipes of other calls so that they see their end of input */
+        syscall(SYS_close_range, 3U, ~0U, 0);
+#else /* !SYS_close_range */
+        close(pipe_wr[R]);
+        close(pipe_wr[W]);
+        close(pipe_rd[R]);
+        close(pipe_rd[W]);
+#endif /* SYS_close_range */
+
+        _exit(api_command(argc, argv));
+    }
+
+    close(pipe_wr[R]);
+    close(pipe_rd[W]);
+    ctx->wr = pipe_wr[W];
+    ctx->rd = pipe_rd[R];
+    fcntl(ctx->rd, F_SETFL, fcntl(ctx->rd, F_GETFL) | O_NONBLOCK);
+
+    return 0;
+
+pipe_rw:
+    close(pipe_rd[R]);
+    close(pipe_rd[W]);
+pipe_rd:
+    close(pipe_wr[R]);
+    close(pipe_wr[W]);
+pipe_wr:
+    return ~0;
+}
+
+#undef R
+#undef W
+
+/* write the input of the child process, which may exit without reading it */
+static void api_input(int fd, struct iovec *iov, int n)
+{
+    sigset_t mask, orig_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &mask, &orig_mask);
+    while (n)
+    {
+        ssize_t size = writev(fd, iov, n);
+        if (size < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EPIPE)
+            {
+                struct timespec timeout = {0, 0};
+                sigtimedwait(&mask, 0, &timeout);
+            }
+            break;
+        }
+        for (; n && (size_t)size >= iov->iov_len; --n)
+        {
+            size -= (ssize_t)iov++->iov_len;
+        }
+        if (n)
+        {
+            iov->iov_base = (char *)iov->iov_base + size;
+            iov->iov_len -= (size_t)size;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &orig_mask, 0);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief arguments of a child process
+*/
+typedef struct
+{
+    char *argv[24];
+    int argc;
+    int nin;
+    struct iovec in[2]; //!< input of the child process
+    char *line; //!< values joined by dialog_line
+    char buf[2][32]; //!< formatted numbers
+    int at[2]; //!< index of the values in argv that are patched, 0 if absent
+} api_argv_s;
+
+/*!
+ @brief endpoint of a kind of call
+*/
+typedef struct
+{
+    int api; //!< TERMUX_API_*
+    int wait; //!< the adaptive deadline applies
+    void (*argv)(const termux_call_s *ctx, api_argv_s *argv); //!< build the arguments
+    int (*patch)(const termux_call_s *ctx, api_argv_s *argv); //!< rewrite the parameters in place, nonzero to build again
+    int (*done)(termux_call_s *ctx, int status); //!< decode the output, nonzero if unusable
+    int (*share)(termux_call_s *ctx, const termux_call_s *from); //!< copy the results of an identical read, 0 if not shared
+} api_call_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief endpoints as X(kind, api, wait, argv, patch, done, share)
+*/
+#define API_CALL(X)                                                                                                 \
+    X(BRIGHTNESS, BRIGHTNESS, 1, brightness_argv, brightness_patch, api_done_exit, 0)                               \
+    X(CLIPBOARD_GET, CLIPBOARD_GET, 0, clipboard_get_argv, api_patch_none, clipboard_get_done, clipboard_get_share) \
+    X(CLIPBOARD_SET, CLIPBOARD_SET, 0, clipboard_set_argv, clipboard_set_patch, api_done_exit, 0)                   \
+    X(DIALOG_CONFIRM, DIALOG, 0, dialog_confirm_argv, api_patch_build, dialog_confirm_done, 0)                      \
+    X(DIALOG_CHECKBOX, DIALOG, 0, dialog_checkbox_argv, api_patch_build, dialog_checkbox_done, 0)                   \
+    X(DIALOG_COUNTER, DIALOG, 0, dialog_counter_argv, dialog_counter_patch, dialog_counter_done, 0)                 \
+    X(DIALOG_DATE, DIALOG, 0, dialog_date_argv, api_patch_build, dialog_date_done, 0)                               \
+    X(DIALOG_RADIO, DIALOG, 0, dialog_radio_argv, api_patch_build, dialog_radio_done, 0)                            \
+    X(DIALOG_SHEET, DIALOG, 0, dialog_sheet_argv, api_patch_build, dialog_sheet_done, 0)                            \
+    X(DIALOG_SPINNER, DIALOG, 0, dialog_spinner_argv, api_patch_build, dialog_spinner_done, 0)                      \
+    X(DIALOG_SPEECH, DIALOG, 0, dialog_speech_argv, api_patch_build, dialog_speech_done, 0)                         \
+    X(DIALOG_TEXT, DIALOG, 0, dialog_text_argv, api_patch_build, dialog_text_done, 0)                               \
+    X(DIALOG_TIME, DIALOG, 0, dialog_time_argv, api_patch_build, dialog_time_done, 0)                               \
+    X(FINGERPRINT, FINGERPRINT, 0, fingerprint_argv, api_patch_build, fingerprint_done, 0)                          \
+    X(SENSOR_CLEANUP, SENSOR_CLEANUP, 1, sensor_cleanup_argv, api_patch_none, api_done_exit, 0)                     \
+    X(SENSOR_LIST, SENSOR_LIST, 0, sensor_list_argv, api_patch_none, sensor_list_done, sensor_list_share)           \
+    X(SENSOR, SENSOR, 0, sensor_argv, sensor_patch, sensor_done, sensor_share)                                      \
+    X(TOAST, TOAST, 1, toast_argv, api_patch_build, toast_done, 0)                                                  \
+    X(TORCH, TORCH, 1, torch_argv, torch_patch, api_done_exit, 0)                                                   \
+    X(VIBRATE, VIBRATE, 1, vibrate_argv, vibrate_patch, api_done_exit, 0)                                           \
+    X(VOLUME_GET, VOLUME_GET, 0, volume_get_argv, api_patch_none, volume_get_done, volume_get_share)                \
+    X(VOLUME_SET, VOLUME_SET, 1, volume_set_argv, volume_set_patch, api_done_exit, 0)
+
+#define X(kind, api, wait, argv, patch, done, share)             \
+    static void argv(const termux_call_s *ctx, api_argv_s *argv_); \
+    static int patch(const termux_call_s *ctx, api_argv_s *argv_); \
+    static int done(termux_call_s *ctx, int status);
+API_CALL(X)
+#undef X
+static int clipboard_get_share(termux_call_s *ctx, const termux_call_s *from);
+static int sensor_list_share(termux_call_s *ctx, const termux_call_s *from);
+static int sensor_share(termux_call_s *ctx, const termux_call_s *from);
+static int volume_get_share(termux_call_s *ctx, const termux_call_s *from);
+
+static const api_call_s api_call[TERMUX_CALL_MAX] = {
+#define X(kind, api, wait, argv, patch, done, share) [TERMUX_CALL_##kind] = {TERMUX_API_##api, wait, argv, patch, done, share},
+    API_CALL(X)
+#undef X
+};
+
+/* the parameters are not in argv */
+static int api_patch_none(const termux_call_s *ctx, api_argv_s *argv)
+{
+    (void)ctx;
+    (void)argv;
+    return 0;
+}
+
+/* the parameters change the shape of argv */
+static int api_patch_build(const termux_call_s *ctx, api_argv_s *argv)
+{
+    (void)ctx;
+    (void)argv;
+    return ~0;
+}
+
+/* format a decimal number without the overhead of printf, return the end of the string */
+static char *api_itoa(char *s, int x)
+{
+    char buf[16];
+    char *p = buf + sizeof(buf);
+    unsigned int u = x < 0 ? 0U - (unsigned int)x : (unsigned int)x;
+    do
+    {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (x < 0)
+    {
+        *--p = '-';
+    }
+    size_t n = (size_t)(buf + sizeof(buf) - p);
+    memcpy(s, p, n);
+    s[n] = 0;
+    return s + n;
+}
+
+static void api_build(const termux_call_s *ctx, api_argv_s *argv)
+{
+    argv->argc = 0;
+    argv->nin = 0;
+    argv->line = 0;
+    argv->at[0] = 0;
+    argv->at[1] = 0;
+    argv->argv[argv->argc++] = 0;
+    api_call[ctx->call].argv(ctx, argv);
+    argv->argv[argv->argc] = 0;
+}
+
+/* reset the results of a call, ~0 if the kind of call is unknown */
+static int api_reset(termux_call_s *ctx)
+{
+    ctx->status = ~0;
+    ctx->buf = 0;
+    ctx->len = 0;
+    ctx->cap = 0;
+    ctx->fd = ~0;
+    ctx->pid = ~0;
+    ctx->eof = 0;
+    ctx->cause = 0;
+    memset(&ctx->out, 0, sizeof(ctx->out));
+    if (ctx->call < 0 || ctx->call >= TERMUX_CALL_MAX)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    return 0;
+}
+
+static int api_spawn(termux_call_s *ctx, api_argv_s *argv, int wait)
+{
+    const api_call_s *call = api_call + ctx->call;
+    unsigned long ms = api_once ? api_once : ctx->deadline;
+    api_once = 0;
+    if (api_cancel)
+    {
+        ctx->cancel = api_cancel;
+        api_cancel = 0;
+    }
+    if (ctx->cancel && termux_cancelled(ctx->cancel))
+    {
+        errno = ECANCELED;
+        return ctx->status = TERMUX_CANCEL;
+    }
+    /* a deadline set by the caller covers the wait for a slot and a token, the adaptive one starts with the child */
+    uint64_t end = ms ? api_clock() + (uint64_t)ms * 1000 : 0;
+    int ok = api_admit(call->api, wait, end, ctx->cancel);
+    if (ok)
+    {
+        return ctx->status = ok;
+    }
+    ok = api_probe(ctx);
+    if (ok)
+    {
+        api_release();
+        return ctx->status = ok;
+    }
+    /* the shared budget is drawn last, a call that is turned away spends none of it */
+    ok = api_bucket_take(call->api, wait, end, ctx->cancel);
+    if (ok)
+    {
+        api_unprobe(ctx);
+        api_release();
+        return ctx->status = ok;
+    }
+    api_begin(ctx, call->api, call->wait, end);
+    api_s pipe;
+    if (api_open(&pipe, argv->argc, argv->argv))
+    {
+        api_release();
+        api_end(ctx, call->api, 0, 1);
+        return ctx->status;
+    }
+    /* api_input consumes the vector, keep the one of argv for the next run */
+    struct iovec in[2];
+    memcpy(in, argv->in, sizeof(in));
+    api_input(pipe.wr, in, argv->nin);
+    close(pipe.wr);
+    ctx->fd = pipe.rd;
+    ctx->pid = pipe.pid;
+    return 0;
+}
+
+static int api_start(termux_call_s *ctx, int wait)
+{
+    if (api_reset(ctx))
+    {
+        return ~0;
+    }
+    api_argv_s argv;
+    api_build(ctx, &argv);
+    int ok = api_spawn(ctx, &argv, wait);
+    free(argv.line);
+    return ok;
+}
+
+int termux_call_start(termux_call_s *ctx)
+{
+    return api_start(ctx, 0);
+}
+
+int termux_call_fd(const termux_call_s *ctx)
+{
+    return ctx->fd;
+}
+
+int termux_call_read(termux_call_s *ctx)
+{
+    if (ctx->fd < 0)
+    {
+        return ~0;
+    }
+    if (ctx->cancel && termux_cancelled(ctx->cancel))
+    {
+        ctx->cause = TERMUX_CANCEL;
+        errno = ECANCELED;
+        return ~0;
+    }
+    while (!ctx->eof)
+    {
+        if (ctx->cap - ctx->len < BUFSIZ)
+        {
+            size_t cap = ctx->cap ? ctx->cap << 1 : BUFSIZ + 1;
+            char *buf = (char *)realloc(ctx->buf, cap);
+            if (buf == 0)
+            {
+                return ~0;
+            }
+            ctx->buf = buf;
+            ctx->cap = cap;
+        }
+        /* keep one byte to terminate the output */
+        ssize_t size = read(ctx->fd, ctx->buf + ctx->len, ctx->cap - ctx->len - 1);
+        if (size > 0)
+        {
+            ctx->len += (size_t)size;
+        }
+        else if (size == 0)
+        {
+            ctx->eof = 1;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        else if (errno != EINTR)
+        {
+            return ~0;
+        }
+    }
+    return 1;
+}
+
+long termux_call_left(const termux_call_s *ctx)
+{
+    if (ctx->ms == 0)
+    {
+        return ~0;
+    }
+    uint64_t now = api_clock();
+    uint64_t end = ctx->t0 + (uint64_t)ctx->ms * 1000;
+    return now < end ? (long)((end - now + 999) / 1000) : 0;
+}
+
+int termux_call_wait(termux_call_s *ctx)
+{
+    for (;;)
+    {
+        int ok = termux_call_read(ctx);
+        if (ok)
+        {
+            return ok > 0 ? 0 : ~0;
+        }
+        long ms = termux_call_left(ctx);
+        struct pollfd fds[2] = {{.fd = ctx->fd, .events = POLLIN}, {.fd = ~0, .events = POLLIN}};
+        if (ctx->cancel)
+        {
+            fds[1].fd = ctx->cancel->fd;
+        }
+        if (ms == 0 || (poll(fds, 2, (int)ms) == 0 && termux_call_left(ctx) == 0))
+        {
+            ctx->cause = TERMUX_TIMEOUT;
+            errno = ETIMEDOUT;
+            return ~0;
+        }
+    }
+}
+
+/* terminate a child process that still runs and reap it */
+static void api_kill(pid_t pid, int *status)
+{
+    pid_t ok = 0;
+    kill(pid, SIGTERM);
+    for (int i = 0; i != 100 && ok == 0; ++i)
+    {
+        poll(0, 0, 1);
+        ok = waitpid(pid, status, WNOHANG);
+    }
+    if (ok == 0)
+    {
+        /* it ignored the request, so do not let it linger */
+        kill(pid, SIGKILL);
+    }
+    while (ok == 0 || (ok < 0 && errno == EINTR))
+    {
+        ok = waitpid(pid, status, 0);
+    }
+}
+
+int termux_call_finish(termux_call_s *ctx)
+{
+    int status = 0;
+    int killed = 0;
+
+    if (ctx->pid < 0)
+    {
+        return ctx->status;
+    }
+    close(ctx->fd);
+    ctx->fd = ~0;
+
+    pid_t pid = waitpid(ctx->pid, &status, WNOHANG);
+    /* the child closed its output, so it is about to exit, but not past the deadline */
+    while (ctx->eof && (pid == 0 || (pid < 0 && errno == EINTR)))
+    {
+        long ms = termux_call_left(ctx);
+        if (ms == 0)
+        {
+            break;
+        }
+        if (ms > 0)
+        {
+            poll(0, 0, 1);
+        }
+        pid = waitpid(ctx->pid, &status, ms > 0 ? WNOHANG : 0);
+    }
+    if (pid == 0)
+    {
+        /* terminate the child process that missed its deadline or was cancelled */
+        api_kill(ctx->pid, &status);
+        killed = 1;
+    }
+    while (pid < 0 && errno == EINTR)
+    {
+        pid = waitpid(ctx->pid, &status, 0);
+    }
+    ctx->pid = ~0;
+    api_release();
+
+    int failed = !WIFEXITED(status) || WEXITSTATUS(status);
+    /* check if the child process terminated normally */
+    if (WIFEXITED(status))
+    {
+        status = WEXITSTATUS(status);
+    }
+    /* check if the child process was terminated by a signal */
+    else if (WIFSIGNALED(status))
+    {
+        status = WTERMSIG(status);
+    }
+
+    if (ctx->buf)
+    {
+        ctx->buf[ctx->len] = 0;
+    }
+    const api_call_s *call = api_call + ctx->call;
+    ctx->status = status;
+    if (call->done(ctx, status))
+    {
+        failed = 1;
+    }
+    free(ctx->buf);
+    ctx->buf = 0;
+    ctx->len = 0;
+    ctx->cap = 0;
+    if (killed && ctx->cause == 0 && termux_call_left(ctx) == 0)
+    {
+        ctx->cause = TERMUX_TIMEOUT;
+    }
+    if (killed && ctx->cause)
+    {
+        ctx->status = ctx->cause;
+    }
+    /* a cancellation is not a fault of the service, nor a sign that it recovered */
+    if (ctx->cause == TERMUX_CANCEL)
+    {
+        killed = 0;
+    }
+    api_end(ctx, call->api, killed, failed);
+    return ctx->status;
+}
+
+static int api_run(termux_call_s *ctx)
+{
+    if (api_start(ctx, 1) == 0)
+    {
+        termux_call_wait(ctx);
+    }
+    return termux_call_finish(ctx);
+}
+
+/*!
+ @brief read in flight that identical reads wait for
+*/
+typedef struct api_flight_s
+{
+    struct api_flight_s *next;
+    termux_call_s *call; //!< the read that runs, holding the results
+    unsigned int waiters;
+    int done;
+} api_flight_s;
+
+static pthread_mutex_t api_flight_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t api_flight_cond = PTHREAD_COND_INITIALIZER;
+static api_flight_s *api_flight;
+static int api_flight_off;
+
+void termux_share(int enabled)
+{
+    pthread_mutex_lock(&api_flight_mutex);
+    api_flight_off = !enabled;
+    pthread_mutex_unlock(&api_flight_mutex);
+}
+
+/* the reads are of the same kind with the same arguments */
+static int api_same(const termux_call_s *lhs, const termux_call_s *rhs)
+{
+    if (lhs->call != rhs->call)
+    {
+        return 0;
+    }
+    if (lhs->call == TERMUX_CALL_SENSOR)
+    {
+        return lhs->in.sensor && rhs->in.sensor && strcmp(lhs->in.sensor, rhs->in.sensor) == 0;
+    }
+    return 1;
+}
+
+/* must be called with api_flight_mutex held, the joiner waits no longer than its own deadline and token allow */
+static int api_join(termux_call_s *ctx, api_flight_s *flight)
+{
+    unsigned long ms = api_once ? api_once : ctx->deadline;
+    termux_cancel_s *cancel = api_cancel ? api_cancel : ctx->cancel;
+    uint64_t end = ms ? api_clock() + (uint64_t)ms * 1000 : 0;
+    api_reset(ctx);
+    ++flight->waiters;
+    while (!flight->done)
+    {
+        ctx->cause = api_expired(end, cancel);
+        if (ctx->cause)
+        {
+            break;
+        }
+        api_wait(&api_flight_cond, &api_flight_mutex, end, cancel);
+    }
+    if (ctx->cause)
+    {
+        ctx->status = ctx->cause;
+    }
+    else
+    {
+        ctx->status = flight->call->status;
+        if (api_call[ctx->call].share(ctx, flight->call))
+        {
+            ctx->status = ~0;
+        }
+    }
+    if (--flight->waiters == 0)
+    {
+        pthread_cond_broadcast(&api_flight_cond);
+    }
+    return ctx->status;
+}
+
+int termux_call(termux_call_s *ctx)
+{
+    if (ctx->call < 0 || ctx->call >= TERMUX_CALL_MAX || api_call[ctx->call].share == 0)
+    {
+        return api_run(ctx);
+    }
+    pthread_mutex_lock(&api_flight_mutex);
+    if (api_flight_off)
+    {
+        pthread_mutex_unlock(&api_flight_mutex);
+        return api_run(ctx);
+    }
+    for (api_flight_s *flight = api_flight; flight; flight = flight->next)
+    {
+        if (!flight->done && api_same(flight->call, ctx))
+        {
+            int ok = api_join(ctx, flight);
+            pthread_mutex_unlock(&api_flight_mutex);
+            /* the deadline and token for this call were not used */
+            api_once = 0;
+            api_cancel = 0;
+            pthread_mutex_lock(&api_stat_mutex);
+            ++api_stat[api_call[ctx->call].api].shared;
+            pthread_mutex_unlock(&api_stat_mutex);
+            return ok;
+        }
+    }
+    api_flight_s flight = {api_flight, ctx, 0, 0};
+    api_flight = &flight;
+    pthread_mutex_unlock(&api_flight_mutex);
+
+    api_run(ctx);
+
+    pthread_mutex_lock(&api_flight_mutex);
+    flight.done = 1;
+    pthread_cond_broadcast(&api_flight_cond);
+    /* the waiters copy the results before the caller may free them */
+    while (flight.waiters)
+    {
+        pthread_cond_wait(&api_flight_cond, &api_flight_mutex);
+    }
+    api_flight_s **link = &api_flight;
+    while (*link != &flight)
+    {
+        link = &(*link)->next;
+    }
+    *link = flight.next;
+    pthread_mutex_unlock(&api_flight_mutex);
+    return ctx->status;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+struct termux_prepared_s
+{
+    termux_call_s call[1];
+    api_argv_s argv[1];
+    int kind; //!< kind of call the arguments were built for
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+termux_prepared_s *termux_prepare(const termux_call_s *call)
+{
+    if (call->call < 0 || call->call >= TERMUX_CALL_MAX)
+    {
+        errno = EINVAL;
+        return 0;
+    }
+    termux_prepared_s *ctx = (termux_prepared_s *)malloc(sizeof(termux_prepared_s));
+    if (ctx)
+    {
+        *ctx->call = *call;
+        api_reset(ctx->call);
+        api_build(ctx->call, ctx->argv);
+        ctx->kind = call->call;
+    }
+    return ctx;
+}
+
+termux_call_s *termux_prepared_call(termux_prepared_s *ctx)
+{
+    return ctx->call;
+}
+
+static int api_prepared_start(termux_prepared_s *ctx, int wait)
+{
+    if (api_reset(ctx->call))
+    {
+        return ~0;
+    }
+    if (ctx->kind != ctx->call->call || api_call[ctx->kind].patch(ctx->call, ctx->argv))
+    {
+        free(ctx->argv->line);
+        api_build(ctx->call, ctx->argv);
+        ctx->kind = ctx->call->call;
+    }
+    return api_spawn(ctx->call, ctx->argv, wait);
+}
+
+int termux_prepared_start(termux_prepared_s *ctx)
+{
+    return api_prepared_start(ctx, 0);
+}
+
+int termux_prepared_run(termux_prepared_s *ctx)
+{
+    if (api_prepared_start(ctx, 1) == 0)
+    {
+        termux_call_wait(ctx->call);
+    }
+    return termux_call_finish(ctx->call);
+}
+
+void termux_prepared_free(termux_prepared_s *ctx)
+{
+    if (ctx)
+    {
+        free(ctx->argv->line);
+        free(ctx);
+    }
+}
+
+static json_t *api_json(const termux_call_s *ctx)
+{
+    json_error_t error;
+    return ctx->len ? json_loadb(ctx->buf, ctx->len, 0, &error) : 0;
+}
+
+static void api_arg(api_argv_s *ctx, char *arg)
+{
+    ctx->argv[ctx->argc++] = arg;
+}
+
+/* append an extra whose value is set by the patch of the endpoint, return its index */
+static int api_slot(api_argv_s *ctx, char *type, char *key)
+{
+    ctx->argv[ctx->argc++] = type;
+    ctx->argv[ctx->argc++] = key;
+    ctx->argv[ctx->argc] = 0;
+    return ctx->argc++;
+}
+
+/* append an extra unless its value is missing */
+static void api_extra(api_argv_s *ctx, char *type, char *key, char *value)
+{
+    if (value)
+    {
+        ctx->argv[ctx->argc++] = type;
+        ctx->argv[ctx->argc++] = key;
+        ctx->argv[ctx->argc++] = value;
+    }
+}
+
+static int api_done_exit(termux_call_s *ctx, int status)
+{
+    (void)ctx;
+    (void)status;
+    return 0;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+struct termux_init_s
+{
+    pipe_s ctx[1];
+    int done;
+    int ok;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static char api_am[PATH_MAX] = "/data/data/com.termux/files/usr/bin/am";
+static unsigned long api_cache = 60000;
+
+void termux_am(const char *path)
+{
+    snprintf(api_am, sizeof(api_am), "%s", path ? path : "/data/data/com.termux/files/usr/bin/am");
+}
+
+void termux_init_cache(unsigned long ms)
+{
+    api_cache = ms;
+}
+
+/* the state file records the last time the service was started */
+static int api_alive(void)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    struct timespec now;
+    if (api_cache == 0)
+    {
+        return 0;
+    }
+    api_path(path, sizeof(path), "alive");
+    if (stat(path, &st) || clock_gettime(CLOCK_REALTIME, &now))
+    {
+        return 0;
+    }
+    long long ms = (long long)(now.tv_sec - st.st_mtim.tv_sec) * 1000 + (now.tv_nsec - st.st_mtim.tv_nsec) / 1000000;
+    return ms >= 0 && (unsigned long long)ms < api_cache;
+}
+
+termux_init_s *termux_init_async(void)
+{
+    termux_init_s *ctx = (termux_init_s *)calloc(1, sizeof(termux_init_s));
+    if (ctx == 0)
+    {
+        return 0;
+    }
+    if (api_alive())
+    {
+        ctx->done = 1;
+        return ctx;
+    }
+    if (pipe_open3(ctx->ctx, api_am,
+                   (char *[]){"am", "startservice", "-n", "com.termux.api/.KeepAliveService", 0},
+                   0))
+    {
+        ctx->done = 1;
+        ctx->ok = ~0;
+    }
+    return ctx;
+}
+
+int termux_init_done(termux_init_s *ctx)
+{
+    if (ctx->done)
+    {
+        return 1;
+    }
+    /* am closed its stderr, so it has exited */
+    struct pollfd fds = {.fd = fileno(ctx->ctx->er), .events = POLLIN};
+    return poll(&fds, 1, 0) > 0 && (fds.revents & POLLHUP);
+}
+
+int termux_init_wait(termux_init_s *ctx)
+{
+    if (ctx == 0)
+    {
+        return ~0;
+    }
+    int ok = ctx->ok;
+    if (!ctx->done)
+    {
+        char buf[128] = {0};
+        size_t n = fread(buf, 1, sizeof(buf) - 1, ctx->ctx->er);
+        pipe_close(ctx->ctx);
+        if (n && *buf == 'E')
+        {
+            fputs(buf, stderr);
+            ok = ~0;
+        }
+        else
+        {
+            char path[PATH_MAX];
+            api_path(path, sizeof(path), "alive");
+            int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+    free(ctx);
+    return ok;
+}
+
+int termux_init(void)
+{
+    return termux_init_wait(termux_init_async());
+}
+
+void termux_exit(void)
+{
+    char path[PATH_MAX];
+    api_path(path, sizeof(path), "alive");
+    unlink(path);
+    pipe_s ctx[1];
+    if (pipe_open3(ctx, api_am,
+                   (char *[]){"am", "stopservice", "-n", "com.termux.api/.KeepAliveService", 0},
+                   0) == 0)
+    {
+        pipe_wait(ctx, 0);
+        pipe_close(ctx);
+    }
+}
+
+static void brightness_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    api_arg(argv, "Brightness");
+    argv->argv[api_slot(argv, "--ei", "brightness")] = argv->buf[0];
+    argv->at[0] = api_slot(argv, "--ez", "auto");
+    brightness_patch(ctx, argv);
+}
+
+static int brightness_patch(const termux_call_s *ctx, api_argv_s *argv)
+{
+    int automatic = ctx->in.brightness < 0;
+    api_itoa(argv->buf[0], automatic ? 0 : ctx->in.brightness);
+    argv->argv[argv->at[0]] = automatic ? "1" : "0";
+    return 0;
+}
+
+int termux_brightness(int brightness)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_BRIGHTNESS, .in.brightness = brightness}};
+    return termux_call(ctx);
+}
+
+static void clipboard_get_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    (void)ctx;
+    api_arg(argv, "Clipboard");
+}
+
+static int clipboard_get_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    if (ctx->len)
+    {
+        /* hand the output over to the caller */
+        ctx->out.text.data = ctx->buf;
+        ctx->out.text.byte = ctx->len;
+        ctx->buf = 0;
+    }
+    return 0;
+}
+
+static int clipboard_get_share(termux_call_s *ctx, const termux_call_s *from)
+{
+    size_t byte = from->out.text.byte;
+    if (from->out.text.data)
+    {
+        ctx->out.text.data = (char *)malloc(byte + 1);
+        if (ctx->out.text.data == 0)
+        {
+            return ~0;
+        }
+        memcpy(ctx->out.text.data, from->out.text.data, byte + 1);
+        ctx->out.text.byte = byte;
+    }
+    return 0;
+}
+
+int termux_clipboard_get(char **data, size_t *byte)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_CLIPBOARD_GET}};
+    int ok = termux_call(ctx);
+    if (data && byte)
+    {
+        *data = ctx->out.text.data;
+        *byte = ctx->out.text.byte;
+    }
+    else
+    {
+        free(ctx->out.text.data);
+    }
+    return ok;
+}
+
+static void clipboard_set_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    api_arg(argv, "Clipboard");
+    api_extra(argv, "-e", "api_version", "2");
+    api_extra(argv, "--ez", "set", "true");
+    argv->nin = 1;
+    clipboard_set_patch(ctx, argv);
+}
+
+static int clipboard_set_patch(const termux_call_s *ctx, api_argv_s *argv)
+{
+    argv->in->iov_base = ctx->in.clipboard.data;
+    argv->in->iov_len = ctx->in.clipboard.byte;
+    return 0;
+}
+
+int termux_clipboard_set(void *data, size_t byte)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_CLIPBOARD_SET, .in.clipboard = {data, byte}}};
+    return termux_call(ctx);
+}
+
+static char *dialog_line(char *const values[])
+{
+    size_t size = 1;
+    size_t cur = 0;
+    char *line = 0;
+    if (values == 0 || *values == 0)
+    {
+        goto exit;
+    }
+
+    for (char *const *strv = values; *strv; ++strv)
+    {
+        size += strlen(*strv) + 1;
+    }
+
+    line = (char *)malloc(size);
+    if (line == 0)
+    {
+        goto exit;
+    }
+
+    for (char *const *strv = values; *strv; ++strv)
+    {
+        strcpy(line + cur, *strv);
+        cur += strlen(*strv) + 1;
+        line[cur - 1] = ',';
+    }
+    line[cur - 1] = 0;
+
+exit:
+    return line;
+}
+
+static void dialog_argv(api_argv_s *argv, char *method)
+{
+    api_arg(argv, "Dialog");
+    api_extra(argv, "--es", "input_method", method);
+}
+
+static void dialog_values(const termux_call_s *ctx, api_argv_s *argv, char *method)
+{
+    dialog_argv(argv, method);
+    api_extra(argv, "--es", "input_title", ctx->in.dialog.title);
+    argv->line = dialog_line(ctx->in.dialog.values);
+    api_extra(argv, "--es", "input_values", argv->line);
+}
+
+/* code of a finished dialog, 0 if the reply is not JSON */
+static json_t *dialog_code(termux_call_s *ctx, json_int_t *code)
+{
+    json_t *root = api_json(ctx);
+    if (root)
+    {
+        *code = json_integer_value(json_object_get(root, "code"));
+    }
+    ctx->status = ~0;
+    return root;
+}
+
+static void dialog_confirm_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_argv(argv, "confirm");
+    api_extra(argv, "--es", "input_hint", ctx->in.dialog.hint);
+    api_extra(argv, "--es", "input_title", ctx->in.dialog.title);
+}
+
+static int dialog_confirm_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_int_t code;
+    json_t *root = dialog_code(ctx, &code);
+    if (root == 0)
     {
-        json_t *object = json_object_get(root, "code");
-        json_int_t code = json_integer_value(object);
-        if (code == -1)
+        return ~0;
+    }
+    const char *string = json_string_value(json_object_get(root, "text"));
+    if (string && strcmp(string, "yes") == 0)
+    {
+        ctx->status = 0;
+    }
+    else if (string && strcmp(string, "no") == 0)
+    {
+        ctx->status = 1;
+    }
+    else
+    {
+        ctx->status = 2;
+    }
+    json_decref(root);
+    return 0;
+}
+
+int termux_dialog_confirm(char *hint, char *title)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_CONFIRM, .in.dialog = {.hint = hint, .title = title}}};
+    return termux_call(ctx);
+}
+
+static void dialog_checkbox_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_values(ctx, argv, "checkbox");
+}
+
+static int dialog_checkbox_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_int_t code;
+    json_t *root = dialog_code(ctx, &code);
+    if (root == 0)
+    {
+        return ~0;
+    }
+    if (code == -1)
+    {
+        json_t *object = json_object_get(root, "values");
+        size_t n = json_array_size(object);
+        if (n)
         {
-            object = json_object_get(root, "values");
-            size_t n = json_array_size(object);
-            if (n)
-            {
-                *index = (int *)malloc(sizeof(int) * n);
-            }
-            for (size_t i = 0; i != n; ++i)
+            ctx->out.index = (int *)malloc(sizeof(int) * n);
+            if (ctx->out.index == 0)
             {
-                json_t *item = json_array_get(object, i);
-                (*index)[i] = (int)json_integer_value(json_object_get(item, "index"));
+                n = 0;
             }
-            ok = (int)n;
         }
-        json_decref(root);
+        for (size_t i = 0; i != n; ++i)
+        {
+            json_t *item = json_array_get(object, i);
+            ctx->out.index[i] = (int)json_integer_value(json_object_get(item, "index"));
+        }
+        ctx->status = (int)n;
+    }
+    json_decref(root);
+    return 0;
+}
+
+int termux_dialog_checkbox(char *const values[], char *title, int **index)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_CHECKBOX, .in.dialog = {.title = title, .values = values}}};
+    int ok = termux_call(ctx);
+    if (ctx->out.index)
+    {
+        *index = ctx->out.index;
     }
     return ok;
 }
 
+static void dialog_counter_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_argv(argv, "counter");
+    if (ctx->in.dialog.title)
+    {
+        argv->at[0] = api_slot(argv, "--es", "input_title");
+    }
+    argv->argv[api_slot(argv, "--eia", "input_range")] = argv->buf[0];
+    dialog_counter_patch(ctx, argv);
+}
+
+static int dialog_counter_patch(const termux_call_s *ctx, api_argv_s *argv)
+{
+    if (!ctx->in.dialog.title != !argv->at[0])
+    {
+        return ~0;
+    }
+    if (argv->at[0])
+    {
+        argv->argv[argv->at[0]] = ctx->in.dialog.title;
+    }
+    char *s = api_itoa(argv->buf[0], ctx->in.dialog.min);
+    *s++ = ',';
+    s = api_itoa(s, ctx->in.dialog.max);
+    *s++ = ',';
+    api_itoa(s, ctx->in.dialog.value);
+    return 0;
+}
+
+static int dialog_counter_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_int_t code;
+    json_t *root = dialog_code(ctx, &code);
+    if (root == 0)
+    {
+        return ~0;
+    }
+    const char *string = json_string_value(json_object_get(root, "text"));
+    if (code == -1 && string)
+    {
+        ctx->out.value = atoi(string);
+        ctx->status = 0;
+    }
+    json_decref(root);
+    return 0;
+}
+
 int termux_dialog_counter(char *title, int min, int max, int *out)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[12] = {0, "Dialog", "--es", "input_method", "counter"};
-    char *input_title = title;
-    if (input_title)
-    {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
-    }
-    char input_range[64];
-    snprintf(input_range, 64, "%i,%i,%i", min, max, out ? *out : 0);
-    argv[argc++] = "--eia";
-    argv[argc++] = "input_range";
-    argv[argc++] = input_range;
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    if (root)
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_COUNTER, .in.dialog = {.title = title, .min = min, .max = max, .value = out ? *out : 0}}};
+    int ok = termux_call(ctx);
+    if (ok == 0)
     {
-        json_t *object = json_object_get(root, "code");
-        json_int_t code = json_integer_value(object);
-        if (code == -1)
-        {
-            object = json_object_get(root, "text");
-            *out = atoi(json_string_value(object));
-            ok = 0;
-        }
-        json_decref(root);
+        *out = ctx->out.value;
     }
     return ok;
 }
 
+/* text of a dialog that was accepted */
+static void dialog_text(termux_call_s *ctx, json_t *root, int accepted)
+{
+    const char *string = json_string_value(json_object_get(root, "text"));
+    if (accepted && string)
+    {
+        ctx->out.text.data = strdup(string);
+        ctx->out.text.byte = strlen(string);
+        ctx->status = 0;
+    }
+}
+
+static void dialog_date_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_argv(argv, "date");
+    api_extra(argv, "--es", "input_title", ctx->in.dialog.title);
+    api_extra(argv, "--es", "date_format", ctx->in.dialog.format);
+}
+
+static int dialog_date_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_int_t code;
+    json_t *root = dialog_code(ctx, &code);
+    if (root == 0)
+    {
+        return ~0;
+    }
+    dialog_text(ctx, root, code == -1);
+    json_decref(root);
+    return 0;
+}
+
 int termux_dialog_date(char *format, char *title, char **out)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[12] = {0, "Dialog", "--es", "input_method", "date"};
-    char *input_title = title;
-    if (input_title)
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_DATE, .in.dialog = {.title = title, .format = format}}};
+    int ok = termux_call(ctx);
+    if (ok == 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
+        *out = ctx->out.text.data;
     }
-    char *date_format = format;
-    if (date_format)
+    return ok;
+}
+
+/* index of a dialog that finished with the code that accepts it */
+static int dialog_index_done(termux_call_s *ctx, json_int_t accept)
+{
+    json_int_t code;
+    json_t *root = dialog_code(ctx, &code);
+    if (root == 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "date_format";
-        argv[argc++] = date_format;
+        return ~0;
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    if (root)
+    json_t *object = json_object_get(root, "index");
+    if (code == accept && object)
+    {
+        ctx->status = (int)json_integer_value(object);
+    }
+    json_decref(root);
+    return 0;
+}
+
+static void dialog_radio_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_values(ctx, argv, "radio");
+}
+
+static int dialog_radio_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    return dialog_index_done(ctx, -1);
+}
+
+int termux_dialog_radio(char *const values[], char *title)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_RADIO, .in.dialog = {.title = title, .values = values}}};
+    return termux_call(ctx);
+}
+
+static void dialog_sheet_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_values(ctx, argv, "sheet");
+}
+
+static int dialog_sheet_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    return dialog_index_done(ctx, 0);
+}
+
+int termux_dialog_sheet(char *const values[], char *title)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_SHEET, .in.dialog = {.title = title, .values = values}}};
+    return termux_call(ctx);
+}
+
+static void dialog_spinner_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_values(ctx, argv, "spinner");
+}
+
+static int dialog_spinner_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    return dialog_index_done(ctx, -1);
+}
+
+int termux_dialog_spinner(char *const values[], char *title)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_SPINNER, .in.dialog = {.title = title, .values = values}}};
+    return termux_call(ctx);
+}
+
+static void dialog_speech_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_argv(argv, "speech");
+    api_extra(argv, "--es", "input_hint", ctx->in.dialog.hint);
+    api_extra(argv, "--es", "input_title", ctx->in.dialog.title);
+}
+
+static int dialog_speech_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_t *root = api_json(ctx);
+    ctx->status = ~0;
+    if (root == 0)
+    {
+        return ~0;
+    }
+    json_t *object = json_object_get(root, "code");
+    if (object == 0)
     {
-        json_t *object = json_object_get(root, "code");
-        json_int_t code = json_integer_value(object);
-        if (code == -1)
+        object = json_object_get(root, "error");
+        if (object)
         {
-            object = json_object_get(root, "text");
-            *out = strdup(json_string_value(object));
-            ok = 0;
+            fprintf(stderr, "%s\n", json_string_value(object));
         }
-        json_decref(root);
+        ctx->status = ~1;
+    }
+    else
+    {
+        dialog_text(ctx, root, json_integer_value(object) == 0);
+    }
+    json_decref(root);
+    return 0;
+}
+
+int termux_dialog_speech(char *hint, char *title, char **out)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_SPEECH, .in.dialog = {.hint = hint, .title = title}}};
+    int ok = termux_call(ctx);
+    if (ok == 0)
+    {
+        *out = ctx->out.text.data;
     }
     return ok;
 }
 
-int termux_dialog_radio(char *const values[], char *title)
+static void dialog_text_argv(const termux_call_s *ctx, api_argv_s *argv)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[12] = {0, "Dialog", "--es", "input_method", "radio"};
-    char *input_title = title;
-    if (input_title)
+    dialog_argv(argv, "text");
+    api_extra(argv, "--es", "input_hint", ctx->in.dialog.hint);
+    api_extra(argv, "--es", "input_title", ctx->in.dialog.title);
+    if (ctx->in.dialog.option & TERMUX_DIALOG_M)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
+        api_extra(argv, "--ez", "multiple_lines", "true");
     }
-    char *input_values = dialog_line(values);
-    if (input_values)
+    if (ctx->in.dialog.option & TERMUX_DIALOG_P)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_values";
-        argv[argc++] = input_values;
+        api_extra(argv, "--ez", "password", "true");
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    free(input_values);
-    if (root)
+    if (ctx->in.dialog.option & TERMUX_DIALOG_N)
     {
-        json_t *object = json_object_get(root, "code");
-        json_int_t code = json_integer_value(object);
-        if (code == -1)
-        {
-            object = json_object_get(root, "index");
-            if (object)
-            {
-                ok = (int)json_integer_value(object);
-            }
-        }
-        json_decref(root);
+        api_extra(argv, "--ez", "numeric", "true");
+    }
+}
+
+static int dialog_text_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_int_t code;
+    json_t *root = dialog_code(ctx, &code);
+    if (root == 0)
+    {
+        return ~0;
+    }
+    dialog_text(ctx, root, code == -1);
+    json_decref(root);
+    return 0;
+}
+
+int termux_dialog_text(char *hint, char *title, char **out, int option)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_TEXT, .in.dialog = {.hint = hint, .title = title, .option = option}}};
+    int ok = termux_call(ctx);
+    if (ok == 0)
+    {
+        *out = ctx->out.text.data;
     }
     return ok;
 }
 
-int termux_dialog_sheet(char *const values[], char *title)
+static void dialog_time_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    dialog_argv(argv, "time");
+    api_extra(argv, "--es", "input_title", ctx->in.dialog.title);
+}
+
+static int dialog_time_done(termux_call_s *ctx, int status)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[12] = {0, "Dialog", "--es", "input_method", "sheet"};
-    char *input_title = title;
-    if (input_title)
+    (void)status;
+    json_int_t code;
+    json_t *root = dialog_code(ctx, &code);
+    if (root == 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
+        return ~0;
     }
-    char *input_values = dialog_line(values);
-    if (input_values)
+    const char *string = json_string_value(json_object_get(root, "text"));
+    int hour, minute;
+    if (code == -1 && string && sscanf(string, " %i:%i", &hour, &minute) == 2)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_values";
-        argv[argc++] = input_values;
+        ctx->status = hour * 100 + minute;
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    free(input_values);
-    if (root)
+    json_decref(root);
+    return 0;
+}
+
+int termux_dialog_time(char *title)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_TIME, .in.dialog = {.title = title}}};
+    return termux_call(ctx);
+}
+
+static void fingerprint_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    api_arg(argv, "Fingerprint");
+    api_extra(argv, "--es", "title", ctx->in.fingerprint.title);
+    api_extra(argv, "--es", "description", ctx->in.fingerprint.description);
+    api_extra(argv, "--es", "subtitle", ctx->in.fingerprint.subtitle);
+    api_extra(argv, "--es", "cancel", ctx->in.fingerprint.cancel);
+}
+
+static int fingerprint_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_t *root = api_json(ctx);
+    ctx->status = ~0;
+    if (root == 0)
+    {
+        return ~0;
+    }
+    const char *string = json_string_value(json_object_get(root, "auth_result"));
+    if (string && strcmp(string, "AUTH_RESULT_SUCCESS") == 0)
+    {
+        ctx->status = 0;
+    }
+    else if (string && strcmp(string, "AUTH_RESULT_FAILURE") == 0)
+    {
+        ctx->status = 1;
+    }
+    else
+    {
+        ctx->status = 2;
+    }
+    json_decref(root);
+    return 0;
+}
+
+int termux_fingerprint(char *title, char *description, char *subtitle, char *cancel)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_FINGERPRINT, .in.fingerprint = {title, description, subtitle, cancel}}};
+    return termux_call(ctx);
+}
+
+static void sensor_cleanup_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    (void)ctx;
+    api_arg(argv, "Sensor");
+    api_arg(argv, "-a");
+    api_arg(argv, "cleanup");
+}
+
+int termux_sensor_cleanup(void)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_SENSOR_CLEANUP}};
+    return termux_call(ctx);
+}
+
+static void sensor_list_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    (void)ctx;
+    api_arg(argv, "Sensor");
+    api_arg(argv, "-a");
+    api_arg(argv, "list");
+}
+
+static int sensor_list_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_t *root = api_json(ctx);
+    ctx->status = ~0;
+    if (root == 0)
+    {
+        return ~0;
+    }
+    json_t *object = json_object_get(root, "sensors");
+    if (object)
     {
-        json_t *object = json_object_get(root, "code");
-        json_int_t code = json_integer_value(object);
-        if (code == 0)
+        size_t n = json_array_size(object);
+        if (n)
         {
-            object = json_object_get(root, "index");
-            if (object)
+            ctx->out.sensors = (char **)malloc(sizeof(char *) * n);
+            if (ctx->out.sensors == 0)
             {
-                ok = (int)json_integer_value(object);
+                n = 0;
             }
         }
-        json_decref(root);
+        for (size_t i = 0; i != n; ++i)
+        {
+            const char *string = json_string_value(json_array_get(object, i));
+            ctx->out.sensors[i] = strdup(string ? string : "");
+        }
+        ctx->status = (int)n;
     }
-    return ok;
+    json_decref(root);
+    return 0;
+}
+
+static int sensor_list_share(termux_call_s *ctx, const termux_call_s *from)
+{
+    int n = from->status;
+    if (n > 0 && from->out.sensors)
+    {
+        ctx->out.sensors = (char **)malloc(sizeof(char *) * (size_t)n);
+        if (ctx->out.sensors == 0)
+        {
+            return ~0;
+        }
+        for (int i = 0; i != n; ++i)
+        {
+            ctx->out.sensors[i] = strdup(from->out.sensors[i]);
+        }
+    }
+    return 0;
 }
 
-int termux_dialog_spinner(char *const values[], char *title)
+int termux_sensor_list(char ***sensor)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[12] = {0, "Dialog", "--es", "input_method", "spinner"};
-    char *input_title = title;
-    if (input_title)
-    {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
-    }
-    char *input_values = dialog_line(values);
-    if (input_values)
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_SENSOR_LIST}};
+    int ok = termux_call(ctx);
+    if (ctx->out.sensors)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_values";
-        argv[argc++] = input_values;
+        *sensor = ctx->out.sensors;
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    free(input_values);
-    if (root)
+    return ok;
+}
+
+static void sensor_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    api_arg(argv, "Sensor");
+    api_arg(argv, "-a");
+    api_arg(argv, "sensors");
+    if (ctx->in.sensor)
     {
-        json_t *object = json_object_get(root, "code");
-        json_int_t code = json_integer_value(object);
-        if (code == -1)
-        {
-            object = json_object_get(root, "index");
-            if (object)
-            {
-                ok = (int)json_integer_value(object);
-            }
-        }
-        json_decref(root);
+        argv->at[0] = api_slot(argv, "--es", "sensors");
+        argv->argv[argv->at[0]] = ctx->in.sensor;
     }
-    return ok;
+    api_extra(argv, "--ei", "limit", "1");
 }
 
-int termux_dialog_speech(char *hint, char *title, char **out)
+static int sensor_patch(const termux_call_s *ctx, api_argv_s *argv)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[12] = {0, "Dialog", "--es", "input_method", "speech"};
-    char *input_hint = hint;
-    if (input_hint)
+    if (ctx->in.sensor == 0 || argv->at[0] == 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_hint";
-        argv[argc++] = input_hint;
+        return ~0;
     }
-    char *input_title = title;
-    if (input_title)
+    argv->argv[argv->at[0]] = ctx->in.sensor;
+    return 0;
+}
+
+static int sensor_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_t *root = api_json(ctx);
+    ctx->status = ~0;
+    if (root == 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
+        return ~0;
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    if (root)
+    json_t *object = json_object_get(json_object_get(root, ctx->in.sensor), "values");
+    if (object)
     {
-        json_t *object = json_object_get(root, "code");
-        if (object == 0)
+        size_t n = json_array_size(object);
+        if (n)
         {
-            object = json_object_get(root, "error");
-            if (object)
+            ctx->out.values = (double *)malloc(sizeof(double) * n);
+            if (ctx->out.values == 0)
             {
-                fprintf(stderr, "%s\n", json_string_value(object));
+                n = 0;
             }
-            ok = ~1;
-            goto done;
         }
-        json_int_t code = json_integer_value(object);
-        if (code == 0)
+        for (size_t i = 0; i != n; ++i)
         {
-            object = json_object_get(root, "text");
-            *out = strdup(json_string_value(object));
-            ok = 0;
+            json_t *item = json_array_get(object, i);
+            ctx->out.values[i] = json_is_number(item) ? json_number_value(item) : 0;
         }
-    done:
-        json_decref(root);
+        ctx->status = (int)n;
     }
-    return ok;
+    json_decref(root);
+    return 0;
 }
 
-int termux_dialog_text(char *hint, char *title, char **out, int option)
+static int sensor_share(termux_call_s *ctx, const termux_call_s *from)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[21] = {0, "Dialog", "--es", "input_method", "text"};
-    char *input_hint = hint;
-    if (input_hint)
+    int n = from->status;
+    if (n > 0 && from->out.values)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_hint";
-        argv[argc++] = input_hint;
+        ctx->out.values = (double *)malloc(sizeof(double) * (size_t)n);
+        if (ctx->out.values == 0)
+        {
+            return ~0;
+        }
+        memcpy(ctx->out.values, from->out.values, sizeof(double) * (size_t)n);
     }
-    char *input_title = title;
-    if (input_title)
+    return 0;
+}
+
+int termux_sensor(char *sensor, double **values)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_SENSOR, .in.sensor = sensor}};
+    int ok = termux_call(ctx);
+    if (ctx->out.values)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
+        *values = ctx->out.values;
     }
-    if (option & TERMUX_DIALOG_M)
+    return ok;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief reports of the child process are json objects one after another, split by counting braces
+*/
+struct termux_stream_s
+{
+    api_s api;
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t head; //!< start of the object being scanned
+    size_t scan; //!< bytes scanned
+    int depth; //!< braces open
+    int string; //!< inside a string
+    int escape; //!< after a backslash in a string
+    int eof;
+    int locked; //!< buf is locked in memory
+    termux_metrics_s *metrics; //!< metrics fed by the stream, may be 0
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+termux_stream_s *termux_stream_open(const char *sensors, int delay)
+{
+    if (sensors == 0 || delay < 0)
     {
-        argv[argc++] = "--ez";
-        argv[argc++] = "multiple_lines";
-        argv[argc++] = "true";
+        errno = EINVAL;
+        return 0;
     }
-    if (option & TERMUX_DIALOG_P)
+    termux_stream_s *ctx = (termux_stream_s *)calloc(1, sizeof(termux_stream_s));
+    if (ctx == 0)
     {
-        argv[argc++] = "--ez";
-        argv[argc++] = "password";
-        argv[argc++] = "true";
+        return 0;
     }
-    if (option & TERMUX_DIALOG_N)
+    char ms[16];
+    api_itoa(ms, delay);
+    char *argv[] = {0, "Sensor", "-a", "sensors", "--es", "sensors", (char *)sensors, "--ei", "delay", ms, 0};
+    if (api_open(&ctx->api, (int)(sizeof(argv) / sizeof(*argv)) - 1, argv))
     {
-        argv[argc++] = "--ez";
-        argv[argc++] = "numeric";
-        argv[argc++] = "true";
+        free(ctx);
+        return 0;
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    if (root)
+    /* the service reads no input */
+    close(ctx->api.wr);
+    ctx->api.wr = ~0;
+    return ctx;
+}
+
+int termux_stream_fd(const termux_stream_s *ctx)
+{
+    return ctx->api.rd;
+}
+
+void termux_stream_metrics(termux_stream_s *ctx, termux_metrics_s *metrics)
+{
+    if (metrics)
     {
-        json_t *object = json_object_get(root, "code");
-        json_int_t code = json_integer_value(object);
-        if (code == -1)
-        {
-            object = json_object_get(root, "text");
-            *out = strdup(json_string_value(object));
-            ok = 0;
-        }
-        json_decref(root);
+        termux_metrics_restart(metrics);
     }
-    return ok;
+    ctx->metrics = metrics;
 }
 
-int termux_dialog_time(char *title)
+/* move the buffer of a stream, keeping it locked if it was */
+static int api_stream_grow(termux_stream_s *ctx, size_t cap)
 {
-    int ok = ~0;
-    int argc = 5;
-    char *argv[9] = {0, "Dialog", "--es", "input_method", "time"};
-    char *input_title = title;
-    if (input_title)
+    if (ctx->locked)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "input_title";
-        argv[argc++] = input_title;
+        munlock(ctx->buf, ctx->cap);
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    if (root)
+    char *buf = (char *)realloc(ctx->buf, cap);
+    if (buf)
     {
-        json_t *object = json_object_get(root, "code");
-        json_int_t code = json_integer_value(object);
-        if (code == -1)
-        {
-            int hour, minute;
-            object = json_object_get(root, "text");
-            const char *string = json_string_value(object);
-            sscanf(string, " %i:%i", &hour, &minute);
-            ok = hour * 100 + minute;
-        }
-        json_decref(root);
+        ctx->buf = buf;
+        ctx->cap = cap;
     }
-    return ok;
+    if (ctx->locked && mlock(ctx->buf, ctx->cap))
+    {
+        ctx->locked = 0;
+    }
+    return buf ? 0 : ~0;
 }
 
-int termux_fingerprint(char *title, char *description, char *subtitle, char *cancel)
+int termux_stream_buffer(termux_stream_s *ctx, size_t byte, int lock)
 {
-    int ok = ~0;
-    int argc = 2;
-    char *argv[15] = {0, "Fingerprint"};
-    if (title)
+    if (byte < 0x2000)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "title";
-        argv[argc++] = title;
+        byte = 0x2000;
     }
-    if (description)
+    if (byte > ctx->cap && api_stream_grow(ctx, byte))
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "description";
-        argv[argc++] = description;
+        return ~0;
     }
-    if (subtitle)
+    /* fault the pages in now rather than on the first reports */
+    memset(ctx->buf + ctx->len, 0, ctx->cap - ctx->len);
+    if (lock && !ctx->locked)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "subtitle";
-        argv[argc++] = subtitle;
+        if (mlock(ctx->buf, ctx->cap))
+        {
+            return ~0;
+        }
+        ctx->locked = 1;
     }
-    if (cancel)
+    return 0;
+}
+
+/*
+ time of a sensor event, nanosecond of CLOCK_BOOTTIME as android stamps them, on CLOCK_MONOTONIC.
+ a stamp that is not one, or later than the receipt, gives the time of the receipt.
+*/
+static uint64_t api_stream_event(json_t *stamp, uint64_t ns)
+{
+    if (!json_is_integer(stamp) || json_integer_value(stamp) <= 0)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "cancel";
-        argv[argc++] = cancel;
+        return ns;
     }
-    argv[argc] = 0;
-    json_t *root = read_json(argc, argv);
-    if (root)
-    {
-        json_t *object = json_object_get(root, "auth_result");
-        const char *string = json_string_value(object);
-        if (strcmp(string, "AUTH_RESULT_SUCCESS") == 0)
+    struct timespec boot, mono;
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    int64_t asleep = (int64_t)(boot.tv_sec - mono.tv_sec) * 1000000000 + (boot.tv_nsec - mono.tv_nsec);
+    int64_t event = (int64_t)json_integer_value(stamp) - asleep;
+    return event > 0 && (uint64_t)event < ns ? (uint64_t)event : ns;
+}
+
+/* decode one report, return the number of sensors in it */
+static int api_stream_object(const char *text, size_t byte, uint64_t ns, termux_metrics_s *metrics,
+                             void (*sample)(const char *, const double *, int, uint64_t, void *), void *arg)
+{
+    int count = 0;
+    uint64_t mark = metrics ? api_clock_ns() : 0, share = 0;
+    json_t *root = json_loadb(text, byte, 0, 0);
+    if (metrics && json_object_size(root))
+    {
+        /* the sensors of a report share the time to load it */
+        uint64_t now = api_clock_ns();
+        share = (now - mark) / json_object_size(root);
+        mark = now;
+    }
+    const char *key;
+    json_t *value;
+    json_object_foreach(root, key, value)
+    {
+        double values[TERMUX_SAMPLE_MAX];
+        json_t *array = json_object_get(value, "values");
+        int n = (int)json_array_size(array);
+        if (n > TERMUX_SAMPLE_MAX)
         {
-            ok = 0;
+            n = TERMUX_SAMPLE_MAX;
         }
-        else if (strcmp(string, "AUTH_RESULT_FAILURE") == 0)
+        for (int i = 0; i != n; ++i)
         {
-            ok = 1;
+            json_t *item = json_array_get(array, (size_t)i);
+            values[i] = json_is_number(item) ? json_number_value(item) : 0;
         }
-        else
+        uint64_t event = api_stream_event(json_object_get(value, "timestamp"), ns);
+        if (metrics)
+        {
+            termux_metrics_sample(metrics, key, event, ns, share + api_clock_ns() - mark);
+        }
+        sample(key, values, n, event, arg);
+        if (metrics)
         {
-            ok = 2;
+            mark = api_clock_ns();
         }
-        json_decref(root);
+        ++count;
     }
-    return ok;
-}
-
-int termux_sensor_cleanup(void)
-{
-    int argc = 4;
-    char *argv[5] = {0, "Sensor", "-a", "cleanup", 0};
-    return pipe_exec(argc, argv, 1000);
+    json_decref(root);
+    return count;
 }
 
-int termux_sensor_list(char ***sensor)
+int termux_stream_read(termux_stream_s *ctx, void (*sample)(const char *sensor, const double *values, int n, uint64_t ns, void *arg), void *arg)
 {
-    int ok = ~0;
-    int argc = 4;
-    char *argv[5] = {0, "Sensor", "-a", "list", 0};
-    json_t *root = read_json(argc, argv);
-    if (root)
+    int count = 0;
+    while (!ctx->eof)
     {
-        json_t *object = json_object_get(root, "sensors");
-        if (object)
+        if (ctx->cap - ctx->len < 0x1000 && api_stream_grow(ctx, ctx->cap ? ctx->cap * 2 : 0x2000))
         {
-            size_t n = json_array_size(object);
-            if (n)
+            return count ? count : ~0;
+        }
+        ssize_t size = read(ctx->api.rd, ctx->buf + ctx->len, ctx->cap - ctx->len);
+        if (size < 0)
+        {
+            if (errno == EINTR)
             {
-                *sensor = (char **)malloc(sizeof(char *) * n);
+                continue;
             }
-            for (size_t i = 0; i != n; ++i)
+            if (errno != EAGAIN)
             {
-                json_t *item = json_array_get(object, i);
-                (*sensor)[i] = strdup(json_string_value(item));
+                ctx->eof = 1;
             }
-            ok = (int)n;
-        }
-        json_decref(root);
-    }
-    return ok;
-}
-
-int termux_sensor(char *sensor, double **values)
-{
-    int ok = ~0;
-    int argc = 10;
-    char *argv[11] = {0, "Sensor", "-a", "sensors", "--es", "sensors", sensor, "--ei", "limit", "1", 0};
-    json_t *root = read_json(argc, argv);
-    if (root)
-    {
-        json_t *object = json_object_get(root, sensor);
-        if (object == 0)
-        {
-            goto done;
+            break;
         }
-        object = json_object_get(object, "values");
-        if (object == 0)
+        if (size == 0)
         {
-            goto done;
+            ctx->eof = 1;
+            break;
         }
-        size_t n = json_array_size(object);
-        if (n)
+        ctx->len += (size_t)size;
+        if (ctx->metrics)
         {
-            *values = (double *)malloc(sizeof(double) * n);
+            termux_metrics_read(ctx->metrics, (size_t)size);
         }
-        for (size_t i = 0; i != n; ++i)
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t ns = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+        for (; ctx->scan != ctx->len; ++ctx->scan)
         {
-            json_t *item = json_array_get(object, i);
-            if (json_is_number(item))
+            char c = ctx->buf[ctx->scan];
+            if (ctx->string)
+            {
+                if (ctx->escape)
+                {
+                    ctx->escape = 0;
+                }
+                else if (c == '\\')
+                {
+                    ctx->escape = 1;
+                }
+                else if (c == '"')
+                {
+                    ctx->string = 0;
+                }
+            }
+            else if (c == '"')
+            {
+                ctx->string = 1;
+            }
+            else if (c == '{')
             {
-                (*values)[i] = json_number_value(item);
+                if (ctx->depth++ == 0)
+                {
+                    ctx->head = ctx->scan;
+                }
+            }
+            else if (c == '}' && ctx->depth && --ctx->depth == 0)
+            {
+                count += api_stream_object(ctx->buf + ctx->head, ctx->scan + 1 - ctx->head, ns, ctx->metrics, sample, arg);
+                ctx->head = ctx->scan + 1;
             }
         }
-        ok = (int)n;
-    done:
-        json_decref(root);
+        /* keep only the object not yet complete */
+        if (ctx->depth == 0)
+        {
+            ctx->head = ctx->len;
+        }
+        memmove(ctx->buf, ctx->buf + ctx->head, ctx->len - ctx->head);
+        ctx->len -= ctx->head;
+        ctx->scan -= ctx->head;
+        ctx->head = 0;
     }
-    return ok;
+    return ctx->eof && count == 0 ? ~0 : count;
 }
 
-int termux_toast(char *text, char *text_color, char *background, int gravity)
+int termux_stream_wait(const termux_stream_s *ctx, long ms)
 {
-    int argc = 2;
-    char *argv[15] = {0, "Toast"};
-    if (gravity & TERMUX_TOAST_SHORT)
+    if (ctx->eof)
+    {
+        return 0;
+    }
+    struct pollfd fds = {.fd = ctx->api.rd, .events = POLLIN};
+    int ok = poll(&fds, 1, ms < 0 ? -1 : (int)ms);
+    if (ok == 0)
     {
-        argv[argc++] = "--ez";
-        argv[argc++] = "short";
-        argv[argc++] = "true";
+        errno = ETIMEDOUT;
     }
-    if (text_color)
+    return ok > 0 ? 0 : ~0;
+}
+
+void termux_stream_close(termux_stream_s *ctx)
+{
+    if (ctx)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "text_color";
-        argv[argc++] = text_color;
+        int status;
+        close(ctx->api.rd);
+        api_kill(ctx->api.pid, &status);
+        if (ctx->locked)
+        {
+            munlock(ctx->buf, ctx->cap);
+        }
+        free(ctx->buf);
+        free(ctx);
     }
-    if (background)
+}
+
+static void toast_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    api_arg(argv, "Toast");
+    int gravity = ctx->in.toast.gravity;
+    if (gravity & TERMUX_TOAST_SHORT)
     {
-        argv[argc++] = "--es";
-        argv[argc++] = "background";
-        argv[argc++] = background;
+        api_extra(argv, "--ez", "short", "true");
     }
+    api_extra(argv, "--es", "text_color", ctx->in.toast.text_color);
+    api_extra(argv, "--es", "background", ctx->in.toast.background);
     gravity &= 0x3;
     if (gravity)
     {
         char *map[] = {"middle", "top", "middle", "bottom"};
-        argv[argc++] = "--es";
-        argv[argc++] = "gravity";
-        argv[argc++] = map[gravity];
-    }
-    argv[argc] = 0;
-    api_s ctx[1];
-    int ok = api_open(ctx, argc, argv);
-    api_printf(ctx, "%s\n", text);
-    api_wait(ctx, 300);
-    api_close(ctx);
-    return ok;
+        api_extra(argv, "--es", "gravity", map[gravity]);
+    }
+    argv->in[argv->nin].iov_base = ctx->in.toast.text;
+    argv->in[argv->nin++].iov_len = ctx->in.toast.text ? strlen(ctx->in.toast.text) : 0;
+    argv->in[argv->nin].iov_base = "\n";
+    argv->in[argv->nin++].iov_len = 1;
+}
+
+static int toast_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    /* the toast was handed over once the child started */
+    ctx->status = 0;
+    return 0;
+}
+
+int termux_toast(char *text, char *text_color, char *background, int gravity)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_TOAST, .in.toast = {text, text_color, background, gravity}}};
+    return termux_call(ctx);
+}
+
+static void torch_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    api_arg(argv, "Torch");
+    argv->at[0] = api_slot(argv, "--ez", "enabled");
+    torch_patch(ctx, argv);
+}
+
+static int torch_patch(const termux_call_s *ctx, api_argv_s *argv)
+{
+    argv->argv[argv->at[0]] = ctx->in.torch ? "1" : "0";
+    return 0;
 }
 
 int termux_torch(int enabled)
 {
-    int argc = 5;
-    char *argv[6] = {0, "Torch", "--ez", "enabled", enabled ? "1" : "0", 0};
-    return pipe_exec(argc, argv, 1000);
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_TORCH, .in.torch = enabled}};
+    return termux_call(ctx);
 }
 
-int termux_vibrate(int ms, int force)
+static void vibrate_argv(const termux_call_s *ctx, api_argv_s *argv)
 {
-    int argc = 5;
-    char buff[16];
-    char *argv[9] = {0, "Vibrate", "--ei", "duration_ms", buff};
-    snprintf(buff, 16, "%i", ms > 0 ? ms : 1000);
-    if (force)
+    api_arg(argv, "Vibrate");
+    argv->argv[api_slot(argv, "--ei", "duration_ms")] = argv->buf[0];
+    if (ctx->in.vibrate.force)
     {
-        argv[argc++] = "--ez";
-        argv[argc++] = "force";
-        argv[argc++] = "true";
+        argv->at[0] = argv->argc;
+        api_extra(argv, "--ez", "force", "true");
     }
-    argv[argc] = 0;
-    return pipe_exec(argc, argv, 1000);
+    vibrate_patch(ctx, argv);
 }
 
-int termux_volume_get(termux_volume_s *ctx)
+static int vibrate_patch(const termux_call_s *ctx, api_argv_s *argv)
 {
-    int ok = ~0;
-    int argc = 2;
-    char *argv[3] = {0, "Volume", 0};
-    json_t *root = read_json(argc, argv);
-    if (root)
+    if (!ctx->in.vibrate.force != !argv->at[0])
     {
-        size_t n = json_array_size(root);
-        for (size_t i = 0; i != n; ++i)
+        return ~0;
+    }
+    api_itoa(argv->buf[0], ctx->in.vibrate.ms > 0 ? ctx->in.vibrate.ms : 1000);
+    return 0;
+}
+
+int termux_vibrate(int ms, int force)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_VIBRATE, .in.vibrate = {ms, force}}};
+    return termux_call(ctx);
+}
+
+static void volume_get_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    (void)ctx;
+    api_arg(argv, "Volume");
+}
+
+static int volume_get_done(termux_call_s *ctx, int status)
+{
+    (void)status;
+    json_t *root = api_json(ctx);
+    ctx->status = ~0;
+    if (root == 0)
+    {
+        return ~0;
+    }
+    size_t n = json_array_size(root);
+    for (size_t i = 0; i != n; ++i)
+    {
+        json_t *item = json_array_get(root, i);
+        json_int_t volume = json_integer_value(json_object_get(item, "volume"));
+        json_int_t max_volume = json_integer_value(json_object_get(item, "max_volume"));
+        const char *stream = json_string_value(json_object_get(item, "stream"));
+        switch (stream ? *stream : 0)
         {
-            json_t *item = json_array_get(root, i);
-            json_int_t volume = json_integer_value(json_object_get(item, "volume"));
-            json_int_t max_volume = json_integer_value(json_object_get(item, "max_volume"));
-            const char *stream = json_string_value(json_object_get(item, "stream"));
-            switch (*stream)
-            {
-            case 'c':
-            {
-                ctx->call->volume = (int)volume;
-                ctx->call->max_volume = (int)max_volume;
-            }
-            break;
-            case 's':
-            {
-                ctx->system->volume = (int)volume;
-                ctx->system->max_volume = (int)max_volume;
-            }
-            break;
-            case 'r':
-            {
-                ctx->ring->volume = (int)volume;
-                ctx->ring->max_volume = (int)max_volume;
-            }
-            break;
-            case 'm':
-            {
-                ctx->music->volume = (int)volume;
-                ctx->music->max_volume = (int)max_volume;
-            }
-            break;
-            case 'a':
-            {
-                ctx->alarm->volume = (int)volume;
-                ctx->alarm->max_volume = (int)max_volume;
-            }
-            break;
-            case 'n':
-            {
-                ctx->notice->volume = (int)volume;
-                ctx->notice->max_volume = (int)max_volume;
-            }
+        case 'c':
+        {
+            ctx->out.volume.call->volume = (int)volume;
+            ctx->out.volume.call->max_volume = (int)max_volume;
+        }
+        break;
+        case 's':
+        {
+            ctx->out.volume.system->volume = (int)volume;
+            ctx->out.volume.system->max_volume = (int)max_volume;
+        }
+        break;
+        case 'r':
+        {
+            ctx->out.volume.ring->volume = (int)volume;
+            ctx->out.volume.ring->max_volume = (int)max_volume;
+        }
+        break;
+        case 'm':
+        {
+            ctx->out.volume.music->volume = (int)volume;
+            ctx->out.volume.music->max_volume = (int)max_volume;
+        }
+        break;
+        case 'a':
+        {
+            ctx->out.volume.alarm->volume = (int)volume;
+            ctx->out.volume.alarm->max_volume = (int)max_volume;
+        }
+        break;
+        case 'n':
+        {
+            ctx->out.volume.notice->volume = (int)volume;
+            ctx->out.volume.notice->max_volume = (int)max_volume;
+        }
+        break;
+        default:
             break;
-            default:
-                break;
-            }
         }
-        ok = 0;
     }
-    return ok;
+    ctx->status = 0;
+    json_decref(root);
+    return 0;
 }
 
-int termux_volume_set(termux_volume_s *ctx)
+static int volume_get_share(termux_call_s *ctx, const termux_call_s *from)
 {
-    int ok = ~0;
-    int argc = 10;
-    char buff[16];
-    termux_volume_s stats[1];
-    char *argv[11] = {0, "Volume", "-a", "set-volume", "--es", "stream", 0, "--ei", "volume", buff, 0};
-    ok = termux_volume_get(stats);
-    if (ctx->call->volume != stats->call->volume)
+    ctx->out.volume = from->out.volume;
+    return 0;
+}
+
+int termux_volume_get(termux_volume_s *ctx)
+{
+    termux_call_s call[1] = {{.call = TERMUX_CALL_VOLUME_GET}};
+    int ok = termux_call(call);
+    if (ok == 0)
     {
-        argv[6] = "call";
-        snprintf(buff, 16, "%i", ctx->call->volume);
-        if (pipe_exec(argc, argv, 1000) == 0 && ctx->call->volume > stats->call->max_volume)
-        {
-            ctx->call->max_volume = stats->call->max_volume;
-            ctx->call->volume = stats->call->max_volume;
-        }
+        *ctx = call->out.volume;
     }
-    if (ctx->system->volume != stats->system->volume)
+    return ok;
+}
+
+static void volume_set_argv(const termux_call_s *ctx, api_argv_s *argv)
+{
+    api_arg(argv, "Volume");
+    api_arg(argv, "-a");
+    api_arg(argv, "set-volume");
+    if (ctx->in.volume.stream)
     {
-        argv[6] = "system";
-        snprintf(buff, 16, "%i", ctx->system->volume);
-        if (pipe_exec(argc, argv, 1000) == 0 && ctx->system->volume > stats->system->max_volume)
-        {
-            ctx->system->max_volume = stats->system->max_volume;
-            ctx->system->volume = stats->system->max_volume;
-        }
+        argv->at[0] = api_slot(argv, "--es", "stream");
     }
-    if (ctx->ring->volume != stats->ring->volume)
+    argv->argv[api_slot(argv, "--ei", "volume")] = argv->buf[0];
+    volume_set_patch(ctx, argv);
+}
+
+static int volume_set_patch(const termux_call_s *ctx, api_argv_s *argv)
+{
+    if (!ctx->in.volume.stream != !argv->at[0])
     {
-        argv[6] = "ring";
-        snprintf(buff, 16, "%i", ctx->ring->volume);
-        if (pipe_exec(argc, argv, 1000) == 0 && ctx->ring->volume > stats->ring->max_volume)
-        {
-            ctx->ring->max_volume = stats->ring->max_volume;
-            ctx->ring->volume = stats->ring->max_volume;
-        }
+        return ~0;
     }
-    if (ctx->music->volume != stats->music->volume)
+    if (argv->at[0])
     {
-        argv[6] = "music";
-        snprintf(buff, 16, "%i", ctx->music->volume);
-        if (pipe_exec(argc, argv, 1000) == 0 && ctx->music->volume > stats->music->max_volume)
-        {
-            ctx->music->max_volume = stats->music->max_volume;
-            ctx->music->volume = stats->music->max_volume;
-        }
+        argv->argv[argv->at[0]] = ctx->in.volume.stream;
     }
-    if (ctx->alarm->volume != stats->alarm->volume)
+    api_itoa(argv->buf[0], ctx->in.volume.volume);
+    return 0;
+}
+
+static void volume_set(char *stream, int *volume, int *max_volume, int now, int max)
+{
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_VOLUME_SET, .in.volume = {stream, *volume}}};
+    if (*volume != now && termux_call(ctx) == 0 && *volume > max)
     {
-        argv[6] = "alarm";
-        snprintf(buff, 16, "%i", ctx->alarm->volume);
-        if (pipe_exec(argc, argv, 1000) == 0 && ctx->alarm->volume > stats->alarm->max_volume)
-        {
-            ctx->alarm->max_volume = stats->alarm->max_volume;
-            ctx->alarm->volume = stats->alarm->max_volume;
-        }
+        *max_volume = max;
+        *volume = max;
     }
-    if (ctx->notice->volume != stats->notice->volume)
+}
+
+int termux_volume_set(termux_volume_s *ctx)
+{
+    termux_volume_s stats[1];
+    int ok = termux_volume_get(stats);
+    if (ok)
     {
-        argv[6] = "notification";
-        snprintf(buff, 16, "%i", ctx->notice->volume);
-        if (pipe_exec(argc, argv, 1000) == 0 && ctx->notice->volume > stats->notice->max_volume)
-        {
-            ctx->notice->max_volume = stats->notice->max_volume;
-            ctx->notice->volume = stats->notice->max_volume;
-        }
+        return ok;
     }
+    volume_set("call", &ctx->call->volume, &ctx->call->max_volume, stats->call->volume, stats->call->max_volume);
+    volume_set("system", &ctx->system->volume, &ctx->system->max_volume, stats->system->volume, stats->system->max_volume);
+    volume_set("ring", &ctx->ring->volume, &ctx->ring->max_volume, stats->ring->volume, stats->ring->max_volume);
+    volume_set("music", &ctx->music->volume, &ctx->music->max_volume, stats->music->volume, stats->music->max_volume);
+    volume_set("alarm", &ctx->alarm->volume, &ctx->alarm->max_volume, stats->alarm->volume, stats->alarm->max_volume);
+    volume_set("notification", &ctx->notice->volume, &ctx->notice->max_volume, stats->notice->volume, stats->notice->max_volume);
     return ok;
 }
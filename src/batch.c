@@ -0,0 +1,220 @@
+/*!
+ @file batch.c
+ @brief batch of termux api calls run together
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/batch.h"
+
+#include <poll.h>
+#include <errno.h>
+#include <stdlib.h>
+
+enum
+{
+    BATCH_QUEUED,
+    BATCH_RUNNING,
+    BATCH_DONE
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+typedef struct
+{
+    int after; //!< index of the call to finish first, ~0 for none
+    int state;
+} batch_item_s;
+
+struct termux_batch_s
+{
+    termux_call_s *call;
+    batch_item_s *item;
+    struct pollfd *fds; //!< output of the calls in flight, then their tokens
+    int *run; //!< index of the calls in flight
+    unsigned int n;
+    unsigned int cap;
+    unsigned int base; //!< first call of the next run
+    unsigned int limit;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+termux_batch_s *termux_batch_new(unsigned int limit)
+{
+    termux_batch_s *ctx = (termux_batch_s *)calloc(1, sizeof(termux_batch_s));
+    if (ctx)
+    {
+        ctx->limit = limit;
+    }
+    return ctx;
+}
+
+void termux_batch_free(termux_batch_s *ctx)
+{
+    if (ctx)
+    {
+        free(ctx->call);
+        free(ctx->item);
+        free(ctx->fds);
+        free(ctx->run);
+        free(ctx);
+    }
+}
+
+int termux_batch_add(termux_batch_s *ctx, const termux_call_s *call, int after)
+{
+    /* a call only waits for an earlier one, so a batch has no cycle */
+    if (after >= (int)ctx->n || (after < 0 && after != ~0))
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    if (ctx->n == ctx->cap)
+    {
+        unsigned int cap = ctx->cap ? ctx->cap << 1 : 8;
+        termux_call_s *calls = (termux_call_s *)realloc(ctx->call, sizeof(termux_call_s) * cap);
+        if (calls == 0)
+        {
+            return ~0;
+        }
+        ctx->call = calls;
+        batch_item_s *item = (batch_item_s *)realloc(ctx->item, sizeof(batch_item_s) * cap);
+        if (item == 0)
+        {
+            return ~0;
+        }
+        ctx->item = item;
+        ctx->cap = cap;
+    }
+    ctx->call[ctx->n] = *call;
+    ctx->item[ctx->n].after = after;
+    ctx->item[ctx->n].state = BATCH_QUEUED;
+    return (int)ctx->n++;
+}
+
+termux_call_s *termux_batch_calls(termux_batch_s *ctx, unsigned int *n)
+{
+    if (n)
+    {
+        *n = ctx->n;
+    }
+    return ctx->call;
+}
+
+/* start the queued calls that are ready while slots are free, return number that failed to start */
+static int batch_start(termux_batch_s *ctx, unsigned int *next, unsigned int *running, unsigned int limit)
+{
+    int failed = 0;
+    while (*next < ctx->n && ctx->item[*next].state != BATCH_QUEUED)
+    {
+        ++*next;
+    }
+    for (unsigned int i = *next; i < ctx->n && *running < limit; ++i)
+    {
+        batch_item_s *item = ctx->item + i;
+        if (item->state != BATCH_QUEUED || (item->after != ~0 && ctx->item[item->after].state != BATCH_DONE))
+        {
+            continue;
+        }
+        termux_call_s *call = ctx->call + i;
+        int ok = termux_call_start(call);
+        /* the slots of termux_sched_config() are taken by other threads, wait for one */
+        while (ok == TERMUX_REJECT && errno == EAGAIN && *running == 0)
+        {
+            poll(0, 0, 1);
+            ok = termux_call_start(call);
+        }
+        if (ok == TERMUX_REJECT && errno == EAGAIN)
+        {
+            /* retry once one of ours finished */
+            break;
+        }
+        if (ok)
+        {
+            termux_call_finish(call);
+            item->state = BATCH_DONE;
+            ++failed;
+            continue;
+        }
+        item->state = BATCH_RUNNING;
+        ctx->fds[*running].fd = termux_call_fd(call);
+        ctx->fds[*running].events = POLLIN;
+        ctx->run[(*running)++] = (int)i;
+    }
+    return failed;
+}
+
+int termux_batch_run(termux_batch_s *ctx)
+{
+    unsigned int left = ctx->n - ctx->base;
+    unsigned int limit = ctx->limit && ctx->limit < left ? ctx->limit : left;
+    if (left == 0)
+    {
+        return 0;
+    }
+    struct pollfd *fds = (struct pollfd *)realloc(ctx->fds, sizeof(struct pollfd) * limit * 2);
+    if (fds == 0)
+    {
+        return ~0;
+    }
+    ctx->fds = fds;
+    int *run = (int *)realloc(ctx->run, sizeof(int) * limit);
+    if (run == 0)
+    {
+        return ~0;
+    }
+    ctx->run = run;
+
+    int failed = 0;
+    unsigned int next = ctx->base;
+    unsigned int running = 0;
+    for (;;)
+    {
+        failed += batch_start(ctx, &next, &running, limit);
+        if (running == 0)
+        {
+            break;
+        }
+        long ms = ~0;
+        for (unsigned int k = 0; k != running; ++k)
+        {
+            termux_call_s *call = ctx->call + ctx->run[k];
+            long left_ms = termux_call_left(call);
+            if (left_ms >= 0 && (ms < 0 || left_ms < ms))
+            {
+                ms = left_ms;
+            }
+            /* a cancelled token wakes the poll as well */
+            ctx->fds[running + k].fd = call->cancel ? termux_cancel_fd(call->cancel) : ~0;
+            ctx->fds[running + k].events = POLLIN;
+        }
+        int ok = poll(ctx->fds, running * 2, (int)ms);
+        /* give up the calls in flight if they cannot be waited for */
+        int stop = ok < 0 && errno != EINTR;
+        for (unsigned int k = 0; k < running;)
+        {
+            termux_call_s *call = ctx->call + ctx->run[k];
+            int cancelled = call->cancel && termux_cancelled(call->cancel);
+            ok = (ctx->fds[k].revents || cancelled) && !stop ? termux_call_read(call) : 0;
+            if (ok == 0 && !stop && termux_call_left(call) != 0)
+            {
+                ++k;
+                continue;
+            }
+            /* a call whose output has not ended is killed */
+            failed += ok != 1;
+            termux_call_finish(call);
+            ctx->item[ctx->run[k]].state = BATCH_DONE;
+            --running;
+            ctx->fds[k] = ctx->fds[running];
+            ctx->run[k] = ctx->run[running];
+        }
+    }
+    ctx->base = ctx->n;
+    return failed;
+}
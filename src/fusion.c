@@ -0,0 +1,212 @@
+/*!
+ @file fusion.c
+ @brief orientation of the device from its accelerometer, gyroscope and magnetometer
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/fusion.h"
+
+#include <string.h>
+#include <math.h>
+
+#define FUSION_ACCEL 1
+#define FUSION_MAG 2
+
+void termux_fusion_init(termux_fusion_s *ctx, double beta)
+{
+    ctx->q[0] = 1;
+    ctx->q[1] = ctx->q[2] = ctx->q[3] = 0;
+    ctx->beta = beta > 0 ? beta : TERMUX_FUSION_BETA;
+    ctx->ns = 0;
+    ctx->updates = 0;
+    ctx->have = 0;
+}
+
+static int fusion_unit(double *v, const double *x)
+{
+    double r = x[0] * x[0] + x[1] * x[1] + x[2] * x[2];
+    if (!(r > 0))
+    {
+        return 0;
+    }
+    r = 1 / sqrt(r);
+    v[0] = x[0] * r;
+    v[1] = x[1] * r;
+    v[2] = x[2] * r;
+    return 1;
+}
+
+/* the earth axes seen from the device are the rows of the rotation from the device to the earth */
+static void fusion_start(termux_fusion_s *ctx, const double *a, const double *m)
+{
+    double x[3], y[3], z[3];
+    if (!fusion_unit(z, a))
+    {
+        return;
+    }
+    static const double ex[3] = {1, 0, 0}, ey[3] = {0, 1, 0};
+    const double *h = m ? m : fabs(z[0]) < 0.9 ? ex : ey;
+    double d = h[0] * z[0] + h[1] * z[1] + h[2] * z[2];
+    double t[3] = {h[0] - d * z[0], h[1] - d * z[1], h[2] - d * z[2]};
+    if (!fusion_unit(x, t))
+    {
+        return;
+    }
+    y[0] = z[1] * x[2] - z[2] * x[1];
+    y[1] = z[2] * x[0] - z[0] * x[2];
+    y[2] = z[0] * x[1] - z[1] * x[0];
+    double *q = ctx->q;
+    double trace = x[0] + y[1] + z[2];
+    if (trace > 0)
+    {
+        double s = 2 * sqrt(trace + 1);
+        q[0] = s / 4;
+        q[1] = (z[1] - y[2]) / s;
+        q[2] = (x[2] - z[0]) / s;
+        q[3] = (y[0] - x[1]) / s;
+    }
+    else if (x[0] > y[1] && x[0] > z[2])
+    {
+        double s = 2 * sqrt(1 + x[0] - y[1] - z[2]);
+        q[0] = (z[1] - y[2]) / s;
+        q[1] = s / 4;
+        q[2] = (x[1] + y[0]) / s;
+        q[3] = (x[2] + z[0]) / s;
+    }
+    else if (y[1] > z[2])
+    {
+        double s = 2 * sqrt(1 + y[1] - x[0] - z[2]);
+        q[0] = (x[2] - z[0]) / s;
+        q[1] = (x[1] + y[0]) / s;
+        q[2] = s / 4;
+        q[3] = (y[2] + z[1]) / s;
+    }
+    else
+    {
+        double s = 2 * sqrt(1 + z[2] - x[0] - y[1]);
+        q[0] = (y[0] - x[1]) / s;
+        q[1] = (x[2] + z[0]) / s;
+        q[2] = (y[2] + z[1]) / s;
+        q[3] = s / 4;
+    }
+}
+
+/*
+ the gradient of the error between the directions measured and those the orientation expects,
+ gravity (0, 0, 1) and the field (bx, 0, bz) turned into the device frame, as J^T f in the paper of Madgwick.
+*/
+static void fusion_gradient(const double *q, const double *a, const double *m, double *s)
+{
+    double q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+    double f0 = 2 * (q1 * q3 - q0 * q2) - a[0];
+    double f1 = 2 * (q0 * q1 + q2 * q3) - a[1];
+    double f2 = 1 - 2 * (q1 * q1 + q2 * q2) - a[2];
+    s[0] = -2 * q2 * f0 + 2 * q1 * f1;
+    s[1] = 2 * q3 * f0 + 2 * q0 * f1 - 4 * q1 * f2;
+    s[2] = -2 * q0 * f0 + 2 * q3 * f1 - 4 * q2 * f2;
+    s[3] = 2 * q1 * f0 + 2 * q2 * f1;
+    if (m == 0)
+    {
+        return;
+    }
+    /* the field turned into the earth frame, its horizontal part is taken as the north */
+    double hx = m[0] * (1 - 2 * (q2 * q2 + q3 * q3)) + m[1] * 2 * (q1 * q2 - q0 * q3) + m[2] * 2 * (q1 * q3 + q0 * q2);
+    double hy = m[0] * 2 * (q1 * q2 + q0 * q3) + m[1] * (1 - 2 * (q1 * q1 + q3 * q3)) + m[2] * 2 * (q2 * q3 - q0 * q1);
+    double bz = m[0] * 2 * (q1 * q3 - q0 * q2) + m[1] * 2 * (q2 * q3 + q0 * q1) + m[2] * (1 - 2 * (q1 * q1 + q2 * q2));
+    double bx = sqrt(hx * hx + hy * hy);
+    double g0 = 2 * bx * (0.5 - q2 * q2 - q3 * q3) + 2 * bz * (q1 * q3 - q0 * q2) - m[0];
+    double g1 = 2 * bx * (q1 * q2 - q0 * q3) + 2 * bz * (q0 * q1 + q2 * q3) - m[1];
+    double g2 = 2 * bx * (q0 * q2 + q1 * q3) + 2 * bz * (0.5 - q1 * q1 - q2 * q2) - m[2];
+    s[0] += -2 * bz * q2 * g0 + (-2 * bx * q3 + 2 * bz * q1) * g1 + 2 * bx * q2 * g2;
+    s[1] += 2 * bz * q3 * g0 + (2 * bx * q2 + 2 * bz * q0) * g1 + (2 * bx * q3 - 4 * bz * q1) * g2;
+    s[2] += (-4 * bx * q2 - 2 * bz * q0) * g0 + (2 * bx * q1 + 2 * bz * q3) * g1 + (2 * bx * q0 - 4 * bz * q2) * g2;
+    s[3] += (-4 * bx * q3 + 2 * bz * q1) * g0 + (-2 * bx * q0 + 2 * bz * q2) * g1 + 2 * bx * q1 * g2;
+}
+
+void termux_fusion_update(termux_fusion_s *ctx, uint64_t ns, const double *gyro, const double *accel, const double *mag)
+{
+    double a[3], m[3];
+    int has_a = accel && fusion_unit(a, accel);
+    int has_m = has_a && mag && fusion_unit(m, mag);
+    if (ctx->updates++ == 0 || ns - ctx->ns > TERMUX_FUSION_GAP)
+    {
+        ctx->ns = ns;
+        if (has_a)
+        {
+            fusion_start(ctx, a, has_m ? m : 0);
+        }
+        return;
+    }
+    double dt = (double)(int64_t)(ns - ctx->ns) * 1e-9;
+    ctx->ns = ns;
+    if (!(dt > 0))
+    {
+        return;
+    }
+    double *q = ctx->q;
+    double gx = gyro[0], gy = gyro[1], gz = gyro[2];
+    double d[4] = {
+        0.5 * (-q[1] * gx - q[2] * gy - q[3] * gz),
+        0.5 * (q[0] * gx + q[2] * gz - q[3] * gy),
+        0.5 * (q[0] * gy - q[1] * gz + q[3] * gx),
+        0.5 * (q[0] * gz + q[1] * gy - q[2] * gx),
+    };
+    if (has_a)
+    {
+        double s[4];
+        fusion_gradient(q, a, has_m ? m : 0, s);
+        double r = s[0] * s[0] + s[1] * s[1] + s[2] * s[2] + s[3] * s[3];
+        if (r > 0)
+        {
+            r = ctx->beta / sqrt(r);
+            for (int i = 0; i != 4; ++i)
+            {
+                d[i] -= r * s[i];
+            }
+        }
+    }
+    double r = 0;
+    for (int i = 0; i != 4; ++i)
+    {
+        q[i] += d[i] * dt;
+        r += q[i] * q[i];
+    }
+    r = 1 / sqrt(r);
+    for (int i = 0; i != 4; ++i)
+    {
+        q[i] *= r;
+    }
+}
+
+void termux_fusion_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    termux_fusion_s *ctx = (termux_fusion_s *)arg;
+    if (n < 3)
+    {
+        return;
+    }
+    if (strcasestr(sensor, "gyro"))
+    {
+        termux_fusion_update(ctx, ns, values, ctx->have & FUSION_ACCEL ? ctx->accel : 0,
+                             ctx->have & FUSION_MAG ? ctx->mag : 0);
+    }
+    else if (strcasestr(sensor, "accel"))
+    {
+        memcpy(ctx->accel, values, sizeof(ctx->accel));
+        ctx->have |= FUSION_ACCEL;
+    }
+    else if (strcasestr(sensor, "magnet"))
+    {
+        memcpy(ctx->mag, values, sizeof(ctx->mag));
+        ctx->have |= FUSION_MAG;
+    }
+}
+
+void termux_fusion_euler(const termux_fusion_s *ctx, double *euler)
+{
+    double const *q = ctx->q;
+    double sp = 2 * (q[0] * q[2] - q[1] * q[3]);
+    euler[0] = atan2(q[0] * q[1] + q[2] * q[3], 0.5 - q[1] * q[1] - q[2] * q[2]);
+    euler[1] = asin(sp > 1 ? 1 : sp < -1 ? -1 : sp);
+    euler[2] = atan2(q[1] * q[2] + q[0] * q[3], 0.5 - q[2] * q[2] - q[3] * q[3]);
+}
@@ -0,0 +1,303 @@
+/*!
+ @file gorilla.c
+ @brief compression of sensor samples in blocks
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/gorilla.h"
+
+#include <string.h>
+
+#define GORILLA_NS 68 /* most bits of a time */
+#define GORILLA_VALUE 77 /* most bits of a value */
+#define GORILLA_NONE 0xFF /* no window of meaningful bits yet */
+
+size_t termux_gorilla_bound(size_t n, int axes)
+{
+    return TERMUX_GORILLA_HEAD + (n * (GORILLA_NS + GORILLA_VALUE * (size_t)axes) + 7) / 8 + 8;
+}
+
+/* write the 64 bits pending, most significant byte first */
+static void gorilla_flush(termux_gorilla_s *ctx)
+{
+    unsigned char *p = ctx->buf + ctx->byte;
+    for (int i = 0; i != 8; ++i)
+    {
+        p[i] = (unsigned char)(ctx->bits >> (56 - 8 * i));
+    }
+    ctx->byte += 8;
+}
+
+/* append the n lowest bits of value, n is 1~64 and value has no bits above them */
+static void gorilla_put(termux_gorilla_s *ctx, uint64_t value, unsigned int n)
+{
+    unsigned int room = 64 - ctx->fill;
+    if (n < room)
+    {
+        ctx->bits |= value << (room - n);
+        ctx->fill += n;
+        return;
+    }
+    unsigned int rest = n - room;
+    ctx->bits |= rest ? value >> rest : value;
+    gorilla_flush(ctx);
+    ctx->bits = rest ? value << (64 - rest) : 0;
+    ctx->fill = rest;
+}
+
+int termux_gorilla_init(termux_gorilla_s *ctx, void *buf, size_t cap, int axes)
+{
+    if (axes < 1 || axes > TERMUX_SAMPLE_MAX || cap < TERMUX_GORILLA_HEAD)
+    {
+        return ~0;
+    }
+    ctx->count = 0;
+    ctx->axes = axes;
+    ctx->index = 0;
+    ctx->buf = (unsigned char *)buf;
+    ctx->cap = cap;
+    ctx->byte = TERMUX_GORILLA_HEAD;
+    ctx->bits = 0;
+    ctx->fill = 0;
+    ctx->ns = 0;
+    ctx->delta = 0;
+    memset(ctx->lead, GORILLA_NONE, sizeof(ctx->lead));
+    return 0;
+}
+
+static void gorilla_put_value(termux_gorilla_s *ctx, int axis, uint64_t value)
+{
+    uint64_t x = value ^ ctx->value[axis];
+    ctx->value[axis] = value;
+    if (x == 0)
+    {
+        gorilla_put(ctx, 0, 1);
+        return;
+    }
+    unsigned int lead = (unsigned int)__builtin_clzll(x);
+    unsigned int trail = (unsigned int)__builtin_ctzll(x);
+    if (lead > 31)
+    {
+        lead = 31;
+    }
+    /* the bits that changed fit in the window of the value before */
+    if (ctx->lead[axis] != GORILLA_NONE && lead >= ctx->lead[axis] && trail >= ctx->trail[axis])
+    {
+        unsigned int n = 64U - ctx->lead[axis] - ctx->trail[axis];
+        gorilla_put(ctx, 2, 2);
+        gorilla_put(ctx, x >> ctx->trail[axis], n);
+        return;
+    }
+    unsigned int n = 64 - lead - trail;
+    gorilla_put(ctx, (3U << 11) | (lead << 6) | (n & 63), 13);
+    gorilla_put(ctx, x >> trail, n);
+    ctx->lead[axis] = (unsigned char)lead;
+    ctx->trail[axis] = (unsigned char)trail;
+}
+
+int termux_gorilla_put(termux_gorilla_s *ctx, uint64_t ns, const double *values)
+{
+    size_t most = (GORILLA_NS + GORILLA_VALUE * (size_t)ctx->axes + 7) / 8 + 8;
+    if (ctx->byte + most > ctx->cap || ctx->count == UINT32_MAX)
+    {
+        return ~0;
+    }
+    uint64_t value;
+    if (ctx->count++ == 0)
+    {
+        gorilla_put(ctx, ns, 64);
+        for (int i = 0; i != ctx->axes; ++i)
+        {
+            memcpy(&value, values + i, sizeof(value));
+            gorilla_put(ctx, value, 64);
+            ctx->value[i] = value;
+        }
+        ctx->ns = ns;
+        return 0;
+    }
+    /* wrap in unsigned so times going back or far apart round trip, signed only to pick the bucket */
+    uint64_t delta = ns - ctx->ns;
+    uint64_t bits = delta - ctx->delta;
+    int64_t dod = (int64_t)bits;
+    ctx->ns = ns;
+    ctx->delta = delta;
+    if (dod == 0)
+    {
+        gorilla_put(ctx, 0, 1);
+    }
+    else if (dod >= -2048 && dod < 2048)
+    {
+        gorilla_put(ctx, (2ULL << 12) | (bits & 0xFFF), 14);
+    }
+    else if (dod >= -524288 && dod < 524288)
+    {
+        gorilla_put(ctx, (6ULL << 20) | (bits & 0xFFFFF), 23);
+    }
+    else if (dod >= INT32_MIN && dod <= INT32_MAX)
+    {
+        gorilla_put(ctx, (14ULL << 32) | (bits & 0xFFFFFFFF), 36);
+    }
+    else
+    {
+        gorilla_put(ctx, 15, 4);
+        gorilla_put(ctx, bits, 64);
+    }
+    for (int i = 0; i != ctx->axes; ++i)
+    {
+        memcpy(&value, values + i, sizeof(value));
+        gorilla_put_value(ctx, i, value);
+    }
+    return 0;
+}
+
+size_t termux_gorilla_end(termux_gorilla_s *ctx)
+{
+    for (unsigned int i = 0; i < ctx->fill; i += 8)
+    {
+        ctx->buf[ctx->byte++] = (unsigned char)(ctx->bits >> (56 - i));
+    }
+    ctx->bits = 0;
+    ctx->fill = 0;
+    uint32_t head[2] = {ctx->count, (uint32_t)ctx->axes};
+    for (int i = 0; i != TERMUX_GORILLA_HEAD; ++i)
+    {
+        ctx->buf[i] = (unsigned char)(head[i / 4] >> (8 * (i % 4)));
+    }
+    return ctx->byte;
+}
+
+int termux_gorilla_open(termux_gorilla_s *ctx, const void *buf, size_t byte)
+{
+    const unsigned char *p = (const unsigned char *)buf;
+    if (byte < TERMUX_GORILLA_HEAD)
+    {
+        return ~0;
+    }
+    uint32_t head[2] = {0, 0};
+    for (int i = 0; i != TERMUX_GORILLA_HEAD; ++i)
+    {
+        head[i / 4] |= (uint32_t)p[i] << (8 * (i % 4));
+    }
+    if (head[1] < 1 || head[1] > TERMUX_SAMPLE_MAX)
+    {
+        return ~0;
+    }
+    ctx->count = head[0];
+    ctx->axes = (int)head[1];
+    ctx->index = 0;
+    ctx->buf = (unsigned char *)p;
+    ctx->cap = byte;
+    ctx->byte = TERMUX_GORILLA_HEAD;
+    ctx->bits = 0;
+    ctx->fill = 0;
+    ctx->ns = 0;
+    ctx->delta = 0;
+    memset(ctx->lead, GORILLA_NONE, sizeof(ctx->lead));
+    return 0;
+}
+
+/* take the next n bits, n is 1~56, bits past the end of the block are 0 */
+static uint64_t gorilla_get(termux_gorilla_s *ctx, unsigned int n)
+{
+    while (ctx->fill < n)
+    {
+        uint64_t byte = ctx->byte < ctx->cap ? ctx->buf[ctx->byte++] : 0;
+        ctx->bits |= byte << (56 - ctx->fill);
+        ctx->fill += 8;
+    }
+    uint64_t value = ctx->bits >> (64 - n);
+    ctx->bits <<= n;
+    ctx->fill -= n;
+    return value;
+}
+
+static uint64_t gorilla_get64(termux_gorilla_s *ctx, unsigned int n)
+{
+    if (n > 56)
+    {
+        uint64_t high = gorilla_get(ctx, n - 32);
+        return (high << 32) | gorilla_get(ctx, 32);
+    }
+    return gorilla_get(ctx, n);
+}
+
+/* sign extend the n lowest bits, kept unsigned so adding it wraps */
+static uint64_t gorilla_signed(uint64_t value, unsigned int n)
+{
+    uint64_t sign = 1ULL << (n - 1);
+    return (value ^ sign) - sign;
+}
+
+int termux_gorilla_get(termux_gorilla_s *ctx, uint64_t *ns, double *values)
+{
+    if (ctx->index == ctx->count)
+    {
+        return ~0;
+    }
+    if (ctx->index++ == 0)
+    {
+        ctx->ns = gorilla_get64(ctx, 64);
+        for (int i = 0; i != ctx->axes; ++i)
+        {
+            ctx->value[i] = gorilla_get64(ctx, 64);
+        }
+    }
+    else
+    {
+        uint64_t dod = 0;
+        if (gorilla_get(ctx, 1))
+        {
+            if (gorilla_get(ctx, 1) == 0)
+            {
+                dod = gorilla_signed(gorilla_get(ctx, 12), 12);
+            }
+            else if (gorilla_get(ctx, 1) == 0)
+            {
+                dod = gorilla_signed(gorilla_get(ctx, 20), 20);
+            }
+            else if (gorilla_get(ctx, 1) == 0)
+            {
+                dod = gorilla_signed(gorilla_get(ctx, 32), 32);
+            }
+            else
+            {
+                dod = gorilla_get64(ctx, 64);
+            }
+        }
+        ctx->delta += dod;
+        ctx->ns += ctx->delta;
+        for (int i = 0; i != ctx->axes; ++i)
+        {
+            if (gorilla_get(ctx, 1) == 0)
+            {
+                continue;
+            }
+            if (gorilla_get(ctx, 1))
+            {
+                unsigned int lead = (unsigned int)gorilla_get(ctx, 5);
+                unsigned int n = (unsigned int)gorilla_get(ctx, 6);
+                n = n ? n : 64;
+                if (lead + n > 64)
+                {
+                    ctx->index = ctx->count;
+                    return ~0;
+                }
+                ctx->lead[i] = (unsigned char)lead;
+                ctx->trail[i] = (unsigned char)(64 - lead - n);
+            }
+            else if (ctx->lead[i] == GORILLA_NONE)
+            {
+                ctx->index = ctx->count;
+                return ~0;
+            }
+            unsigned int n = 64U - ctx->lead[i] - ctx->trail[i];
+            ctx->value[i] ^= gorilla_get64(ctx, n) << ctx->trail[i];
+        }
+    }
+    *ns = ctx->ns;
+    for (int i = 0; i != ctx->axes; ++i)
+    {
+        memcpy(values + i, ctx->value + i, sizeof(double));
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+/*!
+ @file metrics.c
+ @brief metrics of the sensors of streams
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define METRICS_SETTLE 4 /* times between samples taken before gaps are told apart */
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+typedef struct metrics_sensor_s
+{
+    termux_metric_s metric; //!< counts and maxima, the means are made from the sums
+    uint64_t last; //!< time of the last sample
+    uint64_t since; //!< samples since the stream started
+    uint64_t latency; //!< sum of the latency
+    uint64_t interval; //!< sum of the times between samples outside gaps
+    uint64_t intervals;
+    uint64_t jitter; //!< sum of the jitter
+    uint64_t jitters;
+    uint64_t parse; //!< sum of the time to decode
+} metrics_sensor_s;
+
+struct termux_metrics_s
+{
+    pthread_mutex_t mutex;
+    metrics_sensor_s *sensor;
+    int sensors;
+    int cap;
+    int hit; //!< sensor of the last sample
+    termux_queue_metric_s queue; //!< counts and maxima, backlog is a sum
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+termux_metrics_s *termux_metrics_new(void)
+{
+    termux_metrics_s *ctx = (termux_metrics_s *)calloc(1, sizeof(termux_metrics_s));
+    if (ctx)
+    {
+        pthread_mutex_init(&ctx->mutex, 0);
+    }
+    return ctx;
+}
+
+void termux_metrics_free(termux_metrics_s *ctx)
+{
+    if (ctx == 0)
+    {
+        return;
+    }
+    pthread_mutex_destroy(&ctx->mutex);
+    free(ctx->sensor);
+    free(ctx);
+}
+
+void termux_metrics_reset(termux_metrics_s *ctx)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->sensors = 0;
+    ctx->hit = 0;
+    memset(&ctx->queue, 0, sizeof(ctx->queue));
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+void termux_metrics_restart(termux_metrics_s *ctx)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    for (int i = 0; i != ctx->sensors; ++i)
+    {
+        metrics_sensor_s *s = ctx->sensor + i;
+        s->last = 0;
+        s->since = 0;
+        s->interval = 0;
+        s->intervals = 0;
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+void termux_metrics_read(termux_metrics_s *ctx, size_t byte)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    ++ctx->queue.reads;
+    ctx->queue.bytes += byte;
+    if (ctx->queue.backlog_max < byte)
+    {
+        ctx->queue.backlog_max = byte;
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+void termux_metrics_queue(termux_metrics_s *ctx, size_t queued)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->queue.queued = queued;
+    if (ctx->queue.queued_max < queued)
+    {
+        ctx->queue.queued_max = queued;
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+/* find or add a sensor under the mutex */
+static metrics_sensor_s *metrics_find(termux_metrics_s *ctx, const char *sensor)
+{
+    if (ctx->hit < ctx->sensors && strncmp(ctx->sensor[ctx->hit].metric.name, sensor, TERMUX_SENSOR_NAME - 1) == 0)
+    {
+        return ctx->sensor + ctx->hit;
+    }
+    for (int i = 0; i != ctx->sensors; ++i)
+    {
+        if (strncmp(ctx->sensor[i].metric.name, sensor, TERMUX_SENSOR_NAME - 1) == 0)
+        {
+            ctx->hit = i;
+            return ctx->sensor + i;
+        }
+    }
+    if (ctx->sensors == ctx->cap)
+    {
+        int cap = ctx->cap ? ctx->cap << 1 : 4;
+        metrics_sensor_s *p = (metrics_sensor_s *)realloc(ctx->sensor, sizeof(metrics_sensor_s) * (size_t)cap);
+        if (p == 0)
+        {
+            return 0;
+        }
+        ctx->sensor = p;
+        ctx->cap = cap;
+    }
+    metrics_sensor_s *s = ctx->sensor + ctx->sensors;
+    memset(s, 0, sizeof(metrics_sensor_s));
+    strncpy(s->metric.name, sensor, TERMUX_SENSOR_NAME - 1);
+    ctx->hit = ctx->sensors++;
+    return s;
+}
+
+static unsigned int metrics_bucket(uint64_t ns)
+{
+    unsigned int i = 0;
+    for (uint64_t us = ns / 1000; us && i != TERMUX_METRIC_BUCKETS - 1; us >>= 1)
+    {
+        ++i;
+    }
+    return i;
+}
+
+void termux_metrics_sample(termux_metrics_s *ctx, const char *sensor, uint64_t ns, uint64_t now, uint64_t parse)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    metrics_sensor_s *s = metrics_find(ctx, sensor);
+    if (s == 0)
+    {
+        pthread_mutex_unlock(&ctx->mutex);
+        return;
+    }
+    termux_metric_s *m = &s->metric;
+    if (now > ns)
+    {
+        uint64_t latency = now - ns;
+        ++m->stamped;
+        s->latency += latency;
+        m->latency_max = latency > m->latency_max ? latency : m->latency_max;
+    }
+    s->parse += parse;
+    m->parse_max = parse > m->parse_max ? parse : m->parse_max;
+    ++m->samples;
+    if (s->since++ && ns > s->last)
+    {
+        uint64_t dt = ns - s->last;
+        uint64_t mean = s->intervals ? s->interval / s->intervals : 0;
+        if (s->intervals >= METRICS_SETTLE && dt * 2 > mean * 3)
+        {
+            ++m->gaps;
+            m->dropped += (dt + mean / 2) / mean - 1;
+        }
+        else
+        {
+            if (s->intervals)
+            {
+                uint64_t jitter = dt > mean ? dt - mean : mean - dt;
+                s->jitter += jitter;
+                ++s->jitters;
+                m->jitter_max = jitter > m->jitter_max ? jitter : m->jitter_max;
+                ++m->jitter_hist[metrics_bucket(jitter)];
+            }
+            s->interval += dt;
+            ++s->intervals;
+        }
+    }
+    s->last = ns > s->last ? ns : s->last;
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+int termux_metrics_snapshot(termux_metrics_s *ctx, termux_queue_metric_s *queue, termux_metric_s *metric, int max)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    if (queue)
+    {
+        *queue = ctx->queue;
+        queue->backlog = queue->reads ? queue->bytes / queue->reads : 0;
+    }
+    for (int i = 0; i < ctx->sensors && i < max; ++i)
+    {
+        const metrics_sensor_s *s = ctx->sensor + i;
+        termux_metric_s *m = metric + i;
+        *m = s->metric;
+        m->latency = m->stamped ? s->latency / m->stamped : 0;
+        m->interval = s->intervals ? s->interval / s->intervals : 0;
+        m->jitter = s->jitters ? s->jitter / s->jitters : 0;
+        m->parse = m->samples ? s->parse / m->samples : 0;
+    }
+    int sensors = ctx->sensors;
+    pthread_mutex_unlock(&ctx->mutex);
+    return sensors;
+}
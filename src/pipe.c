@@ -278,7 +278,7 @@ int pipe_open3(pipe_s *ctx, const char *path, char *const argv[], char *const en
         goto open_rd;
     }
     ctx->er = fdopen(pipe_er[R], "r");
-    if (ctx->rd == 0)
+    if (ctx->er == 0)
     {
         goto open_er;
     }
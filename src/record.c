@@ -0,0 +1,435 @@
+/*!
+ @file record.c
+ @brief recordings of sensor samples in mapped files
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/record.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RECORD_MAGIC 0x63727874 /* "txrc" */
+#define RECORD_VERSION 1
+#define RECORD_HEAD 0x1000 /* the first block follows the header page */
+#define RECORD_GROW 0x100000 /* least growth of the file */
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief header of a recording, in the first page of the file
+ @details size is stored last when a block is appended, and count of a block after its sample,
+ so a recording cut short by a crash is still valid up to the last sample counted.
+*/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type; //!< bytes of a value
+    uint32_t block; //!< samples in a block
+    _Atomic uint32_t sensors;
+    uint32_t reserved;
+    _Atomic uint64_t size; //!< bytes used by the header and blocks
+    struct
+    {
+        char name[TERMUX_SENSOR_NAME];
+        uint32_t axes;
+        uint32_t reserved;
+    } sensor[TERMUX_RECORD_SENSORS];
+} record_head_s;
+
+/*!
+ @brief header of a block, followed by block times and block values of each axis
+*/
+typedef struct
+{
+    _Alignas(64) uint32_t sensor;
+    _Atomic uint32_t count; //!< samples written
+    uint64_t byte; //!< bytes of the block with its header
+} record_block_s;
+
+_Static_assert(sizeof(record_head_s) <= RECORD_HEAD, "header outgrows its page");
+
+struct termux_record_s
+{
+    unsigned char *map;
+    size_t cap; //!< bytes mapped
+    size_t used; //!< bytes of the header and blocks
+    size_t open[TERMUX_RECORD_SENSORS]; //!< offset of the block being filled for each sensor, 0 for none
+    uint64_t next; //!< time of the next flush, nanosecond
+    uint64_t sync; //!< nanosecond between two flushes
+    int last; //!< sensor of the last sample
+    int fd;
+};
+
+struct termux_recording_s
+{
+    const unsigned char *map;
+    size_t byte;
+    size_t *block; //!< offset of each block
+    size_t blocks;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static uint64_t record_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+termux_record_s *termux_record_open(const char *path, int type, size_t block, unsigned long sync)
+{
+    if ((type != TERMUX_RECORD_FLOAT && type != TERMUX_RECORD_DOUBLE) || block == 0 || block > 0x1000000)
+    {
+        errno = EINVAL;
+        return 0;
+    }
+    termux_record_s *ctx = (termux_record_s *)calloc(1, sizeof(termux_record_s));
+    if (ctx == 0)
+    {
+        return 0;
+    }
+    ctx->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (ctx->fd < 0)
+    {
+        goto open;
+    }
+    ctx->cap = RECORD_GROW;
+    if (ftruncate(ctx->fd, (off_t)ctx->cap) < 0)
+    {
+        goto map;
+    }
+    ctx->map = (unsigned char *)mmap(0, ctx->cap, PROT_READ | PROT_WRITE, MAP_SHARED, ctx->fd, 0);
+    if (ctx->map == MAP_FAILED)
+    {
+        goto map;
+    }
+    record_head_s *head = (record_head_s *)ctx->map;
+    head->magic = RECORD_MAGIC;
+    head->version = RECORD_VERSION;
+    head->type = (uint32_t)type;
+    head->block = (uint32_t)((block + 15) & ~(size_t)15);
+    ctx->used = RECORD_HEAD;
+    atomic_store_explicit(&head->size, ctx->used, memory_order_release);
+    ctx->sync = (uint64_t)sync * 1000000;
+    ctx->next = record_clock() + ctx->sync;
+    return ctx;
+
+map:
+    close(ctx->fd);
+    unlink(path);
+open:
+    free(ctx);
+    return 0;
+}
+
+/* find the sensor of a sample or add it to the header */
+static int record_find(termux_record_s *ctx, const char *sensor, int n)
+{
+    record_head_s *head = (record_head_s *)ctx->map;
+    int sensors = (int)atomic_load_explicit(&head->sensors, memory_order_relaxed);
+    if (ctx->last < sensors && strncmp(head->sensor[ctx->last].name, sensor, TERMUX_SENSOR_NAME - 1) == 0)
+    {
+        return ctx->last;
+    }
+    for (int i = 0; i != sensors; ++i)
+    {
+        if (strncmp(head->sensor[i].name, sensor, TERMUX_SENSOR_NAME - 1) == 0)
+        {
+            return ctx->last = i;
+        }
+    }
+    if (sensors == TERMUX_RECORD_SENSORS)
+    {
+        errno = ENOSPC;
+        return ~0;
+    }
+    strncpy(head->sensor[sensors].name, sensor, TERMUX_SENSOR_NAME - 1);
+    head->sensor[sensors].axes = (uint32_t)(n < 0 ? 0 : n > TERMUX_SAMPLE_MAX ? TERMUX_SAMPLE_MAX : n);
+    atomic_store_explicit(&head->sensors, (uint32_t)sensors + 1, memory_order_release);
+    return ctx->last = sensors;
+}
+
+/* append an empty block for a sensor, growing the file when it is full */
+static record_block_s *record_block(termux_record_s *ctx, int sensor)
+{
+    record_head_s *head = (record_head_s *)ctx->map;
+    size_t byte = sizeof(record_block_s) + (sizeof(uint64_t) + head->sensor[sensor].axes * head->type) * head->block;
+    if (ctx->used + byte > ctx->cap)
+    {
+        size_t cap = ctx->cap * 2;
+        while (cap < ctx->used + byte)
+        {
+            cap *= 2;
+        }
+        if (ftruncate(ctx->fd, (off_t)cap) < 0)
+        {
+            return 0;
+        }
+        void *map = mremap(ctx->map, ctx->cap, cap, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED)
+        {
+            return 0;
+        }
+        ctx->map = (unsigned char *)map;
+        ctx->cap = cap;
+        head = (record_head_s *)ctx->map;
+    }
+    record_block_s *block = (record_block_s *)(ctx->map + ctx->used);
+    block->sensor = (uint32_t)sensor;
+    block->byte = byte;
+    atomic_store_explicit(&block->count, 0, memory_order_relaxed);
+    ctx->open[sensor] = ctx->used;
+    ctx->used += byte;
+    atomic_store_explicit(&head->size, ctx->used, memory_order_release);
+    return block;
+}
+
+int termux_record(termux_record_s *ctx, const char *sensor, const double *values, int n, uint64_t ns)
+{
+    int i = record_find(ctx, sensor, n);
+    if (i < 0)
+    {
+        return ~0;
+    }
+    record_head_s *head = (record_head_s *)ctx->map;
+    record_block_s *block = (record_block_s *)(ctx->map + ctx->open[i]);
+    uint32_t count = ctx->open[i] ? atomic_load_explicit(&block->count, memory_order_relaxed) : head->block;
+    if (count == head->block)
+    {
+        block = record_block(ctx, i);
+        if (block == 0)
+        {
+            return ~0;
+        }
+        head = (record_head_s *)ctx->map;
+        count = 0;
+    }
+    uint32_t axes = head->sensor[i].axes;
+    uint32_t size = head->block;
+    uint64_t now = ns ? ns : record_clock();
+    ((uint64_t *)(block + 1))[count] = now;
+    unsigned char *column = (unsigned char *)(block + 1) + sizeof(uint64_t) * size;
+    if (head->type == TERMUX_RECORD_FLOAT)
+    {
+        float *value = (float *)column + count;
+        for (uint32_t axis = 0; axis != axes; ++axis, value += size)
+        {
+            *value = (int)axis < n ? (float)values[axis] : 0;
+        }
+    }
+    else
+    {
+        double *value = (double *)column + count;
+        for (uint32_t axis = 0; axis != axes; ++axis, value += size)
+        {
+            *value = (int)axis < n ? values[axis] : 0;
+        }
+    }
+    atomic_store_explicit(&block->count, count + 1, memory_order_release);
+    if (ctx->sync && (ns ? record_clock() : now) >= ctx->next)
+    {
+        return termux_record_sync(ctx);
+    }
+    return 0;
+}
+
+void termux_record_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    termux_record((termux_record_s *)arg, sensor, values, n, ns);
+}
+
+int termux_record_sync(termux_record_s *ctx)
+{
+    ctx->next = record_clock() + ctx->sync;
+    return fdatasync(ctx->fd) < 0 ? ~0 : 0;
+}
+
+int termux_record_close(termux_record_s *ctx)
+{
+    int ok = 0;
+    if (ctx == 0)
+    {
+        return ok;
+    }
+    munmap(ctx->map, ctx->cap);
+    if (ftruncate(ctx->fd, (off_t)ctx->used) < 0 || fdatasync(ctx->fd) < 0)
+    {
+        ok = ~0;
+    }
+    close(ctx->fd);
+    free(ctx);
+    return ok;
+}
+
+termux_recording_s *termux_recording_open(const char *path)
+{
+    termux_recording_s *ctx = (termux_recording_s *)calloc(1, sizeof(termux_recording_s));
+    if (ctx == 0)
+    {
+        return 0;
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        goto open;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        goto stat;
+    }
+    if ((size_t)st.st_size < RECORD_HEAD)
+    {
+        errno = EPROTO;
+        goto stat;
+    }
+    ctx->byte = (size_t)st.st_size;
+    ctx->map = (const unsigned char *)mmap(0, ctx->byte, PROT_READ, MAP_SHARED, fd, 0);
+    if (ctx->map == MAP_FAILED)
+    {
+        goto stat;
+    }
+    close(fd);
+    fd = ~0;
+    record_head_s *head = (record_head_s *)ctx->map;
+    uint64_t size = atomic_load_explicit(&head->size, memory_order_acquire);
+    if (head->magic != RECORD_MAGIC || head->version != RECORD_VERSION || size > ctx->byte || size < RECORD_HEAD ||
+        (head->type != TERMUX_RECORD_FLOAT && head->type != TERMUX_RECORD_DOUBLE) || head->sensors > TERMUX_RECORD_SENSORS)
+    {
+        errno = EPROTO;
+        goto head;
+    }
+    /* index the blocks, their values are left alone */
+    size_t cap = 0;
+    for (size_t off = RECORD_HEAD; off + sizeof(record_block_s) <= size;)
+    {
+        const record_block_s *block = (const record_block_s *)(ctx->map + off);
+        if (block->byte < sizeof(record_block_s) || block->byte > size - off || block->sensor >= head->sensors)
+        {
+            break;
+        }
+        if (ctx->blocks == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            size_t *p = (size_t *)realloc(ctx->block, sizeof(size_t) * cap);
+            if (p == 0)
+            {
+                goto head;
+            }
+            ctx->block = p;
+        }
+        ctx->block[ctx->blocks++] = off;
+        off += block->byte;
+    }
+    return ctx;
+
+head:
+    munmap((void *)ctx->map, ctx->byte);
+stat:
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+open:
+    free(ctx->block);
+    free(ctx);
+    return 0;
+}
+
+void termux_recording_close(termux_recording_s *ctx)
+{
+    if (ctx)
+    {
+        munmap((void *)ctx->map, ctx->byte);
+        free(ctx->block);
+        free(ctx);
+    }
+}
+
+int termux_recording_type(const termux_recording_s *ctx)
+{
+    return (int)((const record_head_s *)ctx->map)->type;
+}
+
+int termux_recording_sensors(const termux_recording_s *ctx)
+{
+    return (int)atomic_load(&((record_head_s *)ctx->map)->sensors);
+}
+
+const char *termux_recording_name(const termux_recording_s *ctx, int sensor)
+{
+    if (sensor < 0 || sensor >= termux_recording_sensors(ctx))
+    {
+        return 0;
+    }
+    return ((const record_head_s *)ctx->map)->sensor[sensor].name;
+}
+
+int termux_recording_axes(const termux_recording_s *ctx, int sensor)
+{
+    if (sensor < 0 || sensor >= termux_recording_sensors(ctx))
+    {
+        return 0;
+    }
+    return (int)((const record_head_s *)ctx->map)->sensor[sensor].axes;
+}
+
+size_t termux_recording_blocks(const termux_recording_s *ctx)
+{
+    return ctx->blocks;
+}
+
+size_t termux_recording_block(const termux_recording_s *ctx, size_t block, int *sensor)
+{
+    if (block >= ctx->blocks)
+    {
+        return 0;
+    }
+    record_block_s *p = (record_block_s *)(ctx->map + ctx->block[block]);
+    if (sensor)
+    {
+        *sensor = (int)p->sensor;
+    }
+    size_t count = atomic_load_explicit(&p->count, memory_order_acquire);
+    size_t size = ((const record_head_s *)ctx->map)->block;
+    return count < size ? count : size;
+}
+
+const uint64_t *termux_recording_ns(const termux_recording_s *ctx, size_t block)
+{
+    if (block >= ctx->blocks)
+    {
+        return 0;
+    }
+    return (const uint64_t *)((const record_block_s *)(ctx->map + ctx->block[block]) + 1);
+}
+
+const void *termux_recording_axis(const termux_recording_s *ctx, size_t block, int axis)
+{
+    if (block >= ctx->blocks)
+    {
+        return 0;
+    }
+    const record_head_s *head = (const record_head_s *)ctx->map;
+    const record_block_s *p = (const record_block_s *)(ctx->map + ctx->block[block]);
+    if (axis < 0 || (uint32_t)axis >= head->sensor[p->sensor].axes)
+    {
+        return 0;
+    }
+    const unsigned char *column = (const unsigned char *)(p + 1) + sizeof(uint64_t) * head->block;
+    return column + (size_t)axis * head->type * head->block;
+}
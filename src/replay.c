@@ -0,0 +1,481 @@
+/*!
+ @file replay.c
+ @brief replay of recorded sensors through the termux api
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/replay.h"
+
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <jansson.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief samples of a sensor in the order they were captured
+*/
+typedef struct
+{
+    char name[TERMUX_SENSOR_NAME];
+    int axes;
+    size_t n;
+    size_t cap;
+    uint64_t *ns;
+    double *values; //!< axes values for each sample
+} replay_sensor_s;
+
+/*!
+ @brief capture shared with the child processes, which inherit it from fork()
+*/
+static struct
+{
+    replay_sensor_s *sensor;
+    int sensors;
+    uint64_t start; //!< time of the first sample
+    uint64_t end; //!< time of the last sample
+    uint64_t w0; //!< time the replay started, nanosecond of CLOCK_MONOTONIC
+    double speed;
+    _Atomic uint64_t *cursor; //!< time of the last report at speed 0, shared by all processes
+} replay;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static uint64_t replay_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void replay_free(void)
+{
+    for (int i = 0; i != replay.sensors; ++i)
+    {
+        free(replay.sensor[i].ns);
+        free(replay.sensor[i].values);
+    }
+    free(replay.sensor);
+    replay.sensor = 0;
+    replay.sensors = 0;
+    if (replay.cursor)
+    {
+        munmap((void *)replay.cursor, sizeof(*replay.cursor));
+        replay.cursor = 0;
+    }
+}
+
+static replay_sensor_s *replay_sensor(const char *name, int axes)
+{
+    for (int i = 0; i != replay.sensors; ++i)
+    {
+        if (strcmp(replay.sensor[i].name, name) == 0)
+        {
+            return replay.sensor + i;
+        }
+    }
+    replay_sensor_s *sensor = (replay_sensor_s *)realloc(replay.sensor, sizeof(replay_sensor_s) * (size_t)(replay.sensors + 1));
+    if (sensor == 0)
+    {
+        return 0;
+    }
+    replay.sensor = sensor;
+    sensor += replay.sensors++;
+    memset(sensor, 0, sizeof(*sensor));
+    snprintf(sensor->name, sizeof(sensor->name), "%s", name);
+    sensor->axes = axes < 0 ? 0 : axes > TERMUX_SAMPLE_MAX ? TERMUX_SAMPLE_MAX : axes;
+    return sensor;
+}
+
+/* make room for n more samples */
+static int replay_reserve(replay_sensor_s *ctx, size_t n)
+{
+    if (ctx->n + n <= ctx->cap)
+    {
+        return 0;
+    }
+    size_t cap = ctx->cap ? ctx->cap : 64;
+    while (cap < ctx->n + n)
+    {
+        cap *= 2;
+    }
+    uint64_t *ns = (uint64_t *)realloc(ctx->ns, sizeof(uint64_t) * cap);
+    if (ns == 0)
+    {
+        return ~0;
+    }
+    ctx->ns = ns;
+    double *values = (double *)realloc(ctx->values, sizeof(double) * cap * (size_t)(ctx->axes ? ctx->axes : 1));
+    if (values == 0)
+    {
+        return ~0;
+    }
+    ctx->values = values;
+    ctx->cap = cap;
+    return 0;
+}
+
+static int replay_recording(termux_recording_s *recording)
+{
+    int type = termux_recording_type(recording);
+    for (size_t b = 0; b != termux_recording_blocks(recording); ++b)
+    {
+        int index = 0;
+        size_t n = termux_recording_block(recording, b, &index);
+        replay_sensor_s *sensor = replay_sensor(termux_recording_name(recording, index), termux_recording_axes(recording, index));
+        if (sensor == 0 || replay_reserve(sensor, n))
+        {
+            return ~0;
+        }
+        memcpy(sensor->ns + sensor->n, termux_recording_ns(recording, b), sizeof(uint64_t) * n);
+        for (int axis = 0; axis != sensor->axes; ++axis)
+        {
+            const void *column = termux_recording_axis(recording, b, axis);
+            double *value = sensor->values + sensor->n * (size_t)sensor->axes + axis;
+            for (size_t i = 0; i != n; ++i, value += sensor->axes)
+            {
+                *value = type == TERMUX_RECORD_FLOAT ? ((const float *)column)[i] : ((const double *)column)[i];
+            }
+        }
+        sensor->n += n;
+    }
+    return 0;
+}
+
+static int replay_transcript(const char *path, unsigned long period)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == 0)
+    {
+        return ~0;
+    }
+    char *text = 0;
+    size_t byte = 0;
+    for (size_t cap = 0;;)
+    {
+        if (byte == cap)
+        {
+            cap = cap ? cap * 2 : 0x10000;
+            char *p = (char *)realloc(text, cap);
+            if (p == 0)
+            {
+                break;
+            }
+            text = p;
+        }
+        size_t n = fread(text + byte, 1, cap - byte, file);
+        if (n == 0)
+        {
+            break;
+        }
+        byte += n;
+    }
+    fclose(file);
+    int ok = 0;
+    /* the time 0 is before the first report */
+    uint64_t ns = (uint64_t)period * 1000000;
+    for (size_t off = 0; off != byte; ns += (uint64_t)period * 1000000)
+    {
+        while (off != byte && strchr(" \t\r\n", text[off]))
+        {
+            ++off;
+        }
+        if (off == byte)
+        {
+            break;
+        }
+        json_error_t error;
+        json_t *root = json_loadb(text + off, byte - off, JSON_DISABLE_EOF_CHECK, &error);
+        if (root == 0)
+        {
+            break;
+        }
+        off += (size_t)error.position;
+        const char *key;
+        json_t *value;
+        json_object_foreach(root, key, value)
+        {
+            json_t *array = json_object_get(value, "values");
+            replay_sensor_s *sensor = replay_sensor(key, (int)json_array_size(array));
+            if (sensor == 0 || replay_reserve(sensor, 1))
+            {
+                ok = ~0;
+                break;
+            }
+            sensor->ns[sensor->n] = ns;
+            for (int axis = 0; axis != sensor->axes; ++axis)
+            {
+                json_t *item = json_array_get(array, (size_t)axis);
+                sensor->values[sensor->n * (size_t)sensor->axes + (size_t)axis] = json_is_number(item) ? json_number_value(item) : 0;
+            }
+            ++sensor->n;
+        }
+        json_decref(root);
+    }
+    free(text);
+    return ok;
+}
+
+/* index of the last sample not after t, or of the first sample */
+static size_t replay_find(const replay_sensor_s *ctx, uint64_t t)
+{
+    size_t lo = 0, hi = ctx->n;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ctx->ns[mid] <= t)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo ? lo - 1 : 0;
+}
+
+/* time of the report after t, 0 after the last */
+static uint64_t replay_next(const replay_sensor_s *lead, uint64_t t, uint64_t delay)
+{
+    if (t < lead->ns[0])
+    {
+        return lead->ns[0];
+    }
+    size_t i = replay_find(lead, t) + 1;
+    if (i == lead->n)
+    {
+        return 0;
+    }
+    uint64_t next = lead->ns[i];
+    if (next < t + delay)
+    {
+        next = t + delay <= lead->ns[lead->n - 1] ? t + delay : 0;
+    }
+    return next;
+}
+
+static void replay_report(FILE *out, replay_sensor_s **sensor, int n, uint64_t t)
+{
+    fputc('{', out);
+    for (int i = 0; i != n; ++i)
+    {
+        const replay_sensor_s *ctx = sensor[i];
+        const double *values = ctx->values + replay_find(ctx, t) * (size_t)ctx->axes;
+        fprintf(out, "%s\"%s\":{\"values\":[", i ? "," : "", ctx->name);
+        for (int axis = 0; axis != ctx->axes; ++axis)
+        {
+            fprintf(out, axis ? ",%.17g" : "%.17g", values[axis]);
+        }
+        fputs("]}", out);
+    }
+    fputs("}\n", out);
+    fflush(out);
+}
+
+static const char *replay_arg(int argc, char *argv[], const char *key)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (argv[i] && strcmp(argv[i], key) == 0)
+        {
+            return argv[i + 1];
+        }
+    }
+    return 0;
+}
+
+/* value of an extra such as --es key value */
+static const char *replay_extra(int argc, char *argv[], const char *key)
+{
+    for (int i = 1; i + 2 < argc; ++i)
+    {
+        if (argv[i] && strncmp(argv[i], "--e", 3) == 0 && strcmp(argv[i + 1], key) == 0)
+        {
+            return argv[i + 2];
+        }
+    }
+    return 0;
+}
+
+/* stands in for the service in the child process */
+static int replay_backend(int argc, char *argv[])
+{
+    if (argc < 2 || strcmp(argv[1], "Sensor") != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    /* stdout may hold output of the parent not flushed before fork() */
+    FILE *out = fdopen(STDOUT_FILENO, "w");
+    if (out == 0)
+    {
+        return EXIT_FAILURE;
+    }
+    const char *action = replay_arg(argc, argv, "-a");
+    if (action && strcmp(action, "list") == 0)
+    {
+        fputs("{\"sensors\":[", out);
+        for (int i = 0; i != replay.sensors; ++i)
+        {
+            fprintf(out, i ? ",\"%s\"" : "\"%s\"", replay.sensor[i].name);
+        }
+        fputs("]}\n", out);
+        fflush(out);
+        return EXIT_SUCCESS;
+    }
+    if (action == 0 || strcmp(action, "sensors") != 0)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    /* the service matches the names asked for as parts of sensor names */
+    replay_sensor_s *sensor[TERMUX_SAMPLE_MAX];
+    int n = 0;
+    const char *names = replay_extra(argc, argv, "sensors");
+    char buf[0x400];
+    snprintf(buf, sizeof(buf), "%s", names ? names : "");
+    for (char *save = 0, *name = strtok_r(buf, ",", &save); name && n != TERMUX_SAMPLE_MAX; name = strtok_r(0, ",", &save))
+    {
+        for (int i = 0; i != replay.sensors; ++i)
+        {
+            if (replay.sensor[i].n && strcasestr(replay.sensor[i].name, name))
+            {
+                sensor[n++] = replay.sensor + i;
+                break;
+            }
+        }
+    }
+    if (n == 0)
+    {
+        fputs("{}\n", out);
+        fflush(out);
+        return EXIT_SUCCESS;
+    }
+    const char *limit = replay_extra(argc, argv, "limit");
+    const char *delay = replay_extra(argc, argv, "delay");
+    long reports = limit ? atol(limit) : -1;
+    uint64_t step = delay ? (uint64_t)atol(delay) * 1000000 : 0;
+
+    uint64_t t;
+    if (replay.speed > 0)
+    {
+        t = replay.start + (uint64_t)((double)(replay_clock() - replay.w0) * replay.speed);
+    }
+    else
+    {
+        uint64_t last = atomic_load(replay.cursor);
+        do
+        {
+            t = replay_next(sensor[0], last, step);
+        } while (t && !atomic_compare_exchange_weak(replay.cursor, &last, t));
+        if (t == 0)
+        {
+            t = replay.end;
+        }
+    }
+    for (;;)
+    {
+        if (replay.speed > 0)
+        {
+            uint64_t w = replay.w0 + (uint64_t)((double)(t - replay.start) / replay.speed);
+            uint64_t now = replay_clock();
+            if (w > now)
+            {
+                struct timespec ts = {(time_t)((w - now) / 1000000000), (long)((w - now) % 1000000000)};
+                nanosleep(&ts, 0);
+            }
+        }
+        replay_report(out, sensor, n, t);
+        if (reports > 0 && --reports == 0)
+        {
+            break;
+        }
+        uint64_t last = t;
+        t = replay_next(sensor[0], last, step);
+        if (t == 0)
+        {
+            break;
+        }
+        if (replay.speed <= 0)
+        {
+            /* other readers may have moved the capture on meanwhile */
+            uint64_t cursor = atomic_load(replay.cursor);
+            while (cursor < t && !atomic_compare_exchange_weak(replay.cursor, &cursor, t))
+            {
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int termux_replay(const char *path, double speed, unsigned long period)
+{
+    if (!(speed >= 0) || period == 0)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    termux_backend(0);
+    replay_free();
+    termux_recording_s *recording = termux_recording_open(path);
+    int ok = recording ? replay_recording(recording) : replay_transcript(path, period);
+    termux_recording_close(recording);
+    replay.start = UINT64_MAX;
+    replay.end = 0;
+    for (int i = 0; i != replay.sensors; ++i)
+    {
+        replay_sensor_s *sensor = replay.sensor + i;
+        if (sensor->n && sensor->ns[0] < replay.start)
+        {
+            replay.start = sensor->ns[0];
+        }
+        if (sensor->n && sensor->ns[sensor->n - 1] > replay.end)
+        {
+            replay.end = sensor->ns[sensor->n - 1];
+        }
+    }
+    if (ok == 0 && replay.start > replay.end)
+    {
+        errno = EPROTO;
+        ok = ~0;
+    }
+    if (ok == 0)
+    {
+        void *cursor = mmap(0, sizeof(*replay.cursor), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (cursor == MAP_FAILED)
+        {
+            ok = ~0;
+        }
+        else
+        {
+            replay.cursor = (_Atomic uint64_t *)cursor;
+            /* the first report is the first sample */
+            atomic_init(replay.cursor, 0);
+        }
+    }
+    if (ok)
+    {
+        replay_free();
+        return ~0;
+    }
+    replay.speed = speed;
+    replay.w0 = replay_clock();
+    termux_backend(replay_backend);
+    return 0;
+}
+
+void termux_replay_stop(void)
+{
+    termux_backend(0);
+    replay_free();
+}
@@ -0,0 +1,443 @@
+/*!
+ @file rule.c
+ @brief rules over the values of sensors evaluated for each sample
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/rule.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define RULE_NORM TERMUX_SAMPLE_MAX /* axis of the length of all values */
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*
+ every comparison is turned into sign * x > on to become active and sign * x < off to become inactive,
+ <= and >= by moving the threshold to the double below it.
+*/
+typedef struct rule_hot_s
+{
+    double sign;
+    double on;
+    double off;
+    uint64_t hold; //!< time a change has to hold, nanosecond
+    uint64_t since; //!< time the change began to hold, 0 if none
+    int axis;
+    int active;
+    int rule;
+} rule_hot_s;
+
+/* rules of a sensor, evaluated one after another */
+typedef struct rule_group_s
+{
+    char want[TERMUX_SENSOR_NAME]; //!< name in the rules
+    char name[TERMUX_SENSOR_NAME]; //!< full name of the samples, empty before the first
+    int bound; //!< name is no longer a candidate
+    rule_hot_s *hot;
+    int count;
+    int cap;
+    int axes; //!< values the rules read, RULE_NORM + 1 if one reads the norm
+} rule_group_s;
+
+typedef struct rule_s
+{
+    int group;
+    int slot;
+    void (*fire)(int rule, int active, double value, uint64_t ns, void *arg);
+    void *arg;
+    termux_call_s *action;
+    termux_call_s run;
+    int running;
+    termux_rule_stat_s stat;
+} rule_s;
+
+struct termux_rules_s
+{
+    rule_s *rule;
+    int rules;
+    int rules_cap;
+    rule_group_s *group;
+    int groups;
+    int groups_cap;
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static uint64_t rule_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+termux_rules_s *termux_rules_new(void)
+{
+    return (termux_rules_s *)calloc(1, sizeof(termux_rules_s));
+}
+
+void termux_rules_free(termux_rules_s *ctx)
+{
+    if (ctx == 0)
+    {
+        return;
+    }
+    for (int i = 0; i != ctx->rules; ++i)
+    {
+        if (ctx->rule[i].running)
+        {
+            termux_call_finish(&ctx->rule[i].run);
+        }
+        free(ctx->rule[i].action);
+    }
+    for (int i = 0; i != ctx->groups; ++i)
+    {
+        free(ctx->group[i].hot);
+    }
+    free(ctx->group);
+    free(ctx->rule);
+    free(ctx);
+}
+
+static const char *rule_space(const char *p)
+{
+    while (isspace((unsigned char)*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+/* sensor[axis] op value [hyst h] [for ms] */
+static int rule_parse(const char *text, char *sensor, rule_hot_s *hot)
+{
+    const char *p = rule_space(text), *q = strchr(p, '[');
+    if (q == 0)
+    {
+        return ~0;
+    }
+    size_t len = (size_t)(q - p);
+    while (len && isspace((unsigned char)p[len - 1]))
+    {
+        --len;
+    }
+    if (len == 0 || len >= TERMUX_SENSOR_NAME)
+    {
+        return ~0;
+    }
+    memcpy(sensor, p, len);
+    sensor[len] = 0;
+    p = rule_space(q + 1);
+    char *end;
+    if (strncmp(p, "norm", 4) == 0)
+    {
+        hot->axis = RULE_NORM;
+        end = (char *)p + 4;
+    }
+    else
+    {
+        long axis = strtol(p, &end, 10);
+        if (end == p || axis < 0 || axis >= TERMUX_SAMPLE_MAX)
+        {
+            return ~0;
+        }
+        hot->axis = (int)axis;
+    }
+    p = rule_space(end);
+    if (*p++ != ']')
+    {
+        return ~0;
+    }
+    p = rule_space(p);
+    int less = *p == '<';
+    if (*p != '<' && *p != '>')
+    {
+        return ~0;
+    }
+    int equal = p[1] == '=';
+    p += 1 + equal;
+    double value = strtod(p, &end);
+    if (end == p || !isfinite(value))
+    {
+        return ~0;
+    }
+    double hyst = 0, ms = 0;
+    for (p = rule_space(end); *p; p = rule_space(end))
+    {
+        double *option = strncmp(p, "hyst", 4) == 0 ? &hyst : strncmp(p, "for", 3) == 0 ? &ms : 0;
+        if (option == 0)
+        {
+            return ~0;
+        }
+        p += option == &hyst ? 4 : 3;
+        *option = strtod(p, &end);
+        if (end == p || !(*option >= 0) || !isfinite(*option))
+        {
+            return ~0;
+        }
+    }
+    hot->sign = less ? -1 : 1;
+    hot->off = hot->sign * value - hyst;
+    hot->on = equal ? nextafter(hot->sign * value, -INFINITY) : hot->sign * value;
+    hot->hold = (uint64_t)(ms * 1e6);
+    hot->since = 0;
+    hot->active = 0;
+    return 0;
+}
+
+int termux_rule_add(termux_rules_s *ctx, const char *rule,
+                    void (*fire)(int rule, int active, double value, uint64_t ns, void *arg), void *arg)
+{
+    char sensor[TERMUX_SENSOR_NAME];
+    rule_hot_s hot;
+    if (rule_parse(rule, sensor, &hot) != 0)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    int g = 0;
+    while (g != ctx->groups && strcmp(ctx->group[g].want, sensor) != 0)
+    {
+        ++g;
+    }
+    if (g == ctx->groups && ctx->groups == ctx->groups_cap)
+    {
+        int cap = ctx->groups_cap ? ctx->groups_cap << 1 : 4;
+        rule_group_s *group = (rule_group_s *)realloc(ctx->group, sizeof(rule_group_s) * (size_t)cap);
+        if (group == 0)
+        {
+            return ~0;
+        }
+        ctx->group = group;
+        ctx->groups_cap = cap;
+    }
+    if (ctx->rules == ctx->rules_cap)
+    {
+        int cap = ctx->rules_cap ? ctx->rules_cap << 1 : 16;
+        rule_s *rules = (rule_s *)realloc(ctx->rule, sizeof(rule_s) * (size_t)cap);
+        if (rules == 0)
+        {
+            return ~0;
+        }
+        ctx->rule = rules;
+        ctx->rules_cap = cap;
+    }
+    if (g == ctx->groups)
+    {
+        rule_group_s *group = ctx->group + ctx->groups++;
+        memset(group, 0, sizeof(rule_group_s));
+        strcpy(group->want, sensor);
+    }
+    rule_group_s *group = ctx->group + g;
+    if (group->count == group->cap)
+    {
+        int cap = group->cap ? group->cap << 1 : 8;
+        rule_hot_s *h = (rule_hot_s *)realloc(group->hot, sizeof(rule_hot_s) * (size_t)cap);
+        if (h == 0)
+        {
+            return ~0;
+        }
+        group->hot = h;
+        group->cap = cap;
+    }
+    int i = ctx->rules++;
+    hot.rule = i;
+    group->hot[group->count] = hot;
+    group->axes = hot.axis + 1 > group->axes ? hot.axis + 1 : group->axes;
+    rule_s *r = ctx->rule + i;
+    memset(r, 0, sizeof(rule_s));
+    r->group = g;
+    r->slot = group->count++;
+    r->fire = fire;
+    r->arg = arg;
+    return i;
+}
+
+int termux_rule_action(termux_rules_s *ctx, int rule, const termux_call_s *call)
+{
+    if (rule < 0 || rule >= ctx->rules)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    rule_s *r = ctx->rule + rule;
+    if (call == 0)
+    {
+        free(r->action);
+        r->action = 0;
+        return 0;
+    }
+    if (r->action == 0)
+    {
+        r->action = (termux_call_s *)malloc(sizeof(termux_call_s));
+        if (r->action == 0)
+        {
+            return ~0;
+        }
+    }
+    *r->action = *call;
+    return 0;
+}
+
+/* finish the action of a rule once its call ended or passed its deadline, return 1 while it runs */
+static int rule_reap(rule_s *r)
+{
+    if (r->running && (termux_call_read(&r->run) != 0 || termux_call_left(&r->run) == 0))
+    {
+        r->running = 0;
+        r->stat.failed += termux_call_finish(&r->run) != 0;
+    }
+    return r->running;
+}
+
+static void rule_change(termux_rules_s *ctx, int i, int active, double value, uint64_t ns)
+{
+    rule_s *r = ctx->rule + i;
+    ++*(active ? &r->stat.rises : &r->stat.falls);
+    if (r->fire)
+    {
+        r->fire(i, active, value, ns, r->arg);
+    }
+    if (!active || r->action == 0)
+    {
+        return;
+    }
+    if (rule_reap(r))
+    {
+        ++r->stat.busy;
+        return;
+    }
+    r->run = *r->action;
+    if (termux_call_start(&r->run) != 0)
+    {
+        ++r->stat.failed;
+        return;
+    }
+    r->running = 1;
+    ++r->stat.actions;
+}
+
+/* the name in the rules is taken at once, else the first name that contains it once it comes again and a whole report had no exact name */
+static int rule_match(rule_group_s *group, const char *sensor)
+{
+    if (group->bound)
+    {
+        return strncmp(group->name, sensor, TERMUX_SENSOR_NAME - 1) == 0;
+    }
+    if (strcasecmp(sensor, group->want) == 0)
+    {
+        strncpy(group->name, sensor, TERMUX_SENSOR_NAME - 1);
+        group->bound = 1;
+        return 1;
+    }
+    if (group->name[0] == 0)
+    {
+        if (strcasestr(sensor, group->want))
+        {
+            strncpy(group->name, sensor, TERMUX_SENSOR_NAME - 1);
+        }
+        return 0;
+    }
+    group->bound = strncmp(group->name, sensor, TERMUX_SENSOR_NAME - 1) == 0;
+    return group->bound;
+}
+
+int termux_rules_eval(termux_rules_s *ctx, const char *sensor, const double *values, int n, uint64_t ns)
+{
+    int changed = 0;
+    if (ns == 0)
+    {
+        ns = rule_clock();
+    }
+    for (int g = 0; g != ctx->groups; ++g)
+    {
+        rule_group_s *group = ctx->group + g;
+        if (!rule_match(group, sensor))
+        {
+            continue;
+        }
+        /* axes the sample does not have compare false both ways, so their rules stay as they are */
+        double x[RULE_NORM + 1];
+        int a = 0;
+        for (; a != n && a != TERMUX_SAMPLE_MAX && a != group->axes; ++a)
+        {
+            x[a] = values[a];
+        }
+        for (; a < group->axes; ++a)
+        {
+            x[a] = NAN;
+        }
+        if (group->axes > RULE_NORM)
+        {
+            double s = 0;
+            for (int i = 0; i < n && i != TERMUX_SAMPLE_MAX; ++i)
+            {
+                s += values[i] * values[i];
+            }
+            x[RULE_NORM] = sqrt(s);
+        }
+        rule_hot_s *hot = group->hot;
+        for (int i = 0; i != group->count; ++i, ++hot)
+        {
+            double y = hot->sign * x[hot->axis];
+            int want = hot->active ? !(y < hot->off) : y > hot->on;
+            if (want == hot->active)
+            {
+                hot->since = 0;
+                continue;
+            }
+            if (hot->since == 0)
+            {
+                hot->since = ns;
+            }
+            if (ns - hot->since < hot->hold)
+            {
+                continue;
+            }
+            hot->active = want;
+            hot->since = 0;
+            ++changed;
+            rule_change(ctx, hot->rule, want, x[hot->axis], ns);
+        }
+    }
+    return changed;
+}
+
+void termux_rules_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    termux_rules_eval((termux_rules_s *)arg, sensor, values, n, ns);
+}
+
+int termux_rules_poll(termux_rules_s *ctx)
+{
+    int running = 0;
+    for (int i = 0; i != ctx->rules; ++i)
+    {
+        running += rule_reap(ctx->rule + i);
+    }
+    return running;
+}
+
+int termux_rule_stat(const termux_rules_s *ctx, int rule, termux_rule_stat_s *stat)
+{
+    if (rule < 0 || rule >= ctx->rules)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    const rule_s *r = ctx->rule + rule;
+    *stat = r->stat;
+    stat->active = ctx->group[r->group].hot[r->slot].active;
+    return 0;
+}
@@ -0,0 +1,1392 @@
+/*!
+ @file sensor.c
+ @brief termux api sensor streams shared by processes
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/sensor.h"
+#include "termux/metrics.h"
+
+#include <time.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define SENSOR_BUS 0x7362 /* "bs" */
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief statistics of a reader thread, written by the thread only
+*/
+typedef struct
+{
+    _Atomic uint64_t reports;
+    _Atomic uint64_t late;
+    _Atomic uint64_t missed;
+    _Atomic uint64_t jitter; //!< sum over the intervals
+    _Atomic uint64_t jitter_max;
+    _Atomic uint64_t intervals;
+    _Atomic unsigned int applied;
+    uint64_t period; //!< the delay, nanosecond
+    uint64_t read; //!< time the last sample was read, 0 before the first of a stream
+    uint64_t ns; //!< time of the last sample
+} reader_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static termux_reader_s reader_options;
+static pthread_mutex_t reader_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void termux_reader_config(const termux_reader_s *options)
+{
+    static const termux_reader_s none;
+    pthread_mutex_lock(&reader_mutex);
+    reader_options = options ? *options : none;
+    pthread_mutex_unlock(&reader_mutex);
+}
+
+/* give the calling thread the options, reader may be 0 */
+static void reader_apply(reader_s *reader, termux_stream_s *stream)
+{
+    unsigned int applied = 0;
+    pthread_mutex_lock(&reader_mutex);
+    termux_reader_s options = reader_options;
+    pthread_mutex_unlock(&reader_mutex);
+    if (options.cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned int i = 0; i != sizeof(options.cpus) * 8 && i != CPU_SETSIZE; ++i)
+        {
+            if (options.cpus >> i & 1)
+            {
+                CPU_SET(i, &set);
+            }
+        }
+        applied |= sched_setaffinity(0, sizeof(set), &set) == 0 ? TERMUX_READER_AFFINITY : 0U;
+    }
+    if (options.policy == TERMUX_READER_FIFO)
+    {
+        struct sched_param param;
+        int lo = sched_get_priority_min(SCHED_FIFO), hi = sched_get_priority_max(SCHED_FIFO);
+        param.sched_priority = options.priority < lo ? lo : options.priority > hi ? hi : options.priority;
+        applied |= pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0 ? TERMUX_READER_PRIORITY : 0U;
+    }
+    else if (options.priority)
+    {
+        /* the nice value of a linux thread is its own */
+        id_t tid = (id_t)syscall(SYS_gettid);
+        applied |= setpriority(PRIO_PROCESS, tid, options.priority) == 0 ? TERMUX_READER_PRIORITY : 0U;
+    }
+    if (stream && (options.buffer || options.lock) && termux_stream_buffer(stream, options.buffer, 0) == 0)
+    {
+        applied |= options.buffer ? TERMUX_READER_BUFFER : 0U;
+        applied |= options.lock && termux_stream_buffer(stream, 0, 1) == 0 ? TERMUX_READER_LOCKED : 0U;
+    }
+    if (reader)
+    {
+        reader->read = 0;
+        atomic_store(&reader->applied, applied);
+    }
+}
+
+static void reader_add(_Atomic uint64_t *x, uint64_t v)
+{
+    atomic_store_explicit(x, atomic_load_explicit(x, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+/* count a sample of time ns read at now, all of one sensor, since the samples of a report are read together */
+static void reader_tick(reader_s *ctx, uint64_t ns, uint64_t now)
+{
+    reader_add(&ctx->reports, 1);
+    if (ctx->read && ctx->period)
+    {
+        uint64_t dt = now - ctx->read;
+        uint64_t jitter = dt > ctx->period ? dt - ctx->period : ctx->period - dt;
+        reader_add(&ctx->jitter, jitter);
+        reader_add(&ctx->intervals, 1);
+        if (atomic_load_explicit(&ctx->jitter_max, memory_order_relaxed) < jitter)
+        {
+            atomic_store_explicit(&ctx->jitter_max, jitter, memory_order_relaxed);
+        }
+        reader_add(&ctx->late, dt * 2 > ctx->period * 3);
+        dt = ns > ctx->ns ? ns - ctx->ns : 0;
+        if (dt * 2 > ctx->period * 3)
+        {
+            reader_add(&ctx->missed, (dt + ctx->period / 2) / ctx->period - 1);
+        }
+    }
+    ctx->read = now;
+    ctx->ns = ns;
+}
+
+static void reader_stat(reader_s *ctx, termux_reader_stat_s *stat)
+{
+    uint64_t intervals = atomic_load(&ctx->intervals);
+    stat->reports = atomic_load(&ctx->reports);
+    stat->late = atomic_load(&ctx->late);
+    stat->missed = atomic_load(&ctx->missed);
+    stat->jitter = intervals ? atomic_load(&ctx->jitter) / intervals : 0;
+    stat->jitter_max = atomic_load(&ctx->jitter_max);
+    stat->applied = atomic_load(&ctx->applied);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief adaptive delay of a stream, weighed by its thread and read by any
+*/
+typedef struct
+{
+    pthread_mutex_t mutex;
+    termux_adapt_s adapt;
+    int on;
+    int delay; //!< delay of the running stream
+    unsigned int longer; //!< windows in a row that called for a longer delay
+    unsigned int shorter; //!< windows in a row that called for a shorter delay
+    uint64_t end; //!< time the window ends, 0 to start one
+    uint64_t count[4]; //!< samples, lost samples, reads and starved reads at the start of the window
+    termux_adapt_stat_s stat;
+    termux_adapt_event_s log[TERMUX_ADAPT_LOG];
+} adapt_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static void adapt_init(adapt_s *ctx, int delay)
+{
+    memset(ctx, 0, sizeof(adapt_s));
+    pthread_mutex_init(&ctx->mutex, 0);
+    ctx->delay = delay;
+}
+
+static void adapt_exit(adapt_s *ctx)
+{
+    pthread_mutex_destroy(&ctx->mutex);
+}
+
+static int adapt_set(adapt_s *ctx, const termux_adapt_s *adapt)
+{
+    if (adapt && (adapt->delay_min < 0 || adapt->delay_min > adapt->delay_max || adapt->window == 0 ||
+                  !(adapt->coarse > 0 && adapt->coarse <= 1) || !(adapt->fine > 0 && adapt->fine <= 1)))
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->on = adapt != 0;
+    if (adapt)
+    {
+        ctx->adapt = *adapt;
+    }
+    ctx->longer = 0;
+    ctx->shorter = 0;
+    ctx->end = 0;
+    pthread_mutex_unlock(&ctx->mutex);
+    return 0;
+}
+
+/* start the next window from the counts of the next weighing, as those so far span a stream that stopped */
+static void adapt_begin(adapt_s *ctx)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->end = 0;
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+/* weigh the window once it ended, return 1 with the decision if the delay is to change */
+static int adapt_tick(adapt_s *ctx, uint64_t now, const uint64_t *count, int behind, termux_adapt_event_s *event)
+{
+    int change = 0;
+    pthread_mutex_lock(&ctx->mutex);
+    const termux_adapt_s *adapt = &ctx->adapt;
+    if (!ctx->on || (ctx->end && now < ctx->end))
+    {
+        pthread_mutex_unlock(&ctx->mutex);
+        return 0;
+    }
+    uint64_t samples = count[0] - ctx->count[0], lost = count[1] - ctx->count[1];
+    uint64_t reads = count[2] - ctx->count[2], starved = count[3] - ctx->count[3];
+    int weigh = ctx->end != 0;
+    ctx->end = now + (uint64_t)adapt->window * 1000000;
+    memcpy(ctx->count, count, sizeof(ctx->count));
+    if (!weigh)
+    {
+        pthread_mutex_unlock(&ctx->mutex);
+        return 0;
+    }
+    ++ctx->stat.windows;
+    event->ns = now;
+    event->from = ctx->delay;
+    event->to = ctx->delay;
+    event->failed = 0;
+    event->lost = samples ? (lost < samples ? (double)lost / (double)samples : 1) : 0;
+    event->starved = reads ? (double)starved / (double)reads : 0;
+    int lo = adapt->delay_min, hi = adapt->delay_max, d = ctx->delay;
+    unsigned int hold = adapt->hold ? adapt->hold : 1;
+    if (behind || event->lost > adapt->coarse)
+    {
+        ++ctx->longer;
+        ctx->shorter = 0;
+    }
+    else if (event->starved > adapt->fine)
+    {
+        ++ctx->shorter;
+        ctx->longer = 0;
+    }
+    else
+    {
+        ctx->longer = 0;
+        ctx->shorter = 0;
+    }
+    if (d < lo || d > hi)
+    {
+        event->to = d < lo ? lo : hi;
+    }
+    else if (ctx->longer >= hold && d < hi)
+    {
+        event->to = d == 0 ? 1 : d > hi / 2 ? hi : d * 2;
+    }
+    else if (ctx->shorter >= hold && d > lo)
+    {
+        event->to = d / 2 < lo ? lo : d / 2;
+    }
+    change = event->to != d;
+    pthread_mutex_unlock(&ctx->mutex);
+    return change;
+}
+
+/* log a decision once the stream was started again or not */
+static void adapt_log(adapt_s *ctx, const termux_adapt_event_s *event)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->log[ctx->stat.events++ % TERMUX_ADAPT_LOG] = *event;
+    if (event->failed)
+    {
+        ++ctx->stat.failed;
+    }
+    else
+    {
+        ++*(event->to > event->from ? &ctx->stat.coarser : &ctx->stat.finer);
+        ctx->delay = event->to;
+    }
+    ctx->longer = 0;
+    ctx->shorter = 0;
+    ctx->end = 0;
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+/* ms until the window ends, -1 if the delay does not adapt */
+static int adapt_wait(adapt_s *ctx, uint64_t now)
+{
+    int ms = -1;
+    pthread_mutex_lock(&ctx->mutex);
+    if (ctx->on)
+    {
+        ms = ctx->end > now ? (int)((ctx->end - now) / 1000000) + 1 : 0;
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+    return ms;
+}
+
+static int adapt_stat(adapt_s *ctx, termux_adapt_stat_s *stat, termux_adapt_event_s *event, int max)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    *stat = ctx->stat;
+    stat->delay = ctx->delay;
+    stat->on = ctx->on;
+    int n = stat->events < TERMUX_ADAPT_LOG ? (int)stat->events : TERMUX_ADAPT_LOG;
+    n = event == 0 || max < 0 ? 0 : max < n ? max : n;
+    for (int i = 0; i != n; ++i)
+    {
+        event[i] = ctx->log[(stat->events - (uint64_t)n + (uint64_t)i) % TERMUX_ADAPT_LOG];
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+    return n;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief slot of a sensor, on its own cache lines
+ @details seq is odd while the publisher writes the sample, a reader copies the sample
+ and tries again if seq was odd or changed meanwhile.
+*/
+typedef struct
+{
+    _Alignas(64) _Atomic uint32_t seq;
+    char name[TERMUX_SENSOR_NAME];
+    termux_sample_s sample;
+} bus_slot_s;
+
+/*!
+ @brief layout of the file of a bus
+*/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t size;
+    _Atomic uint32_t count; //!< slots in use, a slot is named before it is counted
+    bus_slot_s slot[TERMUX_BUS_MAX];
+} bus_map_s;
+
+struct termux_bus_s
+{
+    bus_map_s *map;
+    termux_stream_s *stream; //!< 0 for a reader
+    pthread_t thread;
+    int stop; //!< eventfd that stops the thread
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static void bus_path(char *path, size_t size, const char *name)
+{
+    char const *dir = getenv("TMPDIR");
+    snprintf(path, size, "%s/termux-api.%u.bus.%s", dir ? dir : "/tmp", (unsigned int)getuid(), name);
+}
+
+static bus_map_s *bus_map(const char *name, int publish)
+{
+    char path[PATH_MAX];
+    bus_path(path, sizeof(path), name);
+    int fd = open(path, publish ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (publish && (size_t)st.st_size < sizeof(bus_map_s) && ftruncate(fd, sizeof(bus_map_s)) < 0))
+    {
+        close(fd);
+        return 0;
+    }
+    if (!publish && (size_t)st.st_size < sizeof(bus_map_s))
+    {
+        close(fd);
+        errno = EPROTO;
+        return 0;
+    }
+    bus_map_s *map = (bus_map_s *)mmap(0, sizeof(bus_map_s), publish ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return 0;
+    }
+    if (publish)
+    {
+        /* readers of an earlier publisher see the slots emptied */
+        atomic_store(&map->count, 0);
+        for (int i = 0; i != TERMUX_BUS_MAX; ++i)
+        {
+            atomic_store(&map->slot[i].seq, 0);
+        }
+        map->size = sizeof(bus_map_s);
+        map->magic = SENSOR_BUS;
+    }
+    else if (map->magic != SENSOR_BUS || map->size != sizeof(bus_map_s))
+    {
+        munmap(map, sizeof(bus_map_s));
+        errno = EPROTO;
+        return 0;
+    }
+    return map;
+}
+
+static void bus_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    bus_map_s *map = (bus_map_s *)arg;
+    uint32_t count = atomic_load_explicit(&map->count, memory_order_relaxed);
+    uint32_t i = 0;
+    for (; i != count; ++i)
+    {
+        if (strncmp(map->slot[i].name, sensor, TERMUX_SENSOR_NAME - 1) == 0)
+        {
+            break;
+        }
+    }
+    if (i == count)
+    {
+        if (count == TERMUX_BUS_MAX)
+        {
+            return;
+        }
+        snprintf(map->slot[i].name, TERMUX_SENSOR_NAME, "%s", sensor);
+        atomic_store_explicit(&map->count, count + 1, memory_order_release);
+    }
+    bus_slot_s *slot = map->slot + i;
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->sample.ns = ns;
+    slot->sample.seq += 1;
+    slot->sample.n = n;
+    memcpy(slot->sample.values, values, sizeof(double) * (size_t)n);
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+static void *bus_publish(void *arg)
+{
+    termux_bus_s *ctx = (termux_bus_s *)arg;
+    reader_apply(0, ctx->stream);
+    struct pollfd fds[2] = {
+        {.fd = termux_stream_fd(ctx->stream), .events = POLLIN},
+        {.fd = ctx->stop, .events = POLLIN},
+    };
+    for (;;)
+    {
+        if (termux_stream_read(ctx->stream, bus_sample, ctx->map) < 0)
+        {
+            break;
+        }
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (fds[1].revents)
+        {
+            break;
+        }
+    }
+    return 0;
+}
+
+termux_bus_s *termux_bus_publish(const char *name, const char *sensors, int delay)
+{
+    termux_bus_s *ctx = (termux_bus_s *)calloc(1, sizeof(termux_bus_s));
+    if (ctx == 0)
+    {
+        return 0;
+    }
+    ctx->map = bus_map(name, 1);
+    if (ctx->map == 0)
+    {
+        goto map;
+    }
+    ctx->stop = eventfd(0, EFD_CLOEXEC);
+    if (ctx->stop < 0)
+    {
+        goto stop;
+    }
+    ctx->stream = termux_stream_open(sensors, delay);
+    if (ctx->stream == 0)
+    {
+        goto stream;
+    }
+    if (pthread_create(&ctx->thread, 0, bus_publish, ctx))
+    {
+        goto thread;
+    }
+    return ctx;
+
+thread:
+    termux_stream_close(ctx->stream);
+stream:
+    close(ctx->stop);
+stop:
+    munmap(ctx->map, sizeof(bus_map_s));
+map:
+    free(ctx);
+    return 0;
+}
+
+termux_bus_s *termux_bus_open(const char *name)
+{
+    termux_bus_s *ctx = (termux_bus_s *)calloc(1, sizeof(termux_bus_s));
+    if (ctx)
+    {
+        ctx->map = bus_map(name, 0);
+        if (ctx->map == 0)
+        {
+            free(ctx);
+            ctx = 0;
+        }
+    }
+    return ctx;
+}
+
+void termux_bus_close(termux_bus_s *ctx)
+{
+    if (ctx == 0)
+    {
+        return;
+    }
+    if (ctx->stream)
+    {
+        uint64_t one = 1;
+        (void)!write(ctx->stop, &one, sizeof(one));
+        pthread_join(ctx->thread, 0);
+        termux_stream_close(ctx->stream);
+        close(ctx->stop);
+    }
+    munmap(ctx->map, sizeof(bus_map_s));
+    free(ctx);
+}
+
+int termux_bus_find(const termux_bus_s *ctx, const char *sensor)
+{
+    uint32_t count = atomic_load_explicit(&ctx->map->count, memory_order_acquire);
+    for (uint32_t i = 0; i != count && i != TERMUX_BUS_MAX; ++i)
+    {
+        if (strncmp(ctx->map->slot[i].name, sensor, TERMUX_SENSOR_NAME - 1) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return ~0;
+}
+
+const char *termux_bus_name(const termux_bus_s *ctx, int slot)
+{
+    if (slot < 0 || (uint32_t)slot >= atomic_load_explicit(&ctx->map->count, memory_order_acquire))
+    {
+        return 0;
+    }
+    return ctx->map->slot[slot].name;
+}
+
+int termux_bus_read(const termux_bus_s *ctx, int slot, termux_sample_s *sample)
+{
+    if (slot < 0 || slot >= TERMUX_BUS_MAX)
+    {
+        return ~0;
+    }
+    bus_slot_s *from = ctx->map->slot + slot;
+    for (;;)
+    {
+        uint32_t seq = atomic_load_explicit(&from->seq, memory_order_acquire);
+        if (seq == 0)
+        {
+            return ~0;
+        }
+        if (seq & 1)
+        {
+            continue;
+        }
+        sample->ns = from->sample.ns;
+        sample->seq = from->sample.seq;
+        int n = from->sample.n;
+        sample->n = n < 0 || n > TERMUX_SAMPLE_MAX ? 0 : n;
+        memcpy(sample->values, from->sample.values, sizeof(double) * (size_t)sample->n);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&from->seq, memory_order_relaxed) == seq)
+        {
+            return 0;
+        }
+    }
+}
+
+#define SENSOR_FRESH 4U /* the middle buffer holds a sample not yet read */
+#define SENSOR_SWITCH 2000 /* longest time the old stream is read while a new one starts, millisecond */
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+/*!
+ @brief handle on a sensor, a triple buffer between the thread of its stream and its readers
+ @details the thread fills back and swaps it with middle, a reader swaps front with middle only if it is fresh,
+ so neither side ever waits for the other. readers take turns on the mutex, which the thread never takes.
+*/
+struct termux_sensor_s
+{
+    termux_sample_s buf[3];
+    _Atomic unsigned int middle; //!< index of the middle buffer, with SENSOR_FRESH
+    unsigned int back; //!< index written by the thread
+    unsigned int front; //!< index read under the mutex
+    int ready; //!< front holds a sample
+    _Atomic uint64_t seen; //!< time of the last read, nanosecond
+    atomic_int running;
+    _Atomic uint64_t reads; //!< reads so far
+    _Atomic uint64_t starved; //!< reads without a new sample
+    uint64_t lost; //!< samples replaced before they were read
+    reader_s reader;
+    adapt_s adapt;
+    termux_metrics_s *metrics;
+    termux_stream_s *stream;
+    pthread_mutex_t mutex;
+    pthread_t thread;
+    int joinable;
+    int stop; //!< eventfd that stops the thread
+    int delay;
+    unsigned long idle;
+    uint64_t seq;
+    char *sensor;
+    char name[TERMUX_SENSOR_NAME]; //!< full name of the samples taken, empty before the first
+    int bound; //!< name is no longer a candidate
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static uint64_t sensor_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* the name asked for is taken at once, else the first name that contains it once it comes again and a whole report had no exact name */
+static int sensor_bind(char *name, int *bound, const char *want, const char *sensor)
+{
+    if (*bound)
+    {
+        return strncmp(name, sensor, TERMUX_SENSOR_NAME - 1) == 0;
+    }
+    if (strcasecmp(sensor, want) == 0)
+    {
+        strncpy(name, sensor, TERMUX_SENSOR_NAME - 1);
+        *bound = 1;
+        return 1;
+    }
+    if (name[0] == 0)
+    {
+        if (strcasestr(sensor, want))
+        {
+            strncpy(name, sensor, TERMUX_SENSOR_NAME - 1);
+        }
+        return 0;
+    }
+    *bound = strncmp(name, sensor, TERMUX_SENSOR_NAME - 1) == 0;
+    return *bound;
+}
+
+/* start a stream again with another delay, the old one is read until the new one reports, 0 if it did not start */
+static termux_stream_s *sensor_switch(termux_stream_s *old, const char *sensor, int delay, int stop, reader_s *reader,
+                                      termux_metrics_s *metrics, void (*sample)(const char *, const double *, int, uint64_t, void *), void *arg)
+{
+    termux_stream_s *stream = termux_stream_open(sensor, delay);
+    if (stream == 0)
+    {
+        return 0;
+    }
+    struct pollfd fds[3] = {
+        {.fd = termux_stream_fd(stream), .events = POLLIN},
+        {.fd = stop, .events = POLLIN},
+        {.fd = termux_stream_fd(old), .events = POLLIN},
+    };
+    uint64_t end = sensor_clock() + (uint64_t)SENSOR_SWITCH * 1000000;
+    for (uint64_t now = sensor_clock(); now < end; now = sensor_clock())
+    {
+        if (poll(fds, 3, (int)((end - now) / 1000000) + 1) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (fds[0].revents || fds[1].revents)
+        {
+            break;
+        }
+        if (fds[2].revents && termux_stream_read(old, sample, arg) < 0)
+        {
+            break;
+        }
+    }
+    termux_stream_close(old);
+    termux_stream_metrics(stream, metrics);
+    reader->period = (uint64_t)delay * 1000000;
+    reader_apply(reader, stream);
+    return stream;
+}
+
+static void sensor_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    termux_sensor_s *ctx = (termux_sensor_s *)arg;
+    termux_sample_s *sample = ctx->buf + ctx->back;
+    if (!sensor_bind(ctx->name, &ctx->bound, ctx->sensor, sensor))
+    {
+        return;
+    }
+    reader_tick(&ctx->reader, ns, sensor_clock());
+    sample->ns = ns;
+    sample->seq = ++ctx->seq;
+    sample->n = n;
+    memcpy(sample->values, values, sizeof(double) * (size_t)n);
+    unsigned int middle = atomic_exchange(&ctx->middle, ctx->back | SENSOR_FRESH);
+    ctx->lost += (middle & SENSOR_FRESH) != 0;
+    ctx->back = middle & ~SENSOR_FRESH;
+}
+
+/* weigh the adaptive delay, return the ms until it is weighed again or -1 */
+static int sensor_adapt(termux_sensor_s *ctx, uint64_t now)
+{
+    termux_adapt_event_s event;
+    uint64_t count[4] = {
+        ctx->seq,
+        ctx->lost + atomic_load_explicit(&ctx->reader.missed, memory_order_relaxed),
+        atomic_load(&ctx->reads),
+        atomic_load(&ctx->starved),
+    };
+    if (adapt_tick(&ctx->adapt, now, count, 0, &event))
+    {
+        termux_stream_s *stream = sensor_switch(ctx->stream, ctx->sensor, event.to, ctx->stop, &ctx->reader,
+                                                ctx->metrics, sensor_sample, ctx);
+        if (stream)
+        {
+            ctx->stream = stream;
+            ctx->delay = event.to;
+        }
+        event.failed = stream == 0;
+        adapt_log(&ctx->adapt, &event);
+    }
+    return adapt_wait(&ctx->adapt, now);
+}
+
+static void *sensor_run(void *arg)
+{
+    termux_sensor_s *ctx = (termux_sensor_s *)arg;
+    reader_apply(&ctx->reader, ctx->stream);
+    adapt_begin(&ctx->adapt);
+    struct pollfd fds[2] = {
+        {.fd = termux_stream_fd(ctx->stream), .events = POLLIN},
+        {.fd = ctx->stop, .events = POLLIN},
+    };
+    for (;;)
+    {
+        if (termux_stream_read(ctx->stream, sensor_sample, ctx) < 0)
+        {
+            break;
+        }
+        uint64_t now = sensor_clock();
+        int ms = sensor_adapt(ctx, now);
+        if (ctx->idle)
+        {
+            uint64_t end = atomic_load(&ctx->seen) + (uint64_t)ctx->idle * 1000000;
+            if (now >= end)
+            {
+                break;
+            }
+            int idle = (int)((end - now) / 1000000) + 1;
+            ms = ms < 0 || idle < ms ? idle : ms;
+        }
+        fds[0].fd = termux_stream_fd(ctx->stream);
+        if (poll(fds, 2, ms) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (fds[1].revents)
+        {
+            break;
+        }
+    }
+    termux_stream_close(ctx->stream);
+    ctx->stream = 0;
+    atomic_store(&ctx->running, 0);
+    return 0;
+}
+
+/* start the stream under the mutex */
+static int sensor_start(termux_sensor_s *ctx)
+{
+    if (ctx->joinable)
+    {
+        pthread_join(ctx->thread, 0);
+        ctx->joinable = 0;
+    }
+    atomic_store(&ctx->seen, sensor_clock());
+    ctx->stream = termux_stream_open(ctx->sensor, ctx->delay);
+    if (ctx->stream == 0)
+    {
+        return ~0;
+    }
+    termux_stream_metrics(ctx->stream, ctx->metrics);
+    atomic_store(&ctx->running, 1);
+    if (pthread_create(&ctx->thread, 0, sensor_run, ctx))
+    {
+        atomic_store(&ctx->running, 0);
+        termux_stream_close(ctx->stream);
+        ctx->stream = 0;
+        return ~0;
+    }
+    ctx->joinable = 1;
+    return 0;
+}
+
+termux_sensor_s *termux_sensor_open(const char *sensor, int delay, unsigned long idle)
+{
+    termux_sensor_s *ctx = (termux_sensor_s *)calloc(1, sizeof(termux_sensor_s));
+    if (ctx == 0)
+    {
+        return 0;
+    }
+    ctx->sensor = strdup(sensor);
+    if (ctx->sensor == 0)
+    {
+        goto sensor;
+    }
+    ctx->metrics = termux_metrics_new();
+    if (ctx->metrics == 0)
+    {
+        goto metrics;
+    }
+    ctx->stop = eventfd(0, EFD_CLOEXEC);
+    if (ctx->stop < 0)
+    {
+        goto stop;
+    }
+    atomic_init(&ctx->middle, 1);
+    ctx->back = 2;
+    ctx->delay = delay;
+    ctx->idle = idle;
+    ctx->reader.period = (uint64_t)(delay > 0 ? delay : 0) * 1000000;
+    adapt_init(&ctx->adapt, delay);
+    pthread_mutex_init(&ctx->mutex, 0);
+    if (sensor_start(ctx))
+    {
+        goto start;
+    }
+    return ctx;
+
+start:
+    pthread_mutex_destroy(&ctx->mutex);
+    adapt_exit(&ctx->adapt);
+    close(ctx->stop);
+stop:
+    termux_metrics_free(ctx->metrics);
+metrics:
+    free(ctx->sensor);
+sensor:
+    free(ctx);
+    return 0;
+}
+
+int termux_sensor_latest(termux_sensor_s *ctx, termux_sample_s *sample, uint64_t *age)
+{
+    pthread_mutex_lock(&ctx->mutex);
+    atomic_store(&ctx->seen, sensor_clock());
+    if (!atomic_load(&ctx->running))
+    {
+        sensor_start(ctx);
+    }
+    atomic_fetch_add_explicit(&ctx->reads, 1, memory_order_relaxed);
+    if (atomic_load(&ctx->middle) & SENSOR_FRESH)
+    {
+        ctx->front = atomic_exchange(&ctx->middle, ctx->front) & ~SENSOR_FRESH;
+        ctx->ready = 1;
+    }
+    else
+    {
+        atomic_fetch_add_explicit(&ctx->starved, 1, memory_order_relaxed);
+    }
+    if (!ctx->ready)
+    {
+        pthread_mutex_unlock(&ctx->mutex);
+        errno = EAGAIN;
+        return ~0;
+    }
+    *sample = ctx->buf[ctx->front];
+    pthread_mutex_unlock(&ctx->mutex);
+    if (age)
+    {
+        uint64_t now = sensor_clock();
+        *age = now > sample->ns ? now - sample->ns : 0;
+    }
+    return sample->n;
+}
+
+int termux_sensor_running(termux_sensor_s *ctx)
+{
+    return atomic_load(&ctx->running);
+}
+
+void termux_sensor_reader(termux_sensor_s *ctx, termux_reader_stat_s *stat)
+{
+    reader_stat(&ctx->reader, stat);
+}
+
+termux_metrics_s *termux_sensor_metrics(termux_sensor_s *ctx)
+{
+    return ctx->metrics;
+}
+
+int termux_sensor_adapt(termux_sensor_s *ctx, const termux_adapt_s *adapt)
+{
+    return adapt_set(&ctx->adapt, adapt);
+}
+
+int termux_sensor_adapt_stat(termux_sensor_s *ctx, termux_adapt_stat_s *stat, termux_adapt_event_s *event, int max)
+{
+    return adapt_stat(&ctx->adapt, stat, event, max);
+}
+
+void termux_sensor_close(termux_sensor_s *ctx)
+{
+    if (ctx == 0)
+    {
+        return;
+    }
+    uint64_t one = 1;
+    (void)!write(ctx->stop, &one, sizeof(one));
+    if (ctx->joinable)
+    {
+        pthread_join(ctx->thread, 0);
+    }
+    pthread_mutex_destroy(&ctx->mutex);
+    adapt_exit(&ctx->adapt);
+    close(ctx->stop);
+    termux_metrics_free(ctx->metrics);
+    free(ctx->sensor);
+    free(ctx);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+typedef struct fanout_s fanout_s;
+
+/*!
+ @brief subscriber with a ring of samples, head is written by the stream and tail read by the subscriber
+*/
+struct termux_sub_s
+{
+    termux_sub_s *next;
+    fanout_s *fanout;
+    termux_sample_s *ring;
+    size_t depth;
+    uint64_t head;
+    uint64_t tail;
+    termux_sub_stat_s stat;
+    pthread_cond_t cond;
+    int overflow;
+    int locked; //!< ring is locked in memory
+};
+
+/*!
+ @brief stream shared by the subscribers of a sensor and delay
+*/
+struct fanout_s
+{
+    fanout_s *next;
+    termux_sub_s *sub;
+    termux_stream_s *stream;
+    reader_s reader;
+    adapt_s adapt;
+    termux_metrics_s *metrics;
+    pthread_mutex_t mutex; //!< guards the subscribers and their rings, and the counts below
+    uint64_t dropped; //!< samples dropped from full rings
+    uint64_t nexts; //!< calls of termux_sub_next()
+    uint64_t waits; //!< calls that found their ring empty
+    pthread_t thread;
+    unsigned int count; //!< subscribers, guarded by fanout_mutex
+    uint64_t seq;
+    int ended;
+    int listed; //!< in fanout_list, guarded by fanout_mutex
+    int stop;
+    int delay; //!< delay of the running stream, guarded by fanout_mutex
+    char *sensor;
+    char name[TERMUX_SENSOR_NAME]; //!< full name of the samples taken, empty before the first
+    int bound; //!< name is no longer a candidate
+};
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+static fanout_s *fanout_list;
+static pthread_mutex_t fanout_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void fanout_sample(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    fanout_s *ctx = (fanout_s *)arg;
+    if (!sensor_bind(ctx->name, &ctx->bound, ctx->sensor, sensor))
+    {
+        return;
+    }
+    reader_tick(&ctx->reader, ns, sensor_clock());
+    ++ctx->seq;
+    size_t queued = 0;
+    pthread_mutex_lock(&ctx->mutex);
+    for (termux_sub_s *sub = ctx->sub; sub; sub = sub->next)
+    {
+        if (sub->head - sub->tail == sub->depth)
+        {
+            ++sub->stat.dropped;
+            ++ctx->dropped;
+            if (sub->overflow == TERMUX_OVERFLOW_NEWEST)
+            {
+                continue;
+            }
+            ++sub->tail;
+        }
+        termux_sample_s *sample = sub->ring + sub->head % sub->depth;
+        sample->ns = ns;
+        sample->seq = ctx->seq;
+        sample->n = n;
+        memcpy(sample->values, values, sizeof(double) * (size_t)n);
+        ++sub->head;
+        ++sub->stat.delivered;
+        size_t lag = (size_t)(sub->head - sub->tail);
+        if (sub->stat.lag_max < lag)
+        {
+            sub->stat.lag_max = lag;
+        }
+        queued = lag > queued ? lag : queued;
+        pthread_cond_signal(&sub->cond);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+    termux_metrics_queue(ctx->metrics, queued);
+}
+
+/* weigh the adaptive delay, return the ms until it is weighed again or -1 */
+static int fanout_adapt(fanout_s *ctx)
+{
+    termux_adapt_event_s event;
+    uint64_t now = sensor_clock(), count[4];
+    int behind = 0;
+    pthread_mutex_lock(&ctx->mutex);
+    count[0] = ctx->seq;
+    count[1] = ctx->dropped + atomic_load_explicit(&ctx->reader.missed, memory_order_relaxed);
+    count[2] = ctx->nexts;
+    count[3] = ctx->waits;
+    for (termux_sub_s *sub = ctx->sub; sub; sub = sub->next)
+    {
+        behind |= (sub->head - sub->tail) * 2 > sub->depth;
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+    if (adapt_tick(&ctx->adapt, now, count, behind, &event))
+    {
+        termux_stream_s *stream = sensor_switch(ctx->stream, ctx->sensor, event.to, ctx->stop, &ctx->reader,
+                                                ctx->metrics, fanout_sample, ctx);
+        if (stream)
+        {
+            ctx->stream = stream;
+            /* fanout_get() hands the stream to the subscribers of its delay */
+            pthread_mutex_lock(&fanout_mutex);
+            ctx->delay = event.to;
+            pthread_mutex_unlock(&fanout_mutex);
+        }
+        event.failed = stream == 0;
+        adapt_log(&ctx->adapt, &event);
+    }
+    return adapt_wait(&ctx->adapt, now);
+}
+
+static void *fanout_run(void *arg)
+{
+    fanout_s *ctx = (fanout_s *)arg;
+    reader_apply(&ctx->reader, ctx->stream);
+    struct pollfd fds[2] = {
+        {.fd = termux_stream_fd(ctx->stream), .events = POLLIN},
+        {.fd = ctx->stop, .events = POLLIN},
+    };
+    for (;;)
+    {
+        if (termux_stream_read(ctx->stream, fanout_sample, ctx) < 0)
+        {
+            break;
+        }
+        int ms = fanout_adapt(ctx);
+        fds[0].fd = termux_stream_fd(ctx->stream);
+        if (poll(fds, 2, ms) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (fds[1].revents)
+        {
+            break;
+        }
+    }
+    pthread_mutex_lock(&ctx->mutex);
+    ctx->ended = 1;
+    for (termux_sub_s *sub = ctx->sub; sub; sub = sub->next)
+    {
+        pthread_cond_signal(&sub->cond);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+    return 0;
+}
+
+static void fanout_free(fanout_s *ctx)
+{
+    if (ctx->stream)
+    {
+        termux_stream_close(ctx->stream);
+    }
+    if (ctx->stop >= 0)
+    {
+        close(ctx->stop);
+    }
+    pthread_mutex_destroy(&ctx->mutex);
+    adapt_exit(&ctx->adapt);
+    termux_metrics_free(ctx->metrics);
+    free(ctx->sensor);
+    free(ctx);
+}
+
+/* add a subscriber to a stream under fanout_mutex */
+static void fanout_link(fanout_s *ctx, termux_sub_s *sub)
+{
+    ++ctx->count;
+    sub->fanout = ctx;
+    pthread_mutex_lock(&ctx->mutex);
+    sub->next = ctx->sub;
+    ctx->sub = sub;
+    pthread_mutex_unlock(&ctx->mutex);
+}
+
+/* find or start the stream of a sensor and delay and link the subscriber under fanout_mutex, streams that ended are left to their subscribers */
+static fanout_s *fanout_get(const char *sensor, int delay, termux_sub_s *sub)
+{
+    fanout_s *ctx, **node = &fanout_list;
+    while ((ctx = *node) != 0)
+    {
+        pthread_mutex_lock(&ctx->mutex);
+        int ended = ctx->ended;
+        pthread_mutex_unlock(&ctx->mutex);
+        if (ended)
+        {
+            *node = ctx->next;
+            ctx->listed = 0;
+            continue;
+        }
+        if (ctx->delay == delay && strcmp(ctx->sensor, sensor) == 0)
+        {
+            fanout_link(ctx, sub);
+            return ctx;
+        }
+        node = &ctx->next;
+    }
+    ctx = (fanout_s *)calloc(1, sizeof(fanout_s));
+    if (ctx == 0)
+    {
+        return 0;
+    }
+    pthread_mutex_init(&ctx->mutex, 0);
+    adapt_init(&ctx->adapt, delay);
+    ctx->delay = delay;
+    ctx->reader.period = (uint64_t)(delay > 0 ? delay : 0) * 1000000;
+    ctx->sensor = strdup(sensor);
+    ctx->metrics = termux_metrics_new();
+    ctx->stop = eventfd(0, EFD_CLOEXEC);
+    if (ctx->sensor == 0 || ctx->metrics == 0 || ctx->stop < 0)
+    {
+        goto fail;
+    }
+    ctx->stream = termux_stream_open(sensor, delay);
+    if (ctx->stream == 0)
+    {
+        goto fail;
+    }
+    termux_stream_metrics(ctx->stream, ctx->metrics);
+    /* the first reports go to the subscriber that started the stream */
+    fanout_link(ctx, sub);
+    if (pthread_create(&ctx->thread, 0, fanout_run, ctx))
+    {
+        goto fail;
+    }
+    ctx->next = fanout_list;
+    fanout_list = ctx;
+    ctx->listed = 1;
+    return ctx;
+
+fail:
+    fanout_free(ctx);
+    return 0;
+}
+
+termux_sub_s *termux_subscribe(const char *sensor, int delay, size_t depth, int overflow)
+{
+    if (sensor == 0 || depth == 0 || (overflow != TERMUX_OVERFLOW_OLDEST && overflow != TERMUX_OVERFLOW_NEWEST))
+    {
+        errno = EINVAL;
+        return 0;
+    }
+    termux_sub_s *ctx = (termux_sub_s *)calloc(1, sizeof(termux_sub_s));
+    if (ctx == 0)
+    {
+        return 0;
+    }
+    ctx->ring = (termux_sample_s *)malloc(sizeof(termux_sample_s) * depth);
+    if (ctx->ring == 0)
+    {
+        free(ctx);
+        return 0;
+    }
+    ctx->depth = depth;
+    ctx->overflow = overflow;
+    pthread_mutex_lock(&reader_mutex);
+    int lock = reader_options.lock;
+    pthread_mutex_unlock(&reader_mutex);
+    if (lock)
+    {
+        /* the stream thread must not fault on the ring while it holds the mutex of the subscribers */
+        memset(ctx->ring, 0, sizeof(termux_sample_s) * depth);
+        ctx->locked = mlock(ctx->ring, sizeof(termux_sample_s) * depth) == 0;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ctx->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_mutex_lock(&fanout_mutex);
+    fanout_s *fanout = fanout_get(sensor, delay, ctx);
+    pthread_mutex_unlock(&fanout_mutex);
+    if (fanout == 0)
+    {
+        pthread_cond_destroy(&ctx->cond);
+        if (ctx->locked)
+        {
+            munlock(ctx->ring, sizeof(termux_sample_s) * depth);
+        }
+        free(ctx->ring);
+        free(ctx);
+        return 0;
+    }
+    return ctx;
+}
+
+int termux_sub_next(termux_sub_s *ctx, termux_sample_s *sample, long ms)
+{
+    fanout_s *fanout = ctx->fanout;
+    struct timespec ts;
+    if (ms > 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += ms / 1000;
+        ts.tv_nsec += ms % 1000 * 1000000;
+        if (ts.tv_nsec >= 1000000000)
+        {
+            ts.tv_nsec -= 1000000000;
+            ++ts.tv_sec;
+        }
+    }
+    pthread_mutex_lock(&fanout->mutex);
+    ++fanout->nexts;
+    fanout->waits += ctx->head == ctx->tail;
+    while (ctx->head == ctx->tail)
+    {
+        if (fanout->ended)
+        {
+            pthread_mutex_unlock(&fanout->mutex);
+            errno = EPIPE;
+            return ~0;
+        }
+        if (ms == 0 || (ms > 0 && pthread_cond_timedwait(&ctx->cond, &fanout->mutex, &ts) == ETIMEDOUT))
+        {
+            if (ctx->head != ctx->tail)
+            {
+                break;
+            }
+            pthread_mutex_unlock(&fanout->mutex);
+            errno = ETIMEDOUT;
+            return ~0;
+        }
+        if (ms < 0)
+        {
+            pthread_cond_wait(&ctx->cond, &fanout->mutex);
+        }
+    }
+    *sample = ctx->ring[ctx->tail++ % ctx->depth];
+    ++ctx->stat.taken;
+    uint64_t now = sensor_clock();
+    ctx->stat.age = now > sample->ns ? now - sample->ns : 0;
+    pthread_mutex_unlock(&fanout->mutex);
+    return sample->n;
+}
+
+void termux_sub_stat(termux_sub_s *ctx, termux_sub_stat_s *stat)
+{
+    fanout_s *fanout = ctx->fanout;
+    pthread_mutex_lock(&fanout_mutex);
+    pthread_mutex_lock(&fanout->mutex);
+    *stat = ctx->stat;
+    stat->lag = (size_t)(ctx->head - ctx->tail);
+    stat->subscribers = fanout->count;
+    pthread_mutex_unlock(&fanout->mutex);
+    pthread_mutex_unlock(&fanout_mutex);
+}
+
+void termux_sub_reader(termux_sub_s *ctx, termux_reader_stat_s *stat)
+{
+    reader_stat(&ctx->fanout->reader, stat);
+}
+
+termux_metrics_s *termux_sub_metrics(termux_sub_s *ctx)
+{
+    return ctx->fanout->metrics;
+}
+
+int termux_sub_adapt(termux_sub_s *ctx, const termux_adapt_s *adapt)
+{
+    return adapt_set(&ctx->fanout->adapt, adapt);
+}
+
+int termux_sub_adapt_stat(termux_sub_s *ctx, termux_adapt_stat_s *stat, termux_adapt_event_s *event, int max)
+{
+    return adapt_stat(&ctx->fanout->adapt, stat, event, max);
+}
+
+void termux_unsubscribe(termux_sub_s *ctx)
+{
+    if (ctx == 0)
+    {
+        return;
+    }
+    fanout_s *fanout = ctx->fanout;
+    pthread_mutex_lock(&fanout_mutex);
+    pthread_mutex_lock(&fanout->mutex);
+    termux_sub_s **sub = &fanout->sub;
+    while (*sub != ctx)
+    {
+        sub = &(*sub)->next;
+    }
+    *sub = ctx->next;
+    pthread_mutex_unlock(&fanout->mutex);
+    int last = --fanout->count == 0;
+    if (last && fanout->listed)
+    {
+        fanout_s **node = &fanout_list;
+        while (*node != fanout)
+        {
+            node = &(*node)->next;
+        }
+        *node = fanout->next;
+    }
+    pthread_mutex_unlock(&fanout_mutex);
+    if (last)
+    {
+        uint64_t one = 1;
+        (void)!write(fanout->stop, &one, sizeof(one));
+        pthread_join(fanout->thread, 0);
+        fanout_free(fanout);
+    }
+    pthread_cond_destroy(&ctx->cond);
+    if (ctx->locked)
+    {
+        munlock(ctx->ring, sizeof(termux_sample_s) * ctx->depth);
+    }
+    free(ctx->ring);
+    free(ctx);
+}
@@ -0,0 +1,282 @@
+/*!
+ @file setter.c
+ @brief setters that keep only the newest value
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/setter.h"
+#include "termux/call.h"
+
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpadded"
+#endif /* __GNUC__ || __clang__ */
+
+typedef struct
+{
+    termux_setter_s stat;
+    uint64_t next; //!< earliest time of the next call, millisecond
+    int value; //!< newest value
+    int applied; //!< stat.value was applied
+} setter_s;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ || __clang__ */
+
+enum
+{
+    SETTER_IDLE,
+    SETTER_RUN,
+    SETTER_STOP
+};
+
+static setter_s setter[TERMUX_SETTER_MAX];
+static pthread_mutex_t setter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t setter_idle = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t setter_wake;
+static pthread_t setter_thread;
+static unsigned long setter_interval;
+static int setter_state = SETTER_IDLE;
+static int setter_busy; /* a value is being applied */
+static void (*setter_applied)(int, int, int, void *);
+static void *setter_arg;
+
+static char *const setter_stream[TERMUX_SETTER_MAX] = {
+    [TERMUX_SETTER_VOLUME_CALL] = "call",
+    [TERMUX_SETTER_VOLUME_SYSTEM] = "system",
+    [TERMUX_SETTER_VOLUME_RING] = "ring",
+    [TERMUX_SETTER_VOLUME_MUSIC] = "music",
+    [TERMUX_SETTER_VOLUME_ALARM] = "alarm",
+    [TERMUX_SETTER_VOLUME_NOTICE] = "notification",
+};
+
+static uint64_t setter_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int setter_call(int target, int value)
+{
+    switch (target)
+    {
+    case TERMUX_SETTER_BRIGHTNESS:
+        return termux_brightness(value);
+    case TERMUX_SETTER_TORCH:
+        return termux_torch(value);
+    default:
+    {
+        termux_call_s ctx[1] = {{.call = TERMUX_CALL_VOLUME_SET, .in.volume = {setter_stream[target], value}}};
+        return termux_call(ctx);
+    }
+    }
+}
+
+/* must be called with setter_mutex held, the next target due or ~0 and when one is due */
+static int setter_due(int last, uint64_t now, uint64_t *wake)
+{
+    *wake = UINT64_MAX;
+    /* start after the last target so that a busy one cannot starve the others */
+    for (int k = 1; k <= TERMUX_SETTER_MAX; ++k)
+    {
+        int i = (last + k) % TERMUX_SETTER_MAX;
+        if (!setter[i].stat.pending)
+        {
+            continue;
+        }
+        if (setter[i].next <= now)
+        {
+            return i;
+        }
+        if (setter[i].next < *wake)
+        {
+            *wake = setter[i].next;
+        }
+    }
+    return ~0;
+}
+
+static void *setter_main(void *arg)
+{
+    int last = TERMUX_SETTER_MAX - 1;
+    (void)arg;
+    pthread_mutex_lock(&setter_mutex);
+    for (;;)
+    {
+        uint64_t wake;
+        int target = setter_due(last, setter_clock(), &wake);
+        if (target < 0)
+        {
+            if (wake == UINT64_MAX)
+            {
+                pthread_cond_broadcast(&setter_idle);
+                if (setter_state == SETTER_STOP)
+                {
+                    break;
+                }
+                pthread_cond_wait(&setter_wake, &setter_mutex);
+            }
+            else
+            {
+                struct timespec ts = {.tv_sec = (time_t)(wake / 1000), .tv_nsec = (long)(wake % 1000) * 1000000};
+                pthread_cond_timedwait(&setter_wake, &setter_mutex, &ts);
+            }
+            continue;
+        }
+        last = target;
+        setter_s *ctx = setter + target;
+        int value = ctx->value;
+        ctx->stat.pending = 0;
+        if (ctx->applied && ctx->stat.value == value)
+        {
+            ++ctx->stat.skipped;
+            continue;
+        }
+
+        setter_busy = 1;
+        pthread_mutex_unlock(&setter_mutex);
+        int status = setter_call(target, value);
+        pthread_mutex_lock(&setter_mutex);
+        setter_busy = 0;
+
+        ctx->next = setter_clock() + setter_interval;
+        if (status == 0)
+        {
+            ctx->stat.value = value;
+            ctx->applied = 1;
+            ++ctx->stat.applied;
+        }
+        else
+        {
+            ++ctx->stat.failed;
+        }
+        void (*applied)(int, int, int, void *) = setter_applied;
+        void *applied_arg = setter_arg;
+        if (applied)
+        {
+            pthread_mutex_unlock(&setter_mutex);
+            applied(target, value, status, applied_arg);
+            pthread_mutex_lock(&setter_mutex);
+        }
+    }
+    pthread_mutex_unlock(&setter_mutex);
+    return 0;
+}
+
+int termux_setter_start(unsigned long interval)
+{
+    int ok = ~0;
+    pthread_mutex_lock(&setter_mutex);
+    if (setter_state != SETTER_IDLE)
+    {
+        errno = EBUSY;
+        goto exit;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    /* the deadlines follow the monotonic clock */
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&setter_wake, &attr);
+    pthread_condattr_destroy(&attr);
+    setter_interval = interval;
+    setter_state = SETTER_RUN;
+    errno = pthread_create(&setter_thread, 0, setter_main, 0);
+    if (errno)
+    {
+        pthread_cond_destroy(&setter_wake);
+        setter_state = SETTER_IDLE;
+        goto exit;
+    }
+    ok = 0;
+exit:
+    pthread_mutex_unlock(&setter_mutex);
+    return ok;
+}
+
+void termux_setter_stop(void)
+{
+    pthread_mutex_lock(&setter_mutex);
+    if (setter_state != SETTER_RUN)
+    {
+        pthread_mutex_unlock(&setter_mutex);
+        return;
+    }
+    setter_state = SETTER_STOP;
+    pthread_cond_signal(&setter_wake);
+    pthread_mutex_unlock(&setter_mutex);
+    pthread_join(setter_thread, 0);
+    pthread_mutex_lock(&setter_mutex);
+    pthread_cond_destroy(&setter_wake);
+    setter_state = SETTER_IDLE;
+    pthread_mutex_unlock(&setter_mutex);
+}
+
+int termux_setter(int target, int value)
+{
+    if (target < 0 || target >= TERMUX_SETTER_MAX)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    pthread_mutex_lock(&setter_mutex);
+    if (setter_state != SETTER_RUN)
+    {
+        pthread_mutex_unlock(&setter_mutex);
+        errno = ESRCH;
+        return ~0;
+    }
+    setter_s *ctx = setter + target;
+    ctx->stat.replaced += (unsigned long)ctx->stat.pending;
+    ctx->stat.pending = 1;
+    ++ctx->stat.sets;
+    ctx->value = value;
+    pthread_cond_signal(&setter_wake);
+    pthread_mutex_unlock(&setter_mutex);
+    return 0;
+}
+
+void termux_setter_flush(void)
+{
+    pthread_mutex_lock(&setter_mutex);
+    for (;;)
+    {
+        int pending = setter_busy;
+        for (int i = 0; i != TERMUX_SETTER_MAX; ++i)
+        {
+            pending |= setter[i].stat.pending;
+        }
+        if (!pending || setter_state == SETTER_IDLE)
+        {
+            break;
+        }
+        pthread_cond_wait(&setter_idle, &setter_mutex);
+    }
+    pthread_mutex_unlock(&setter_mutex);
+}
+
+void termux_setter_report(void (*applied)(int target, int value, int status, void *arg), void *arg)
+{
+    pthread_mutex_lock(&setter_mutex);
+    setter_applied = applied;
+    setter_arg = arg;
+    pthread_mutex_unlock(&setter_mutex);
+}
+
+int termux_setter_stats(int target, termux_setter_s *ctx)
+{
+    if (target < 0 || target >= TERMUX_SETTER_MAX)
+    {
+        errno = EINVAL;
+        return ~0;
+    }
+    pthread_mutex_lock(&setter_mutex);
+    *ctx = setter[target].stat;
+    pthread_mutex_unlock(&setter_mutex);
+    return 0;
+}
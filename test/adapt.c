@@ -0,0 +1,151 @@
+/*!
+ @file adapt.c
+ @brief Test termux api delays that adapt to the readers of sensors
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/sensor.h"
+#include "test.h"
+
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static int *spawns;
+
+/* stands in for the service, reporting at the delay asked for once it started */
+static int backend(int argc, char *argv[])
+{
+    int delay = backend_int(argc, argv, "delay", 0);
+    __atomic_add_fetch(spawns, 1, __ATOMIC_SEQ_CST);
+    usleep(100000);
+    for (int i = 1;; ++i)
+    {
+        printf("{\"light\":{\"values\":[%i]}}\n", i);
+        fflush(stdout);
+        usleep((useconds_t)(delay ? delay : 1) * 1000);
+    }
+    return 0;
+}
+
+static void show(const termux_adapt_stat_s *stat, const termux_adapt_event_s *event, int events)
+{
+    printf("delay %ims after %llu windows, %llu coarser, %llu finer, %llu failed\n", stat->delay,
+           (unsigned long long)stat->windows, (unsigned long long)stat->coarser,
+           (unsigned long long)stat->finer, (unsigned long long)stat->failed);
+    for (int i = 0; i != events; ++i)
+    {
+        printf("  %ims -> %ims, %.2f lost, %.2f starved\n", event[i].from, event[i].to, event[i].lost, event[i].starved);
+    }
+}
+
+/* read a handle every us for some time, return the oldest sample read in ms */
+static double reads(termux_sensor_s *light, unsigned int us, unsigned int ms)
+{
+    termux_sample_s sample;
+    uint64_t age, oldest = 0;
+    for (unsigned int t = 0; t < ms * 1000; t += us)
+    {
+        if (termux_sensor_latest(light, &sample, &age) >= 0 && oldest < age)
+        {
+            oldest = age;
+        }
+        usleep(us);
+    }
+    return (double)oldest / 1e6;
+}
+
+int main(void)
+{
+    int fail = 0;
+    termux_adapt_stat_s stat;
+    termux_adapt_event_s event[TERMUX_ADAPT_LOG];
+    spawns = (int *)mmap(0, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    termux_backend(backend);
+
+    termux_sensor_s *light = termux_sensor_open("light", 2, 0);
+    fail += check(light != 0, "open");
+    if (light == 0)
+    {
+        return fail;
+    }
+    termux_adapt_s adapt = {.delay_min = 2, .delay_max = 64, .window = 100, .coarse = 0.5, .fine = 0.5, .hold = 2};
+    termux_adapt_s bad = adapt;
+    bad.delay_min = 100;
+    fail += check(termux_sensor_adapt(light, &bad) == ~0 && errno == EINVAL, "bounds checked");
+    bad = adapt;
+    bad.fine = 0;
+    fail += check(termux_sensor_adapt(light, &bad) == ~0 && errno == EINVAL, "thresholds checked");
+    fail += check(termux_sensor_adapt(light, &adapt) == 0, "adapt");
+
+    /* read at 50Hz while the sensor reports at 500Hz */
+    usleep(150000);
+    double oldest = reads(light, 20000, 2000);
+    int events = termux_sensor_adapt_stat(light, &stat, event, TERMUX_ADAPT_LOG);
+    show(&stat, event, events);
+    fail += check(stat.on && stat.delay >= 16 && stat.delay <= 32, "delay longer for a slow reader");
+    fail += check(stat.coarser >= 3 && events >= 3 && event[0].from == 2 && event[0].to == 4, "decisions logged");
+    fail += check(*spawns == 1 + (int)(stat.coarser + stat.finer), "a stream for each change");
+    int steady = 1;
+    for (int i = 1; i < events; ++i)
+    {
+        steady &= event[i].from == event[i - 1].to;
+    }
+    fail += check(steady, "each change from the delay before");
+    printf("oldest sample %.3fms\n", oldest);
+    fail += check(oldest < 80, "the old stream read while the new one starts");
+
+    /* read at 1kHz */
+    reads(light, 1000, 1500);
+    events = termux_sensor_adapt_stat(light, &stat, event, TERMUX_ADAPT_LOG);
+    show(&stat, event, events);
+    fail += check(stat.delay <= 4 && stat.finer >= 2, "delay shorter for a fast reader");
+
+    fail += check(termux_sensor_adapt(light, 0) == 0, "stop adapting");
+    int delay = stat.delay, spawned = *spawns;
+    reads(light, 20000, 500);
+    termux_sensor_adapt_stat(light, &stat, 0, 0);
+    fail += check(!stat.on && stat.delay == delay && *spawns == spawned, "delay kept");
+    termux_sensor_close(light);
+
+    /* subscribers that do not read lose samples */
+    termux_sub_s *sub = termux_subscribe("light", 2, 16, TERMUX_OVERFLOW_OLDEST);
+    fail += check(sub != 0, "subscribe");
+    if (sub == 0)
+    {
+        return fail;
+    }
+    adapt.delay_max = 32;
+    termux_sub_adapt(sub, &adapt);
+    usleep(1500000);
+    events = termux_sub_adapt_stat(sub, &stat, event, TERMUX_ADAPT_LOG);
+    show(&stat, event, events);
+    fail += check(stat.delay == 32 && stat.coarser == 4, "delay longer for lagging subscribers");
+    termux_sample_s sample;
+    for (int i = 0; i != 60; ++i)
+    {
+        termux_sub_next(sub, &sample, 1000);
+    }
+    events = termux_sub_adapt_stat(sub, &stat, event, TERMUX_ADAPT_LOG);
+    show(&stat, event, events);
+    fail += check(stat.delay < 32 && stat.finer >= 1, "delay shorter for waiting subscribers");
+
+    /* later subscribers share the stream at the delay it reached */
+    termux_sub_adapt(sub, 0);
+    termux_sub_adapt_stat(sub, &stat, 0, 0);
+    termux_sub_stat_s sub_stat;
+    termux_sub_s *reached = termux_subscribe("light", stat.delay, 16, TERMUX_OVERFLOW_OLDEST);
+    termux_sub_stat(reached, &sub_stat);
+    fail += check(sub_stat.subscribers == 2, "shared at the delay reached");
+    termux_sub_s *first = termux_subscribe("light", 2, 16, TERMUX_OVERFLOW_OLDEST);
+    termux_sub_stat(first, &sub_stat);
+    fail += check(sub_stat.subscribers == 1, "a stream of its own at the delay first asked for");
+    termux_unsubscribe(first);
+    termux_unsubscribe(reached);
+    termux_unsubscribe(sub);
+    return fail;
+}
@@ -0,0 +1,146 @@
+/*!
+ @file aggregate.c
+ @brief Test termux api statistics of sensor samples over windows
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/aggregate.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 1000
+
+static double values[SAMPLES * TERMUX_SAMPLE_MAX];
+static termux_window_s expect[SAMPLES * TERMUX_SAMPLE_MAX];
+static termux_window_s stats[SAMPLES * TERMUX_SAMPLE_MAX];
+static size_t fed;
+
+/* two passes in the order of the samples */
+static void reference(const double *x, size_t n, int axes, termux_window_s *out)
+{
+    for (int a = 0; a != axes; ++a)
+    {
+        double s = 0, q = 0, lo = x[a], hi = x[a];
+        for (size_t i = 0; i != n; ++i)
+        {
+            double v = x[i * (size_t)axes + (size_t)a];
+            s += v;
+            q += v * v;
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+        }
+        double mean = s / (double)n, var = 0;
+        for (size_t i = 0; i != n; ++i)
+        {
+            double d = x[i * (size_t)axes + (size_t)a] - mean;
+            var += d * d;
+        }
+        out[a].mean = mean;
+        out[a].min = lo;
+        out[a].max = hi;
+        out[a].var = var / (double)n;
+        out[a].rms = sqrt(q / (double)n);
+    }
+}
+
+static int near(double x, double y, double scale)
+{
+    return fabs(x - y) <= 1e-9 * scale;
+}
+
+static int same(const termux_window_s *x, const termux_window_s *y, size_t n)
+{
+    for (size_t i = 0; i != n; ++i)
+    {
+        double scale = fabs(y[i].min) + fabs(y[i].max);
+        if (x[i].min != y[i].min || x[i].max != y[i].max || !near(x[i].mean, y[i].mean, scale) ||
+            !near(x[i].rms, y[i].rms, scale) || !near(x[i].var, y[i].var, scale * scale))
+        {
+            printf("window %zu: mean %g %g min %g %g max %g %g var %g %g rms %g %g\n", i,
+                   x[i].mean, y[i].mean, x[i].min, y[i].min, x[i].max, y[i].max, x[i].var, y[i].var, x[i].rms, y[i].rms);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void done(const termux_window_s *out, int axes, void *arg)
+{
+    memcpy((termux_window_s *)arg + fed, out, sizeof(termux_window_s) * (size_t)axes);
+    fed += (size_t)axes;
+}
+
+int main(void)
+{
+    static const int axes[] = {1, 2, 3, 4, 5, 16};
+    static const size_t shape[][2] = {{1, 1}, {7, 7}, {50, 50}, {64, 16}, {33, 5}, {10, 25}, {1000, 1}};
+    int fail = 0;
+    srand(1);
+    for (size_t i = 0; i != sizeof(values) / sizeof(*values); ++i)
+    {
+        values[i] = 9.81 + (rand() % 2001 - 1000) / 1e4;
+    }
+
+    int best = termux_aggregate_simd(TERMUX_SIMD_MAX);
+    printf("kernels of %d bits\n", best == TERMUX_SIMD_256 ? 256 : best == TERMUX_SIMD_128 ? 128 : 64);
+    for (int simd = TERMUX_SIMD_NONE; simd <= best; ++simd)
+    {
+        int ok = termux_aggregate_simd(simd) == simd;
+        for (size_t a = 0; a != sizeof(axes) / sizeof(*axes); ++a)
+        {
+            for (size_t s = 0; s != sizeof(shape) / sizeof(*shape); ++s)
+            {
+                size_t window = shape[s][0], step = shape[s][1];
+                size_t n = termux_aggregate(values, SAMPLES, axes[a], window, step, stats);
+                ok &= n == (SAMPLES - window) / step + 1;
+                for (size_t w = 0; w != n; ++w)
+                {
+                    reference(values + w * step * (size_t)axes[a], window, axes[a], expect + w * (size_t)axes[a]);
+                }
+                ok &= same(stats, expect, n * (size_t)axes[a]);
+            }
+        }
+        char what[64];
+        sprintf(what, "kernel %d matches the reference", simd);
+        fail += check(ok, what);
+    }
+    termux_aggregate_simd(TERMUX_SIMD_MAX);
+
+    /* batches of any size give the windows of the whole array */
+    int ok = 1;
+    for (size_t a = 0; a != sizeof(axes) / sizeof(*axes); ++a)
+    {
+        for (size_t s = 0; s != sizeof(shape) / sizeof(*shape); ++s)
+        {
+            termux_aggregate_s ctx[1];
+            termux_aggregate_init(ctx, axes[a], shape[s][0], shape[s][1]);
+            size_t n = termux_aggregate(values, SAMPLES, axes[a], shape[s][0], shape[s][1], expect);
+            fed = 0;
+            for (size_t i = 0, k; i < SAMPLES; i += k)
+            {
+                k = (size_t)(rand() % 80);
+                k = i + k < SAMPLES ? k : SAMPLES - i;
+                termux_aggregate_feed(ctx, values + i * (size_t)axes[a], k, done, stats);
+            }
+            ok &= ctx->windows == n && fed == n * (size_t)axes[a] && same(stats, expect, fed);
+            termux_aggregate_exit(ctx);
+        }
+    }
+    fail += check(ok, "batches");
+
+    termux_aggregate_s ctx[1];
+    fail += check(termux_aggregate_init(ctx, 0, 1, 1) != 0 && termux_aggregate_init(ctx, 3, 0, 1) != 0, "bad windows");
+    termux_aggregate_init(ctx, 3, 4, 4);
+    termux_aggregate_feed(ctx, values, 3, done, stats);
+    termux_aggregate_reset(ctx);
+    fed = 0;
+    termux_aggregate_feed(ctx, values + 3 * 3, 4, done, stats);
+    reference(values + 3 * 3, 4, 3, expect);
+    fail += check(ctx->windows == 1 && same(stats, expect, 3), "reset");
+    termux_aggregate_exit(ctx);
+    return fail;
+}
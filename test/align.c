@@ -0,0 +1,185 @@
+/*!
+ @file align.c
+ @brief Test termux api samples of several sensors aligned into frames
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/align.h"
+#include "test.h"
+
+#include <time.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MS 1000000ULL
+
+/* stands in for the service, stamping each report 50ms before it prints it */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    FILE *out = fdopen(STDOUT_FILENO, "w");
+    for (int i = 1; i <= 3; ++i)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_BOOTTIME, &ts);
+        long long stamp = (long long)ts.tv_sec * 1000000000 + ts.tv_nsec - 50 * (long long)MS;
+        fprintf(out, "{\"light\":{\"timestamp\":%lld,\"values\":[%i]},\"proximity\":{\"values\":[%i]}}\n", stamp, i, i);
+        fflush(out);
+        usleep(10000);
+    }
+    return 0;
+}
+
+static uint64_t clock_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t stamps[2][8];
+static int stamped[2];
+
+static void stamp(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    (void)values;
+    (void)n;
+    (void)arg;
+    int i = strcmp(sensor, "light") != 0;
+    if (stamped[i] != 8)
+    {
+        stamps[i][stamped[i]++] = ns;
+    }
+}
+
+/* an accelerometer near 100Hz and a light sensor near 30Hz, both a line of their time */
+static double line(int sensor, uint64_t ns)
+{
+    return sensor ? 3 - (double)ns / 1e7 : 1 + (double)ns / 1e6;
+}
+
+int main(void)
+{
+    int fail = 0;
+    termux_frame_s frame;
+    termux_align_stat_s stat;
+    srand(1);
+
+    fail += check(termux_align_new("", 10 * MS, TERMUX_ALIGN_LINEAR, 16, 0) == 0 && errno == EINVAL, "no sensors");
+    termux_align_s *ctx = termux_align_new("accel,LIGHT", 10 * MS, TERMUX_ALIGN_LINEAR, 16, 50 * MS);
+    fail += check(ctx != 0, "new");
+    if (ctx == 0)
+    {
+        return fail;
+    }
+    double v[2];
+    uint64_t t[2] = {1003 * MS, 1001 * MS}, last = 0;
+    fail += check(termux_align_next(ctx, 1 << 30, &frame) != 0 && errno == EAGAIN, "no frame before every sensor");
+    int ok = 1, frames = 0, seen[2] = {0, 0};
+    for (int k = 0; k != 2000; ++k)
+    {
+        int i = t[0] <= t[1] ? 0 : 1;
+        v[0] = line(i, t[i]);
+        v[1] = -v[0];
+        /* a name that only contains the one asked for is taken once it comes again */
+        ok &= termux_align_push(ctx, i ? "TMD2772 Light" : "BMI160 Accelerometer", v, 2, t[i]) == (seen[i]++ ? i : ~0);
+        last = i ? t[i] : last;
+        t[i] += (i ? 33 : 10) * MS + (uint64_t)(rand() % 2000000) - 1000000;
+        while (termux_align_next(ctx, t[0] < t[1] ? t[0] : t[1], &frame) == 0)
+        {
+            ok &= frame.ns % (10 * MS) == 0 && frame.stale == 0 && frame.sensors == 2 && frame.n[0] == 2;
+            for (int s = 0; s != 2; ++s)
+            {
+                ok &= fabs(frame.values[s][0] - line(s, frame.ns)) < 1e-6 && frame.values[s][1] == -frame.values[s][0];
+            }
+            frames += ok;
+        }
+    }
+    termux_align_stat(ctx, &stat);
+    fail += check(ok && frames > 600 && stat.frames == (uint64_t)frames, "linear frames");
+    fail += check(strcmp(termux_align_name(ctx, 0), "BMI160 Accelerometer") == 0, "full name");
+    fail += check(termux_align_push(ctx, "BMI160 Gyroscope", v, 2, 0) == ~0, "not a sensor of the frames");
+    fail += check(termux_align_push(ctx, "TMD2772 Light", v, 2, 1) == ~0, "older than the newest");
+
+    /* the light sensor stops: frames wait for the latency, then hold it */
+    for (uint64_t ns = t[0]; ns < last + 100 * MS; ns += 10 * MS)
+    {
+        v[0] = line(0, ns);
+        termux_align_push(ctx, "BMI160 Accelerometer", v, 2, ns);
+    }
+    uint64_t newest = 0;
+    int stale = 0;
+    while (termux_align_next(ctx, last + 100 * MS, &frame) == 0)
+    {
+        if (frame.stale)
+        {
+            stale += frame.stale == 2 && frame.values[1][0] == line(1, last);
+            newest = frame.ns;
+        }
+    }
+    fail += check(stale > 0 && newest <= last + 50 * MS && newest > last + 30 * MS, "latency");
+    termux_align_free(ctx);
+
+    /* hold gives the sample before, frames of samples pushed out of the ring are skipped */
+    ctx = termux_align_new("a,b", 10 * MS, TERMUX_ALIGN_HOLD, 4, 0);
+    for (uint64_t ns = 1 * MS; ns < 200 * MS; ns += 7 * MS)
+    {
+        v[0] = (double)ns;
+        termux_align_push(ctx, "a", v, 1, ns);
+        termux_align_push(ctx, "b", v, 1, ns + 3 * MS);
+    }
+    termux_align_stat(ctx, &stat);
+    ok = termux_align_next(ctx, 1, &frame) == 0 && stat.dropped == 2 * (29 - 4);
+    ok &= frame.ns == 180 * MS && frame.values[0][0] == 176 * MS && frame.values[1][0] == 176 * MS;
+    termux_align_stat(ctx, &stat);
+    fail += check(ok && stat.skipped == 0, "hold");
+    ok = termux_align_next(ctx, 1, &frame) == 0 && frame.ns == 190 * MS && frame.values[0][0] == 190 * MS && frame.values[1][0] == 183 * MS;
+    ok &= termux_align_next(ctx, 1, &frame) != 0;
+    for (uint64_t ns = 400 * MS; ns < 440 * MS; ns += 7 * MS)
+    {
+        v[0] = (double)ns;
+        termux_align_push(ctx, "a", v, 1, ns);
+        termux_align_push(ctx, "b", v, 1, ns);
+    }
+    ok &= termux_align_next(ctx, 1, &frame) == 0 && frame.ns == 420 * MS;
+    termux_align_stat(ctx, &stat);
+    fail += check(ok && stat.skipped == 22, "skip");
+    termux_align_free(ctx);
+
+    /* a name longer than the names kept is still the same sensor */
+    const char *name = "LSM6DSO Accelerometer Non-wakeup Uncalibrated Secondary Display Sensor";
+    ctx = termux_align_new("accel", 10 * MS, TERMUX_ALIGN_HOLD, 4, 0);
+    ok = termux_align_push(ctx, name, v, 1, 1 * MS) == ~0 && termux_align_push(ctx, name, v, 1, 2 * MS) == 0;
+    ok &= termux_align_push(ctx, name, v, 1, 3 * MS) == 0;
+    fail += check(ok && strncmp(termux_align_name(ctx, 0), name, strlen(termux_align_name(ctx, 0))) == 0, "long name");
+    termux_align_free(ctx);
+
+    /* the name asked for wins over one listed before it that contains it */
+    ctx = termux_align_new("light", 10 * MS, TERMUX_ALIGN_HOLD, 4, 0);
+    ok = termux_align_push(ctx, "light uncalibrated", v, 1, 1 * MS) == ~0 && termux_align_push(ctx, "Light", v, 1, 2 * MS) == 0;
+    ok &= termux_align_push(ctx, "light uncalibrated", v, 1, 3 * MS) == ~0 && strcmp(termux_align_name(ctx, 0), "Light") == 0;
+    fail += check(ok, "exact name first");
+    termux_align_free(ctx);
+
+    /* a stream uses the times the service stamps */
+    termux_backend(backend);
+    fflush(stdout);
+    termux_stream_s *stream = termux_stream_open("light,proximity", 10);
+    uint64_t t0 = clock_ns();
+    while (stream && termux_stream_wait(stream, 1000) == 0 && termux_stream_read(stream, stamp, 0) != ~0)
+    {
+    }
+    termux_stream_close(stream);
+    ok = stamped[0] == 3 && stamped[1] == 3;
+    for (int i = 0; i != stamped[0] && ok; ++i)
+    {
+        ok &= stamps[0][i] < t0 + (uint64_t)i * 10 * MS && stamps[0][i] + 100 * MS > t0 && stamps[1][i] > stamps[0][i] + 40 * MS;
+    }
+    fail += check(ok, "event times");
+    return fail;
+}
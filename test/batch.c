@@ -0,0 +1,150 @@
+/*!
+ @file batch.c
+ @brief Test termux api batch of calls
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/batch.h"
+#include "test.h"
+
+#include <time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+static char log_path[64];
+static int hang;
+
+static long now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+/* stands in for the service, taking 50ms and logging when each call ran, or never answering */
+static int backend(int argc, char *argv[])
+{
+    while (hang)
+    {
+        pause();
+    }
+    char line[128];
+    long t0 = now();
+    usleep(50000);
+    int n = snprintf(line, sizeof(line), "%s %s %li %li\n", argv[1], argc > 3 ? argv[argc - 1] : "-", t0, now());
+    int fd = open(log_path, O_WRONLY | O_APPEND);
+    ssize_t ok = write(fd, line, (size_t)n);
+    close(fd);
+    if (strcmp(argv[1], "Sensor") == 0)
+    {
+        static const char reply[] = "{\"light\":{\"values\":[42]}}";
+        ok = write(STDOUT_FILENO, reply, sizeof(reply) - 1);
+    }
+    return ok < 0;
+}
+
+/* when the call whose last argument is value ran */
+static int span(const char *name, const char *value, long *t0, long *t1)
+{
+    char line[128], what[32], arg[32];
+    FILE *log = fopen(log_path, "r");
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), log))
+    {
+        found = sscanf(line, "%31s %31s %li %li", what, arg, t0, t1) == 4 &&
+                strcmp(what, name) == 0 && strcmp(arg, value) == 0;
+    }
+    fclose(log);
+    return found;
+}
+
+static int failed = 0;
+
+static void *trigger(void *arg)
+{
+    usleep(50000);
+    termux_cancel((termux_cancel_s *)arg);
+    return 0;
+}
+
+int main(void)
+{
+    snprintf(log_path, sizeof(log_path), "/tmp/termux-batch.%i", (int)getpid());
+    close(open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600));
+    termux_backend(backend);
+
+    termux_batch_s *ctx = termux_batch_new(3);
+    termux_call_s call[1] = {{.call = TERMUX_CALL_BRIGHTNESS, .in.brightness = 10}};
+    int brightness = termux_batch_add(ctx, call, ~0);
+    call->call = TERMUX_CALL_TORCH;
+    call->in.torch = 1;
+    /* the torch waits for the brightness, the rest runs alongside */
+    termux_batch_add(ctx, call, brightness);
+    call->call = TERMUX_CALL_VOLUME_SET;
+    call->in.volume.stream = "music";
+    call->in.volume.volume = 7;
+    termux_batch_add(ctx, call, ~0);
+    call->call = TERMUX_CALL_SENSOR;
+    call->in.sensor = "light";
+    termux_batch_add(ctx, call, ~0);
+    call->call = TERMUX_CALL_VIBRATE;
+    call->in.vibrate.ms = 20;
+    call->in.vibrate.force = 0;
+    termux_batch_add(ctx, call, ~0);
+    failed += check(termux_batch_add(ctx, call, 5) == ~0, "reject a dependency on a later call");
+
+    long t = now();
+    failed += check(termux_batch_run(ctx) == 0, "run");
+    t = now() - t;
+    printf("     5 calls of 50ms, 3 in flight: %lims\n", t);
+    failed += check(t < 200, "calls overlap");
+
+    unsigned int n = 0;
+    termux_call_s *calls = termux_batch_calls(ctx, &n);
+    failed += check(n == 5, "one result per call");
+    int ok = 1;
+    for (unsigned int i = 0; i != n; ++i)
+    {
+        ok = ok && calls[i].status == (calls[i].call == TERMUX_CALL_SENSOR ? 1 : 0);
+    }
+    failed += check(ok, "statuses");
+    failed += check(calls[3].out.values && calls[3].out.values[0] == 42, "sensor values");
+    free(calls[3].out.values);
+
+    long b0, b1, t0, t1, v0, v1;
+    failed += check(span("Brightness", "0", &b0, &b1) && span("Torch", "1", &t0, &t1) && t0 >= b1, "torch after brightness");
+    failed += check(span("Volume", "7", &v0, &v1) && v0 < b1, "volume alongside brightness");
+
+    /* calls queued later run on their own */
+    call->call = TERMUX_CALL_TORCH;
+    call->in.torch = 0;
+    termux_batch_add(ctx, call, 1);
+    failed += check(termux_batch_run(ctx) == 0 && termux_batch_calls(ctx, &n)[5].status == 0 && n == 6, "run again");
+    termux_batch_free(ctx);
+
+    /* a token cancelled from another thread ends the calls in flight at once */
+    hang = 1;
+    termux_cancel_s *token = termux_cancel_new();
+    ctx = termux_batch_new(0);
+    call->call = TERMUX_CALL_TORCH;
+    call->deadline = 5000;
+    call->cancel = token;
+    termux_batch_add(ctx, call, ~0);
+    termux_batch_add(ctx, call, ~0);
+    pthread_t thread;
+    pthread_create(&thread, 0, trigger, token);
+    t = now();
+    ok = termux_batch_run(ctx) == 2;
+    t = now() - t;
+    pthread_join(thread, 0);
+    calls = termux_batch_calls(ctx, &n);
+    failed += check(ok && calls[0].status == TERMUX_CANCEL && calls[1].status == TERMUX_CANCEL && t < 500, "cancelled");
+    termux_batch_free(ctx);
+    termux_cancel_free(token);
+
+    unlink(log_path);
+    return failed;
+}
@@ -0,0 +1,58 @@
+/*!
+ @file bench_aggregate.c
+ @brief Benchmark termux api statistics of sensor samples over windows
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/aggregate.h"
+#include "test.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLES (1 << 20)
+#define ROUNDS 10
+
+int main(void)
+{
+    static const int axes[] = {1, 3, 6};
+    static const size_t shape[][2] = {{64, 64}, {256, 64}, {1024, 1024}};
+    double *values = (double *)malloc(sizeof(double) * SAMPLES * 6);
+    termux_window_s *stats = (termux_window_s *)malloc(sizeof(termux_window_s) * SAMPLES / 64 * 6);
+    for (size_t i = 0; i != SAMPLES * 6; ++i)
+    {
+        values[i] = (rand() % 20000) / 1e3 - 10;
+    }
+    int best = termux_aggregate_simd(TERMUX_SIMD_MAX);
+    printf("%-5s %-9s %10s %10s %10s\n", "axes", "window", "scalar", "128", "256");
+    for (size_t a = 0; a != sizeof(axes) / sizeof(*axes); ++a)
+    {
+        for (size_t s = 0; s != sizeof(shape) / sizeof(*shape); ++s)
+        {
+            printf("%-5d %4zu/%-4zu", axes[a], shape[s][0], shape[s][1]);
+            for (int simd = TERMUX_SIMD_NONE; simd <= TERMUX_SIMD_256; ++simd)
+            {
+                if (simd > best)
+                {
+                    printf(" %10s", "-");
+                    continue;
+                }
+                termux_aggregate_simd(simd);
+                elapse();
+                for (int r = 0; r != ROUNDS; ++r)
+                {
+                    termux_aggregate(values, SAMPLES, axes[a], shape[s][0], shape[s][1], stats);
+                }
+                double ms = elapse();
+                /* values reduced a second, windows overlap so a value may count more than once */
+                double rate = (double)SAMPLES * (double)shape[s][0] / (double)shape[s][1] * axes[a] * ROUNDS / ms / 1e3;
+                printf(" %7.0fM/s", rate);
+            }
+            printf("\n");
+        }
+    }
+    free(stats);
+    free(values);
+    return 0;
+}
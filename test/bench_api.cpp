@@ -0,0 +1,144 @@
+/*!
+ @file bench_api.cpp
+ @brief Benchmark termux api for C++ against the C calls
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/api.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+/* stands in for the service with canned replies */
+static int backend(int argc, char *argv[])
+{
+    static const char list[] = "{\"sensors\":[\"accel\",\"gyro\",\"light\"]}";
+    static const char accel[] = "{\"accel\":{\"values\":[0.5,1.25,-9.81]}}";
+    static const char clip[] = "clipboard text";
+    const char *reply = "";
+    if (std::strcmp(argv[1], "Sensor") == 0)
+    {
+        reply = std::strcmp(argv[3], "list") == 0 ? list : accel;
+    }
+    else if (std::strcmp(argv[1], "Clipboard") == 0)
+    {
+        reply = clip;
+    }
+    (void)argc;
+    return write(STDOUT_FILENO, reply, std::strlen(reply)) < 0;
+}
+
+template <typename F>
+static double bench(long n, F &&f)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (long i = 0; i != n; ++i)
+    {
+        f();
+    }
+    std::chrono::duration<double, std::nano> dt = std::chrono::steady_clock::now() - t0;
+    return dt.count() / double(n);
+}
+
+static volatile double sink;
+
+/* allocates like termux_sensor without spawning, to isolate the wrapper */
+static int __attribute__((noinline)) fake_sensor(char *sensor, double **values)
+{
+    *values = static_cast<double *>(std::malloc(sizeof(double) * 3));
+    (*values)[0] = 0.5;
+    (*values)[1] = 1.25;
+    (*values)[2] = sensor ? -9.81 : 0;
+    return 3;
+}
+
+static termux::expected<termux::array<double>> wrap_sensor(const char *name) noexcept
+{
+    double *values = nullptr;
+    int n = fake_sensor(const_cast<char *>(name), &values);
+    termux::array<double> out(values, n > 0 ? std::size_t(n) : 0);
+    if (n < 0)
+    {
+        return termux::status(n);
+    }
+    return out;
+}
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? std::atol(argv[1]) : 200;
+    termux_backend(backend);
+
+    double c = bench(n, [] {
+        double *values = nullptr;
+        int m = termux_sensor(const_cast<char *>("accel"), &values);
+        for (int i = 0; i < m; ++i)
+        {
+            sink = sink + values[i];
+        }
+        std::free(values);
+    });
+    double cc = bench(n, [] {
+        auto values = termux::sensor("accel");
+        for (double v : values.value())
+        {
+            sink = sink + v;
+        }
+    });
+    std::printf("%-24s C %10.0f ns  C++ %10.0f ns\n", "sensor", c, cc);
+
+    c = bench(n, [] {
+        char **sensor = nullptr;
+        int m = termux_sensor_list(&sensor);
+        for (int i = 0; i < m; ++i)
+        {
+            sink = sink + double(std::strlen(sensor[i]));
+            std::free(sensor[i]);
+        }
+        std::free(sensor);
+    });
+    cc = bench(n, [] {
+        auto sensor = termux::sensor_list();
+        for (std::string_view name : sensor.value())
+        {
+            sink = sink + double(name.size());
+        }
+    });
+    std::printf("%-24s C %10.0f ns  C++ %10.0f ns\n", "sensor_list", c, cc);
+
+    c = bench(n, [] {
+        char *data = nullptr;
+        size_t byte = 0;
+        termux_clipboard_get(&data, &byte);
+        sink = sink + double(byte);
+        std::free(data);
+    });
+    cc = bench(n, [] {
+        auto data = termux::clipboard_get();
+        sink = sink + double(data->size());
+    });
+    std::printf("%-24s C %10.0f ns  C++ %10.0f ns\n", "clipboard_get", c, cc);
+
+    /* the result handling alone, without the child process */
+    long m = n * 10000;
+    c = bench(m, [] {
+        double *values = nullptr;
+        int k = fake_sensor(const_cast<char *>("accel"), &values);
+        for (int i = 0; i < k; ++i)
+        {
+            sink = sink + values[i];
+        }
+        std::free(values);
+    });
+    cc = bench(m, [] {
+        auto values = wrap_sensor("accel");
+        for (double v : *values)
+        {
+            sink = sink + v;
+        }
+    });
+    std::printf("%-24s C %10.2f ns  C++ %10.2f ns\n", "result handling only", c, cc);
+    return 0;
+}
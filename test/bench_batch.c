@@ -0,0 +1,79 @@
+/*!
+ @file bench_batch.c
+ @brief Benchmark termux api batch of calls against serial calls
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/batch.h"
+#include "test.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static long delay = 20; /* millisecond the service takes to reply */
+
+/* stands in for the service, replying after a delay */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    usleep((useconds_t)delay * 1000);
+    return 0;
+}
+
+/* the kind of step a script takes, over and over */
+static void step(termux_call_s *call, int i)
+{
+    switch (i % 3)
+    {
+    case 0:
+        call->call = TERMUX_CALL_BRIGHTNESS;
+        call->in.brightness = i % 256;
+        break;
+    case 1:
+        call->call = TERMUX_CALL_TORCH;
+        call->in.torch = i & 1;
+        break;
+    default:
+        call->call = TERMUX_CALL_VOLUME_SET;
+        call->in.volume.stream = "music";
+        call->in.volume.volume = i % 16;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 60;
+    delay = argc > 2 ? atol(argv[2]) : delay;
+    termux_backend(backend);
+
+    elapse();
+    for (int i = 0; i != n; ++i)
+    {
+        termux_call_s call[1] = {{0}};
+        step(call, i);
+        termux_call(call);
+    }
+    printf("%i calls of %lims: serial %8.1fms\n", n, delay, elapse());
+
+    /* limit 0 starts every call at once */
+    static const unsigned int limits[] = {1, 4, 16, 0};
+    for (unsigned int k = 0; k != sizeof(limits) / sizeof(*limits); ++k)
+    {
+        termux_batch_s *ctx = termux_batch_new(limits[k]);
+        for (int i = 0; i != n; ++i)
+        {
+            termux_call_s call[1] = {{0}};
+            step(call, i);
+            termux_batch_add(ctx, call, ~0);
+        }
+        elapse();
+        int failed = termux_batch_run(ctx);
+        double ms = elapse();
+        printf("%i calls of %lims: batch  %8.1fms, limit %u, %i failed\n", n, delay, ms, limits[k], failed);
+        termux_batch_free(ctx);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*!
+ @file bench_co.cpp
+ @brief Benchmark termux api as C++20 coroutines against blocking calls
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/co.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+static long delay = 20; /* millisecond the service takes to reply */
+
+/* stands in for the service, answering every sensor read after a delay */
+static int backend(int argc, char *argv[])
+{
+    static const char accel[] = "{\"accel\":{\"values\":[0.5,1.25,-9.81]}}";
+    usleep(useconds_t(delay * 1000));
+    (void)argc;
+    (void)argv;
+    return write(STDOUT_FILENO, accel, sizeof(accel) - 1) < 0;
+}
+
+static volatile double sink;
+static long failed;
+
+static termux::co::task<void> read(termux::co::loop &loop)
+{
+    auto values = co_await termux::co::sensor(loop, "accel");
+    if (!values)
+    {
+        ++failed;
+        co_return;
+    }
+    for (double v : *values)
+    {
+        sink = sink + v;
+    }
+}
+
+template <typename F>
+static double bench(F &&f)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> dt = std::chrono::steady_clock::now() - t0;
+    return dt.count();
+}
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? std::atol(argv[1]) : 100;
+    delay = argc > 2 ? std::atol(argv[2]) : delay;
+    termux_backend(backend);
+    termux_timeout(TERMUX_API_SENSOR, 60000, 60000, 1);
+
+    double serial = bench([n] {
+        for (long i = 0; i != n; ++i)
+        {
+            auto values = termux::sensor("accel");
+            sink = sink + double(values ? values->size() : 0);
+        }
+    });
+    double co = bench([n] {
+        termux::co::loop loop;
+        for (long i = 0; i != n; ++i)
+        {
+            termux::co::spawn(read(loop));
+        }
+        loop.run();
+    });
+    std::printf("%li calls of %li ms: blocking %.1f ms, coroutines %.1f ms, %li failed\n",
+                n, delay, serial, co, failed);
+    return failed != 0;
+}
@@ -0,0 +1,48 @@
+/*!
+ @file bench_fusion.c
+ @brief Benchmark termux api orientation of the device
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/fusion.h"
+#include "test.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLES 4096
+#define ROUNDS 1000
+
+static double samples[3][SAMPLES][3];
+
+int main(void)
+{
+    for (int i = 0; i != SAMPLES; ++i)
+    {
+        for (int a = 0; a != 3; ++a)
+        {
+            samples[0][i][a] = (a == 2 ? 9.81 : 0) + (rand() % 100) / 1e3;
+            samples[1][i][a] = (rand() % 100) / 1e3 - 0.05;
+            samples[2][i][a] = (a == 2 ? -42 : a == 0 ? 22 : 0) + (rand() % 100) / 1e2;
+        }
+    }
+    static const char *const what[3] = {"gyroscope", "with gravity", "with the field"};
+    for (int k = 0; k != 3; ++k)
+    {
+        termux_fusion_s ctx[1];
+        termux_fusion_init(ctx, 0);
+        uint64_t ns = 0;
+        elapse();
+        for (int r = 0; r != ROUNDS; ++r)
+        {
+            for (int i = 0; i != SAMPLES; ++i)
+            {
+                termux_fusion_update(ctx, ns += 5000000, samples[1][i], k > 0 ? samples[0][i] : 0, k > 1 ? samples[2][i] : 0);
+            }
+        }
+        double ms = elapse();
+        printf("%-15s %6.1fns %6.1fM updates/s\n", what[k], ms * 1e6 / SAMPLES / ROUNDS, SAMPLES * (double)ROUNDS / ms / 1e3);
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*!
+ @file bench_gorilla.c
+ @brief Benchmark termux api compression of sensor samples
+ @details bench_gorilla [recording], without a recording it makes up one minute of three sensors
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/gorilla.h"
+#include "termux/record.h"
+#include "test.h"
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK 1024 /* samples in a block */
+
+typedef struct
+{
+    int axes;
+    size_t n;
+    uint64_t *ns;
+    double *values;
+} series_s;
+
+/* an accelerometer and a gyroscope at 400Hz, a light sensor at 5Hz, with the jitter of a phone */
+static int fake(series_s *series)
+{
+    static const int rate[3] = {400, 400, 5};
+    static const int axes[3] = {3, 3, 1};
+    srand(1);
+    for (int s = 0; s != 3; ++s)
+    {
+        series_s *ctx = series + s;
+        ctx->axes = axes[s];
+        ctx->n = (size_t)rate[s] * 60;
+        ctx->ns = (uint64_t *)malloc(sizeof(uint64_t) * ctx->n);
+        ctx->values = (double *)malloc(sizeof(double) * ctx->n * (size_t)ctx->axes);
+        uint64_t t = 1000000000;
+        for (size_t i = 0; i != ctx->n; ++i)
+        {
+            t += 1000000000 / (uint64_t)rate[s] + (uint64_t)(rand() % 20000);
+            ctx->ns[i] = t;
+            for (int a = 0; a != ctx->axes; ++a)
+            {
+                double x = s == 2 ? (double)(100 + i / 50 * 10) : sin((double)i / 200 + a) + (rand() % 64) / 1024.0;
+                ctx->values[i * (size_t)ctx->axes + (size_t)a] = (float)x;
+            }
+        }
+    }
+    return 3;
+}
+
+static int load(series_s *series, const char *path)
+{
+    termux_recording_s *recording = termux_recording_open(path);
+    if (recording == 0)
+    {
+        return 0;
+    }
+    int sensors = termux_recording_sensors(recording);
+    for (int s = 0; s != sensors; ++s)
+    {
+        series[s].axes = termux_recording_axes(recording, s);
+        series[s].n = 0;
+    }
+    for (size_t b = 0; b != termux_recording_blocks(recording); ++b)
+    {
+        int s = 0;
+        size_t n = termux_recording_block(recording, b, &s);
+        series[s].n += n;
+    }
+    for (int s = 0; s != sensors; ++s)
+    {
+        series[s].ns = (uint64_t *)malloc(sizeof(uint64_t) * (series[s].n + 1));
+        series[s].values = (double *)malloc(sizeof(double) * (series[s].n + 1) * (size_t)(series[s].axes + 1));
+        series[s].n = 0;
+    }
+    int type = termux_recording_type(recording);
+    for (size_t b = 0; b != termux_recording_blocks(recording); ++b)
+    {
+        int s = 0;
+        size_t n = termux_recording_block(recording, b, &s);
+        series_s *ctx = series + s;
+        memcpy(ctx->ns + ctx->n, termux_recording_ns(recording, b), sizeof(uint64_t) * n);
+        for (int a = 0; a != ctx->axes; ++a)
+        {
+            const void *column = termux_recording_axis(recording, b, a);
+            for (size_t i = 0; i != n; ++i)
+            {
+                double x = type == TERMUX_RECORD_FLOAT ? ((const float *)column)[i] : ((const double *)column)[i];
+                ctx->values[(ctx->n + i) * (size_t)ctx->axes + (size_t)a] = x;
+            }
+        }
+        ctx->n += n;
+    }
+    termux_recording_close(recording);
+    return sensors;
+}
+
+int main(int argc, char *argv[])
+{
+    series_s series[TERMUX_RECORD_SENSORS];
+    int sensors = argc > 1 ? load(series, argv[1]) : fake(series);
+    if (sensors == 0)
+    {
+        fprintf(stderr, "%s is not a recording\n", argv[1]);
+        return 1;
+    }
+    size_t raw = 0, packed = 0, samples = 0;
+    double encode = 0, decode = 0;
+    int ok = 1;
+    for (int s = 0; s != sensors; ++s)
+    {
+        series_s *ctx = series + s;
+        size_t cap = termux_gorilla_bound(BLOCK, ctx->axes);
+        size_t blocks = (ctx->n + BLOCK - 1) / BLOCK;
+        unsigned char *buf = (unsigned char *)malloc(cap * (blocks ? blocks : 1));
+        size_t *byte = (size_t *)malloc(sizeof(size_t) * (blocks ? blocks : 1));
+        termux_gorilla_s enc[1], dec[1];
+        elapse();
+        for (size_t b = 0; b != blocks; ++b)
+        {
+            termux_gorilla_init(enc, buf + b * cap, cap, ctx->axes);
+            for (size_t i = b * BLOCK; i != ctx->n && i != (b + 1) * BLOCK; ++i)
+            {
+                termux_gorilla_put(enc, ctx->ns[i], ctx->values + i * (size_t)ctx->axes);
+            }
+            byte[b] = termux_gorilla_end(enc);
+            packed += byte[b];
+        }
+        encode += elapse();
+        double values[TERMUX_SAMPLE_MAX];
+        uint64_t ns;
+        size_t i = 0;
+        for (size_t b = 0; b != blocks; ++b)
+        {
+            termux_gorilla_open(dec, buf + b * cap, byte[b]);
+            while (termux_gorilla_get(dec, &ns, values) == 0)
+            {
+                ok &= ns == ctx->ns[i] && memcmp(values, ctx->values + i * (size_t)ctx->axes, sizeof(double) * (size_t)ctx->axes) == 0;
+                ++i;
+            }
+        }
+        decode += elapse();
+        ok &= i == ctx->n;
+        raw += ctx->n * (sizeof(uint64_t) + sizeof(double) * (size_t)ctx->axes);
+        samples += ctx->n;
+        free(byte);
+        free(buf);
+        free(ctx->ns);
+        free(ctx->values);
+    }
+    printf("%zu samples, %zu bytes raw, %zu bytes packed, ratio %.2f, %.2f bytes a sample\n",
+           samples, raw, packed, (double)raw / (double)packed, (double)packed / (double)samples);
+    printf("encode %.1fms %.0fMB/s %.1fM samples/s\n", encode, (double)raw / encode / 1e3, (double)samples / encode / 1e3);
+    printf("decode %.1fms %.0fMB/s %.1fM samples/s\n", decode, (double)raw / decode / 1e3, (double)samples / decode / 1e3);
+    printf("%s\n", ok ? "lossless" : "MISMATCH");
+    return !ok;
+}
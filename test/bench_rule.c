@@ -0,0 +1,68 @@
+/*!
+ @file bench_rule.c
+ @brief Benchmark termux api rules over the values of sensors
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/rule.h"
+#include "test.h"
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLES 1000000
+
+static unsigned long changes;
+
+static void fire(int rule, int active, double value, uint64_t ns, void *arg)
+{
+    (void)rule;
+    (void)active;
+    (void)value;
+    (void)ns;
+    (void)arg;
+    ++changes;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const sensors[3] = {"BMI160 Accelerometer", "BMI160 Gyroscope", "AK09918 Magnetic Field"};
+    static const char *const want[3] = {"accel", "gyro", "magnet"};
+    static const char *const op[4] = {">", ">=", "<", "<="};
+    int rules = argc > 1 ? atoi(argv[1]) : 600;
+    termux_rules_s *ctx = termux_rules_new();
+    srand(1);
+    for (int i = 0; i != rules; ++i)
+    {
+        char rule[128];
+        snprintf(rule, sizeof(rule), "%s[%i] %s %g hyst %g for %i", want[i % 3], i / 3 % 4 == 3 ? 0 : i / 3 % 4,
+                 op[rand() % 4], (rand() % 200) / 10.0 - 10, (rand() % 10) / 10.0, rand() % 3 * 10);
+        if (i / 3 % 4 == 3)
+        {
+            snprintf(rule, sizeof(rule), "%s[norm] > %g", want[i % 3], (rand() % 150) / 10.0);
+        }
+        termux_rule_add(ctx, rule, fire, 0);
+    }
+    double (*values)[3] = (double(*)[3])malloc(sizeof(double[3]) * 4096);
+    for (int i = 0; i != 4096; ++i)
+    {
+        for (int a = 0; a != 3; ++a)
+        {
+            values[i][a] = 10 * sin(i / 300.0 + a) + (rand() % 100) / 100.0;
+        }
+    }
+    uint64_t ns = 1;
+    elapse();
+    for (int i = 0; i != SAMPLES; ++i)
+    {
+        termux_rules_eval(ctx, sensors[i % 3], values[i & 4095], 3, ns += 1000000);
+    }
+    double ms = elapse();
+    printf("%i rules over 3 sensors: %.0fns a sample, %.0fk samples/s, %.0fM rules/s, %lu changes\n", rules,
+           ms * 1e6 / SAMPLES, SAMPLES / ms, (double)SAMPLES * rules / 3 / ms / 1e3, changes);
+    free(values);
+    termux_rules_free(ctx);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*!
+ @file breaker.c
+ @brief Test termux api circuit breaker
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/api.h"
+#include "test.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+static int down = 0;
+
+/* stands in for the service, hanging like an unreachable one when down */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    while (down)
+    {
+        pause();
+    }
+    return 0;
+}
+
+static int state(void)
+{
+    termux_breaker_s ctx[1];
+    return termux_breaker(ctx);
+}
+
+/* check with the state of the breaker after it */
+static int check_state(int expr, const char *what)
+{
+    char line[128];
+    termux_breaker_s ctx[1];
+    termux_breaker(ctx);
+    snprintf(line, sizeof(line), "%-28s state=%i failures=%u backoff=%lums opens=%lu rejects=%lu",
+             what, ctx->state, ctx->failures, ctx->backoff, ctx->opens, ctx->rejects);
+    return check(expr, line);
+}
+
+static void *trigger(void *arg)
+{
+    usleep(20000);
+    termux_cancel((termux_cancel_s *)arg);
+    return 0;
+}
+
+int main(void)
+{
+    int fail = 0;
+    termux_backend(backend);
+    termux_breaker_config(3, 200, 1000);
+    termux_timeout(TERMUX_API_TORCH, 50, 50, 1);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        fail += check_state(termux_torch(1) == 0, "up");
+    }
+
+    down = 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        termux_timeout_once(50);
+        fail += check_state(termux_torch(1) != 0, "down, timed out");
+    }
+    fail += check_state(state() == TERMUX_BREAKER_OPEN, "opened");
+
+    elapse();
+    int ok = termux_torch(1);
+    double ms = elapse();
+    fail += check_state(ok == TERMUX_REJECT && ms < 5, "rejected immediately");
+
+    usleep(250000);
+    termux_timeout_once(50);
+    fail += check_state(termux_torch(1) != 0, "probe while down");
+    fail += check_state(state() == TERMUX_BREAKER_OPEN, "reopened");
+
+    down = 0;
+    fail += check_state(termux_torch(1) == TERMUX_REJECT, "rejected during back-off");
+    usleep(450000);
+    fail += check_state(termux_torch(1) == 0, "probe after recovery");
+    fail += check_state(state() == TERMUX_BREAKER_CLOSED, "closed");
+    fail += check_state(termux_torch(0) == 0, "up again");
+
+    /* a cancelled probe leaves the breaker open for the next one */
+    down = 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        termux_timeout_once(50);
+        termux_torch(1);
+    }
+    usleep(250000);
+    termux_cancel_s *token = termux_cancel_new();
+    pthread_t thread;
+    pthread_create(&thread, 0, trigger, token);
+    termux_cancel_once(token);
+    termux_timeout_once(1000);
+    ok = termux_torch(1);
+    down = 0;
+    pthread_join(thread, 0);
+    termux_breaker_s ctx[1];
+    termux_breaker(ctx);
+    fail += check_state(ok == TERMUX_CANCEL && ctx->state == TERMUX_BREAKER_OPEN && ctx->backoff == 200 && ctx->retry == 0,
+                        "probe cancelled");
+    fail += check_state(termux_torch(1) == 0 && state() == TERMUX_BREAKER_CLOSED, "probed again");
+    termux_cancel_free(token);
+
+    return fail != 0;
+}
@@ -0,0 +1,197 @@
+/*!
+ @file bucket.c
+ @brief Test termux api token buckets shared by many processes
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/call.h"
+#include "test.h"
+
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#define WORKERS 4
+#define RATE 40.0
+#define BURST 4.0
+
+static char dir[] = "/tmp/termux-bucket-XXXXXX";
+
+/* stands in for the service, replying at once, a vibration fails */
+static int backend(int argc, char *argv[])
+{
+    static const char volume[] = "[{\"stream\":\"music\",\"volume\":6,\"max_volume\":15}]";
+    (void)argc;
+    if (strcmp(argv[1], "Vibrate") == 0)
+    {
+        return 1;
+    }
+    return write(STDOUT_FILENO, volume, sizeof(volume) - 1) < 0;
+}
+
+static void *cancel(void *arg)
+{
+    usleep(50000);
+    termux_cancel((termux_cancel_s *)arg);
+    return 0;
+}
+
+/* calls that reached the bucket of a class */
+static unsigned long drawn(int priority)
+{
+    termux_bucket_s bucket[1];
+    termux_bucket(priority, bucket);
+    return bucket->taken + bucket->waited + bucket->rejected;
+}
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* an independent process polling the volume as fast as it can for a while */
+static int worker(double seconds, int go)
+{
+    char c;
+    if (termux_bucket_open() || read(go, &c, 1) != 1)
+    {
+        return 1;
+    }
+    termux_backend(backend);
+    int n = 0;
+    for (double t0 = now(); now() - t0 < seconds;)
+    {
+        termux_volume_s volume[1];
+        n += termux_volume_get(volume) == 0;
+    }
+    /* the count of calls is the exit status */
+    return n > 255 ? 255 : n;
+}
+
+/* run the workers together, return the calls they made */
+static int run(double seconds)
+{
+    int go[2];
+    pid_t pid[WORKERS];
+    if (pipe(go) < 0)
+    {
+        return 0;
+    }
+    for (int i = 0; i != WORKERS; ++i)
+    {
+        pid[i] = fork();
+        if (pid[i] == 0)
+        {
+            close(go[1]);
+            _exit(worker(seconds, go[0]));
+        }
+    }
+    close(go[0]);
+    (void)!write(go[1], "gggg", WORKERS);
+    close(go[1]);
+    int total = 0;
+    for (int i = 0; i != WORKERS; ++i)
+    {
+        int status = 0;
+        waitpid(pid[i], &status, 0);
+        total += WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+    }
+    return total;
+}
+
+static int failed = 0;
+
+int main(void)
+{
+    if (mkdtemp(dir) == 0)
+    {
+        return 1;
+    }
+    setenv("TMPDIR", dir, 1);
+    termux_share(0);
+    failed += check(termux_bucket_open() == 0, "open");
+
+    /* without a limit each process alone would exceed the budget */
+    int free_calls = run(0.5);
+    printf("     %i processes without a limit: at least %i calls in 0.5s\n", WORKERS, free_calls);
+
+    termux_bucket_config(TERMUX_PRIORITY_LOW, RATE, BURST);
+    double seconds = 1.5;
+    int calls = run(seconds);
+    /* each worker may hold one token reserved before its time ran out */
+    double bound = RATE * seconds + BURST + WORKERS;
+    printf("     %i processes at %g/s: %i calls in %gs, bound %g\n", WORKERS, RATE, calls, seconds, bound);
+    failed += check(calls <= bound, "aggregate rate stays bounded");
+    failed += check(calls >= RATE * seconds * 0.8, "budget is used");
+
+    termux_bucket_s bucket[1];
+    termux_bucket(TERMUX_PRIORITY_LOW, bucket);
+    printf("     rate %g burst %g: %lu taken, %lu waited, %lu rejected\n",
+           bucket->rate, bucket->burst, bucket->taken, bucket->waited, bucket->rejected);
+    failed += check(bucket->waited > 0, "calls over the budget wait");
+
+    /* a call that cannot wait is rejected once the bucket is empty */
+    termux_backend(backend);
+    termux_bucket_config(TERMUX_PRIORITY_LOW, 1, 1);
+    int rejected = 0;
+    for (int i = 0; i != 3; ++i)
+    {
+        termux_call_s call[1] = {{.call = TERMUX_CALL_VOLUME_GET}};
+        rejected += termux_call_start(call) == TERMUX_REJECT && errno == EAGAIN;
+        termux_call_finish(call);
+    }
+    failed += check(rejected >= 2, "start without a token is rejected");
+
+    /* other classes have their own budget */
+    termux_call_s torch[1] = {{.call = TERMUX_CALL_TORCH, .in.torch = 1}};
+    failed += check(termux_call(torch) == 0, "other classes are not limited");
+
+    /* a call waiting for a token keeps its deadline and token and gives the token back */
+    termux_bucket_config(TERMUX_PRIORITY_LOW, 2, 1);
+    termux_volume_s volume[1];
+    termux_volume_get(volume);
+    double t0 = now();
+    termux_timeout_once(100);
+    int ok = termux_volume_get(volume);
+    failed += check(ok == TERMUX_TIMEOUT && now() - t0 < 0.2, "a token past the deadline is not waited for");
+    termux_cancel_s *token = termux_cancel_new();
+    pthread_t thread;
+    pthread_create(&thread, 0, cancel, token);
+    termux_cancel_once(token);
+    ok = termux_volume_get(volume);
+    pthread_join(thread, 0);
+    failed += check(ok == TERMUX_CANCEL && now() - t0 < 0.2, "a call waiting for a token is cancelled");
+    ok = termux_volume_get(volume);
+    printf("     next token after %.0fms\n", (now() - t0) * 1e3);
+    failed += check(ok == 0 && now() - t0 < 0.7, "the tokens of the calls that gave up are back");
+    termux_cancel_free(token);
+
+    /* calls turned away by the scheduler or the breaker take no token */
+    unsigned long before = drawn(TERMUX_PRIORITY_LOW);
+    termux_sched_config(1, 0);
+    failed += check(termux_call_start(torch) == 0, "the slot is taken");
+    termux_call_s call[1] = {{.call = TERMUX_CALL_VOLUME_GET}};
+    ok = termux_call_start(call);
+    termux_call_finish(call);
+    termux_call_wait(torch);
+    termux_call_finish(torch);
+    termux_sched_config(0, 0);
+    termux_breaker_config(1, 60000, 60000);
+    termux_vibrate(1, 0);
+    int open = termux_volume_get(volume);
+    termux_breaker_reset();
+    failed += check(ok == TERMUX_REJECT && open == TERMUX_REJECT && drawn(TERMUX_PRIORITY_LOW) == before,
+                    "rejected calls spend no budget");
+
+    char path[sizeof(dir) + 32];
+    snprintf(path, sizeof(path), "%s/termux-api.%u.bucket", dir, (unsigned int)getuid());
+    unlink(path);
+    rmdir(dir);
+    return failed;
+}
@@ -0,0 +1,118 @@
+/*!
+ @file bus.c
+ @brief Test termux api sensor bus read by other processes
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/sensor.h"
+#include "test.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* stands in for the service, each report holds its number in every value */
+static int backend(int argc, char *argv[])
+{
+    int delay = backend_int(argc, argv, "delay", 0);
+    for (int i = 1;; ++i)
+    {
+        printf("{\n  \"accel\": {\n    \"values\": [\n      %i,\n      %i,\n      %i\n    ]\n  },\n"
+               "  \"light\": {\n    \"values\": [\n      %i\n    ]\n  }\n}\n",
+               i, i, i, i);
+        fflush(stdout);
+        usleep((useconds_t)delay * 1000);
+    }
+    return 0;
+}
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* read the bus from another process as fast as possible, fail on a torn or stale sample */
+static int reader(const char *name)
+{
+    termux_bus_s *bus = termux_bus_open(name);
+    if (bus == 0)
+    {
+        return 1;
+    }
+    int slot = ~0;
+    while ((slot = termux_bus_find(bus, "accel")) < 0)
+    {
+        usleep(1000);
+    }
+    termux_sample_s last = {0}, sample;
+    unsigned long reads = 0, changes = 0;
+    int fail = 0;
+    for (uint64_t t = now() + 300000000; now() < t; ++reads)
+    {
+        if (termux_bus_read(bus, slot, &sample))
+        {
+            continue;
+        }
+        if (sample.n != 3 || sample.values[0] != sample.values[1] || sample.values[1] != sample.values[2] ||
+            sample.seq < last.seq || sample.ns < last.ns || (uint64_t)sample.values[0] != sample.seq)
+        {
+            fail = 1;
+        }
+        changes += sample.seq != last.seq;
+        last = sample;
+    }
+    printf("reads=%lu changes=%lu age=%.3fms\n", reads, changes, (double)(now() - last.ns) / 1e6);
+    fflush(stdout);
+    termux_bus_close(bus);
+    return fail || changes < 10;
+}
+
+int main(void)
+{
+    int fail = 0;
+    char name[32];
+    snprintf(name, sizeof(name), "test%i", (int)getpid());
+    termux_backend(backend);
+
+    termux_bus_s *bus = termux_bus_publish(name, "accel,light", 1);
+    fail += check(bus != 0, "publish");
+    if (bus == 0)
+    {
+        return fail;
+    }
+
+    pid_t pid[2];
+    fflush(stdout);
+    for (int i = 0; i != 2; ++i)
+    {
+        pid[i] = fork();
+        if (pid[i] == 0)
+        {
+            _exit(reader(name));
+        }
+    }
+    for (int i = 0; i != 2; ++i)
+    {
+        int status = 1;
+        waitpid(pid[i], &status, 0);
+        fail += check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "consistent snapshots in another process");
+    }
+
+    termux_sample_s sample;
+    int light = termux_bus_find(bus, "light");
+    fail += check(light >= 0 && strcmp(termux_bus_name(bus, light), "light") == 0, "slot of light");
+    fail += check(termux_bus_read(bus, light, &sample) == 0 && sample.n == 1, "sample of light");
+    fail += check(termux_bus_find(bus, "gyro") < 0, "no slot of gyro");
+
+    termux_bus_close(bus);
+    fail += check(waitpid(-1, 0, WNOHANG) < 0, "publisher stopped");
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/termux-api.%u.bus.%s", (unsigned int)getuid(), name);
+    unlink(path);
+    return fail;
+}
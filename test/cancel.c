@@ -0,0 +1,126 @@
+/*!
+ @file cancel.c
+ @brief Test termux api deadlines and cancellation of prompts nobody answers
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/call.h"
+#include "test.h"
+
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+static int stubborn = 0;
+static int closed = 0;
+
+/* stands in for a prompt that the user never answers */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    if (stubborn)
+    {
+        signal(SIGTERM, SIG_IGN);
+    }
+    if (closed)
+    {
+        close(STDOUT_FILENO);
+        close(STDERR_FILENO);
+    }
+    for (;;)
+    {
+        pause();
+    }
+    return 0;
+}
+
+/* check with the time the call took */
+static int check_time(int expr, const char *what, double ms)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "%-32s %.1fms", what, ms);
+    return check(expr, line);
+}
+
+static void *trigger(void *arg)
+{
+    struct timespec t = {0, 50000000};
+    nanosleep(&t, 0);
+    termux_cancel((termux_cancel_s *)arg);
+    return 0;
+}
+
+int main(void)
+{
+    int fail = 0;
+    int status;
+    double ms;
+    termux_backend(backend);
+    termux_breaker_config(100, 200, 1000);
+    termux_cancel_s *token = termux_cancel_new();
+    if (!token)
+    {
+        return 1;
+    }
+
+    elapse();
+    termux_timeout_once(50);
+    status = termux_dialog_confirm("never", "answered");
+    ms = elapse();
+    fail += check_time(status == TERMUX_TIMEOUT && ms < 500, "dialog deadline", ms);
+
+    pthread_t thread;
+    pthread_create(&thread, 0, trigger, token);
+    elapse();
+    termux_cancel_once(token);
+    status = termux_fingerprint("never", 0, 0, 0);
+    ms = elapse();
+    pthread_join(thread, 0);
+    fail += check_time(status == TERMUX_CANCEL && errno == ECANCELED && ms < 500, "fingerprint cancelled", ms);
+
+    /* a cancelled token stops the call before it runs */
+    elapse();
+    termux_cancel_once(token);
+    status = termux_fingerprint("never", 0, 0, 0);
+    ms = elapse();
+    fail += check_time(status == TERMUX_CANCEL && ms < 10, "cancelled before start", ms);
+    termux_cancel_reset(token);
+    fail += check_time(!termux_cancelled(token), "token reset", 0);
+
+    termux_call_s ctx[1] = {{.call = TERMUX_CALL_DIALOG_TEXT, .deadline = 50, .cancel = token}};
+    elapse();
+    status = termux_call(ctx);
+    ms = elapse();
+    fail += check_time(status == TERMUX_TIMEOUT && ms < 500, "call deadline", ms);
+
+    /* a child that ignores SIGTERM is killed */
+    stubborn = 1;
+    ctx->deadline = 20;
+    elapse();
+    status = termux_call(ctx);
+    ms = elapse();
+    fail += check_time(status == TERMUX_TIMEOUT && ms < 1000, "stubborn child killed", ms);
+
+    /* a child that closed its output but does not exit */
+    stubborn = 0;
+    closed = 1;
+    ctx->deadline = 50;
+    elapse();
+    status = termux_call(ctx);
+    ms = elapse();
+    fail += check_time(status == TERMUX_TIMEOUT && ms < 500, "deadline after the output closed", ms);
+
+    fail += check_time(waitpid(-1, 0, WNOHANG) < 0 && errno == ECHILD, "no child left", 0);
+
+    termux_latency_s latency[1];
+    termux_latency(TERMUX_API_FINGERPRINT, latency);
+    fail += check_time(latency->kills == 0, "cancel is not a kill", 0);
+
+    termux_cancel_free(token);
+    return fail;
+}
@@ -0,0 +1,61 @@
+/*!
+ @file co.cpp
+ @brief Test termux api as C++20 coroutines
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/co.hpp"
+
+#include <coroutine>
+#include <cstdio>
+#include <string>
+
+static termux::co::task<void> read_sensor(termux::co::loop &loop, std::string name)
+{
+    auto values = co_await termux::co::sensor(loop, name.c_str());
+    std::printf("\"%s\":", name.c_str());
+    if (values)
+    {
+        char c = '[';
+        for (double v : *values)
+        {
+            std::printf("%c%g", c, v);
+            c = ',';
+        }
+        std::putchar(']');
+    }
+    std::putchar('\n');
+}
+
+static termux::co::task<void> read_volume(termux::co::loop &loop)
+{
+    auto volume = co_await termux::co::volume_get(loop);
+    if (volume)
+    {
+        std::printf("music %i/%i\n", volume->music->volume, volume->music->max_volume);
+    }
+}
+
+static termux::co::task<void> run(termux::co::loop &loop)
+{
+    auto list = co_await termux::co::sensor_list(loop);
+    if (!list)
+    {
+        co_return;
+    }
+    /* every sensor is read at the same time */
+    for (std::string_view name : *list)
+    {
+        termux::co::spawn(read_sensor(loop, std::string(name)));
+    }
+    co_await read_volume(loop);
+}
+
+int main()
+{
+    termux::co::loop loop;
+    termux::co::spawn(run(loop));
+    loop.run();
+    termux::sensor_cleanup();
+    return 0;
+}
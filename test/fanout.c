@@ -0,0 +1,128 @@
+/*!
+ @file fanout.c
+ @brief Test termux api sensor streams shared by subscribers
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/sensor.h"
+#include "test.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+static int *spawns;
+static int *go;
+
+/* stands in for the service, counting the streams it starts, a stream of 3ms ends after 10 reports */
+static int backend(int argc, char *argv[])
+{
+    int delay = backend_int(argc, argv, "delay", 0);
+    __atomic_add_fetch(spawns, 1, __ATOMIC_SEQ_CST);
+    /* report once every subscriber is in, so each sees the stream from its first sample */
+    while (__atomic_load_n(go, __ATOMIC_SEQ_CST) == 0)
+    {
+        usleep(1000);
+    }
+    for (int i = 1; delay != 3 || i <= 10; ++i)
+    {
+        /* the reports carry another sensor before it that contains the name asked for */
+        printf("{\"linear accel\":{\"values\":[0]},\"accel\":{\"values\":[%i,0,-9.81]}}\n", i);
+        fflush(stdout);
+        usleep((useconds_t)delay * 1000);
+    }
+    return 0;
+}
+
+/* take every sample and check that none is skipped */
+static void *consumer(void *arg)
+{
+    termux_sub_s *sub = (termux_sub_s *)arg;
+    termux_sample_s sample;
+    uint64_t seq = 0;
+    intptr_t fail = 0;
+    for (int i = 0; i != 200; ++i)
+    {
+        if (termux_sub_next(sub, &sample, 1000) != 3 || (seq && sample.seq != seq + 1))
+        {
+            fail = 1;
+        }
+        fail |= (uint64_t)sample.values[0] != sample.seq;
+        seq = sample.seq;
+    }
+    return (void *)fail;
+}
+
+int main(void)
+{
+    int fail = 0;
+    spawns = (int *)mmap(0, sizeof(int) * 2, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    go = spawns + 1;
+    termux_backend(backend);
+
+    termux_sub_s *sub[3];
+    sub[0] = termux_subscribe("accel", 1, 64, TERMUX_OVERFLOW_OLDEST);
+    sub[1] = termux_subscribe("accel", 1, 8, TERMUX_OVERFLOW_OLDEST);
+    sub[2] = termux_subscribe("accel", 1, 8, TERMUX_OVERFLOW_NEWEST);
+    termux_sub_s *slow = termux_subscribe("accel", 20, 8, TERMUX_OVERFLOW_OLDEST);
+    fail += check(sub[0] && sub[1] && sub[2] && slow, "subscribe");
+    if (!(sub[0] && sub[1] && sub[2] && slow))
+    {
+        return fail;
+    }
+    __atomic_store_n(go, 1, __ATOMIC_SEQ_CST);
+
+    pthread_t thread;
+    void *ret = 0;
+    pthread_create(&thread, 0, consumer, sub[0]);
+    pthread_join(thread, &ret);
+    fail += check(ret == 0, "a consumer that keeps up sees every sample");
+    fail += check(*spawns == 2, "one stream for each sensor and delay");
+
+    termux_sub_stat_s stat[3];
+    for (int i = 0; i != 3; ++i)
+    {
+        termux_sub_stat(sub[i], stat + i);
+        printf("delivered=%lu taken=%lu dropped=%lu lag=%zu lag_max=%zu age=%.3fms subscribers=%u\n",
+               (unsigned long)stat[i].delivered, (unsigned long)stat[i].taken, (unsigned long)stat[i].dropped,
+               stat[i].lag, stat[i].lag_max, (double)stat[i].age / 1e6, stat[i].subscribers);
+    }
+    fail += check(stat[0].subscribers == 3 && stat[0].taken == 200 && stat[0].dropped == 0, "stat of the consumer");
+    fail += check(stat[1].lag == 8 && stat[1].dropped >= 190 && stat[2].lag == 8, "lag of idle subscribers");
+
+    termux_sample_s sample;
+    termux_sub_next(sub[1], &sample, 0);
+    fail += check(sample.seq > 190, "oldest samples overwritten");
+    termux_sub_next(sub[2], &sample, 0);
+    fail += check(sample.seq == 1, "newest samples dropped");
+
+    termux_unsubscribe(sub[0]);
+    termux_unsubscribe(sub[1]);
+    termux_sub_stat(sub[2], stat);
+    fail += check(stat->subscribers == 1 && waitpid(-1, 0, WNOHANG) == 0, "stream kept for the last subscriber");
+    termux_unsubscribe(sub[2]);
+    termux_unsubscribe(slow);
+    fail += check(waitpid(-1, 0, WNOHANG) < 0 && errno == ECHILD, "streams stopped");
+
+    /* a stream that ended is not shared with later subscribers */
+    int spawned = *spawns, n = 0;
+    sub[0] = termux_subscribe("accel", 3, 16, TERMUX_OVERFLOW_OLDEST);
+    while (termux_sub_next(sub[0], &sample, 1000) == 3)
+    {
+        ++n;
+    }
+    fail += check(n == 10 && errno == EPIPE, "stream ended");
+    sub[1] = termux_subscribe("accel", 3, 16, TERMUX_OVERFLOW_OLDEST);
+    fail += check(sub[1] && termux_sub_next(sub[1], &sample, 1000) == 3 && sample.seq == 1 && *spawns == spawned + 2,
+                  "a new stream after the one that ended");
+    termux_sub_stat(sub[1], stat);
+    fail += check(stat->subscribers == 1, "subscriber of the new stream alone");
+    termux_unsubscribe(sub[0]);
+    termux_unsubscribe(sub[1]);
+    return fail;
+}
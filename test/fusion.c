@@ -0,0 +1,210 @@
+/*!
+ @file fusion.c
+ @brief Test termux api orientation of the device
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/fusion.h"
+#include "termux/record.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RATE 200
+#define SECONDS 60
+#define SAMPLES (RATE * SECONDS)
+#define DEGREE (180 / M_PI)
+
+static const char *const names[3] = {"BMI160 Accelerometer", "BMI160 Gyroscope", "AK09918 Magnetic Field"};
+static double truth[SAMPLES][4];
+static double samples[3][SAMPLES][3];
+static uint64_t times[SAMPLES];
+
+static double noise(double sigma)
+{
+    double u = (rand() + 1.0) / (RAND_MAX + 2.0), v = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sigma * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/* turn a vector of the earth frame into the device frame */
+static void into(const double *q, const double *e, double *v)
+{
+    double x[3] = {1 - 2 * (q[2] * q[2] + q[3] * q[3]), 2 * (q[1] * q[2] - q[0] * q[3]), 2 * (q[1] * q[3] + q[0] * q[2])};
+    double y[3] = {2 * (q[1] * q[2] + q[0] * q[3]), 1 - 2 * (q[1] * q[1] + q[3] * q[3]), 2 * (q[2] * q[3] - q[0] * q[1])};
+    double z[3] = {2 * (q[1] * q[3] - q[0] * q[2]), 2 * (q[2] * q[3] + q[0] * q[1]), 1 - 2 * (q[1] * q[1] + q[2] * q[2])};
+    for (int i = 0; i != 3; ++i)
+    {
+        v[i] = x[i] * e[0] + y[i] * e[1] + z[i] * e[2];
+    }
+}
+
+static double angle(const double *p, const double *q)
+{
+    double d = fabs(p[0] * q[0] + p[1] * q[1] + p[2] * q[2] + p[3] * q[3]);
+    return 2 * acos(d < 1 ? d : 1) * DEGREE;
+}
+
+static double tilt(const double *p, const double *q)
+{
+    static const double up[3] = {0, 0, 1};
+    double u[3], v[3];
+    into(p, up, u);
+    into(q, up, v);
+    double d = u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+    return acos(d < 1 ? d : 1) * DEGREE;
+}
+
+/* a phone turned about every axis, sampled with the noise and the bias of a cheap imu */
+static void simulate(void)
+{
+    static const double gravity[3] = {0, 0, 9.81}, field[3] = {22, 0, -42};
+    double q[4] = {0.9, 0.2, -0.3, 0.25}, r = sqrt(0.9 * 0.9 + 0.2 * 0.2 + 0.3 * 0.3 + 0.25 * 0.25);
+    for (int i = 0; i != 4; ++i)
+    {
+        q[i] /= r;
+    }
+    for (int i = 0; i != SAMPLES; ++i)
+    {
+        double t = (double)i / RATE, w[3];
+        for (int k = 0; k != 10; ++k)
+        {
+            double s = t + k / (10.0 * RATE);
+            w[0] = 0.8 * sin(0.7 * s);
+            w[1] = 0.6 * sin(1.1 * s + 1);
+            w[2] = 0.9 * sin(0.5 * s + 2);
+            double d[4] = {
+                0.5 * (-q[1] * w[0] - q[2] * w[1] - q[3] * w[2]),
+                0.5 * (q[0] * w[0] + q[2] * w[2] - q[3] * w[1]),
+                0.5 * (q[0] * w[1] - q[1] * w[2] + q[3] * w[0]),
+                0.5 * (q[0] * w[2] + q[1] * w[1] - q[2] * w[0]),
+            };
+            r = 0;
+            for (int j = 0; j != 4; ++j)
+            {
+                q[j] += d[j] / (10.0 * RATE);
+                r += q[j] * q[j];
+            }
+            for (int j = 0; j != 4; ++j)
+            {
+                q[j] /= sqrt(r);
+            }
+        }
+        memcpy(truth[i], q, sizeof(q));
+        times[i] = 1000000000 + (uint64_t)i * (1000000000 / RATE);
+        into(q, gravity, samples[0][i]);
+        into(q, field, samples[2][i]);
+        t = (double)(i + 1) / RATE;
+        samples[1][i][0] = 0.8 * sin(0.7 * t) + 0.004;
+        samples[1][i][1] = 0.6 * sin(1.1 * t + 1) - 0.003;
+        samples[1][i][2] = 0.9 * sin(0.5 * t + 2) + 0.002;
+        for (int j = 0; j != 3; ++j)
+        {
+            samples[0][i][j] += noise(0.05);
+            samples[1][i][j] += noise(0.01);
+            samples[2][i][j] += noise(0.3);
+        }
+    }
+}
+
+int main(void)
+{
+    int fail = 0;
+    srand(1);
+    simulate();
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/fusion%i", (int)getpid());
+    termux_record_s *record = termux_record_open(path, TERMUX_RECORD_FLOAT, 1024, 0);
+    for (int i = 0; i != SAMPLES; ++i)
+    {
+        for (int s = 0; s != 3; ++s)
+        {
+            termux_record(record, names[s], samples[s][i], 3, times[i]);
+        }
+    }
+    termux_record_close(record);
+
+    /* play the recording back in the order of its times, the gyroscope last as it drives the updates */
+    termux_recording_s *recording = termux_recording_open(path);
+    fail += check(recording && termux_recording_sensors(recording) == 3, "recording");
+    memset(samples, 0, sizeof(samples));
+    size_t count[3] = {0, 0, 0};
+    for (size_t b = 0; recording && b != termux_recording_blocks(recording); ++b)
+    {
+        int s;
+        size_t n = termux_recording_block(recording, b, &s);
+        for (int a = 0; a != 3; ++a)
+        {
+            const float *x = (const float *)termux_recording_axis(recording, b, a);
+            for (size_t i = 0; i != n; ++i)
+            {
+                samples[s][count[s] + i][a] = x[i];
+            }
+        }
+        count[s] += n;
+    }
+    fail += check(count[0] == SAMPLES && count[1] == SAMPLES && count[2] == SAMPLES, "samples");
+    const char *name[3];
+    for (int s = 0; s != 3 && recording; ++s)
+    {
+        name[s] = termux_recording_name(recording, s);
+    }
+
+    termux_fusion_s marg[1], imu[1];
+    termux_fusion_init(marg, 0);
+    termux_fusion_init(imu, 0);
+    double start = 0, worst = 0, mean = 0, worst_tilt = 0;
+    for (int i = 0; i != SAMPLES && recording; ++i)
+    {
+        static const int order[3] = {0, 2, 1};
+        for (int k = 0; k != 3; ++k)
+        {
+            int s = order[k];
+            termux_fusion_sample(name[s], samples[s][i], 3, times[i], marg);
+        }
+        termux_fusion_update(imu, times[i], samples[1][i], samples[0][i], 0);
+        if (i == 0)
+        {
+            start = angle(marg->q, truth[i]);
+        }
+        if (i < RATE)
+        {
+            continue;
+        }
+        double e = angle(marg->q, truth[i]);
+        worst = e > worst ? e : worst;
+        mean += e / (SAMPLES - RATE);
+        e = tilt(imu->q, truth[i]);
+        worst_tilt = e > worst_tilt ? e : worst_tilt;
+    }
+    printf("error %.2f at the start, %.2f mean, %.2f worst, tilt without the field %.2f worst, degree\n",
+           start, mean, worst, worst_tilt);
+    fail += check(start < 2, "start from gravity and the field");
+    fail += check(marg->updates == SAMPLES && mean < 1 && worst < 2.5, "orientation");
+    fail += check(worst_tilt < 2.5, "tilt without the field");
+    termux_recording_close(recording);
+    unlink(path);
+
+    /* a quarter turn about z then a tenth about x */
+    termux_fusion_s ctx[1];
+    termux_fusion_init(ctx, 0);
+    double h = M_PI / 8, g = M_PI / 20;
+    ctx->q[0] = cos(h) * cos(g);
+    ctx->q[1] = cos(h) * sin(g);
+    ctx->q[2] = sin(h) * sin(g);
+    ctx->q[3] = sin(h) * cos(g);
+    double euler[3];
+    termux_fusion_euler(ctx, euler);
+    fail += check(fabs(euler[0] - M_PI / 10) < 1e-9 && fabs(euler[1]) < 1e-9 && fabs(euler[2] - M_PI / 4) < 1e-9, "euler");
+
+    /* a gap starts again from gravity */
+    static const double still[3] = {0, 0, 0}, flat[3] = {0, 0, 9.81};
+    termux_fusion_update(ctx, 1, still, flat, 0);
+    termux_fusion_update(ctx, 2 + TERMUX_FUSION_GAP, still, flat, 0);
+    fail += check(fabs(ctx->q[0]) > 1 - 1e-9, "gap");
+    return fail;
+}
@@ -0,0 +1,104 @@
+/*!
+ @file gorilla.c
+ @brief Test termux api compression of sensor samples
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/gorilla.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLES 5000
+#define AXES 3
+
+static uint64_t ns[SAMPLES];
+static double values[SAMPLES][AXES];
+
+/* encode the samples in blocks of at most cap bytes, decode them and compare bit for bit */
+static int roundtrip(size_t cap, size_t *blocks, size_t *byte)
+{
+    unsigned char *buf = (unsigned char *)malloc(cap);
+    termux_gorilla_s enc[1], dec[1];
+    size_t i = 0, j = 0;
+    *blocks = 0;
+    *byte = 0;
+    int ok = 1;
+    while (i != SAMPLES)
+    {
+        termux_gorilla_init(enc, buf, cap, AXES);
+        while (i != SAMPLES && termux_gorilla_put(enc, ns[i], values[i]) == 0)
+        {
+            ++i;
+        }
+        size_t n = termux_gorilla_end(enc);
+        ok &= n <= cap && enc->count > 0;
+        *byte += n;
+        ++*blocks;
+        ok &= termux_gorilla_open(dec, buf, n) == 0 && dec->count == enc->count && dec->axes == AXES;
+        uint64_t t;
+        double v[AXES];
+        while (termux_gorilla_get(dec, &t, v) == 0)
+        {
+            ok &= t == ns[j] && memcmp(v, values[j], sizeof(v)) == 0;
+            ++j;
+        }
+        if (enc->count == 0)
+        {
+            break;
+        }
+    }
+    free(buf);
+    return ok && j == SAMPLES;
+}
+
+int main(void)
+{
+    int fail = 0;
+    size_t blocks, byte;
+    srand(1);
+
+    /* a sensor at 200Hz with jitter, values in float precision as the service reports them */
+    uint64_t t = 123456789000;
+    for (int i = 0; i != SAMPLES; ++i)
+    {
+        t += 5000000 + (uint64_t)(rand() % 100000);
+        ns[i] = t;
+        values[i][0] = (float)(sin(i / 50.0) + (rand() % 100) / 1e4);
+        values[i][1] = (float)0.25;
+        values[i][2] = (float)(9.81 + (rand() % 1000) / 1e5);
+    }
+    fail += check(roundtrip(termux_gorilla_bound(SAMPLES, AXES), &blocks, &byte) && blocks == 1, "one block");
+    printf("%zu bytes for %zu raw, ratio %.2f\n", byte, sizeof(ns) + sizeof(values), (double)(sizeof(ns) + sizeof(values)) / (double)byte);
+    fail += check(byte * 3 < sizeof(ns) + sizeof(values), "smaller than a third");
+    fail += check(roundtrip(4096, &blocks, &byte) && blocks > 1, "many blocks");
+
+    /* every kind of step and value */
+    for (int i = 0; i != SAMPLES; ++i)
+    {
+        int kind = rand() % 6;
+        ns[i] = kind == 0 ? (uint64_t)rand() << 40 : i ? ns[i - 1] + (uint64_t)(rand() % (1 << (kind * 5))) : 0;
+        for (int a = 0; a != AXES; ++a)
+        {
+            uint64_t bits = ((uint64_t)rand() << 62) ^ ((uint64_t)rand() << 31) ^ (uint64_t)rand();
+            memcpy(&values[i][a], &bits, sizeof(bits));
+        }
+        values[i][rand() % AXES] = i % 7 == 0 ? NAN : i % 11 == 0 ? -INFINITY : i % 13 == 0 ? 0.0 : -0.0;
+    }
+    fail += check(roundtrip(termux_gorilla_bound(SAMPLES, AXES), &blocks, &byte) && byte <= termux_gorilla_bound(SAMPLES, AXES), "worst case");
+
+    /* times that jump between the ends of the range, the steps wrap */
+    for (int i = 0; i != SAMPLES; ++i)
+    {
+        ns[i] = i % 4 == 0 ? 0 : i % 4 == 1 ? UINT64_MAX : i % 4 == 2 ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    }
+    fail += check(roundtrip(termux_gorilla_bound(SAMPLES, AXES), &blocks, &byte), "times far apart");
+
+    termux_gorilla_s dec[1];
+    unsigned char junk[8] = {1, 0, 0, 0, 99, 0, 0, 0};
+    fail += check(termux_gorilla_open(dec, junk, sizeof(junk)) != 0, "not a block");
+    return fail;
+}
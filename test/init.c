@@ -0,0 +1,89 @@
+/*!
+ @file init.c
+ @brief Test termux api asynchronous and cached init
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/api.h"
+#include "test.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static char dir[] = "/tmp/termux-init-XXXXXX";
+static char am[sizeof(dir) + 16];
+static char calls[sizeof(dir) + 16];
+
+/* stands in for am, logging each call and failing when asked to */
+static const char script[] =
+    "#!/bin/sh\n"
+    "echo \"$1\" >> \"$0.calls\"\n"
+    "sleep 0.2\n"
+    "if [ -n \"$STANDIN_FAIL\" ]; then echo 'Error: stand-in failure' >&2; fi\n";
+
+static int count(void)
+{
+    int n = 0;
+    FILE *log = fopen(calls, "r");
+    if (log)
+    {
+        for (int c = fgetc(log); c != EOF; c = fgetc(log))
+        {
+            n += c == '\n';
+        }
+        fclose(log);
+    }
+    return n;
+}
+
+/* check with the calls of am and the time since the last check */
+static int check_calls(int expr, const char *what)
+{
+    char line[96];
+    snprintf(line, sizeof(line), "%-32s calls=%i %.1fms", what, count(), elapse());
+    return check(expr, line);
+}
+
+int main(void)
+{
+    int fail = 0;
+    if (mkdtemp(dir) == 0)
+    {
+        return 1;
+    }
+    snprintf(am, sizeof(am), "%s/am", dir);
+    snprintf(calls, sizeof(calls), "%s/am.calls", dir);
+    FILE *out = fopen(am, "w");
+    fputs(script, out);
+    fclose(out);
+    chmod(am, 0700);
+    setenv("TMPDIR", dir, 1);
+    termux_am(am);
+
+    elapse();
+    termux_init_s *ctx = termux_init_async();
+    fail += check_calls(ctx && !termux_init_done(ctx), "async start returns at once");
+    fail += check_calls(termux_init_wait(ctx) == 0 && count() == 1, "wait for am");
+    fail += check_calls(termux_init() == 0 && count() == 1, "cached start skips am");
+    ctx = termux_init_async();
+    fail += check_calls(termux_init_done(ctx) && termux_init_wait(ctx) == 0, "cached async start is done");
+
+    termux_exit();
+    fail += check_calls(count() == 2, "exit runs am");
+    setenv("STANDIN_FAIL", "1", 1);
+    fail += check_calls(termux_init() != 0 && count() == 3, "exit forgets the cached start");
+    fail += check_calls(termux_init() != 0 && count() == 4, "failure is not cached");
+    unsetenv("STANDIN_FAIL");
+    termux_init_cache(0);
+    fail += check_calls(termux_init() == 0 && count() == 5, "start without cache");
+    fail += check_calls(termux_init() == 0 && count() == 6, "start without cache again");
+
+    termux_exit();
+    unlink(calls);
+    unlink(am);
+    rmdir(dir);
+    return fail != 0;
+}
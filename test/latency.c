@@ -0,0 +1,79 @@
+/*!
+ @file latency.c
+ @brief Test termux api latency
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/api.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+static unsigned int wait_us; /* time the stand-in takes, set before each call */
+
+/* stands in for the service, answering after wait_us */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    usleep(wait_us);
+    return 0;
+}
+
+static termux_latency_s display(int api, const char *name)
+{
+    termux_latency_s ctx[1] = {{0}};
+    if (termux_latency(api, ctx) == 0)
+    {
+        printf("%-10s count=%lu kills=%lu p50=%luus p99=%luus deadline=%lums\n",
+               name, ctx->count, ctx->kills, ctx->p50, ctx->p99, ctx->deadline);
+    }
+    return *ctx;
+}
+
+int main(void)
+{
+    int fail = 0;
+    termux_latency_s ctx;
+    termux_backend(backend);
+
+    /* the deadline is scale times p99 once there are enough calls */
+    termux_timeout(TERMUX_API_TORCH, 50, 5000, 4);
+    wait_us = 20000;
+    for (int i = 0; i < 16; ++i)
+    {
+        termux_torch(i & 1);
+    }
+    ctx = display(TERMUX_API_TORCH, "torch");
+    fail += check(ctx.count == 16 && ctx.kills == 0, "calls counted");
+    fail += check(ctx.p50 >= 20000 && ctx.p50 <= ctx.p99, "quantiles");
+    fail += check(ctx.deadline == ctx.p99 * 4 / 1000 + 1, "deadline follows p99");
+
+    /* fast calls are held to the floor */
+    termux_timeout(TERMUX_API_BRIGHTNESS, 50, 5000, 4);
+    wait_us = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        termux_brightness(i);
+    }
+    ctx = display(TERMUX_API_BRIGHTNESS, "brightness");
+    fail += check(ctx.p99 * 4 / 1000 + 1 < 50 && ctx.deadline == 50, "deadline at the floor");
+
+    /* slow calls are held to the ceiling */
+    termux_timeout(TERMUX_API_VIBRATE, 50, 200, 4);
+    wait_us = 100000;
+    for (int i = 0; i < 8; ++i)
+    {
+        termux_vibrate(1, 0);
+    }
+    ctx = display(TERMUX_API_VIBRATE, "vibrate");
+    fail += check(ctx.p99 * 4 / 1000 + 1 > 200 && ctx.deadline == 200, "deadline at the ceiling");
+
+    /* a deadline that no call can meet */
+    termux_timeout_once(1);
+    fail += check(termux_brightness(~0) == TERMUX_TIMEOUT, "call past its deadline");
+    ctx = display(TERMUX_API_BRIGHTNESS, "brightness");
+    fail += check(ctx.count == 9 && ctx.kills == 1, "killed call counted");
+    return fail;
+}
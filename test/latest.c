@@ -0,0 +1,89 @@
+/*!
+ @file latest.c
+ @brief Test termux api sensor handles that keep the newest sample
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/sensor.h"
+#include "test.h"
+
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+static int *spawns;
+
+/* stands in for the service, counting the streams it starts, a sensor listed first contains the name too */
+static int backend(int argc, char *argv[])
+{
+    int delay = backend_int(argc, argv, "delay", 0);
+    __atomic_add_fetch(spawns, 1, __ATOMIC_SEQ_CST);
+    /* the first sample comes after the sensor warms up */
+    usleep(20000);
+    for (int i = 1;; ++i)
+    {
+        printf("{\"light uncalibrated\":{\"values\":[0]},\"light\":{\"values\":[%i,%i]}}\n", i, -i);
+        fflush(stdout);
+        usleep((useconds_t)delay * 1000);
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int fail = 0;
+    termux_sample_s sample;
+    uint64_t age = 0;
+    spawns = (int *)mmap(0, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    termux_backend(backend);
+
+    termux_sensor_s *light = termux_sensor_open("light", 5, 150);
+    fail += check(light != 0, "open");
+    if (light == 0)
+    {
+        return fail;
+    }
+    fail += check(termux_sensor_latest(light, &sample, &age) == ~0 && errno == EAGAIN, "no sample while warming up");
+    while (termux_sensor_latest(light, &sample, &age) < 0)
+    {
+        usleep(1000);
+    }
+    fail += check(sample.n == 2 && sample.values[0] == -sample.values[1], "first sample");
+
+    uint64_t seq = sample.seq;
+    int ok = 1;
+    elapse();
+    for (int i = 0; i != 10000; ++i)
+    {
+        ok &= termux_sensor_latest(light, &sample, &age) == 2 && sample.seq >= seq;
+        ok &= (uint64_t)sample.values[0] == sample.seq;
+        seq = sample.seq;
+    }
+    double ms = elapse();
+    printf("10000 reads in %.3fms, age %.3fms\n", ms, (double)age / 1e6);
+    fail += check(ok && *spawns == 1, "reads without spawning");
+    usleep(50000);
+    termux_sensor_latest(light, &sample, &age);
+    fail += check(sample.seq > seq && age < 50000000, "newer sample");
+
+    usleep(400000);
+    fail += check(!termux_sensor_running(light), "stopped while idle");
+    fail += check(waitpid(-1, 0, WNOHANG) < 0 && errno == ECHILD, "child reaped");
+    /* the stream stopped about 150ms after the last read */
+    fail += check(termux_sensor_latest(light, &sample, &age) == 2 && age > 150000000, "old sample while idle");
+    fail += check(termux_sensor_running(light), "started again by a read");
+    while (termux_sensor_latest(light, &sample, &age) == 2 && age > 150000000)
+    {
+        usleep(1000);
+    }
+    fail += check(age < 50000000 && *spawns == 2, "fresh sample again");
+
+    termux_sensor_close(light);
+    fail += check(waitpid(-1, 0, WNOHANG) < 0 && errno == ECHILD, "closed");
+    return fail;
+}
@@ -0,0 +1,57 @@
+/*!
+ @file loop.cpp
+ @brief Test termux api reactor of the C++20 coroutines
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/co.hpp"
+#include "test.h"
+
+#include <coroutine>
+#include <unistd.h>
+
+/* stands in for the service, every call succeeds */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    return 0;
+}
+
+static termux::co::task<void> torch(termux::co::loop &loop, int *status)
+{
+    *status = (co_await termux::co::torch(loop, true)).code();
+}
+
+int main()
+{
+    int fail = 0;
+    termux_backend(backend);
+    /* a loop that hangs is killed instead of stalling the tests */
+    alarm(10);
+
+    termux::co::loop loop;
+    double ms = (elapse(), loop.poll(), elapse());
+    fail += check(ms < 100, "poll returns at once with nothing in flight");
+    loop.run();
+    fail += check(elapse() < 100, "run returns at once with nothing in flight");
+
+    /* the call ends in await_ready, nothing is watched */
+    termux_cancel_s *token = termux_cancel_new();
+    termux_cancel(token);
+    termux_cancel_once(token);
+    int status = 0;
+    termux::co::spawn(torch(loop, &status));
+    fail += check(status == TERMUX_CANCEL && loop.size() == 0, "a call that fails to start");
+    loop.run();
+    fail += check(elapse() < 100, "run returns after a call that fails to start");
+
+    status = ~0;
+    termux::co::spawn(torch(loop, &status));
+    fail += check(loop.size() == 1, "a call in flight");
+    loop.run();
+    fail += check(status == 0 && loop.size() == 0, "run returns once the call ends");
+
+    termux_cancel_free(token);
+    return fail;
+}
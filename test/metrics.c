@@ -0,0 +1,143 @@
+/*!
+ @file metrics.c
+ @brief Test termux api metrics of the sensors of streams
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/metrics.h"
+#include "test.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/* stands in for the service, a stamped sensor and one without stamps every 5ms, three reports lost once */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    for (int i = 1;; ++i)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_BOOTTIME, &ts);
+        long long stamp = (long long)ts.tv_sec * 1000000000 + ts.tv_nsec - 2000000;
+        if (i < 30 || i > 32)
+        {
+            printf("{\"light\":{\"values\":[%i],\"timestamp\":%lld},\"prox\":{\"values\":[1]}}\n", i, stamp);
+            fflush(stdout);
+        }
+        usleep(5000);
+    }
+    return 0;
+}
+
+static void show(const termux_queue_metric_s *queue, const termux_metric_s *metric, int sensors)
+{
+    printf("%llu reads, %llu bytes, backlog %llu mean %llu max, queued %llu max %llu\n",
+           (unsigned long long)queue->reads, (unsigned long long)queue->bytes,
+           (unsigned long long)queue->backlog, (unsigned long long)queue->backlog_max,
+           (unsigned long long)queue->queued, (unsigned long long)queue->queued_max);
+    for (int i = 0; i != sensors; ++i)
+    {
+        const termux_metric_s *m = metric + i;
+        printf("%s: %llu samples, %llu stamped, latency %.3fms max %.3fms, interval %.3fms, "
+               "jitter %.3fms max %.3fms, %llu gaps, %llu dropped, parse %.3fus max %.3fus\n",
+               m->name, (unsigned long long)m->samples, (unsigned long long)m->stamped,
+               (double)m->latency / 1e6, (double)m->latency_max / 1e6, (double)m->interval / 1e6,
+               (double)m->jitter / 1e6, (double)m->jitter_max / 1e6, (unsigned long long)m->gaps,
+               (unsigned long long)m->dropped, (double)m->parse / 1e3, (double)m->parse_max / 1e3);
+        printf("   jitter");
+        for (int b = 0; b != TERMUX_METRIC_BUCKETS; ++b)
+        {
+            printf(" %llu", (unsigned long long)m->jitter_hist[b]);
+        }
+        printf("\n");
+    }
+}
+
+static uint64_t hist_sum(const termux_metric_s *metric)
+{
+    uint64_t sum = 0;
+    for (int b = 0; b != TERMUX_METRIC_BUCKETS; ++b)
+    {
+        sum += metric->jitter_hist[b];
+    }
+    return sum;
+}
+
+int main(void)
+{
+    int fail = 0;
+    termux_metric_s metric[4];
+    termux_queue_metric_s queue;
+
+    /* a sample every 10ms, then 40ms later, then 10ms later */
+    termux_metrics_s *metrics = termux_metrics_new();
+    for (uint64_t t = 0; t != 100; t += 10)
+    {
+        termux_metrics_sample(metrics, "accel", t * 1000000, t * 1000000 + 500000, 1000);
+    }
+    termux_metrics_sample(metrics, "accel", 130000000, 130000000, 3000);
+    termux_metrics_sample(metrics, "accel", 140000000, 140000000, 2000);
+    termux_metrics_read(metrics, 100);
+    termux_metrics_read(metrics, 300);
+    fail += check(termux_metrics_snapshot(metrics, &queue, metric, 4) == 1, "one sensor");
+    fail += check(metric->samples == 12 && metric->stamped == 10, "samples counted");
+    fail += check(metric->latency == 500000 && metric->latency_max == 500000, "latency of stamped samples");
+    fail += check(metric->interval == 10000000 && metric->gaps == 1 && metric->dropped == 3, "gap and drops");
+    fail += check(metric->jitter == 0 && metric->jitter_hist[0] == 9 && hist_sum(metric) == 9, "jitter histogram");
+    fail += check(metric->parse == 1250 && metric->parse_max == 3000, "parse time");
+    fail += check(queue.reads == 2 && queue.backlog == 200 && queue.backlog_max == 300, "queue of the pipe");
+
+    /* a stream started again at 40ms is not a gap */
+    termux_metrics_restart(metrics);
+    for (uint64_t t = 200; t != 400; t += 40)
+    {
+        termux_metrics_sample(metrics, "accel", t * 1000000, t * 1000000, 1000);
+    }
+    termux_metrics_snapshot(metrics, &queue, metric, 4);
+    fail += check(metric->samples == 17 && metric->interval == 40000000 && metric->gaps == 1, "interval learned again");
+
+    /* a name longer than the names kept is still the same sensor */
+    const char *name = "LSM6DSO Accelerometer Non-wakeup Uncalibrated Secondary Display Sensor";
+    termux_metrics_sample(metrics, name, 0, 0, 1000);
+    termux_metrics_sample(metrics, name, 0, 0, 1000);
+    fail += check(termux_metrics_snapshot(metrics, &queue, metric, 4) == 2 && metric[1].samples == 2, "long name");
+    termux_metrics_reset(metrics);
+    fail += check(termux_metrics_snapshot(metrics, &queue, metric, 4) == 0 && queue.reads == 0, "reset");
+    termux_metrics_free(metrics);
+
+    termux_backend(backend);
+    termux_sensor_s *light = termux_sensor_open("light", 5, 0);
+    fail += check(light != 0, "open");
+    if (light == 0)
+    {
+        return fail;
+    }
+    usleep(400000);
+    int sensors = termux_metrics_snapshot(termux_sensor_metrics(light), &queue, metric, 4);
+    termux_sensor_close(light);
+    show(&queue, metric, sensors);
+    fail += check(sensors == 2, "sensors of the reports");
+    fail += check(metric[0].samples > 40 && metric[0].stamped == metric[0].samples, "stamped sensor");
+    fail += check(metric[0].latency >= 2000000 && metric[0].latency < 50000000, "latency from the stamps");
+    fail += check(metric[0].interval > 4000000 && metric[0].interval < 10000000, "interval");
+    fail += check(metric[0].gaps >= 1 && metric[0].dropped >= 2 && metric[0].dropped <= 4 * metric[0].gaps, "lost reports");
+    fail += check(hist_sum(metric) && hist_sum(metric) < metric[0].samples, "jitter histogram of the stream");
+    fail += check(metric[0].parse && metric[0].parse <= metric[0].parse_max, "parse time of the stream");
+    fail += check(metric[1].samples == metric[0].samples && metric[1].stamped == 0 && metric[1].latency == 0,
+                  "sensor without stamps");
+    fail += check(queue.reads && queue.bytes && queue.backlog <= queue.backlog_max, "reads of the stream");
+
+    termux_sub_s *sub = termux_subscribe("light", 5, 8, TERMUX_OVERFLOW_OLDEST);
+    fail += check(sub != 0, "subscribe");
+    if (sub == 0)
+    {
+        return fail;
+    }
+    usleep(100000);
+    termux_metrics_snapshot(termux_sub_metrics(sub), &queue, metric, 4);
+    fail += check(queue.queued == 8 && queue.queued_max == 8, "samples waiting for the subscriber");
+    termux_unsubscribe(sub);
+    return fail;
+}
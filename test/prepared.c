@@ -0,0 +1,153 @@
+/*!
+ @file prepared.c
+ @brief Test termux api prepared calls
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/call.h"
+#include "test.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static char log_path[64];
+
+/* stands in for the service, logging the arguments of every call */
+static int backend(int argc, char *argv[])
+{
+    char line[512];
+    size_t n = 0;
+    for (int i = 1; i < argc && n < sizeof(line) - 64; ++i)
+    {
+        n += (size_t)snprintf(line + n, sizeof(line) - n, i > 1 ? " %s" : "%s", argv[i]);
+    }
+    line[n++] = '\n';
+    int fd = open(log_path, O_WRONLY | O_APPEND);
+    ssize_t ok = write(fd, line, n);
+    close(fd);
+    if (strcmp(argv[1], "Sensor") == 0)
+    {
+        static const char reply[] = "{\"gyro\":{\"values\":[1,2,3]}}";
+        ok = write(STDOUT_FILENO, reply, sizeof(reply) - 1);
+    }
+    return ok < 0;
+}
+
+/* the last two lines of the log */
+static void last(char *blocking, char *prepared, size_t size)
+{
+    FILE *log = fopen(log_path, "r");
+    blocking[0] = prepared[0] = 0;
+    for (char line[512]; fgets(line, sizeof(line), log);)
+    {
+        strcpy(blocking, prepared);
+        snprintf(prepared, size, "%s", line);
+    }
+    fclose(log);
+}
+
+static int failed = 0;
+
+/* run a prepared call after the blocking one and compare their arguments */
+static int same(termux_prepared_s *ctx, int ok)
+{
+    char blocking[512], prepared[512];
+    int status = termux_prepared_run(ctx);
+    last(blocking, prepared, sizeof(prepared));
+    int pass = ok == status && strcmp(blocking, prepared) == 0;
+    prepared[strcspn(prepared, "\n")] = 0;
+    return check(pass, prepared);
+}
+
+int main(void)
+{
+    snprintf(log_path, sizeof(log_path), "/tmp/termux-prepared.%i", (int)getpid());
+    close(open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600));
+    termux_backend(backend);
+
+    termux_call_s call[1] = {{.call = TERMUX_CALL_VIBRATE, .in.vibrate = {100, 0}}};
+    termux_prepared_s *ctx = termux_prepare(call);
+    termux_vibrate(100, 0);
+    failed += same(ctx, 0);
+    termux_prepared_call(ctx)->in.vibrate.ms = 250;
+    termux_vibrate(250, 0);
+    failed += same(ctx, 0);
+    termux_prepared_call(ctx)->in.vibrate.force = 1;
+    termux_vibrate(250, 1);
+    failed += same(ctx, 0);
+    termux_prepared_call(ctx)->in.vibrate.ms = -1;
+    termux_vibrate(-1, 1);
+    failed += same(ctx, 0);
+    termux_prepared_free(ctx);
+
+    call->call = TERMUX_CALL_BRIGHTNESS;
+    call->in.brightness = 42;
+    ctx = termux_prepare(call);
+    termux_brightness(42);
+    failed += same(ctx, 0);
+    termux_prepared_call(ctx)->in.brightness = -1;
+    termux_brightness(-1);
+    failed += same(ctx, 0);
+    termux_prepared_call(ctx)->in.brightness = 255;
+    termux_brightness(255);
+    failed += same(ctx, 0);
+
+    /* the same prepared call turned into another kind */
+    termux_prepared_call(ctx)->call = TERMUX_CALL_TORCH;
+    termux_prepared_call(ctx)->in.torch = 1;
+    termux_torch(1);
+    failed += same(ctx, 0);
+    termux_prepared_call(ctx)->in.torch = 0;
+    termux_torch(0);
+    failed += same(ctx, 0);
+    termux_prepared_free(ctx);
+
+    call->call = TERMUX_CALL_DIALOG_COUNTER;
+    call->in.dialog.title = "counter";
+    call->in.dialog.min = -5;
+    call->in.dialog.max = 5;
+    call->in.dialog.value = 0;
+    ctx = termux_prepare(call);
+    termux_dialog_counter("counter", -5, 5, &(int){0});
+    failed += same(ctx, ~0);
+    termux_prepared_call(ctx)->in.dialog.value = 2147483647;
+    termux_prepared_call(ctx)->in.dialog.min = -2147483647 - 1;
+    termux_dialog_counter("counter", -2147483647 - 1, 5, &(int){2147483647});
+    failed += same(ctx, ~0);
+    termux_prepared_free(ctx);
+
+    termux_call_s sensor[1] = {{.call = TERMUX_CALL_SENSOR, .in.sensor = "accel"}};
+    ctx = termux_prepare(sensor);
+    double *values = 0;
+    termux_sensor("accel", &values);
+    failed += same(ctx, ~0);
+    termux_prepared_call(ctx)->in.sensor = "gyro";
+    termux_sensor("gyro", &values);
+    free(values);
+    failed += same(ctx, 3);
+    values = termux_prepared_call(ctx)->out.values;
+    if (values == 0 || values[2] != 3)
+    {
+        printf("FAIL values\n");
+        ++failed;
+    }
+    free(values);
+    termux_prepared_free(ctx);
+
+    termux_call_s volume[1] = {{.call = TERMUX_CALL_VOLUME_SET, .in.volume = {"music", 3}}};
+    ctx = termux_prepare(volume);
+    for (int i = 0; i != 3; ++i)
+    {
+        termux_prepared_call(ctx)->in.volume.volume = 3 + i;
+        /* the blocking call leaves unchanged streams alone, so compare with a fresh call */
+        termux_call_s once[1] = {{.call = TERMUX_CALL_VOLUME_SET, .in.volume = {"music", 3 + i}}};
+        termux_call(once);
+        failed += same(ctx, 0);
+    }
+    termux_prepared_free(ctx);
+
+    unlink(log_path);
+    return failed;
+}
@@ -0,0 +1,100 @@
+/*!
+ @file reader.c
+ @brief Test termux api options and statistics of reader threads
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/sensor.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* stands in for the service, a report of two sensors every 5ms that stalls once for 100ms */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    for (int i = 1;; ++i)
+    {
+        printf("{\"light\":{\"values\":[%i]},\"light uncalibrated\":{\"values\":[%i]}}\n", i, i);
+        fflush(stdout);
+        usleep(i == 40 ? 100000 : 5000);
+    }
+    return 0;
+}
+
+static void show(const char *name, const termux_reader_stat_s *stat)
+{
+    printf("%s: %llu reports, %llu late, %llu missed, jitter %.3fms mean %.3fms max, applied %#x\n", name,
+           (unsigned long long)stat->reports, (unsigned long long)stat->late, (unsigned long long)stat->missed,
+           (double)stat->jitter / 1e6, (double)stat->jitter_max / 1e6, stat->applied);
+}
+
+int main(void)
+{
+    int fail = 0;
+    termux_reader_stat_s stat;
+    termux_sample_s sample;
+    termux_backend(backend);
+
+    termux_reader_s options;
+    memset(&options, 0, sizeof(options));
+    options.cpus = 1;
+    options.policy = TERMUX_READER_OTHER;
+    options.priority = 5;
+    options.lock = 1;
+    options.buffer = 0x10000;
+    termux_reader_config(&options);
+
+    termux_sensor_s *light = termux_sensor_open("light", 5, 0);
+    fail += check(light != 0, "open");
+    if (light == 0)
+    {
+        return fail;
+    }
+    usleep(500000);
+    termux_sensor_latest(light, &sample, 0);
+    termux_sensor_reader(light, &stat);
+    termux_sensor_close(light);
+    show("handle", &stat);
+    fail += check(stat.reports > 40 && stat.reports <= sample.seq, "reports counted once");
+    fail += check((stat.applied & TERMUX_READER_AFFINITY) != 0, "affinity");
+    fail += check((stat.applied & TERMUX_READER_PRIORITY) != 0, "nice value");
+    fail += check((stat.applied & TERMUX_READER_BUFFER) != 0, "buffer touched");
+    printf("buffer %slocked\n", stat.applied & TERMUX_READER_LOCKED ? "" : "not ");
+    fail += check(stat.missed >= 15 && stat.missed <= 25, "stall counted as missed samples");
+    fail += check(stat.late >= 1 && stat.late <= 3 && stat.jitter_max >= 90000000, "stall counted as late");
+    fail += check(stat.jitter < stat.jitter_max, "mean jitter below the largest");
+
+    options.policy = TERMUX_READER_FIFO;
+    options.priority = 10;
+    termux_reader_config(&options);
+    termux_sub_s *sub = termux_subscribe("light", 5, 256, TERMUX_OVERFLOW_OLDEST);
+    fail += check(sub != 0, "subscribe");
+    if (sub == 0)
+    {
+        return fail;
+    }
+    for (int i = 0; i != 20; ++i)
+    {
+        fail += termux_sub_next(sub, &sample, 1000) != 1;
+    }
+    termux_sub_reader(sub, &stat);
+    show("subscriber", &stat);
+    printf("real-time scheduling %s\n", stat.applied & TERMUX_READER_PRIORITY ? "applied" : "refused");
+    fail += check(stat.reports >= 20 && (stat.applied & TERMUX_READER_AFFINITY) != 0, "shared stream counted");
+    termux_unsubscribe(sub);
+
+    termux_reader_config(0);
+    light = termux_sensor_open("light", 5, 0);
+    while (termux_sensor_latest(light, &sample, 0) < 0)
+    {
+        usleep(1000);
+    }
+    termux_sensor_reader(light, &stat);
+    termux_sensor_close(light);
+    fail += check(stat.applied == 0, "options reset");
+    return fail;
+}
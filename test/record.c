@@ -0,0 +1,133 @@
+/*!
+ @file record.c
+ @brief Test termux api recordings of sensor samples
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/record.h"
+#include "test.h"
+
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SAMPLES 1000000
+
+/* stands in for the service, reporting two sensors a hundred times */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    for (int i = 0; i != 100; ++i)
+    {
+        printf("{\"accel\":{\"values\":[%i,1,2]},\"light\":{\"values\":[%i]}}\n", i, -i);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+static double cpu(void)
+{
+    static struct timespec t0;
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    double ms = (double)(t.tv_sec - t0.tv_sec) * 1e3 + (double)(t.tv_nsec - t0.tv_nsec) / 1e6;
+    t0 = t;
+    return ms;
+}
+
+int main(void)
+{
+    int fail = 0;
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/record%i", (int)getpid());
+
+    termux_record_s *record = termux_record_open(path, TERMUX_RECORD_FLOAT, 1000, 100);
+    fail += check(record != 0, "create a recording");
+    if (record == 0)
+    {
+        return fail;
+    }
+    elapse();
+    cpu();
+    int ok = 1;
+    for (int i = 0; i != SAMPLES; ++i)
+    {
+        double accel[3] = {i, i * 0.5, -9.81};
+        double light[1] = {i};
+        ok &= termux_record(record, "accel", accel, 3, (uint64_t)i + 1) == 0;
+        if (i % 4 == 0)
+        {
+            ok &= termux_record(record, "light", light, 1, (uint64_t)i + 1) == 0;
+        }
+    }
+    ok &= termux_record_close(record) == 0;
+    double ms = elapse();
+    printf("%i samples in %.1fms, %.1fms of cpu, %.0f kHz\n", SAMPLES * 5 / 4, ms, cpu(), SAMPLES * 1.25 / ms);
+    fail += check(ok, "append samples");
+
+    termux_recording_s *recording = termux_recording_open(path);
+    fail += check(recording != 0, "map the recording");
+    if (recording == 0)
+    {
+        return fail;
+    }
+    fail += check(termux_recording_type(recording) == TERMUX_RECORD_FLOAT && termux_recording_sensors(recording) == 2 &&
+                      strcmp(termux_recording_name(recording, 0), "accel") == 0 && termux_recording_axes(recording, 0) == 3 &&
+                      termux_recording_axes(recording, 1) == 1,
+                  "header");
+    size_t samples[2] = {0, 0};
+    ok = 1;
+    for (size_t b = 0; b != termux_recording_blocks(recording); ++b)
+    {
+        int sensor = 0;
+        size_t n = termux_recording_block(recording, b, &sensor);
+        const uint64_t *ns = termux_recording_ns(recording, b);
+        const float *x = (const float *)termux_recording_axis(recording, b, 0);
+        const float *z = (const float *)termux_recording_axis(recording, b, 2);
+        for (size_t i = 0; i != n; ++i)
+        {
+            ok &= x[i] == (float)(ns[i] - 1);
+            ok &= sensor || z[i] == -9.81f;
+        }
+        ok &= sensor || z != 0;
+        ok &= !sensor || z == 0;
+        samples[sensor] += n;
+    }
+    termux_recording_close(recording);
+    fail += check(ok && samples[0] == SAMPLES && samples[1] == SAMPLES / 4, "columns of every block");
+
+    record = termux_record_open(path, TERMUX_RECORD_DOUBLE, 16, 0);
+    termux_backend(backend);
+    termux_stream_s *stream = termux_stream_open("accel,light", 0);
+    while (termux_stream_read(stream, termux_record_sample, record) >= 0)
+    {
+        termux_stream_wait(stream, -1);
+    }
+    termux_stream_close(stream);
+    termux_record_close(record);
+    recording = termux_recording_open(path);
+    size_t accel = 0;
+    ok = recording && termux_recording_type(recording) == TERMUX_RECORD_DOUBLE;
+    for (size_t b = 0; ok && b != termux_recording_blocks(recording); ++b)
+    {
+        int sensor = 0;
+        size_t n = termux_recording_block(recording, b, &sensor);
+        const double *x = (const double *)termux_recording_axis(recording, b, 0);
+        for (size_t i = 0; i != n && sensor == 0; ++i)
+        {
+            ok &= x[i] == (double)accel++;
+        }
+    }
+    termux_recording_close(recording);
+    fail += check(ok && accel == 100, "record a stream");
+
+    FILE *file = fopen(path, "w");
+    fprintf(file, "{\"accel\":{\"values\":[1,2,3]}}\n");
+    fclose(file);
+    fail += check(termux_recording_open(path) == 0 && errno == EPROTO, "not a recording");
+    unlink(path);
+    return fail;
+}
@@ -0,0 +1,117 @@
+/*!
+ @file replay.c
+ @brief Test termux api replay of recorded sensors
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/replay.h"
+#include "test.h"
+
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STEP 10000000 /* 100Hz */
+
+/* check with the time it took */
+static int check_time(int expr, const char *what, double ms)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "%-36s %.1fms", what, ms);
+    return check(expr, line);
+}
+
+static void count(const char *sensor, const double *values, int n, uint64_t ns, void *arg)
+{
+    long *ctx = (long *)arg;
+    (void)ns;
+    /* reports are in order and hold the sample number in the first value */
+    if (strcmp(sensor, "BMI160 Accelerometer") == 0 && n == 3 && (long)values[0] >= ctx[1])
+    {
+        ctx[0] += 1;
+        ctx[1] = (long)values[0];
+    }
+}
+
+static long stream(const char *sensors, int delay)
+{
+    long ctx[2] = {0, 0};
+    termux_stream_s *stream = termux_stream_open(sensors, delay);
+    while (stream && termux_stream_read(stream, count, ctx) >= 0)
+    {
+        termux_stream_wait(stream, -1);
+    }
+    termux_stream_close(stream);
+    return ctx[0];
+}
+
+int main(void)
+{
+    int fail = 0;
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/replay%i", (int)getpid());
+
+    /* one second of an accelerometer at 100Hz and a light sensor at 10Hz */
+    termux_record_s *record = termux_record_open(path, TERMUX_RECORD_DOUBLE, 64, 0);
+    for (int i = 0; i != 100; ++i)
+    {
+        double accel[3] = {i, 0, -9.81};
+        double light[1] = {i / 10 * 100};
+        termux_record(record, "BMI160 Accelerometer", accel, 3, (uint64_t)(i + 1) * STEP);
+        if (i % 10 == 0)
+        {
+            termux_record(record, "Light", light, 1, (uint64_t)(i + 1) * STEP);
+        }
+    }
+    termux_record_close(record);
+
+    fail += check_time(termux_replay(path, 0, 1) == 0, "replay as fast as possible", 0);
+    char **list = 0;
+    int n = termux_sensor_list(&list);
+    fail += check_time(n == 2 && strcmp(list[0], "BMI160 Accelerometer") == 0 && strcmp(list[1], "Light") == 0, "sensor list", 0);
+    for (int i = 0; i < n; ++i)
+    {
+        free(list[i]);
+    }
+    free(list);
+
+    int ok = 1;
+    for (int i = 0; i != 3; ++i)
+    {
+        double *values = 0;
+        ok &= termux_sensor("BMI160 Accelerometer", &values) == 3 && values[0] == i && values[2] == -9.81;
+        free(values);
+    }
+    fail += check_time(ok, "each call moves one sample on", 0);
+
+    elapse();
+    long reports = stream("accel,light", 0);
+    double ms = elapse();
+    fail += check_time(reports == 97, "stream the rest of the capture", ms);
+
+    termux_replay(path, 0, 1);
+    reports = stream("accel", 50);
+    fail += check_time(reports == 20, "stream with a delay of 50ms", elapse());
+
+    termux_replay(path, 10, 1);
+    elapse();
+    reports = stream("accel", 0);
+    ms = elapse();
+    fail += check_time(reports >= 95 && ms > 80 && ms < 300, "ten times faster than captured", ms);
+
+    FILE *file = fopen(path, "w");
+    for (int i = 0; i != 5; ++i)
+    {
+        fprintf(file, "{\n  \"BMI160 Accelerometer\": {\n    \"values\": [\n      %i,\n      0,\n      9.8\n    ]\n  }\n}\n", i);
+    }
+    fclose(file);
+    fail += check_time(termux_replay(path, 0, 20) == 0 && stream("accel", 0) == 5, "replay a transcript", elapse());
+
+    fprintf(fopen(path, "w"), "not json");
+    fail += check_time(termux_replay(path, 0, 20) != 0 && errno == EPROTO, "nothing to replay", 0);
+    termux_replay_stop();
+    unlink(path);
+    return fail;
+}
@@ -0,0 +1,145 @@
+/*!
+ @file rule.c
+ @brief Test termux api rules over the values of sensors
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/rule.h"
+#include "test.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define MS 1000000ULL
+
+static int *vibrations;
+static int fired[8];
+static double last;
+
+/* stands in for the service, a vibration takes 50ms and the torch never answers */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    if (strcmp(argv[1], "Vibrate") == 0)
+    {
+        __atomic_add_fetch(vibrations, 1, __ATOMIC_SEQ_CST);
+        usleep(50000);
+    }
+    while (strcmp(argv[1], "Torch") == 0)
+    {
+        pause();
+    }
+    return 0;
+}
+
+static void fire(int rule, int active, double value, uint64_t ns, void *arg)
+{
+    (void)ns;
+    (void)arg;
+    fired[rule] += active ? 1 : -1;
+    last = value;
+}
+
+static int stat(termux_rules_s *ctx, int rule, uint64_t rises, uint64_t falls)
+{
+    termux_rule_stat_s s;
+    return termux_rule_stat(ctx, rule, &s) == 0 && s.rises == rises && s.falls == falls && s.active == (rises > falls);
+}
+
+/* run values through the engine as one sensor, a sample each 10ms */
+static void feed(termux_rules_s *ctx, const char *sensor, const double *x, int n, uint64_t *ns)
+{
+    for (int i = 0; i != n; ++i)
+    {
+        double v[3] = {0, 0, x[i]};
+        termux_rules_eval(ctx, sensor, v, 3, *ns += 10 * MS);
+    }
+}
+
+int main(void)
+{
+    int fail = 0;
+    uint64_t ns = 1000 * MS;
+    vibrations = (int *)mmap(0, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    termux_backend(backend);
+
+    termux_rules_s *ctx = termux_rules_new();
+    static const char *const bad[] = {"accel > 1", "accel[16] > 1", "accel[0] = 1", "accel[0] > x", "accel[0] > 1 foo 2", "[0] > 1", "accel[0] > 1 hyst -1"};
+    int ok = 1;
+    for (size_t i = 0; i != sizeof(bad) / sizeof(*bad); ++i)
+    {
+        ok &= termux_rule_add(ctx, bad[i], fire, 0) == ~0 && errno == EINVAL;
+    }
+    fail += check(ok, "not rules");
+
+    int high = termux_rule_add(ctx, " accel[2] > 12 hyst 2", fire, 0);
+    int low = termux_rule_add(ctx, "Accel[2]<=-3", fire, 0);
+    int slow = termux_rule_add(ctx, "accel [ 2 ] >= 20 for 50", fire, 0);
+    int norm = termux_rule_add(ctx, "magnet[norm] > 50", fire, 0);
+    fail += check(high == 0 && low == 1 && slow == 2 && norm == 3, "rules");
+
+    static const double wave[] = {0, 13, 11, 10.5, 12.5, 9.9, 12.1, 0, -3, -2.9, -3.5};
+    feed(ctx, "BMI160 Accelerometer", wave, sizeof(wave) / sizeof(*wave), &ns);
+    fail += check(stat(ctx, high, 2, 2) && fired[high] == 0 && last == -3.5, "hysteresis");
+    fail += check(stat(ctx, low, 2, 1), "at the threshold");
+
+    /* a spike of 40ms is ignored, 60ms is not */
+    static const double spike[] = {25, 25, 25, 25, 0, 25, 25, 25, 25, 25, 25, 25, 0};
+    feed(ctx, "BMI160 Accelerometer", spike, 4, &ns);
+    fail += check(stat(ctx, slow, 0, 0), "debounce");
+    feed(ctx, "BMI160 Accelerometer", spike + 4, 9, &ns);
+    fail += check(stat(ctx, slow, 1, 0), "held long enough");
+    feed(ctx, "BMI160 Accelerometer", spike + 12, 1, &ns);
+    fail += check(stat(ctx, slow, 1, 0), "falls only once held");
+
+    double field[3] = {30, 40, 10};
+    fail += check(termux_rules_eval(ctx, "Accelerometer Uncalibrated", field, 3, ns) == 0, "another sensor");
+    /* a name that only contains the one in the rules is taken once it comes again */
+    fail += check(termux_rules_eval(ctx, "AK09918 Magnetic Field", field, 3, ns) == 0, "name taken on its second sample");
+    fail += check(termux_rules_eval(ctx, "AK09918 Magnetic Field", field, 3, ns) == 1 && last * last == 2600, "norm");
+    fail += check(termux_rules_eval(ctx, "BMI160 Accelerometer", field, 2, ns) == 0 && stat(ctx, slow, 1, 0), "missing axis");
+
+    /* the action starts without waiting, one at a time, the rule is active from the field above */
+    termux_call_s vibrate = {.call = TERMUX_CALL_VIBRATE, .in.vibrate = {.ms = 100, .force = 0}};
+    fail += check(termux_rule_action(ctx, 9, &vibrate) != 0, "no such rule");
+    termux_rule_action(ctx, norm, &vibrate);
+    static const double jolt[] = {0, 60, 0, 60, 0};
+    for (size_t i = 0; i != sizeof(jolt) / sizeof(*jolt); ++i)
+    {
+        field[0] = jolt[i];
+        field[1] = field[2] = 0;
+        termux_rules_eval(ctx, "AK09918 Magnetic Field", field, 3, 0);
+    }
+    termux_rule_stat_s s;
+    termux_rule_stat(ctx, norm, &s);
+    fail += check(s.rises == 3 && s.actions == 1 && s.busy == 1, "busy");
+    int running = 1;
+    for (int i = 0; i != 100 && running; ++i)
+    {
+        usleep(5000);
+        running = termux_rules_poll(ctx);
+    }
+    termux_rule_stat(ctx, norm, &s);
+    fail += check(running == 0 && s.failed == 0 && __atomic_load_n(vibrations, __ATOMIC_SEQ_CST) == 1, "actions");
+
+    /* an action that does not end is finished at its deadline */
+    int dark = termux_rule_add(ctx, "light[0] < 10", 0, 0);
+    termux_call_s torch = {.call = TERMUX_CALL_TORCH, .deadline = 50, .in.torch = 1};
+    termux_rule_action(ctx, dark, &torch);
+    field[0] = 1;
+    termux_rules_eval(ctx, "Light Uncalibrated", field, 1, 0);
+    fail += check(termux_rules_eval(ctx, "light", field, 1, 0) == 1, "exact name first");
+    running = 1;
+    for (int i = 0; i != 100 && running; ++i)
+    {
+        usleep(5000);
+        running = termux_rules_poll(ctx);
+    }
+    termux_rule_stat(ctx, dark, &s);
+    fail += check(running == 0 && s.actions == 1 && s.failed == 1, "action past its deadline");
+    termux_rules_free(ctx);
+    return fail;
+}
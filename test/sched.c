@@ -0,0 +1,174 @@
+/*!
+ @file sched.c
+ @brief Test termux api admission of calls and priority classes
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/call.h"
+#include "test.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static long *shared; /* children in flight and the most at once, in shared memory */
+
+/* stands in for the service, taking 30ms to reply */
+static int backend(int argc, char *argv[])
+{
+    static const char dialog[] = "{\"code\":0,\"text\":\"yes\"}";
+    static const char volume[] = "[{\"stream\":\"music\",\"volume\":6,\"max_volume\":15}]";
+    long n = __atomic_add_fetch(shared, 1, __ATOMIC_SEQ_CST);
+    long max = __atomic_load_n(shared + 1, __ATOMIC_SEQ_CST);
+    while (n > max && !__atomic_compare_exchange_n(shared + 1, &max, n, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    {
+    }
+    usleep(30000);
+    __atomic_sub_fetch(shared, 1, __ATOMIC_SEQ_CST);
+    (void)argc;
+    const char *reply = strcmp(argv[1], "Dialog") == 0 ? dialog : strcmp(argv[1], "Volume") == 0 ? volume : "";
+    return write(STDOUT_FILENO, reply, strlen(reply)) < 0;
+}
+
+static int failed = 0;
+
+static int order[8];
+static int done;
+
+static void *poll_sensor(void *arg)
+{
+    long id = (long)arg;
+    /* come in one after another */
+    usleep((useconds_t)id * 5000);
+    termux_sensor_cleanup();
+    order[__atomic_fetch_add(&done, 1, __ATOMIC_SEQ_CST)] = (int)id;
+    return 0;
+}
+
+/* let the slot go after a second whatever happens to the calls queued behind it */
+static void *release(void *arg)
+{
+    termux_call_s *call = (termux_call_s *)arg;
+    usleep(1000000);
+    termux_call_wait(call);
+    termux_call_finish(call);
+    return 0;
+}
+
+static void *cancel(void *arg)
+{
+    usleep(50000);
+    termux_cancel((termux_cancel_s *)arg);
+    return 0;
+}
+
+static void *poll_volume(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i != 4; ++i)
+    {
+        termux_volume_s volume[1];
+        termux_volume_get(volume);
+    }
+    return 0;
+}
+
+int main(void)
+{
+    shared = (long *)mmap(0, sizeof(long) * 2, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    termux_backend(backend);
+    termux_share(0);
+
+    /* one call at a time, the others wait their turn */
+    termux_sched_config(1, 0);
+    pthread_t thread[8];
+    for (long i = 0; i != 8; ++i)
+    {
+        pthread_create(thread + i, 0, poll_sensor, (void *)i);
+    }
+    for (long i = 0; i != 8; ++i)
+    {
+        pthread_join(thread[i], 0);
+    }
+    int fifo = 1;
+    for (int i = 0; i != 8; ++i)
+    {
+        fifo = fifo && order[i] == i;
+    }
+    failed += check(shared[1] == 1, "one child at a time");
+    failed += check(fifo, "first come first served within a class");
+
+    /* a dialog comes while background polls fill both slots */
+    termux_sched_config(2, 0);
+    shared[1] = 0;
+    for (long i = 0; i != 8; ++i)
+    {
+        pthread_create(thread + i, 0, poll_volume, 0);
+    }
+    usleep(50000);
+    termux_sched_s low[1], high[1];
+    termux_sched(TERMUX_PRIORITY_LOW, low);
+    failed += check(low->queued >= 4 && low->running == 2, "background polls queue");
+    failed += check(termux_dialog_confirm(0, "confirm") == 0, "dialog runs");
+    termux_sched(TERMUX_PRIORITY_HIGH, high);
+    printf("     dialog waited %luus, polls waited %luus at most\n", high->wait_max, low->wait_max);
+    failed += check(high->wait_max < 35000, "dialog overtakes the queued polls");
+
+    /* a call that does not wait is rejected while the slots are taken */
+    termux_call_s call[1] = {{.call = TERMUX_CALL_TORCH, .in.torch = 1}};
+    termux_timeout_once(1);
+    int ok = termux_call_start(call);
+    failed += check(ok == TERMUX_REJECT && errno == EAGAIN, "start without a slot is rejected");
+    termux_call_finish(call);
+    for (long i = 0; i != 8; ++i)
+    {
+        pthread_join(thread[i], 0);
+    }
+    failed += check(shared[1] == 2, "at most two children");
+    failed += check(termux_torch(1) == 0, "the deadline of a rejected call is not kept");
+
+    /* too many waiting in a class are turned away */
+    termux_sched_config(1, 2);
+    for (long i = 0; i != 8; ++i)
+    {
+        pthread_create(thread + i, 0, poll_volume, 0);
+    }
+    for (long i = 0; i != 8; ++i)
+    {
+        pthread_join(thread[i], 0);
+    }
+    termux_sched(TERMUX_PRIORITY_LOW, low);
+    printf("     polls: %lu admitted, %lu waited %luus on average, %lu rejected, %u queued at most\n",
+           low->admitted, low->waited, low->wait, low->rejected, low->queued_max);
+    failed += check(low->rejected > 0 && low->queued == 0 && low->running == 0, "deep queue rejects");
+
+    /* a call queued behind the slot gives up at its own deadline or token */
+    termux_sched_config(1, 0);
+    termux_call_s hold[1] = {{.call = TERMUX_CALL_TORCH, .in.torch = 1}};
+    failed += check(termux_call_start(hold) == 0, "the slot is taken");
+    pthread_create(thread, 0, release, hold);
+    elapse();
+    termux_timeout_once(50);
+    ok = termux_dialog_confirm(0, "confirm");
+    double ms = elapse();
+    termux_sched(TERMUX_PRIORITY_HIGH, high);
+    printf("     queued dialog gave up after %.1fms\n", ms);
+    failed += check(ok == TERMUX_TIMEOUT && ms >= 50 && ms < 500 && high->queued == 0, "a queued call keeps its deadline");
+    termux_cancel_s *token = termux_cancel_new();
+    pthread_create(thread + 1, 0, cancel, token);
+    termux_cancel_once(token);
+    ok = termux_dialog_confirm(0, "confirm");
+    ms = elapse();
+    termux_sched(TERMUX_PRIORITY_HIGH, high);
+    failed += check(ok == TERMUX_CANCEL && ms < 500 && high->queued == 0, "a queued call is cancelled");
+    pthread_join(thread[1], 0);
+    pthread_join(thread[0], 0);
+    failed += check(termux_dialog_confirm(0, "confirm") == 0, "the queue moves on");
+    termux_cancel_free(token);
+
+    munmap(shared, sizeof(long) * 2);
+    return failed;
+}
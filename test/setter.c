@@ -0,0 +1,78 @@
+/*!
+ @file setter.c
+ @brief Test termux api setters that keep only the newest value
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/setter.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+/* stands in for the service, taking 10ms to apply a value */
+static int backend(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    usleep(10000);
+    return 0;
+}
+
+static int last[TERMUX_SETTER_MAX];
+static unsigned long order; /* values applied out of order */
+
+static void applied(int target, int value, int status, void *arg)
+{
+    (void)arg;
+    printf("     applied %i %i status %i\n", target, value, status);
+    /* the values only go up, so a newer value never comes before an older one */
+    order += value < last[target];
+    last[target] = value;
+}
+
+static int failed = 0;
+
+int main(void)
+{
+    termux_backend(backend);
+    termux_setter_report(applied, 0);
+    failed += check(termux_setter(TERMUX_SETTER_TORCH, 1) == ~0, "reject before the start");
+    failed += check(termux_setter_start(50) == 0, "start");
+
+    /* a slider sweeping the brightness and a knob turning the music */
+    for (int i = 0; i != 100; ++i)
+    {
+        termux_setter(TERMUX_SETTER_BRIGHTNESS, i);
+        termux_setter(TERMUX_SETTER_VOLUME_MUSIC, i / 10);
+        usleep(2000);
+    }
+    termux_setter(TERMUX_SETTER_TORCH, 1);
+    termux_setter_flush();
+
+    termux_setter_s brightness[1], music[1], torch[1];
+    termux_setter_stats(TERMUX_SETTER_BRIGHTNESS, brightness);
+    termux_setter_stats(TERMUX_SETTER_VOLUME_MUSIC, music);
+    termux_setter_stats(TERMUX_SETTER_TORCH, torch);
+    printf("     brightness: %lu sets, %lu replaced, %lu skipped, %lu applied\n",
+           brightness->sets, brightness->replaced, brightness->skipped, brightness->applied);
+    printf("     music: %lu sets, %lu replaced, %lu skipped, %lu applied\n",
+           music->sets, music->replaced, music->skipped, music->applied);
+    failed += check(brightness->value == 99 && music->value == 9 && torch->value == 1, "newest values applied");
+    failed += check(brightness->applied < 20 && brightness->sets == 100, "rate capped");
+    failed += check(brightness->sets == brightness->replaced + brightness->skipped + brightness->applied, "every value accounted for");
+    failed += check(order == 0, "applied in order");
+
+    unsigned long skipped = torch->skipped;
+    termux_setter(TERMUX_SETTER_TORCH, 1);
+    termux_setter_flush();
+    termux_setter_stats(TERMUX_SETTER_TORCH, torch);
+    failed += check(torch->skipped == skipped + 1 && torch->applied == 1, "skip the value applied");
+
+    termux_setter(TERMUX_SETTER_BRIGHTNESS, 200);
+    termux_setter_stop();
+    termux_setter_stats(TERMUX_SETTER_BRIGHTNESS, brightness);
+    failed += check(brightness->value == 200 && !brightness->pending, "apply the last value on stop");
+    failed += check(termux_setter(TERMUX_SETTER_TORCH, 0) == ~0, "reject after the stop");
+    return failed;
+}
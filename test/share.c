@@ -0,0 +1,195 @@
+/*!
+ @file share.c
+ @brief Test termux api sharing identical reads across threads
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#include "termux/api.h"
+#include "test.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define THREADS 16
+#define ROUNDS 20
+
+static unsigned long *spawns; /* counted by the children in shared memory */
+static useconds_t slow; /* time the clipboard takes on top */
+
+/* stands in for the service, taking 20ms to reply */
+static int backend(int argc, char *argv[])
+{
+    usleep(slow);
+    static const char list[] = "{\"sensors\":[\"accel\",\"light\"]}";
+    static const char accel[] = "{\"accel\":{\"values\":[0.5,1.25,-9.81]}}";
+    static const char light[] = "{\"light\":{\"values\":[42]}}";
+    static const char volume[] = "[{\"stream\":\"music\",\"volume\":6,\"max_volume\":15}]";
+    const char *reply = "clipboard";
+    __atomic_add_fetch(spawns, 1, __ATOMIC_RELAXED);
+    usleep(20000);
+    if (strcmp(argv[1], "Sensor") == 0)
+    {
+        reply = strcmp(argv[3], "list") == 0 ? list : strcmp(argv[argc - 4], "accel") == 0 ? accel : light;
+    }
+    else if (strcmp(argv[1], "Volume") == 0)
+    {
+        reply = volume;
+    }
+    return write(STDOUT_FILENO, reply, strlen(reply)) < 0;
+}
+
+static unsigned long wrong;
+
+static void *worker(void *arg)
+{
+    long id = (long)arg;
+    for (int i = 0; i != ROUNDS; ++i)
+    {
+        int ok = 1;
+        switch ((id + i) % 4)
+        {
+        case 0:
+        {
+            termux_volume_s volume[1] = {0};
+            ok = termux_volume_get(volume) == 0 && volume->music->volume == 6 && volume->music->max_volume == 15;
+        }
+        break;
+        case 1:
+        {
+            char **sensor = 0;
+            int n = termux_sensor_list(&sensor);
+            ok = n == 2 && strcmp(sensor[0], "accel") == 0 && strcmp(sensor[1], "light") == 0;
+            for (int k = 0; k < n; ++k)
+            {
+                free(sensor[k]);
+            }
+            free(sensor);
+        }
+        break;
+        case 2:
+        {
+            /* reads of different sensors must not be mixed up */
+            double *values = 0;
+            char *name = (id & 1) ? "accel" : "light";
+            int n = termux_sensor(name, &values);
+            ok = (id & 1) ? n == 3 && values[2] == -9.81 : n == 1 && values[0] == 42;
+            free(values);
+        }
+        break;
+        default:
+        {
+            char *data = 0;
+            size_t byte = 0;
+            ok = termux_clipboard_get(&data, &byte) == 0 && byte == 9 && strcmp(data, "clipboard") == 0;
+            free(data);
+        }
+        }
+        if (!ok)
+        {
+            __atomic_add_fetch(&wrong, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return 0;
+}
+
+static void *leader(void *arg)
+{
+    char *data = 0;
+    size_t byte = 0;
+    *(int *)arg = termux_clipboard_get(&data, &byte);
+    free(data);
+    return 0;
+}
+
+static void *trigger(void *arg)
+{
+    usleep(50000);
+    termux_cancel((termux_cancel_s *)arg);
+    return 0;
+}
+
+/* a read that joins a slow one gives up on its own terms */
+static int join(void)
+{
+    int fail = 0, status = ~0;
+    char *data = 0;
+    size_t byte = 0;
+    pthread_t thread[2];
+    termux_timeout(TERMUX_API_CLIPBOARD_GET, 1000, 1000, 1);
+    slow = 300000;
+    pthread_create(thread, 0, leader, &status);
+    usleep(50000);
+    elapse();
+    termux_timeout_once(50);
+    int ok = termux_clipboard_get(&data, &byte);
+    double ms = elapse();
+    fail += check(ok == TERMUX_TIMEOUT && errno == ETIMEDOUT && ms < 150 && data == 0, "joined read past its deadline");
+
+    termux_cancel_s *token = termux_cancel_new();
+    pthread_create(thread + 1, 0, trigger, token);
+    termux_cancel_once(token);
+    ok = termux_clipboard_get(&data, &byte);
+    ms = elapse();
+    fail += check(ok == TERMUX_CANCEL && errno == ECANCELED && ms < 150, "joined read cancelled");
+    pthread_join(thread[1], 0);
+    termux_cancel_free(token);
+
+    ok = termux_clipboard_get(&data, &byte);
+    fail += check(ok == 0 && byte == 9, "joined read without a deadline of its own");
+    free(data);
+    pthread_join(thread[0], 0);
+    fail += check(status == 0, "the read joined");
+    slow = 0;
+    return fail;
+}
+
+static unsigned long shared(void)
+{
+    static const int api[] = {TERMUX_API_VOLUME_GET, TERMUX_API_SENSOR_LIST, TERMUX_API_SENSOR, TERMUX_API_CLIPBOARD_GET};
+    unsigned long n = 0;
+    for (size_t i = 0; i != sizeof(api) / sizeof(*api); ++i)
+    {
+        termux_latency_s ctx[1];
+        termux_latency(api[i], ctx);
+        n += ctx->shared;
+    }
+    return n;
+}
+
+static unsigned long run(void)
+{
+    pthread_t thread[THREADS];
+    *spawns = 0;
+    for (long i = 0; i != THREADS; ++i)
+    {
+        pthread_create(thread + i, 0, worker, (void *)i);
+    }
+    for (long i = 0; i != THREADS; ++i)
+    {
+        pthread_join(thread[i], 0);
+    }
+    return *spawns;
+}
+
+int main(void)
+{
+    spawns = (unsigned long *)mmap(0, sizeof(*spawns), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    termux_backend(backend);
+
+    unsigned long calls = THREADS * ROUNDS;
+    termux_share(0);
+    unsigned long alone = run();
+    printf("%lu reads, not shared: %lu spawned, %lu shared\n", calls, alone, shared());
+    termux_share(1);
+    unsigned long spawned = run();
+    unsigned long n = shared();
+    printf("%lu reads, shared:     %lu spawned, %lu shared, %lu wrong\n", calls, spawned, n, wrong);
+
+    int fail = join();
+    munmap(spawns, sizeof(*spawns));
+    return fail + !(alone == calls && spawned < calls && spawned + n == calls && wrong == 0);
+}
@@ -0,0 +1,54 @@
+/*!
+ @file test.h
+ @brief helpers shared by the tests
+ @copyright Copyright (C) 2020-present tqfx, All rights reserved.
+*/
+
+#ifndef __TERMUX_TEST_H__
+#define __TERMUX_TEST_H__
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*!
+ @brief print the result of a check
+ @return 1 if it failed, to be added to the failures of the test
+*/
+static inline int check(int expr, const char *what)
+{
+    printf("%-5s %s\n", expr ? "ok" : "FAIL", what);
+    return !expr;
+}
+
+/*!
+ @brief time since the last call, millisecond
+*/
+static inline double elapse(void)
+{
+    static struct timespec t0;
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    double ms = (double)(t.tv_sec - t0.tv_sec) * 1e3 + (double)(t.tv_nsec - t0.tv_nsec) / 1e6;
+    t0 = t;
+    return ms;
+}
+
+/*!
+ @brief integer extra of a call passed to a backend, as "--ei name value" puts it
+ @return the value, or value if the call has no such extra
+*/
+static inline int backend_int(int argc, char *argv[], const char *name, int value)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (strcmp(argv[i], name) == 0)
+        {
+            value = atoi(argv[i + 1]);
+        }
+    }
+    return value;
+}
+
+#endif /* __TERMUX_TEST_H__ */
@@ -151,3 +151,262 @@ target("volume")
     add_files("volume.c")
     add_deps("termux_api")
 target_end()
+
+target("latency")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("latency.c")
+    add_deps("termux_api")
+target_end()
+
+target("breaker")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("breaker.c")
+    add_deps("termux_api")
+target_end()
+
+target("init")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("init.c")
+    add_deps("termux_api")
+target_end()
+
+target("bench_api")
+    set_group("bench")
+    set_default(false)
+    set_kind("binary")
+    add_files("bench_api.cpp")
+    add_deps("termux_api")
+target_end()
+
+target("co")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    set_languages("c++20")
+    add_files("co.cpp")
+    add_deps("termux_api")
+target_end()
+
+target("loop")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    set_languages("c++20")
+    add_files("loop.cpp")
+    add_deps("termux_api")
+target_end()
+
+target("bench_co")
+    set_group("bench")
+    set_default(false)
+    set_kind("binary")
+    set_languages("c++20")
+    add_files("bench_co.cpp")
+    add_deps("termux_api")
+target_end()
+
+target("prepared")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("prepared.c")
+    add_deps("termux_api")
+target_end()
+
+target("batch")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("batch.c")
+    add_deps("termux_api")
+target_end()
+
+target("bench_batch")
+    set_group("bench")
+    set_default(false)
+    set_kind("binary")
+    add_files("bench_batch.c")
+    add_deps("termux_api")
+target_end()
+
+target("share")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("share.c")
+    add_deps("termux_api")
+target_end()
+
+target("setter")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("setter.c")
+    add_deps("termux_api")
+target_end()
+
+target("sched")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("sched.c")
+    add_deps("termux_api")
+target_end()
+
+target("bucket")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("bucket.c")
+    add_deps("termux_api")
+target_end()
+
+target("cancel")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("cancel.c")
+    add_deps("termux_api")
+target_end()
+
+target("bus")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("bus.c")
+    add_deps("termux_api")
+target_end()
+
+target("latest")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("latest.c")
+    add_deps("termux_api")
+target_end()
+
+target("fanout")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("fanout.c")
+    add_deps("termux_api")
+target_end()
+
+target("reader")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("reader.c")
+    add_deps("termux_api")
+target_end()
+
+target("metrics")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("metrics.c")
+    add_deps("termux_api")
+target_end()
+
+target("adapt")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("adapt.c")
+    add_deps("termux_api")
+target_end()
+
+target("record")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("record.c")
+    add_deps("termux_api")
+target_end()
+
+target("replay")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("replay.c")
+    add_deps("termux_api")
+target_end()
+
+target("gorilla")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("gorilla.c")
+    add_deps("termux_api")
+target_end()
+
+target("bench_gorilla")
+    set_group("bench")
+    set_default(false)
+    set_kind("binary")
+    add_files("bench_gorilla.c")
+    add_deps("termux_api")
+target_end()
+
+target("aggregate")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("aggregate.c")
+    add_deps("termux_api")
+target_end()
+
+target("bench_aggregate")
+    set_group("bench")
+    set_default(false)
+    set_kind("binary")
+    add_files("bench_aggregate.c")
+    add_deps("termux_api")
+target_end()
+
+target("fusion")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("fusion.c")
+    add_deps("termux_api")
+target_end()
+
+target("bench_fusion")
+    set_group("bench")
+    set_default(false)
+    set_kind("binary")
+    add_files("bench_fusion.c")
+    add_deps("termux_api")
+target_end()
+
+target("align")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("align.c")
+    add_deps("termux_api")
+target_end()
+
+target("rule")
+    set_group("test")
+    set_default(false)
+    set_kind("binary")
+    add_files("rule.c")
+    add_deps("termux_api")
+target_end()
+
+target("bench_rule")
+    set_group("bench")
+    set_default(false)
+    set_kind("binary")
+    add_files("bench_rule.c")
+    add_deps("termux_api")
+target_end()
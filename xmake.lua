@@ -47,10 +47,11 @@ target("termux_api")
     add_defines("_GNU_SOURCE=1")
     -- add link libraries
     add_links("termux-api", "jansson", {public = true})
+    add_syslinks("m", {public = true})
     -- add include directories
     add_includedirs("include", {public = true})
     -- add the header files for installing
-    add_headerfiles("include/(**.h)")
+    add_headerfiles("include/(**.h)", "include/(**.hpp)")
     -- add the common source files
     add_files("src/**.c")
 target_end()